@@ -90,6 +90,7 @@ static char * _bookmark_autocomplete(const char * const input);
 static char * _otr_autocomplete(const char * const input);
 static char * _connect_autocomplete(const char * const input);
 static char * _statuses_autocomplete(const char * const input);
+static char * _xmlconsole_autocomplete(const char * const input);
 static char * _alias_autocomplete(const char * const input);
 static char * _join_autocomplete(const char * const input);
 static char * _log_autocomplete(const char * const input);
@@ -103,6 +104,7 @@ static char * _role_autocomplete(const char * const input);
 static char * _resource_autocomplete(const char * const input);
 static char * _titlebar_autocomplete(const char * const input);
 static char * _inpblock_autocomplete(const char * const input);
+static char * _scrollback_autocomplete(const char * const input);
 static char * _time_autocomplete(const char * const input);
 
 GHashTable *commands = NULL;
@@ -682,6 +684,15 @@ static struct cmd_t command_defs[] =
           "Enable or disable word wrapping in the main window.",
           NULL } } },
 
+    { "/snapshot",
+        cmd_snapshot, parse_args, 1, 1, &cons_snapshot_setting,
+        { "/snapshot on|off", "Restore windows from the last session.",
+        { "/snapshot on|off",
+          "----------------",
+          "Save chat, room and private windows with their scrollback on exit and every few minutes.",
+          "When starting with an account to connect to, the saved windows are shown straight away while connecting.",
+          NULL } } },
+
     { "/time",
         cmd_time, parse_args, 1, 2, &cons_time_setting,
         { "/time setting|statusbar [setting]", "Time display.",
@@ -708,6 +719,21 @@ static struct cmd_t command_defs[] =
           "dynamic on|off : Start with 0 millis and dynamically increase up to timeout when no activity, default: on.",
           NULL } } },
 
+    { "/scrollback",
+        cmd_scrollback, parse_args, 2, 2, &cons_scrollback_setting,
+        { "/scrollback budget|spill [kilobytes|on|off]", "Limit memory used by window scrollback.",
+        { "/scrollback budget|spill [kilobytes|on|off]",
+          "-------------------------------------------",
+          "Limit the scrollback kept in memory for all windows together.",
+          "When over the budget the oldest lines are dropped, starting with the windows viewed least recently.",
+          "The memory used by each window is shown by /wins.",
+          "",
+          "budget kilobytes : Total scrollback to keep in kilobytes, 0 for no limit, default: 0.",
+          "spill on|off     : Write dropped room messages to the room logs when /grlog is off, default: off.",
+          "",
+          "Example: /scrollback budget 4096",
+          NULL } } },
+
     { "/notify",
         cmd_notify, parse_args, 2, 3, &cons_notify_setting,
         { "/notify [type value]|[type setting value]", "Control various desktop notifications.",
@@ -902,15 +928,50 @@ static struct cmd_t command_defs[] =
 
     { "/log",
         cmd_log, parse_args, 1, 2, &cons_log_setting,
-        { "/log where|rotate|maxsize|shared [value]", "Manage system logging settings.",
-        { "/log where|rotate|maxsize|shared [value]",
-          "----------------------------------------",
+        { "/log where|rotate|maxsize|generations|compress|shared [value]", "Manage system logging settings.",
+        { "/log where|rotate|maxsize|generations|compress|shared [value]",
+          "-------------------------------------------------------------",
           "Manage profanity logging settings.",
           "",
-          "where         : Show the current log file location.",
-          "rotate on|off : Rotate log, default on.",
-          "maxsize bytes : With rotate enabled, specifies the max log size, defaults to 1048580 (1MB).",
-          "shared on|off : Share logs between all instances, default: on.",
+          "where              : Show the current log file location.",
+          "rotate on|off      : Rotate log, default on.",
+          "maxsize bytes      : With rotate enabled, specifies the max log size, defaults to 1048580 (1MB).",
+          "generations number : With rotate enabled, number of rotated logs to keep, defaults to 1.",
+          "compress on|off    : Compress rotated logs and chat logs from previous days in the background, default off.",
+          "shared on|off      : Share logs between all instances, default: on.",
+          NULL } } },
+
+    { "/logsearch",
+        cmd_logsearch, parse_args_with_freetext, 1, 2, NULL,
+        { "/logsearch words|open number", "Search chat logs.",
+        { "/logsearch words|open number",
+          "----------------------------",
+          "Search the chat and room logs of the connected account.",
+          "Lines containing all of the words are listed, most recent days first.",
+          "Logs written before the search index existed are indexed in the background.",
+          "",
+          "words       : The words to search for, case is ignored.",
+          "open number : Open the conversation at a numbered result of the last search.",
+          "",
+          "Example: /logsearch release party",
+          "Example: /logsearch open 2",
+          NULL } } },
+
+    { "/find",
+        cmd_find, parse_args_with_freetext, 1, 1, NULL,
+        { "/find text|older|newer|clear", "Search the current window.",
+        { "/find text|older|newer|clear",
+          "----------------------------",
+          "Search the scrollback of the current window, the most recent match is shown first.",
+          "Adding to the text of the last search narrows the existing matches.",
+          "",
+          "text  : Find lines containing the text, case is ignored.",
+          "older : Show the previous older match.",
+          "newer : Show the next more recent match.",
+          "clear : End the search and return to the bottom of the window.",
+          "",
+          "Example: /find release",
+          "Example: /find older",
           NULL } } },
 
     { "/carbons",
@@ -922,6 +983,27 @@ static struct cmd_t command_defs[] =
         "The message carbons feature ensures that both sides of all conversations are shared with all the user's clients that implement this protocol.",
         NULL  } } },
 
+    { "/sm",
+      cmd_sm, parse_args, 1, 1, &cons_sm_setting,
+      { "/sm on|off", "Stream management.",
+      { "/sm on|off",
+        "----------",
+        "Enable or disable stream management (XEP-0198), default off.",
+        "The server acknowledges the stanzas it receives, messages it has not acknowledged when the connection drops are sent again after reconnecting.",
+        "Only enable when the server supports it, switching off takes effect on the next connect.",
+        NULL  } } },
+
+    { "/csi",
+      cmd_csi, parse_args, 1, 1, &cons_csi_setting,
+      { "/csi on|off", "Client state indication.",
+      { "/csi on|off",
+        "-----------",
+        "Enable or disable client state indication (XEP-0352), default off.",
+        "When idle for the autoaway time, or when the terminal loses focus, the server is told the client is inactive.",
+        "The server then holds back presence updates and chat states and delivers them in batches.",
+        "Only enable when the server supports it.",
+        NULL  } } },
+
     { "/reconnect",
         cmd_reconnect, parse_args, 1, 1, &cons_reconnect_setting,
         { "/reconnect seconds", "Set reconnect interval.",
@@ -949,6 +1031,15 @@ static struct cmd_t command_defs[] =
           "If no target is supplied, your chat server will be pinged.",
           NULL } } },
 
+    { "/traffic",
+        cmd_traffic, parse_args, 0, 0, NULL,
+        { "/traffic", "Show bytes sent and received.",
+        { "/traffic",
+          "--------",
+          "Show the bytes of XML sent and received since the last login.",
+          "When compression_estimate is on for the account, also estimate what zlib stream compression would have sent.",
+          NULL } } },
+
     { "/autoaway",
         cmd_autoaway, parse_args_with_freetext, 2, 2, &cons_autoaway_setting,
         { "/autoaway mode|time|message|check value", "Set auto idle/away properties.",
@@ -1012,6 +1103,7 @@ static struct cmd_t command_defs[] =
           "muc                     : The default MUC chat service to use.",
           "nick                    : The default nickname to use when joining chat rooms.",
           "otr                     : Override global OTR policy for this account: manual, opportunistic or always.",
+          "compression_estimate    : Estimate what zlib stream compression (XEP-0138) would save, the stream is not compressed: on or off, see /traffic.",
           "",
           "Example: /account add me",
           "Example: /account set me jid me@chatty",
@@ -1090,11 +1182,21 @@ static struct cmd_t command_defs[] =
           NULL } } },
 
     { "/xmlconsole",
-        cmd_xmlconsole, parse_args, 0, 0, NULL,
-        { "/xmlconsole", "Open the XML console",
-        { "/xmlconsole",
-          "-----------",
+        cmd_xmlconsole, parse_args, 0, 2, NULL,
+        { "/xmlconsole [dir|kind|jid|clear] [value]", "Open or filter the XML console",
+        { "/xmlconsole [dir|kind|jid|clear] [value]",
+          "----------------------------------------",
           "Open the XML console to view incoming and outgoing XMPP traffic.",
+          "Traffic is only captured while the console is open, the most recent 1MB is kept.",
+          "",
+          "dir in|out|both                  : Show only received or sent stanzas, default both.",
+          "kind message|presence|iq|all     : Show only one kind of stanza, default all.",
+          "jid jid|off                      : Show only stanzas to or from a JID, a barejid matches all resources.",
+          "clear                            : Discard the captured stanzas.",
+          "",
+          "Example: /xmlconsole dir in",
+          "Example: /xmlconsole kind iq",
+          "Example: /xmlconsole jid someroom@conference.server.org",
           NULL } } },
 
     { "/away",
@@ -1184,6 +1286,9 @@ static Autocomplete otr_policy_ac;
 static Autocomplete connect_property_ac;
 static Autocomplete statuses_ac;
 static Autocomplete statuses_setting_ac;
+static Autocomplete xmlconsole_ac;
+static Autocomplete xmlconsole_dir_ac;
+static Autocomplete xmlconsole_kind_ac;
 static Autocomplete alias_ac;
 static Autocomplete aliases_ac;
 static Autocomplete join_property_ac;
@@ -1200,6 +1305,8 @@ static Autocomplete time_ac;
 static Autocomplete time_statusbar_ac;
 static Autocomplete resource_ac;
 static Autocomplete inpblock_ac;
+static Autocomplete find_ac;
+static Autocomplete scrollback_ac;
 
 /*
  * Initialise command autocompleter and history
@@ -1300,6 +1407,8 @@ cmd_init(void)
 
     log_ac = autocomplete_new();
     autocomplete_add(log_ac, "maxsize");
+    autocomplete_add(log_ac, "generations");
+    autocomplete_add(log_ac, "compress");
     autocomplete_add(log_ac, "rotate");
     autocomplete_add(log_ac, "shared");
     autocomplete_add(log_ac, "where");
@@ -1356,6 +1465,7 @@ cmd_init(void)
     autocomplete_add(account_set_ac, "muc");
     autocomplete_add(account_set_ac, "nick");
     autocomplete_add(account_set_ac, "otr");
+    autocomplete_add(account_set_ac, "compression_estimate");
 
     account_clear_ac = autocomplete_new();
     autocomplete_add(account_clear_ac, "password");
@@ -1486,6 +1596,23 @@ cmd_init(void)
     autocomplete_add(statuses_setting_ac, "online");
     autocomplete_add(statuses_setting_ac, "none");
 
+    xmlconsole_ac = autocomplete_new();
+    autocomplete_add(xmlconsole_ac, "dir");
+    autocomplete_add(xmlconsole_ac, "kind");
+    autocomplete_add(xmlconsole_ac, "jid");
+    autocomplete_add(xmlconsole_ac, "clear");
+
+    xmlconsole_dir_ac = autocomplete_new();
+    autocomplete_add(xmlconsole_dir_ac, "in");
+    autocomplete_add(xmlconsole_dir_ac, "out");
+    autocomplete_add(xmlconsole_dir_ac, "both");
+
+    xmlconsole_kind_ac = autocomplete_new();
+    autocomplete_add(xmlconsole_kind_ac, "message");
+    autocomplete_add(xmlconsole_kind_ac, "presence");
+    autocomplete_add(xmlconsole_kind_ac, "iq");
+    autocomplete_add(xmlconsole_kind_ac, "all");
+
     alias_ac = autocomplete_new();
     autocomplete_add(alias_ac, "add");
     autocomplete_add(alias_ac, "remove");
@@ -1557,6 +1684,15 @@ cmd_init(void)
     inpblock_ac = autocomplete_new();
     autocomplete_add(inpblock_ac, "timeout");
     autocomplete_add(inpblock_ac, "dynamic");
+
+    find_ac = autocomplete_new();
+    autocomplete_add(find_ac, "older");
+    autocomplete_add(find_ac, "newer");
+    autocomplete_add(find_ac, "clear");
+
+    scrollback_ac = autocomplete_new();
+    autocomplete_add(scrollback_ac, "budget");
+    autocomplete_add(scrollback_ac, "spill");
 }
 
 void
@@ -1598,6 +1734,9 @@ cmd_uninit(void)
     autocomplete_free(connect_property_ac);
     autocomplete_free(statuses_ac);
     autocomplete_free(statuses_setting_ac);
+    autocomplete_free(xmlconsole_ac);
+    autocomplete_free(xmlconsole_dir_ac);
+    autocomplete_free(xmlconsole_kind_ac);
     autocomplete_free(alias_ac);
     autocomplete_free(aliases_ac);
     autocomplete_free(join_property_ac);
@@ -1614,6 +1753,8 @@ cmd_uninit(void)
     autocomplete_free(time_statusbar_ac);
     autocomplete_free(resource_ac);
     autocomplete_free(inpblock_ac);
+    autocomplete_free(find_ac);
+    autocomplete_free(scrollback_ac);
 }
 
 gboolean
@@ -1764,6 +1905,9 @@ cmd_reset_autocomplete()
     autocomplete_reset(connect_property_ac);
     autocomplete_reset(statuses_ac);
     autocomplete_reset(statuses_setting_ac);
+    autocomplete_reset(xmlconsole_ac);
+    autocomplete_reset(xmlconsole_dir_ac);
+    autocomplete_reset(xmlconsole_kind_ac);
     autocomplete_reset(alias_ac);
     autocomplete_reset(aliases_ac);
     autocomplete_reset(join_property_ac);
@@ -1780,6 +1924,8 @@ cmd_reset_autocomplete()
     autocomplete_reset(time_statusbar_ac);
     autocomplete_reset(resource_ac);
     autocomplete_reset(inpblock_ac);
+    autocomplete_reset(find_ac);
+    autocomplete_reset(scrollback_ac);
 
     if (ui_current_win_type() == WIN_CHAT) {
         ProfChatWin *chatwin = wins_get_current_chat();
@@ -1968,13 +2114,12 @@ _cmd_execute_default(const char * inp)
                         if (prefs_get_boolean(PREF_CHLOG)) {
                             const char *jid = jabber_get_fulljid();
                             Jid *jidp = jid_create(jid);
-                            char *pref_otr_log = prefs_get_string(PREF_OTR_LOG);
+                            const char *pref_otr_log = prefs_peek_string(PREF_OTR_LOG);
                             if (strcmp(pref_otr_log, "on") == 0) {
                                 chat_log_chat(jidp->barejid, chatwin->barejid, plugin_message, PROF_OUT_LOG, NULL);
                             } else if (strcmp(pref_otr_log, "redact") == 0) {
                                 chat_log_chat(jidp->barejid, chatwin->barejid, "[redacted]", PROF_OUT_LOG, NULL);
                             }
-                            prefs_free_string(pref_otr_log);
                             jid_destroy(jidp);
                         }
 
@@ -2053,7 +2198,7 @@ _cmd_complete_parameters(const char * const input)
     // autocomplete boolean settings
     gchar *boolean_choices[] = { "/beep", "/intype", "/states", "/outtype",
         "/flash", "/splash", "/chlog", "/grlog", "/mouse", "/history",
-        "/vercheck", "/privileges", "/presence", "/wrap", "/carbons" };
+        "/vercheck", "/privileges", "/presence", "/wrap", "/carbons", "/snapshot", "/sm", "/csi" };
 
     for (i = 0; i < ARRAY_SIZE(boolean_choices); i++) {
         result = autocomplete_param_with_func(input, boolean_choices[i], prefs_autocomplete_boolean_choice);
@@ -2117,8 +2262,8 @@ _cmd_complete_parameters(const char * const input)
         }
     }
 
-    gchar *cmds[] = { "/help", "/prefs", "/disco", "/close", "/wins", "/subject", "/room" };
-    Autocomplete completers[] = { help_ac, prefs_ac, disco_ac, close_ac, wins_ac, subject_ac, room_ac };
+    gchar *cmds[] = { "/help", "/prefs", "/disco", "/close", "/wins", "/subject", "/room", "/find" };
+    Autocomplete completers[] = { help_ac, prefs_ac, disco_ac, close_ac, wins_ac, subject_ac, room_ac, find_ac };
 
     for (i = 0; i < ARRAY_SIZE(cmds); i++) {
         result = autocomplete_param_with_ac(input, cmds[i], completers[i], TRUE);
@@ -2153,7 +2298,9 @@ _cmd_complete_parameters(const char * const input)
     g_hash_table_insert(ac_funcs, "/resource",      _resource_autocomplete);
     g_hash_table_insert(ac_funcs, "/titlebar",      _titlebar_autocomplete);
     g_hash_table_insert(ac_funcs, "/inpblock",      _inpblock_autocomplete);
+    g_hash_table_insert(ac_funcs, "/scrollback",    _scrollback_autocomplete);
     g_hash_table_insert(ac_funcs, "/time",          _time_autocomplete);
+    g_hash_table_insert(ac_funcs, "/xmlconsole",    _xmlconsole_autocomplete);
 
     int len = strlen(input);
     char parsed[len+1];
@@ -2681,6 +2828,24 @@ _inpblock_autocomplete(const char * const input)
     return NULL;
 }
 
+static char *
+_scrollback_autocomplete(const char * const input)
+{
+    char *found = NULL;
+
+    found = autocomplete_param_with_func(input, "/scrollback spill", prefs_autocomplete_boolean_choice);
+    if (found != NULL) {
+        return found;
+    }
+
+    found = autocomplete_param_with_ac(input, "/scrollback", scrollback_ac, FALSE);
+    if (found != NULL) {
+        return found;
+    }
+
+    return NULL;
+}
+
 static char *
 _form_autocomplete(const char * const input)
 {
@@ -2977,6 +3142,29 @@ _statuses_autocomplete(const char * const input)
     return NULL;
 }
 
+static char *
+_xmlconsole_autocomplete(const char * const input)
+{
+    char *result = NULL;
+
+    result = autocomplete_param_with_ac(input, "/xmlconsole dir", xmlconsole_dir_ac, TRUE);
+    if (result != NULL) {
+        return result;
+    }
+
+    result = autocomplete_param_with_ac(input, "/xmlconsole kind", xmlconsole_kind_ac, TRUE);
+    if (result != NULL) {
+        return result;
+    }
+
+    result = autocomplete_param_with_ac(input, "/xmlconsole", xmlconsole_ac, TRUE);
+    if (result != NULL) {
+        return result;
+    }
+
+    return NULL;
+}
+
 static char *
 _alias_autocomplete(const char * const input)
 {
@@ -55,6 +55,7 @@
 #include "roster_list.h"
 #include "jid.h"
 #include "log.h"
+#include "log_index.h"
 #include "muc.h"
 #ifdef PROF_HAVE_LIBOTR
 #include "otr/otr.h"
@@ -64,11 +65,14 @@
 #include "tools/autocomplete.h"
 #include "tools/parser.h"
 #include "tools/tinyurl.h"
+#include "tools/worker.h"
 #include "xmpp/xmpp.h"
 #include "xmpp/bookmark.h"
 #include "ui/ui.h"
 #include "ui/windows.h"
 
+#define LOGSEARCH_MAX_RESULTS 20
+
 static void _update_presence(const resource_presence_t presence,
     const char * const show, gchar **args);
 static gboolean _cmd_set_boolean_preference(gchar *arg, struct cmd_help_t help,
@@ -78,6 +82,16 @@ static void _cmd_show_filtered_help(char *heading, gchar *cmd_filter[], int filt
 static gint _compare_commands(Command *a, Command *b);
 static void _who_room(gchar **args, struct cmd_help_t help);
 static void _who_roster(gchar **args, struct cmd_help_t help);
+static void _cmd_tiny_fetch(gpointer data);
+static void _cmd_tiny_send(gpointer data);
+
+// a /tiny request, recipient is the barejid, fulljid or room of win_type
+struct tiny_job_t {
+    win_type_t win_type;
+    char *recipient;
+    char *url;
+    char *tiny;
+};
 
 extern GHashTable *commands;
 
@@ -405,6 +419,15 @@ cmd_account(gchar **args, struct cmd_help_t help)
                         cons_show("Updated OTR policy for account %s: %s", account_name, value);
                         cons_show("");
                     }
+                } else if (strcmp(property, "compression_estimate") == 0) {
+                    if ((g_strcmp0(value, "on") != 0) && (g_strcmp0(value, "off") != 0)) {
+                        cons_show("Compression estimate must be on or off.");
+                    } else {
+                        accounts_set_compression_estimate(account_name, g_strcmp0(value, "on") == 0);
+                        cons_show("Updated compression estimate for account %s: %s", account_name, value);
+                        cons_show("Takes effect on the next connect.");
+                        cons_show("");
+                    }
                 } else if (strcmp(property, "status") == 0) {
                     if (!valid_resource_presence_string(value) && (strcmp(value, "last") != 0)) {
                         cons_show("Invalid status: %s", value);
@@ -700,19 +723,20 @@ cmd_help(gchar **args, struct cmd_help_t help)
     } else if (strcmp(args[0], "basic") == 0) {
         gchar *filter[] = { "/about", "/clear", "/close", "/connect",
             "/disconnect", "/help", "/msg", "/join", "/quit", "/vercheck",
-            "/wins", "/ping" };
+            "/wins", "/ping", "/traffic" };
         _cmd_show_filtered_help("Basic commands", filter, ARRAY_SIZE(filter));
 
     } else if (strcmp(args[0], "chatting") == 0) {
         gchar *filter[] = { "/chlog", "/otr", "/gone", "/history",
             "/info", "/intype", "/msg", "/notify", "/outtype", "/status",
-            "/close", "/clear", "/tiny" };
+            "/close", "/clear", "/tiny", "/logsearch", "/find" };
         _cmd_show_filtered_help("Chat commands", filter, ARRAY_SIZE(filter));
 
     } else if (strcmp(args[0], "groupchat") == 0) {
         gchar *filter[] = { "/close", "/clear", "/decline", "/grlog",
             "/invite", "/invites", "/join", "/leave", "/notify", "/msg", "/room",
-            "/rooms", "/tiny", "/who", "/nick", "/privileges", "/info", "/occupants" };
+            "/rooms", "/tiny", "/who", "/nick", "/privileges", "/info", "/occupants",
+            "/find" };
         _cmd_show_filtered_help("Groupchat commands", filter, ARRAY_SIZE(filter));
 
     } else if (strcmp(args[0], "presences") == 0) {
@@ -734,7 +758,8 @@ cmd_help(gchar **args, struct cmd_help_t help)
             "/carbons", "/chlog", "/flash", "/gone", "/grlog", "/history", "/intype",
             "/log", "/mouse", "/notify", "/outtype", "/prefs", "/priority",
             "/reconnect", "/roster", "/splash", "/states", "/statuses", "/theme",
-            "/titlebar", "/vercheck", "/privileges", "/occupants", "/presence", "/wrap" };
+            "/titlebar", "/vercheck", "/privileges", "/occupants", "/presence", "/wrap",
+            "/scrollback", "/snapshot", "/sm", "/csi" };
         _cmd_show_filtered_help("Settings commands", filter, ARRAY_SIZE(filter));
 
     } else if (strcmp(args[0], "navigation") == 0) {
@@ -1276,13 +1301,12 @@ cmd_msg(gchar **args, struct cmd_help_t help)
                     if (((win_type == WIN_CHAT) || (win_type == WIN_CONSOLE)) && prefs_get_boolean(PREF_CHLOG)) {
                         const char *jid = jabber_get_fulljid();
                         Jid *jidp = jid_create(jid);
-                        char *pref_otr_log = prefs_get_string(PREF_OTR_LOG);
+                        const char *pref_otr_log = prefs_peek_string(PREF_OTR_LOG);
                         if (strcmp(pref_otr_log, "on") == 0) {
                             chat_log_chat(jidp->barejid, barejid, plugin_message, PROF_OUT_LOG, NULL);
                         } else if (strcmp(pref_otr_log, "redact") == 0) {
                             chat_log_chat(jidp->barejid, barejid, "[redacted]", PROF_OUT_LOG, NULL);
                         }
-                        prefs_free_string(pref_otr_log);
                         jid_destroy(jidp);
                     }
                 } else {
@@ -3074,74 +3098,110 @@ cmd_tiny(gchar **args, struct cmd_help_t help)
             ui_current_error_line(error->str);
         }
         g_string_free(error, TRUE);
-    } else if (win_type != WIN_CONSOLE) {
-        char *tiny = tinyurl_get(url);
+        return TRUE;
+    }
 
-        if (tiny != NULL) {
-            if (win_type == WIN_CHAT) {
-                ProfChatWin *chatwin = wins_get_current_chat();
-#ifdef PROF_HAVE_LIBOTR
-                if (otr_is_secure(chatwin->barejid)) {
-                    char *encrypted = otr_encrypt_message(chatwin->barejid, tiny);
-                    if (encrypted != NULL) {
-                        message_send_chat_encrypted(chatwin->barejid, encrypted);
-                        otr_free_message(encrypted);
-                        if (prefs_get_boolean(PREF_CHLOG)) {
-                            const char *jid = jabber_get_fulljid();
-                            Jid *jidp = jid_create(jid);
-                            char *pref_otr_log = prefs_get_string(PREF_OTR_LOG);
-                            if (strcmp(pref_otr_log, "on") == 0) {
-                                chat_log_chat(jidp->barejid, chatwin->barejid, tiny, PROF_OUT_LOG, NULL);
-                            } else if (strcmp(pref_otr_log, "redact") == 0) {
-                                chat_log_chat(jidp->barejid, chatwin->barejid, "[redacted]", PROF_OUT_LOG, NULL);
-                            }
-                            prefs_free_string(pref_otr_log);
-                            jid_destroy(jidp);
-                        }
+    char *recipient = NULL;
+    if (win_type == WIN_CHAT) {
+        ProfChatWin *chatwin = wins_get_current_chat();
+        recipient = chatwin->barejid;
+    } else if (win_type == WIN_PRIVATE) {
+        ProfPrivateWin *privatewin = wins_get_current_private();
+        recipient = privatewin->fulljid;
+    } else if (win_type == WIN_MUC) {
+        ProfMucWin *mucwin = wins_get_current_muc();
+        recipient = mucwin->roomjid;
+    }
 
-                        ui_outgoing_chat_msg("me", chatwin->barejid, tiny);
-                    } else {
-                        cons_show_error("Failed to send message.");
-                    }
-                } else {
-                    message_send_chat(chatwin->barejid, tiny);
-                    if (prefs_get_boolean(PREF_CHLOG)) {
-                        const char *jid = jabber_get_fulljid();
-                        Jid *jidp = jid_create(jid);
-                        chat_log_chat(jidp->barejid, chatwin->barejid, tiny, PROF_OUT_LOG, NULL);
-                        jid_destroy(jidp);
-                    }
+    if (recipient == NULL) {
+        cons_show("/tiny can only be used in chat windows");
+        return TRUE;
+    }
 
-                    ui_outgoing_chat_msg("me", chatwin->barejid, tiny);
-                }
-#else
-                message_send_chat(chatwin->barejid, tiny);
+    // the url is fetched off the main thread and sent to the window it was
+    // requested from, even if that is no longer the current window
+    struct tiny_job_t *job = malloc(sizeof(struct tiny_job_t));
+    job->win_type = win_type;
+    job->recipient = strdup(recipient);
+    job->url = strdup(url);
+    job->tiny = NULL;
+    worker_submit(_cmd_tiny_fetch, _cmd_tiny_send, job);
+
+    return TRUE;
+}
+
+static void
+_cmd_tiny_fetch(gpointer data)
+{
+    struct tiny_job_t *job = data;
+    job->tiny = tinyurl_get(job->url);
+}
+
+static void
+_cmd_tiny_send(gpointer data)
+{
+    struct tiny_job_t *job = data;
+
+    if (job->tiny == NULL) {
+        cons_show_error("Couldn't get tinyurl.");
+    } else if (jabber_get_connection_status() != JABBER_CONNECTED) {
+        cons_show_error("Couldn't send tinyurl, disconnected.");
+    } else if (job->win_type == WIN_CHAT) {
+#ifdef PROF_HAVE_LIBOTR
+        if (otr_is_secure(job->recipient)) {
+            char *encrypted = otr_encrypt_message(job->recipient, job->tiny);
+            if (encrypted != NULL) {
+                message_send_chat_encrypted(job->recipient, encrypted);
+                otr_free_message(encrypted);
                 if (prefs_get_boolean(PREF_CHLOG)) {
                     const char *jid = jabber_get_fulljid();
                     Jid *jidp = jid_create(jid);
-                    chat_log_chat(jidp->barejid, chatwin->barejid, tiny, PROF_OUT_LOG, NULL);
+                    const char *pref_otr_log = prefs_peek_string(PREF_OTR_LOG);
+                    if (strcmp(pref_otr_log, "on") == 0) {
+                        chat_log_chat(jidp->barejid, job->recipient, job->tiny, PROF_OUT_LOG, NULL);
+                    } else if (strcmp(pref_otr_log, "redact") == 0) {
+                        chat_log_chat(jidp->barejid, job->recipient, "[redacted]", PROF_OUT_LOG, NULL);
+                    }
                     jid_destroy(jidp);
                 }
 
-                ui_outgoing_chat_msg("me", chatwin->barejid, tiny);
-#endif
-            } else if (win_type == WIN_PRIVATE) {
-                ProfPrivateWin *privatewin = wins_get_current_private();
-                message_send_private(privatewin->fulljid, tiny);
-                ui_outgoing_private_msg("me", privatewin->fulljid, tiny);
-            } else if (win_type == WIN_MUC) {
-                ProfMucWin *mucwin = wins_get_current_muc();
-                message_send_groupchat(mucwin->roomjid, tiny);
+                ui_outgoing_chat_msg("me", job->recipient, job->tiny);
+            } else {
+                cons_show_error("Failed to send message.");
             }
-            free(tiny);
         } else {
-            cons_show_error("Couldn't get tinyurl.");
+            message_send_chat(job->recipient, job->tiny);
+            if (prefs_get_boolean(PREF_CHLOG)) {
+                const char *jid = jabber_get_fulljid();
+                Jid *jidp = jid_create(jid);
+                chat_log_chat(jidp->barejid, job->recipient, job->tiny, PROF_OUT_LOG, NULL);
+                jid_destroy(jidp);
+            }
+
+            ui_outgoing_chat_msg("me", job->recipient, job->tiny);
         }
-    } else {
-        cons_show("/tiny can only be used in chat windows");
+#else
+        message_send_chat(job->recipient, job->tiny);
+        if (prefs_get_boolean(PREF_CHLOG)) {
+            const char *jid = jabber_get_fulljid();
+            Jid *jidp = jid_create(jid);
+            chat_log_chat(jidp->barejid, job->recipient, job->tiny, PROF_OUT_LOG, NULL);
+            jid_destroy(jidp);
+        }
+
+        ui_outgoing_chat_msg("me", job->recipient, job->tiny);
+#endif
+    } else if (job->win_type == WIN_PRIVATE) {
+        message_send_private(job->recipient, job->tiny);
+        ui_outgoing_private_msg("me", job->recipient, job->tiny);
+    } else if (job->win_type == WIN_MUC && muc_active(job->recipient)) {
+        message_send_groupchat(job->recipient, job->tiny);
     }
 
-    return TRUE;
+    free(job->recipient);
+    free(job->url);
+    free(job->tiny);
+    free(job);
 }
 
 gboolean
@@ -3278,6 +3338,12 @@ cmd_wrap(gchar **args, struct cmd_help_t help)
     return result;
 }
 
+gboolean
+cmd_snapshot(gchar **args, struct cmd_help_t help)
+{
+    return _cmd_set_boolean_preference(args[0], help, "Session snapshot", PREF_SNAPSHOT);
+}
+
 gboolean
 cmd_time(gchar **args, struct cmd_help_t help)
 {
@@ -3578,6 +3644,36 @@ cmd_inpblock(gchar **args, struct cmd_help_t help)
     return TRUE;
 }
 
+gboolean
+cmd_scrollback(gchar **args, struct cmd_help_t help)
+{
+    char *subcmd = args[0];
+    char *value = args[1];
+    int intval;
+
+    if (g_strcmp0(subcmd, "budget") == 0) {
+        if (_strtoi(value, &intval, 0, INT_MAX / 1024) == 0) {
+            prefs_set_scrollback_budget(intval);
+            ui_update_scrollback_budget();
+            if (intval == 0) {
+                cons_show("Scrollback budget removed.");
+            } else {
+                cons_show("Scrollback budget set to %d KB.", intval);
+            }
+        }
+
+        return TRUE;
+    }
+
+    if (g_strcmp0(subcmd, "spill") == 0) {
+        return _cmd_set_boolean_preference(value, help, "Scrollback spill", PREF_SCROLLBACK_SPILL);
+    }
+
+    cons_show("Usage: %s", help.usage);
+
+    return TRUE;
+}
+
 gboolean
 cmd_log(gchar **args, struct cmd_help_t help)
 {
@@ -3597,6 +3693,18 @@ cmd_log(gchar **args, struct cmd_help_t help)
         return TRUE;
     }
 
+    if (strcmp(subcmd, "generations") == 0) {
+        if (value == NULL) {
+            cons_show("Usage: %s", help.usage);
+            return TRUE;
+        }
+        if (_strtoi(value, &intval, 1, PREFS_MAX_LOG_GENERATIONS) == 0) {
+            prefs_set_log_generations(intval);
+            cons_show("Log generations set to %d", intval);
+        }
+        return TRUE;
+    }
+
     if (strcmp(subcmd, "rotate") == 0) {
         if (value == NULL) {
             cons_show("Usage: %s", help.usage);
@@ -3605,6 +3713,14 @@ cmd_log(gchar **args, struct cmd_help_t help)
         return _cmd_set_boolean_preference(value, help, "Log rotate", PREF_LOG_ROTATE);
     }
 
+    if (strcmp(subcmd, "compress") == 0) {
+        if (value == NULL) {
+            cons_show("Usage: %s", help.usage);
+            return TRUE;
+        }
+        return _cmd_set_boolean_preference(value, help, "Log compression", PREF_LOG_COMPRESS);
+    }
+
     if (strcmp(subcmd, "shared") == 0) {
         if (value == NULL) {
             cons_show("Usage: %s", help.usage);
@@ -3628,6 +3744,92 @@ cmd_log(gchar **args, struct cmd_help_t help)
     return TRUE;
 }
 
+gboolean
+cmd_logsearch(gchar **args, struct cmd_help_t help)
+{
+    jabber_conn_status_t conn_status = jabber_get_connection_status();
+
+    if (conn_status != JABBER_CONNECTED) {
+        cons_show("You are not currently connected.");
+        return TRUE;
+    }
+
+    if ((g_strcmp0(args[0], "open") == 0) && (args[1] != NULL)) {
+        int num = 0;
+        if (_strtoi(args[1], &num, 1, INT_MAX) == 0) {
+            LogSearchHit *hit = log_index_get_hit(num);
+            if (hit == NULL) {
+                cons_show("No log search result %d.", num);
+            } else {
+                GSList *lines = log_index_read_day(hit);
+                ui_show_log_context(hit->contact, hit->room, hit->date, lines, hit->line);
+                g_slist_free_full(lines, free);
+            }
+        }
+        return TRUE;
+    }
+
+    GString *query = g_string_new(args[0]);
+    if (args[1] != NULL) {
+        g_string_append_printf(query, " %s", args[1]);
+    }
+
+    Jid *jidp = jid_create(jabber_get_fulljid());
+    GSList *hits = log_index_search(jidp->barejid, query->str, LOGSEARCH_MAX_RESULTS);
+    jid_destroy(jidp);
+
+    if (hits == NULL) {
+        cons_show("No logs found matching: %s", query->str);
+    } else {
+        cons_show("Logs matching: %s", query->str);
+        int num = 1;
+        GSList *curr = hits;
+        while (curr != NULL) {
+            LogSearchHit *hit = curr->data;
+            cons_show("  %d: %s %s %s", num++, hit->contact, hit->date, hit->text);
+            curr = g_slist_next(curr);
+        }
+        cons_show("Use '/logsearch open <number>' to view a result.");
+    }
+
+    int pending = log_index_pending();
+    if (pending > 0) {
+        cons_show("Still indexing %d days of logs, results may be incomplete.", pending);
+    }
+
+    g_string_free(query, TRUE);
+
+    return TRUE;
+}
+
+gboolean
+cmd_find(gchar **args, struct cmd_help_t help)
+{
+    // results avoid repeating the text, they may be printed to the searched window
+    if (g_strcmp0(args[0], "clear") == 0) {
+        ui_find_clear();
+    } else if (g_strcmp0(args[0], "older") == 0) {
+        if (!ui_find_older()) {
+            cons_show("No older matches.");
+        }
+    } else if (g_strcmp0(args[0], "newer") == 0) {
+        if (!ui_find_newer()) {
+            cons_show("No newer matches.");
+        }
+    } else {
+        int count = ui_find(args[0]);
+        if (count == 0) {
+            cons_show("No matches found.");
+        } else if (count == 1) {
+            cons_show("Found 1 match.");
+        } else {
+            cons_show("Found %d matches, use '/find older' and '/find newer' to move between them.", count);
+        }
+    }
+
+    return TRUE;
+}
+
 gboolean
 cmd_reconnect(gchar **args, struct cmd_help_t help)
 {
@@ -3689,6 +3891,26 @@ cmd_ping(gchar **args, struct cmd_help_t help)
     return TRUE;
 }
 
+gboolean
+cmd_traffic(gchar **args, struct cmd_help_t help)
+{
+    TrafficStats stats;
+    jabber_get_traffic_stats(&stats);
+
+    cons_show("Sent     : %" G_GUINT64_FORMAT " bytes", stats.logical_out);
+    cons_show("Received : %" G_GUINT64_FORMAT " bytes", stats.logical_in);
+
+    // the stream is never compressed, these are what zlib would have sent
+    if (stats.estimating) {
+        double ratio_out = stats.deflated_out > 0 ? (double)stats.logical_out / stats.deflated_out : 1.0;
+        double ratio_in = stats.deflated_in > 0 ? (double)stats.logical_in / stats.deflated_in : 1.0;
+        cons_show("Sent, zlib estimate     : %" G_GUINT64_FORMAT " bytes (%.1fx smaller)", stats.deflated_out, ratio_out);
+        cons_show("Received, zlib estimate : %" G_GUINT64_FORMAT " bytes (%.1fx smaller)", stats.deflated_in, ratio_in);
+    }
+
+    return TRUE;
+}
+
 gboolean
 cmd_autoaway(gchar **args, struct cmd_help_t help)
 {
@@ -3836,10 +4058,67 @@ cmd_vercheck(gchar **args, struct cmd_help_t help)
 gboolean
 cmd_xmlconsole(gchar **args, struct cmd_help_t help)
 {
+    if (args[0] == NULL) {
+        if (!ui_xmlconsole_exists()) {
+            ui_create_xmlconsole_win();
+        } else {
+            ui_open_xmlconsole_win();
+        }
+        return TRUE;
+    }
+
     if (!ui_xmlconsole_exists()) {
-        ui_create_xmlconsole_win();
+        cons_show("The XML console is not open.");
+        return TRUE;
+    }
+
+    if (strcmp(args[0], "clear") == 0) {
+        ui_xmlconsole_clear();
+        cons_show("XML console cleared.");
+        return TRUE;
+    }
+
+    if (args[1] == NULL) {
+        cons_show("Usage: %s", help.usage);
+        return TRUE;
+    }
+
+    if (strcmp(args[0], "dir") == 0) {
+        if (strcmp(args[1], "in") == 0) {
+            ui_xmlconsole_filter_dir(STANZA_DIR_IN);
+        } else if (strcmp(args[1], "out") == 0) {
+            ui_xmlconsole_filter_dir(STANZA_DIR_OUT);
+        } else if (strcmp(args[1], "both") == 0) {
+            ui_xmlconsole_filter_dir(STANZA_DIR_BOTH);
+        } else {
+            cons_show("Usage: %s", help.usage);
+            return TRUE;
+        }
+        cons_show("XML console direction set to: %s.", args[1]);
+    } else if (strcmp(args[0], "kind") == 0) {
+        if (strcmp(args[1], "message") == 0) {
+            ui_xmlconsole_filter_kind(STANZA_KIND_MESSAGE);
+        } else if (strcmp(args[1], "presence") == 0) {
+            ui_xmlconsole_filter_kind(STANZA_KIND_PRESENCE);
+        } else if (strcmp(args[1], "iq") == 0) {
+            ui_xmlconsole_filter_kind(STANZA_KIND_IQ);
+        } else if (strcmp(args[1], "all") == 0) {
+            ui_xmlconsole_filter_kind(STANZA_KIND_ALL);
+        } else {
+            cons_show("Usage: %s", help.usage);
+            return TRUE;
+        }
+        cons_show("XML console stanza kind set to: %s.", args[1]);
+    } else if (strcmp(args[0], "jid") == 0) {
+        if (strcmp(args[1], "off") == 0) {
+            ui_xmlconsole_filter_jid(NULL);
+            cons_show("XML console JID filter removed.");
+        } else {
+            ui_xmlconsole_filter_jid(args[1]);
+            cons_show("XML console JID filter set to: %s.", args[1]);
+        }
     } else {
-        ui_open_xmlconsole_win();
+        cons_show("Usage: %s", help.usage);
     }
 
     return TRUE;
@@ -3948,6 +4227,28 @@ cmd_carbons(gchar **args, struct cmd_help_t help)
     return result;
 }
 
+gboolean
+cmd_sm(gchar **args, struct cmd_help_t help)
+{
+    gboolean result = _cmd_set_boolean_preference(args[0], help,
+        "Stream management", PREF_SM);
+
+    if (strcmp(args[0], "on") == 0) {
+        jabber_enable_stream_management();
+    } else if (strcmp(args[0], "off") == 0) {
+        cons_show("Stream management stays active until the next connect.");
+    }
+
+    return result;
+}
+
+gboolean
+cmd_csi(gchar **args, struct cmd_help_t help)
+{
+    return _cmd_set_boolean_preference(args[0], help,
+        "Client state indication", PREF_CSI);
+}
+
 gboolean
 cmd_away(gchar **args, struct cmd_help_t help)
 {
@@ -86,6 +86,8 @@ gboolean cmd_group(gchar **args, struct cmd_help_t help);
 gboolean cmd_help(gchar **args, struct cmd_help_t help);
 gboolean cmd_history(gchar **args, struct cmd_help_t help);
 gboolean cmd_carbons(gchar **args, struct cmd_help_t help);
+gboolean cmd_sm(gchar **args, struct cmd_help_t help);
+gboolean cmd_csi(gchar **args, struct cmd_help_t help);
 gboolean cmd_info(gchar **args, struct cmd_help_t help);
 gboolean cmd_intype(gchar **args, struct cmd_help_t help);
 gboolean cmd_invite(gchar **args, struct cmd_help_t help);
@@ -93,6 +95,10 @@ gboolean cmd_invites(gchar **args, struct cmd_help_t help);
 gboolean cmd_join(gchar **args, struct cmd_help_t help);
 gboolean cmd_leave(gchar **args, struct cmd_help_t help);
 gboolean cmd_log(gchar **args, struct cmd_help_t help);
+gboolean cmd_logsearch(gchar **args, struct cmd_help_t help);
+gboolean cmd_find(gchar **args, struct cmd_help_t help);
+gboolean cmd_scrollback(gchar **args, struct cmd_help_t help);
+gboolean cmd_snapshot(gchar **args, struct cmd_help_t help);
 gboolean cmd_mouse(gchar **args, struct cmd_help_t help);
 gboolean cmd_msg(gchar **args, struct cmd_help_t help);
 gboolean cmd_nick(gchar **args, struct cmd_help_t help);
@@ -126,6 +132,7 @@ gboolean cmd_xa(gchar **args, struct cmd_help_t help);
 gboolean cmd_alias(gchar **args, struct cmd_help_t help);
 gboolean cmd_xmlconsole(gchar **args, struct cmd_help_t help);
 gboolean cmd_ping(gchar **args, struct cmd_help_t help);
+gboolean cmd_traffic(gchar **args, struct cmd_help_t help);
 gboolean cmd_form(gchar **args, struct cmd_help_t help);
 gboolean cmd_occupants(gchar **args, struct cmd_help_t help);
 gboolean cmd_kick(gchar **args, struct cmd_help_t help);
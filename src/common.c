@@ -35,15 +35,18 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
 #include <curl/curl.h>
 #include <curl/easy.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #ifdef PROF_HAVE_NCURSESW_NCURSES_H
 #include <ncursesw/ncurses.h>
@@ -64,6 +67,8 @@ struct curl_data_t
 };
 
 static size_t _data_callback(void *ptr, size_t size, size_t nmemb, void *data);
+static gboolean _gzip_verify(const char * const filename, off_t size);
+static gboolean _append_file(const char * const src, const char * const dest);
 
 // taken from glib 2.30.3
 gchar *
@@ -113,6 +118,26 @@ p_hash_table_contains(GHashTable  *hash_table, gconstpointer key)
     return (found != NULL);
 }
 
+// threads need initialising before any queue or thread is made on glib < 2.32
+void
+p_threads_init(void)
+{
+#if !GLIB_CHECK_VERSION(2,32,0)
+    if (!g_thread_supported()) {
+        g_thread_init(NULL);
+    }
+#endif
+}
+
+#if !GLIB_CHECK_VERSION(2,32,0)
+GThread *
+p_thread_new(const gchar *name, GThreadFunc func, gpointer data)
+{
+    p_threads_init();
+    return g_thread_create(func, data, TRUE, NULL);
+}
+#endif
+
 gboolean
 create_dir(char *name)
 {
@@ -286,6 +311,184 @@ prof_getline(FILE *stream)
     return s;
 }
 
+// as prof_getline, gzread passes uncompressed files through unchanged
+char *
+prof_gzgetline(gzFile file)
+{
+    char buf[READ_BUF_SIZE];
+    char *s = NULL;
+    size_t s_size = 0;
+
+    while (gzgets(file, buf, READ_BUF_SIZE) != NULL) {
+        size_t buf_size = strlen(buf);
+        gboolean eol = FALSE;
+        if (buf_size > 0 && buf[buf_size - 1] == '\n') {
+            buf[--buf_size] = '\0';
+            eol = TRUE;
+        }
+
+        char *result = realloc(s, s_size + buf_size + 1);
+        if (result == NULL) {
+            free(s);
+            return NULL;
+        }
+        s = result;
+        memcpy(s + s_size, buf, buf_size);
+        s_size += buf_size;
+        s[s_size] = '\0';
+
+        if (eol) {
+            break;
+        }
+    }
+
+    return s;
+}
+
+// compresses filename onto the end of archive as another gzip member, the
+// original is removed only once the archive reads back in full, and the
+// archive is put back as it was if the original grew meanwhile, so lines are
+// never held in both files, error is only set when the archive could not be
+// put back, as this may run off the main thread and must not log
+gboolean
+prof_gzip_file(const char * const filename, const char * const archive,
+    GError **error)
+{
+    FILE *in = fopen(filename, "rb");
+    if (in == NULL) {
+        return FALSE;
+    }
+
+    struct stat before;
+    if (fstat(fileno(in), &before) != 0) {
+        fclose(in);
+        return FALSE;
+    }
+
+    GString *tmp = g_string_new(archive);
+    g_string_append(tmp, ".tmp");
+
+    gboolean ok = FALSE;
+    gzFile out = gzopen(tmp->str, "wb");
+    if (out != NULL) {
+        ok = TRUE;
+        char buf[READ_BUF_SIZE];
+        size_t len;
+        while (ok && (len = fread(buf, 1, sizeof(buf), in)) > 0) {
+            if (gzwrite(out, buf, len) != (int)len) {
+                ok = FALSE;
+            }
+        }
+        if (ferror(in)) {
+            ok = FALSE;
+        }
+        if (gzclose(out) != Z_OK) {
+            ok = FALSE;
+        }
+    }
+    fclose(in);
+
+    if (ok) {
+        ok = _gzip_verify(tmp->str, before.st_size);
+    }
+
+    off_t restore = -1;
+    if (ok) {
+        g_chmod(tmp->str, S_IRUSR | S_IWUSR);
+
+        struct stat existing;
+        if (stat(archive, &existing) == 0) {
+            restore = existing.st_size;
+            ok = _append_file(tmp->str, archive);
+            if (!ok && truncate(archive, restore) != 0) {
+                int err = errno;
+                g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+                    "Could not restore %s: %s", archive, g_strerror(err));
+            }
+        } else {
+            ok = (rename(tmp->str, archive) == 0);
+        }
+    }
+    remove(tmp->str);
+    g_string_free(tmp, TRUE);
+
+    if (!ok) {
+        return FALSE;
+    }
+
+    struct stat after;
+    if (stat(filename, &after) == 0 && after.st_ino == before.st_ino &&
+            after.st_size == before.st_size) {
+        remove(filename);
+        return TRUE;
+    }
+
+    // written to while compressing, leave it for the next attempt
+    if (restore >= 0) {
+        if (truncate(archive, restore) != 0) {
+            int err = errno;
+            g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+                "Could not restore %s: %s", archive, g_strerror(err));
+        }
+    } else {
+        remove(archive);
+    }
+
+    return FALSE;
+}
+
+// writes through a temporary file created with user only permissions and
+// renamed into place, so the contents are never readable by others and a
+// crash never leaves a truncated file behind
+gboolean
+prof_write_private_file(const char * const filename, const char * const data, gsize size,
+    GError **error)
+{
+    GString *tmp = g_string_new(filename);
+    g_string_append(tmp, ".XXXXXX");
+
+    int fd = g_mkstemp_full(tmp->str, O_WRONLY, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        int err = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+            "Could not create %s: %s", tmp->str, g_strerror(err));
+        g_string_free(tmp, TRUE);
+        return FALSE;
+    }
+
+    int err = 0;
+    gsize written = 0;
+    while (err == 0 && written < size) {
+        ssize_t res = write(fd, data + written, size - written);
+        if (res >= 0) {
+            written += res;
+        } else if (errno != EINTR) {
+            err = errno;
+        }
+    }
+    if (err == 0 && fsync(fd) != 0) {
+        err = errno;
+    }
+    if (close(fd) != 0 && err == 0) {
+        err = errno;
+    }
+
+    if (err != 0) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+            "Could not write %s: %s", tmp->str, g_strerror(err));
+    } else if (g_rename(tmp->str, filename) != 0) {
+        err = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+            "Could not rename %s to %s: %s", tmp->str, filename, g_strerror(err));
+    }
+    if (err != 0) {
+        g_unlink(tmp->str);
+    }
+    g_string_free(tmp, TRUE);
+
+    return err == 0;
+}
+
 char *
 release_get_latest()
 {
@@ -297,6 +500,7 @@ release_get_latest()
     output.size = 0;
 
     curl_easy_setopt(handle, CURLOPT_URL, url);
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
     curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, _data_callback);
     curl_easy_setopt(handle, CURLOPT_TIMEOUT, 2);
     curl_easy_setopt(handle, CURLOPT_WRITEDATA, (void *)&output);
@@ -469,14 +673,11 @@ p_sha1_hash(char *str)
 {
     P_SHA1_CTX ctx;
     uint8_t digest[20];
-    uint8_t *input = (uint8_t*)malloc(strlen(str) + 1);
-    memcpy(input, str, strlen(str) + 1);
 
     P_SHA1_Init(&ctx);
-    P_SHA1_Update(&ctx, input, strlen(str));
+    P_SHA1_Update(&ctx, (uint8_t*)str, strlen(str));
     P_SHA1_Final(&ctx, digest);
 
-    free(input);
     return g_base64_encode(digest, sizeof(digest));
 }
 
@@ -616,3 +817,57 @@ strip_arg_quotes(const char * const input)
 
     return unquoted;
 }
+
+static gboolean
+_gzip_verify(const char * const filename, off_t size)
+{
+    gzFile file = gzopen(filename, "rb");
+    if (file == NULL) {
+        return FALSE;
+    }
+
+    char buf[READ_BUF_SIZE];
+    off_t total = 0;
+    int len;
+    while ((len = gzread(file, buf, sizeof(buf))) > 0) {
+        total += len;
+    }
+    if (gzclose(file) != Z_OK) {
+        return FALSE;
+    }
+
+    return (len == 0 && total == size);
+}
+
+static gboolean
+_append_file(const char * const src, const char * const dest)
+{
+    FILE *in = fopen(src, "rb");
+    if (in == NULL) {
+        return FALSE;
+    }
+    FILE *out = fopen(dest, "ab");
+    if (out == NULL) {
+        fclose(in);
+        return FALSE;
+    }
+
+    gboolean ok = TRUE;
+    char buf[READ_BUF_SIZE];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (fwrite(buf, 1, len, out) != len) {
+            ok = FALSE;
+            break;
+        }
+    }
+    if (ferror(in)) {
+        ok = FALSE;
+    }
+    fclose(in);
+    if (fclose(out) == EOF) {
+        ok = FALSE;
+    }
+
+    return ok;
+}
@@ -45,6 +45,7 @@
 #endif
 
 #include <glib.h>
+#include <zlib.h>
 
 #if !GLIB_CHECK_VERSION(2,28,0)
 #define g_slist_free_full(items, free_func)         p_slist_free_full(items, free_func)
@@ -58,6 +59,7 @@
 #if !GLIB_CHECK_VERSION(2,32,0)
 #define g_hash_table_add(hash_table, key)           p_hash_table_add(hash_table, key)
 #define g_hash_table_contains(hash_table, key)      p_hash_table_contains(hash_table, key)
+#define g_thread_new(name, func, data)              p_thread_new(name, func, data)
 #endif
 
 #ifndef NOTIFY_CHECK_VERSION
@@ -105,6 +107,8 @@ void p_slist_free_full(GSList *items, GDestroyNotify free_func);
 void p_list_free_full(GList *items, GDestroyNotify free_func);
 gboolean p_hash_table_add(GHashTable *hash_table, gpointer key);
 gboolean p_hash_table_contains(GHashTable  *hash_table, gconstpointer  key);
+GThread* p_thread_new(const gchar *name, GThreadFunc func, gpointer data);
+void p_threads_init(void);
 
 gboolean create_dir(char *name);
 gboolean mkdir_recursive(const char *dir);
@@ -114,6 +118,11 @@ int str_contains(const char str[], int size, char ch);
 int utf8_display_len(const char * const str);
 gboolean utf8_is_printable(const wint_t ch);
 char * prof_getline(FILE *stream);
+char * prof_gzgetline(gzFile file);
+gboolean prof_gzip_file(const char * const filename, const char * const archive,
+    GError **error);
+gboolean prof_write_private_file(const char * const filename, const char * const data, gsize size,
+    GError **error);
 char* release_get_latest(void);
 gboolean release_is_new(char *found_version);
 gchar * xdg_get_config_home(void);
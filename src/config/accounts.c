@@ -42,6 +42,7 @@
 
 #include "common.h"
 #include "config/account.h"
+#include "config/persist.h"
 #include "jid.h"
 #include "log.h"
 #include "tools/autocomplete.h"
@@ -49,6 +50,12 @@
 
 static gchar *accounts_loc;
 static GKeyFile *accounts;
+static ProfStore *accounts_store;
+
+// parsed copy of the most recently read account, normally the connected one,
+// replaced on the next read after any change to the accounts file
+static ProfAccount *live_account;
+static gboolean live_stale;
 
 static Autocomplete all_ac;
 static Autocomplete enabled_ac;
@@ -65,11 +72,15 @@ static gchar *string_keys[] = {
     "presence.login",
     "muc.service",
     "muc.nick",
-    "otr.policy"
+    "otr.policy",
+    "compression_estimate"
 };
 
 static void _fix_legacy_accounts(const char * const account_name);
 static void _save_accounts(void);
+static ProfAccount * _get_live_account(const char * const account_name);
+static resource_presence_t _presence_from_setting(const char * const account_name, const char * const key,
+    const char * const setting);
 static gchar * _get_accounts_file(void);
 static void _remove_from_list(GKeyFile *accounts, const char * const account_name, const char * const key, const char * const contact_jid);
 
@@ -90,6 +101,13 @@ accounts_load(void)
     g_key_file_load_from_file(accounts, accounts_loc, G_KEY_FILE_KEEP_COMMENTS,
         NULL);
 
+    gchar *xdg_data = xdg_get_data_home();
+    GString *base_str = g_string_new(xdg_data);
+    g_string_append(base_str, "/profanity/");
+    accounts_store = persist_store_new(accounts, accounts_loc, base_str->str);
+    g_free(xdg_data);
+    g_string_free(base_str, TRUE);
+
     // create the logins searchable list for autocompletion
     gsize naccounts;
     gchar **account_names =
@@ -113,6 +131,12 @@ accounts_close(void)
 {
     autocomplete_free(all_ac);
     autocomplete_free(enabled_ac);
+    if (live_account) {
+        account_free(live_account);
+        live_account = NULL;
+    }
+    persist_store_free(accounts_store);
+    accounts_store = NULL;
     g_key_file_free(accounts);
 }
 
@@ -699,24 +723,29 @@ gint
 accounts_get_priority_for_presence_type(const char * const account_name,
     resource_presence_t presence_type)
 {
+    ProfAccount *account = _get_live_account(account_name);
+    if (account == NULL) {
+        return 0;
+    }
+
     gint result;
 
     switch (presence_type)
     {
         case (RESOURCE_ONLINE):
-            result = g_key_file_get_integer(accounts, account_name, "priority.online", NULL);
+            result = account->priority_online;
             break;
         case (RESOURCE_CHAT):
-            result = g_key_file_get_integer(accounts, account_name, "priority.chat", NULL);
+            result = account->priority_chat;
             break;
         case (RESOURCE_AWAY):
-            result = g_key_file_get_integer(accounts, account_name, "priority.away", NULL);
+            result = account->priority_away;
             break;
         case (RESOURCE_XA):
-            result = g_key_file_get_integer(accounts, account_name, "priority.xa", NULL);
+            result = account->priority_xa;
             break;
         default:
-            result = g_key_file_get_integer(accounts, account_name, "priority.dnd", NULL);
+            result = account->priority_dnd;
             break;
     }
 
@@ -744,62 +773,49 @@ accounts_set_login_presence(const char * const account_name, const char * const
     }
 }
 
-resource_presence_t
-accounts_get_last_presence(const char * const account_name)
+void
+accounts_set_compression_estimate(const char * const account_name, gboolean value)
 {
-    resource_presence_t result;
-    gchar *setting = g_key_file_get_string(accounts, account_name, "presence.last", NULL);
+    if (accounts_account_exists(account_name)) {
+        g_key_file_set_boolean(accounts, account_name, "compression_estimate", value);
+        _save_accounts();
+    }
+}
 
-    if (setting == NULL || (strcmp(setting, "online") == 0)) {
-        result = RESOURCE_ONLINE;
-    } else if (strcmp(setting, "chat") == 0) {
-        result = RESOURCE_CHAT;
-    } else if (strcmp(setting, "away") == 0) {
-        result = RESOURCE_AWAY;
-    } else if (strcmp(setting, "xa") == 0) {
-        result = RESOURCE_XA;
-    } else if (strcmp(setting, "dnd") == 0) {
-        result = RESOURCE_DND;
-    } else {
-        log_warning("Error reading presence.last for account: '%s', value: '%s', defaulting to 'online'",
-            account_name, setting);
-        result = RESOURCE_ONLINE;
+gboolean
+accounts_get_compression_estimate(const char * const account_name)
+{
+    if (account_name == NULL) {
+        return FALSE;
     }
 
-    if (setting != NULL) {
-        g_free(setting);
+    return g_key_file_get_boolean(accounts, account_name, "compression_estimate", NULL);
+}
+
+resource_presence_t
+accounts_get_last_presence(const char * const account_name)
+{
+    ProfAccount *account = _get_live_account(account_name);
+    if (account == NULL) {
+        return RESOURCE_ONLINE;
     }
-    return result;
+
+    return _presence_from_setting(account_name, "presence.last", account->last_presence);
 }
 
 resource_presence_t
 accounts_get_login_presence(const char * const account_name)
 {
-    resource_presence_t result;
-    gchar *setting = g_key_file_get_string(accounts, account_name, "presence.login", NULL);
-
-    if (setting == NULL || (strcmp(setting, "online") == 0)) {
-        result = RESOURCE_ONLINE;
-    } else if (strcmp(setting, "chat") == 0) {
-        result = RESOURCE_CHAT;
-    } else if (strcmp(setting, "away") == 0) {
-        result = RESOURCE_AWAY;
-    } else if (strcmp(setting, "xa") == 0) {
-        result = RESOURCE_XA;
-    } else if (strcmp(setting, "dnd") == 0) {
-        result = RESOURCE_DND;
-    } else if (strcmp(setting, "last") == 0) {
-        result = accounts_get_last_presence(account_name);
-    } else {
-        log_warning("Error reading presence.login for account: '%s', value: '%s', defaulting to 'online'",
-            account_name, setting);
-        result = RESOURCE_ONLINE;
+    ProfAccount *account = _get_live_account(account_name);
+    if (account == NULL) {
+        return RESOURCE_ONLINE;
     }
 
-    if (setting != NULL) {
-        g_free(setting);
+    if (g_strcmp0(account->login_presence, "last") == 0) {
+        return _presence_from_setting(account_name, "presence.last", account->last_presence);
     }
-    return result;
+
+    return _presence_from_setting(account_name, "presence.login", account->login_presence);
 }
 
 static void
@@ -855,18 +871,45 @@ _fix_legacy_accounts(const char * const account_name)
 static void
 _save_accounts(void)
 {
-    gsize g_data_size;
-    gchar *g_accounts_data = g_key_file_to_data(accounts, &g_data_size, NULL);
-    gchar *xdg_data = xdg_get_data_home();
-    GString *base_str = g_string_new(xdg_data);
-    g_string_append(base_str, "/profanity/");
-    gchar *true_loc = get_file_or_linked(accounts_loc, base_str->str);
-    g_file_set_contents(true_loc, g_accounts_data, g_data_size, NULL);
-    g_chmod(accounts_loc, S_IRUSR | S_IWUSR);
-    g_free(xdg_data);
-    free(true_loc);
-    g_free(g_accounts_data);
-    g_string_free(base_str, TRUE);
+    live_stale = TRUE;
+    persist_mark_dirty(accounts_store);
+}
+
+static ProfAccount *
+_get_live_account(const char * const account_name)
+{
+    if (live_account && !live_stale && (g_strcmp0(live_account->name, account_name) == 0)) {
+        return live_account;
+    }
+
+    if (live_account) {
+        account_free(live_account);
+    }
+    live_account = accounts_get_account(account_name);
+    live_stale = FALSE;
+
+    return live_account;
+}
+
+static resource_presence_t
+_presence_from_setting(const char * const account_name, const char * const key,
+    const char * const setting)
+{
+    if (setting == NULL || (strcmp(setting, "online") == 0)) {
+        return RESOURCE_ONLINE;
+    } else if (strcmp(setting, "chat") == 0) {
+        return RESOURCE_CHAT;
+    } else if (strcmp(setting, "away") == 0) {
+        return RESOURCE_AWAY;
+    } else if (strcmp(setting, "xa") == 0) {
+        return RESOURCE_XA;
+    } else if (strcmp(setting, "dnd") == 0) {
+        return RESOURCE_DND;
+    } else {
+        log_warning("Error reading %s for account: '%s', value: '%s', defaulting to 'online'",
+            key, account_name, setting);
+        return RESOURCE_ONLINE;
+    }
 }
 
 static gchar *
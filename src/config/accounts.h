@@ -68,6 +68,8 @@ void accounts_set_otr_policy(const char * const account_name, const char * const
 void accounts_set_last_presence(const char * const account_name, const char * const value);
 void accounts_set_login_presence(const char * const account_name, const char * const value);
 resource_presence_t accounts_get_login_presence(const char * const account_name);
+void accounts_set_compression_estimate(const char * const account_name, gboolean value);
+gboolean accounts_get_compression_estimate(const char * const account_name);
 resource_presence_t accounts_get_last_presence(const char * const account_name);
 void accounts_set_priority_online(const char * const account_name, const gint value);
 void accounts_set_priority_chat(const char * const account_name, const gint value);
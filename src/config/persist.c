@@ -0,0 +1,271 @@
+/*
+ * persist.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "common.h"
+#include "log.h"
+#include "config/persist.h"
+
+struct prof_store_t {
+    GKeyFile *keyfile;
+    char *loc;
+    char *basedir;
+    gboolean dirty;
+    GTimer *dirty_since;
+};
+
+// a serialized keyfile waiting to be written, loc NULL stops the writer
+struct persist_job_t {
+    char *loc;
+    gchar *data;
+    gsize size;
+};
+
+static GSList *stores;
+static GAsyncQueue *write_queue;
+// failures on the writer thread, logged from the main loop
+static GAsyncQueue *write_errors;
+static GThread *writer;
+
+static void _store_write(ProfStore *store);
+static gpointer _writer_worker(gpointer data);
+static void _write_file(struct persist_job_t *job);
+static void _job_free(struct persist_job_t *job);
+static void _log_write_errors(void);
+
+void
+persist_init(void)
+{
+    p_threads_init();
+    write_queue = g_async_queue_new();
+    write_errors = g_async_queue_new();
+    writer = g_thread_new("persist-writer", _writer_worker, NULL);
+}
+
+void
+persist_close(void)
+{
+    GSList *curr = stores;
+    while (curr) {
+        persist_flush(curr->data);
+        curr = g_slist_next(curr);
+    }
+
+    if (writer == NULL) {
+        return;
+    }
+
+    // queued writes are finished before the writer stops
+    struct persist_job_t *stop = malloc(sizeof(struct persist_job_t));
+    stop->loc = NULL;
+    stop->data = NULL;
+    stop->size = 0;
+    g_async_queue_push(write_queue, stop);
+    g_thread_join(writer);
+    writer = NULL;
+    g_async_queue_unref(write_queue);
+    write_queue = NULL;
+
+    _log_write_errors();
+    g_async_queue_unref(write_errors);
+    write_errors = NULL;
+}
+
+// called from the main loop, writes stores that have been dirty long enough
+void
+persist_tick(void)
+{
+    if (write_errors) {
+        _log_write_errors();
+    }
+
+    GSList *curr = stores;
+    while (curr) {
+        ProfStore *store = curr->data;
+        if (store->dirty && g_timer_elapsed(store->dirty_since, NULL) >= PERSIST_DELAY) {
+            _store_write(store);
+        }
+        curr = g_slist_next(curr);
+    }
+}
+
+ProfStore *
+persist_store_new(GKeyFile *keyfile, const char * const loc, const char * const basedir)
+{
+    ProfStore *store = malloc(sizeof(struct prof_store_t));
+    store->keyfile = keyfile;
+    store->loc = strdup(loc);
+    if (basedir) {
+        store->basedir = strdup(basedir);
+    } else {
+        store->basedir = NULL;
+    }
+    store->dirty = FALSE;
+    store->dirty_since = g_timer_new();
+
+    stores = g_slist_append(stores, store);
+
+    return store;
+}
+
+// flushes pending changes, must be called before the keyfile is freed
+void
+persist_store_free(ProfStore *store)
+{
+    if (store == NULL) {
+        return;
+    }
+
+    persist_flush(store);
+    stores = g_slist_remove(stores, store);
+    g_timer_destroy(store->dirty_since);
+    free(store->loc);
+    free(store->basedir);
+    free(store);
+}
+
+void
+persist_mark_dirty(ProfStore *store)
+{
+    if (store == NULL || store->dirty) {
+        return;
+    }
+
+    store->dirty = TRUE;
+    g_timer_start(store->dirty_since);
+}
+
+void
+persist_flush(ProfStore *store)
+{
+    if (store && store->dirty) {
+        _store_write(store);
+    }
+}
+
+// queues a copy of data for the writer, files written this way land in the
+// order they were queued, with the same permissions as the stores
+void
+persist_write(const char * const loc, const char * const data, gsize size)
+{
+    struct persist_job_t *job = malloc(sizeof(struct persist_job_t));
+    job->loc = strdup(loc);
+    job->data = g_memdup(data, size);
+    job->size = size;
+
+    if (writer) {
+        g_async_queue_push(write_queue, job);
+    } else {
+        _write_file(job);
+        _job_free(job);
+    }
+}
+
+// the keyfile is serialized here, only the file io happens on the writer
+static void
+_store_write(ProfStore *store)
+{
+    struct persist_job_t *job = malloc(sizeof(struct persist_job_t));
+    job->data = g_key_file_to_data(store->keyfile, &job->size, NULL);
+    if (store->basedir) {
+        job->loc = get_file_or_linked(store->loc, store->basedir);
+    } else {
+        job->loc = strdup(store->loc);
+    }
+    store->dirty = FALSE;
+
+    if (writer) {
+        g_async_queue_push(write_queue, job);
+    } else {
+        _write_file(job);
+        _job_free(job);
+    }
+}
+
+static gpointer
+_writer_worker(gpointer data)
+{
+    while (TRUE) {
+        struct persist_job_t *job = g_async_queue_pop(write_queue);
+        if (job->loc == NULL) {
+            _job_free(job);
+            break;
+        }
+        _write_file(job);
+        _job_free(job);
+    }
+
+    return NULL;
+}
+
+// write to a temporary file next to the target and rename it into place,
+// so a crash never leaves a truncated file behind
+static void
+_write_file(struct persist_job_t *job)
+{
+    GError *error = NULL;
+    if (prof_write_private_file(job->loc, job->data, job->size, &error)) {
+        return;
+    }
+
+    if (write_errors) {
+        g_async_queue_push(write_errors, g_strdup(error->message));
+    } else {
+        log_error("Could not save %s: %s", job->loc, error->message);
+    }
+    g_error_free(error);
+}
+
+static void
+_log_write_errors(void)
+{
+    char *message;
+    while ((message = g_async_queue_try_pop(write_errors)) != NULL) {
+        log_error("Could not save file: %s", message);
+        g_free(message);
+    }
+}
+
+static void
+_job_free(struct persist_job_t *job)
+{
+    free(job->loc);
+    g_free(job->data);
+    free(job);
+}
@@ -0,0 +1,57 @@
+/*
+ * persist.h
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#ifndef CONFIG_PERSIST_H
+#define CONFIG_PERSIST_H
+
+#include <glib.h>
+
+// seconds a store may stay dirty before it is written
+#define PERSIST_DELAY 2
+
+typedef struct prof_store_t ProfStore;
+
+void persist_init(void);
+void persist_close(void);
+void persist_tick(void);
+
+ProfStore * persist_store_new(GKeyFile *keyfile, const char * const loc, const char * const basedir);
+void persist_store_free(ProfStore *store);
+void persist_mark_dirty(ProfStore *store);
+void persist_flush(ProfStore *store);
+
+void persist_write(const char * const loc, const char * const data, gsize size);
+
+#endif
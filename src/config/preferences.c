@@ -50,6 +50,7 @@
 #include "common.h"
 #include "log.h"
 #include "preferences.h"
+#include "config/persist.h"
 #include "tools/autocomplete.h"
 
 // preference groups refer to the sections in .profrc, for example [ui]
@@ -66,7 +67,18 @@
 
 static gchar *prefs_loc;
 static GKeyFile *prefs;
+static ProfStore *prefs_store;
 gint log_maxsize = 0;
+static gint inpblock = INPBLOCK_DEFAULT;
+
+// values of all boolean and string preferences, kept in step with the key file
+// so that reading a preference does not need a key file lookup
+typedef struct pref_cache_t {
+    gboolean boolean;
+    char *string;
+} PrefCache;
+
+static PrefCache cache[PREF_COUNT];
 
 static Autocomplete boolean_choice_ac;
 
@@ -76,6 +88,9 @@ static const char * _get_group(preference_t pref);
 static const char * _get_key(preference_t pref);
 static gboolean _get_default_boolean(preference_t pref);
 static char * _get_default_string(preference_t pref);
+static void _cache_load(void);
+static void _cache_update(preference_t pref);
+static void _cache_free(void);
 
 void
 prefs_load(void)
@@ -93,6 +108,13 @@ prefs_load(void)
     g_key_file_load_from_file(prefs, prefs_loc, G_KEY_FILE_KEEP_COMMENTS,
         NULL);
 
+    gchar *xdg_config = xdg_get_config_home();
+    GString *base_str = g_string_new(xdg_config);
+    g_string_append(base_str, "/profanity/");
+    prefs_store = persist_store_new(prefs, prefs_loc, base_str->str);
+    g_free(xdg_config);
+    g_string_free(base_str, TRUE);
+
     err = NULL;
     log_maxsize = g_key_file_get_integer(prefs, PREF_GROUP_LOGGING, "maxsize", &err);
     if (err != NULL) {
@@ -122,6 +144,8 @@ prefs_load(void)
 
     _save_prefs();
 
+    _cache_load();
+
     boolean_choice_ac = autocomplete_new();
     autocomplete_add(boolean_choice_ac, "on");
     autocomplete_add(boolean_choice_ac, "off");
@@ -131,6 +155,9 @@ void
 prefs_close(void)
 {
     autocomplete_free(boolean_choice_ac);
+    _cache_free();
+    persist_store_free(prefs_store);
+    prefs_store = NULL;
     g_key_file_free(prefs);
     prefs = NULL;
 }
@@ -150,15 +177,7 @@ prefs_reset_boolean_choice(void)
 gboolean
 prefs_get_boolean(preference_t pref)
 {
-    const char *group = _get_group(pref);
-    const char *key = _get_key(pref);
-    gboolean def = _get_default_boolean(pref);
-
-    if (!g_key_file_has_key(prefs, group, key, NULL)) {
-        return def;
-    }
-
-    return g_key_file_get_boolean(prefs, group, key, NULL);
+    return cache[pref].boolean;
 }
 
 void
@@ -167,29 +186,30 @@ prefs_set_boolean(preference_t pref, gboolean value)
     const char *group = _get_group(pref);
     const char *key = _get_key(pref);
     g_key_file_set_boolean(prefs, group, key, value);
+    _cache_update(pref);
     _save_prefs();
 }
 
+// the result must be freed with prefs_free_string
 char *
 prefs_get_string(preference_t pref)
 {
-    const char *group = _get_group(pref);
-    const char *key = _get_key(pref);
-    char *def = _get_default_string(pref);
+    const char *value = cache[pref].string;
 
-    char *result = g_key_file_get_string(prefs, group, key, NULL);
-
-    if (result == NULL) {
-        if (def != NULL) {
-            return strdup(def);
-        } else {
-            return NULL;
-        }
+    if (value == NULL) {
+        return NULL;
     } else {
-        return result;
+        return strdup(value);
     }
 }
 
+// the result is owned by the preferences and only valid until the preference is next set
+const char *
+prefs_peek_string(preference_t pref)
+{
+    return cache[pref].string;
+}
+
 void
 prefs_free_string(char *pref)
 {
@@ -210,6 +230,7 @@ prefs_set_string(preference_t pref, char *value)
     } else {
         g_key_file_set_string(prefs, group, key, value);
     }
+    _cache_update(pref);
     _save_prefs();
 }
 
@@ -256,19 +277,54 @@ prefs_set_max_log_size(gint value)
     _save_prefs();
 }
 
-gint prefs_get_inpblock(void)
+gint
+prefs_get_log_generations(void)
 {
-    int val = g_key_file_get_integer(prefs, PREF_GROUP_UI, "inpblock", NULL);
-    if (val == 0) {
-        return INPBLOCK_DEFAULT;
+    gint result = g_key_file_get_integer(prefs, PREF_GROUP_LOGGING, "generations", NULL);
+
+    if (result > PREFS_MAX_LOG_GENERATIONS || result < 1) {
+        return 1;
     } else {
-        return val;
+        return result;
     }
 }
 
+void
+prefs_set_log_generations(gint value)
+{
+    g_key_file_set_integer(prefs, PREF_GROUP_LOGGING, "generations", value);
+    _save_prefs();
+}
+
+gint prefs_get_inpblock(void)
+{
+    return inpblock;
+}
+
 void prefs_set_inpblock(gint value)
 {
     g_key_file_set_integer(prefs, PREF_GROUP_UI, "inpblock", value);
+    inpblock = value == 0 ? INPBLOCK_DEFAULT : value;
+    _save_prefs();
+}
+
+// kilobytes of scrollback kept for all windows together, 0 for no limit
+gint
+prefs_get_scrollback_budget(void)
+{
+    gint result = g_key_file_get_integer(prefs, PREF_GROUP_UI, "scrollback.budget", NULL);
+
+    if (result < 0) {
+        return 0;
+    } else {
+        return result;
+    }
+}
+
+void
+prefs_set_scrollback_budget(gint value)
+{
+    g_key_file_set_integer(prefs, PREF_GROUP_UI, "scrollback.budget", value);
     _save_prefs();
 }
 
@@ -466,18 +522,7 @@ prefs_free_aliases(GList *aliases)
 static void
 _save_prefs(void)
 {
-    gsize g_data_size;
-    gchar *g_prefs_data = g_key_file_to_data(prefs, &g_data_size, NULL);
-    gchar *xdg_config = xdg_get_config_home();
-    GString *base_str = g_string_new(xdg_config);
-    g_string_append(base_str, "/profanity/");
-    gchar *true_loc = get_file_or_linked(prefs_loc, base_str->str);
-    g_file_set_contents(true_loc, g_prefs_data, g_data_size, NULL);
-    g_chmod(prefs_loc, S_IRUSR | S_IWUSR);
-    g_free(xdg_config);
-    free(true_loc);
-    g_free(g_prefs_data);
-    g_string_free(base_str, TRUE);
+    persist_mark_dirty(prefs_store);
 }
 
 static gchar *
@@ -529,6 +574,8 @@ _get_group(preference_t pref)
         case PREF_RESOURCE_MESSAGE:
         case PREF_OTR_WARN:
         case PREF_INPBLOCK_DYNAMIC:
+        case PREF_SCROLLBACK_SPILL:
+        case PREF_SNAPSHOT:
             return PREF_GROUP_UI;
         case PREF_STATES:
         case PREF_OUTTYPE:
@@ -548,6 +595,7 @@ _get_group(preference_t pref)
         case PREF_GRLOG:
         case PREF_LOG_ROTATE:
         case PREF_LOG_SHARED:
+        case PREF_LOG_COMPRESS:
             return PREF_GROUP_LOGGING;
         case PREF_AUTOAWAY_CHECK:
         case PREF_AUTOAWAY_MODE:
@@ -556,6 +604,8 @@ _get_group(preference_t pref)
         case PREF_CONNECT_ACCOUNT:
         case PREF_DEFAULT_ACCOUNT:
         case PREF_CARBONS:
+        case PREF_SM:
+        case PREF_CSI:
             return PREF_GROUP_CONNECTION;
         case PREF_OTR_LOG:
         case PREF_OTR_POLICY:
@@ -654,6 +704,8 @@ _get_key(preference_t pref)
             return "rotate";
         case PREF_LOG_SHARED:
             return "shared";
+        case PREF_LOG_COMPRESS:
+            return "compress";
         case PREF_PRESENCE:
             return "presence";
         case PREF_WRAP:
@@ -676,6 +728,14 @@ _get_key(preference_t pref)
             return "resource.message";
         case PREF_INPBLOCK_DYNAMIC:
             return "inpblock.dynamic";
+        case PREF_SCROLLBACK_SPILL:
+            return "scrollback.spill";
+        case PREF_SNAPSHOT:
+            return "snapshot";
+        case PREF_SM:
+            return "sm";
+        case PREF_CSI:
+            return "csi";
         default:
             return NULL;
     }
@@ -744,3 +804,57 @@ _get_default_string(preference_t pref)
             return NULL;
     }
 }
+
+static void
+_cache_load(void)
+{
+    preference_t pref;
+    for (pref = 0; pref < PREF_COUNT; pref++) {
+        _cache_update(pref);
+    }
+
+    inpblock = g_key_file_get_integer(prefs, PREF_GROUP_UI, "inpblock", NULL);
+    if (inpblock == 0) {
+        inpblock = INPBLOCK_DEFAULT;
+    }
+}
+
+static void
+_cache_update(preference_t pref)
+{
+    const char *group = _get_group(pref);
+    const char *key = _get_key(pref);
+
+    FREE_SET_NULL(cache[pref].string);
+    cache[pref].boolean = FALSE;
+
+    if (group == NULL || key == NULL) {
+        return;
+    }
+
+    if (g_key_file_has_key(prefs, group, key, NULL)) {
+        cache[pref].boolean = g_key_file_get_boolean(prefs, group, key, NULL);
+    } else {
+        cache[pref].boolean = _get_default_boolean(pref);
+    }
+
+    char *value = g_key_file_get_string(prefs, group, key, NULL);
+    if (value) {
+        cache[pref].string = strdup(value);
+        g_free(value);
+    } else {
+        char *def = _get_default_string(pref);
+        if (def) {
+            cache[pref].string = strdup(def);
+        }
+    }
+}
+
+static void
+_cache_free(void)
+{
+    preference_t pref;
+    for (pref = 0; pref < PREF_COUNT; pref++) {
+        FREE_SET_NULL(cache[pref].string);
+    }
+}
@@ -46,6 +46,7 @@
 
 #define PREFS_MIN_LOG_SIZE 64
 #define PREFS_MAX_LOG_SIZE 1048580
+#define PREFS_MAX_LOG_GENERATIONS 20
 
 // represents all settings in .profrc
 // each enum value is mapped to a group and key in .profrc (see preferences.c)
@@ -98,12 +99,19 @@ typedef enum {
     PREF_DEFAULT_ACCOUNT,
     PREF_LOG_ROTATE,
     PREF_LOG_SHARED,
+    PREF_LOG_COMPRESS,
     PREF_OTR_LOG,
     PREF_OTR_WARN,
     PREF_OTR_POLICY,
     PREF_RESOURCE_TITLE,
     PREF_RESOURCE_MESSAGE,
-    PREF_INPBLOCK_DYNAMIC
+    PREF_INPBLOCK_DYNAMIC,
+    PREF_SCROLLBACK_SPILL,
+    PREF_SNAPSHOT,
+    PREF_SM,
+    PREF_CSI,
+    // number of preferences, not a preference itself
+    PREF_COUNT
 } preference_t;
 
 typedef struct prof_alias_t {
@@ -127,6 +135,8 @@ gint prefs_get_notify_remind(void);
 
 void prefs_set_max_log_size(gint value);
 gint prefs_get_max_log_size(void);
+void prefs_set_log_generations(gint value);
+gint prefs_get_log_generations(void);
 gint prefs_get_priority(void);
 void prefs_set_reconnect(gint value);
 gint prefs_get_reconnect(void);
@@ -134,6 +144,8 @@ void prefs_set_autoping(gint value);
 gint prefs_get_autoping(void);
 gint prefs_get_inpblock(void);
 void prefs_set_inpblock(gint value);
+gint prefs_get_scrollback_budget(void);
+void prefs_set_scrollback_budget(gint value);
 
 void prefs_set_occupants_size(gint value);
 gint prefs_get_occupants_size(void);
@@ -156,6 +168,7 @@ void prefs_free_aliases(GList *aliases);
 gboolean prefs_get_boolean(preference_t pref);
 void prefs_set_boolean(preference_t pref, gboolean value);
 char * prefs_get_string(preference_t pref);
+const char * prefs_peek_string(preference_t pref);
 void prefs_free_string(char *pref);
 void prefs_set_string(preference_t pref, char *value);
 
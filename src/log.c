@@ -38,6 +38,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
 
 #include "glib.h"
 #include "glib/gstdio.h"
@@ -45,6 +48,7 @@
 #include "log.h"
 
 #include "common.h"
+#include "log_index.h"
 #include "config/preferences.h"
 
 #define PROF "prof"
@@ -65,6 +69,30 @@ struct dated_chat_log {
     GDateTime *date;
 };
 
+// work handed to the archive thread, compression and rotation of
+// closed log files never happens on the main loop
+typedef enum {
+    ARCHIVE_ROTATE,
+    ARCHIVE_COMPRESS,
+    ARCHIVE_SWEEP,
+    ARCHIVE_STOP
+} archive_job_type_t;
+
+struct archive_job_t {
+    archive_job_type_t type;
+    char *path;
+    char *target;
+    int generations;
+    gboolean compress;
+};
+
+static GAsyncQueue *archive_queue;
+// failures on the archive thread, logged from the main loop
+static GAsyncQueue *archive_errors;
+static GThread *archive_thread;
+static gint archive_stopping;
+static unsigned int rotations;
+
 static gboolean _log_roll_needed(struct dated_chat_log *dated_log);
 static struct dated_chat_log * _create_log(char *other, const  char * const login);
 static struct dated_chat_log * _create_groupchat_log(char *room, const char * const login);
@@ -78,6 +106,21 @@ static gchar * _get_chatlog_dir(void);
 static gchar * _get_main_log_file(void);
 static void _rotate_log_file(void);
 static char* _log_string_from_level(log_level_t level);
+static GSList * _read_log_lines(const char * const filename, GSList *lines);
+static void _archive_start(void);
+static void _archive_stop(void);
+static struct archive_job_t * _archive_job_new(archive_job_type_t type,
+    const char * const path, const char * const target);
+static void _archive_job_free(struct archive_job_t *job);
+static void _archive_submit(struct archive_job_t *job);
+static void _archive_closed_log(const char * const filename);
+static gpointer _archive_worker(gpointer data);
+static void _archive_run(struct archive_job_t *job);
+static void _archive_rotate(const char * const staged, const char * const log_file,
+    int generations, gboolean compress);
+static gboolean _archive_compress_file(const char * const filename);
+static void _archive_sweep(const char * const dir, const char * const skip);
+static void _archive_log_errors(void);
 
 void
 log_debug(const char * const msg, ...)
@@ -214,19 +257,20 @@ static void
 _rotate_log_file(void)
 {
     gchar *log_file = _get_main_log_file();
-    size_t len = strlen(log_file);
-    char *log_file_new = malloc(len + 3);
-
-    strncpy(log_file_new, log_file, len);
-    log_file_new[len] = '.';
-    log_file_new[len+1] = '1';
-    log_file_new[len+2] = 0;
+    GString *staged = g_string_new(log_file);
+    g_string_append_printf(staged, ".%d.%u.rotating", getpid(), rotations++);
 
     log_close();
-    rename(log_file, log_file_new);
+    rename(log_file, staged->str);
     log_init(log_get_filter());
 
-    free(log_file_new);
+    // shifting generations and compressing is left to the archive thread
+    struct archive_job_t *job = _archive_job_new(ARCHIVE_ROTATE, staged->str, log_file);
+    job->generations = prefs_get_log_generations();
+    job->compress = prefs_get_boolean(PREF_LOG_COMPRESS);
+    _archive_submit(job);
+
+    g_string_free(staged, TRUE);
     free(log_file);
     log_info("Log has been rotated");
 }
@@ -238,6 +282,18 @@ chat_log_init(void)
     log_info("Initialising chat logs");
     logs = g_hash_table_new_full(g_str_hash, (GEqualFunc) _key_equals, free,
         (GDestroyNotify)_free_chat_log);
+
+    _archive_start();
+    log_index_init();
+
+    // compress daily logs left behind by previous sessions
+    if (prefs_get_boolean(PREF_LOG_COMPRESS)) {
+        gchar *chatlogs_dir = _get_chatlog_dir();
+        gchar *today = g_date_time_format(session_started, "%Y_%m_%d.log");
+        _archive_submit(_archive_job_new(ARCHIVE_SWEEP, chatlogs_dir, today));
+        g_free(today);
+        free(chatlogs_dir);
+    }
 }
 
 void
@@ -261,6 +317,7 @@ chat_log_chat(const gchar * const login, gchar *other,
 
     // log exists but needs rolling
     } else if (_log_roll_needed(dated_log)) {
+        _archive_closed_log(dated_log->filename);
         dated_log = _create_log(other, login);
         g_hash_table_replace(logs, strdup(other), dated_log);
     }
@@ -275,28 +332,33 @@ chat_log_chat(const gchar * const login, gchar *other,
 
     date_fmt = g_date_time_format(dt, "%H:%M:%S");
 
+    GString *line = g_string_new("");
+    if (direction == PROF_IN_LOG) {
+        if (strncmp(msg, "/me ", 4) == 0) {
+            g_string_printf(line, "*%s %s", other, msg + 4);
+        } else {
+            g_string_printf(line, "%s: %s", other, msg);
+        }
+    } else {
+        if (strncmp(msg, "/me ", 4) == 0) {
+            g_string_printf(line, "*me %s", msg + 4);
+        } else {
+            g_string_printf(line, "me: %s", msg);
+        }
+    }
+
     FILE *logp = fopen(dated_log->filename, "a");
     g_chmod(dated_log->filename, S_IRUSR | S_IWUSR);
     if (logp != NULL) {
-        if (direction == PROF_IN_LOG) {
-            if (strncmp(msg, "/me ", 4) == 0) {
-                fprintf(logp, "%s - *%s %s\n", date_fmt, other, msg + 4);
-            } else {
-                fprintf(logp, "%s - %s: %s\n", date_fmt, other, msg);
-            }
-        } else {
-            if (strncmp(msg, "/me ", 4) == 0) {
-                fprintf(logp, "%s - *me %s\n", date_fmt, msg + 4);
-            } else {
-                fprintf(logp, "%s - me: %s\n", date_fmt, msg);
-            }
-        }
+        fprintf(logp, "%s - %s\n", date_fmt, line->str);
         fflush(logp);
         int result = fclose(logp);
         if (result == EOF) {
             log_error("Error closing file %s, errno = %d", dated_log->filename, errno);
         }
+        log_index_add(login, dated_log->filename, line->str);
     }
+    g_string_free(line, TRUE);
 
     g_free(date_fmt);
     g_date_time_unref(dt);
@@ -304,7 +366,7 @@ chat_log_chat(const gchar * const login, gchar *other,
 
 void
 groupchat_log_chat(const gchar * const login, const gchar * const room,
-    const gchar * const nick, const gchar * const msg)
+    const gchar * const nick, const gchar * const msg, GTimeVal *tv_stamp)
 {
     gchar *room_copy = strdup(room);
     struct dated_chat_log *dated_log = g_hash_table_lookup(groupchat_logs, room_copy);
@@ -316,34 +378,90 @@ groupchat_log_chat(const gchar * const login, const gchar * const room,
 
     // log exists but needs rolling
     } else if (_log_roll_needed(dated_log)) {
+        _archive_closed_log(dated_log->filename);
         dated_log = _create_groupchat_log(room_copy, login);
-        g_hash_table_replace(logs, room_copy, dated_log);
+        g_hash_table_replace(groupchat_logs, room_copy, dated_log);
+    } else {
+        free(room_copy);
     }
 
-    GDateTime *dt = g_date_time_new_now_local();
+    GDateTime *dt = NULL;
+    if (tv_stamp == NULL) {
+        dt = g_date_time_new_now_local();
+    } else {
+        dt = g_date_time_new_from_timeval_local(tv_stamp);
+    }
 
     gchar *date_fmt = g_date_time_format(dt, "%H:%M:%S");
 
+    GString *line = g_string_new("");
+    if (strncmp(msg, "/me ", 4) == 0) {
+        g_string_printf(line, "*%s %s", nick, msg + 4);
+    } else {
+        g_string_printf(line, "%s: %s", nick, msg);
+    }
+
     FILE *logp = fopen(dated_log->filename, "a");
     g_chmod(dated_log->filename, S_IRUSR | S_IWUSR);
     if (logp != NULL) {
-        if (strncmp(msg, "/me ", 4) == 0) {
-            fprintf(logp, "%s - *%s %s\n", date_fmt, nick, msg + 4);
-        } else {
-            fprintf(logp, "%s - %s: %s\n", date_fmt, nick, msg);
-        }
-
+        fprintf(logp, "%s - %s\n", date_fmt, line->str);
         fflush(logp);
         int result = fclose(logp);
         if (result == EOF) {
             log_error("Error closing file %s, errno = %d", dated_log->filename, errno);
         }
+        log_index_add(login, dated_log->filename, line->str);
     }
+    g_string_free(line, TRUE);
 
     g_free(date_fmt);
     g_date_time_unref(dt);
 }
 
+// time of the last line in today's log for the room, NULL when there is none
+GDateTime *
+groupchat_log_get_last_time(const gchar * const login, const gchar * const room)
+{
+    GDateTime *now = g_date_time_new_now_local();
+    char *filename = _get_groupchat_log_filename(room, login, now, FALSE);
+
+    FILE *logfile = fopen(filename, "r");
+    free(filename);
+    if (logfile == NULL) {
+        g_date_time_unref(now);
+        return NULL;
+    }
+
+    // only the tail is needed, lines of a multi line message have no time
+    char buf[4096];
+    long size = 0;
+    if (fseek(logfile, 0, SEEK_END) == 0) {
+        size = ftell(logfile);
+    }
+    long start = size > (long)sizeof(buf) - 1 ? size - ((long)sizeof(buf) - 1) : 0;
+    fseek(logfile, start, SEEK_SET);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, logfile);
+    buf[len] = '\0';
+    fclose(logfile);
+
+    GDateTime *result = NULL;
+    char *line = buf + len;
+    while (line > buf && result == NULL) {
+        line--;
+        if (line == buf || *(line - 1) == '\n') {
+            int hour, minute, second;
+            if (sscanf(line, "%2d:%2d:%2d - ", &hour, &minute, &second) == 3) {
+                result = g_date_time_new_local(g_date_time_get_year(now),
+                    g_date_time_get_month(now), g_date_time_get_day_of_month(now),
+                    hour, minute, second);
+            }
+        }
+    }
+
+    g_date_time_unref(now);
+
+    return result;
+}
 
 GSList *
 chat_log_get_previous(const gchar * const login, const gchar * const recipient)
@@ -362,8 +480,14 @@ chat_log_get_previous(const gchar * const login, const gchar * const recipient)
     while (g_date_time_compare(log_date, now) != 1) {
         char *filename = _get_log_filename(recipient, login, log_date, FALSE);
 
-        FILE *logp = fopen(filename, "r");
-        if (logp != NULL) {
+        // days archived by a roll are read before anything appended after it
+        GString *archived = g_string_new(filename);
+        g_string_append(archived, LOG_ARCHIVE_EXT);
+        GSList *lines = _read_log_lines(archived->str, NULL);
+        lines = _read_log_lines(filename, lines);
+        g_string_free(archived, TRUE);
+
+        if (lines != NULL) {
             GString *header = g_string_new("");
             g_string_append_printf(header, "%d/%d/%d:",
                 g_date_time_get_day_of_month(log_date),
@@ -372,12 +496,7 @@ chat_log_get_previous(const gchar * const login, const gchar * const recipient)
             history = g_slist_append(history, header->str);
             g_string_free(header, FALSE);
 
-            char *line;
-            while ((line = prof_getline(logp)) != NULL) {
-                history = g_slist_append(history, line);
-            }
-
-            fclose(logp);
+            history = g_slist_concat(history, g_slist_reverse(lines));
         }
 
         free(filename);
@@ -393,14 +512,254 @@ chat_log_get_previous(const gchar * const login, const gchar * const recipient)
     return history;
 }
 
+// called from the main loop, logs what the archive thread could not do
+void
+chat_log_tick(void)
+{
+    if (archive_errors) {
+        _archive_log_errors();
+    }
+}
+
 void
 chat_log_close(void)
 {
+    _archive_stop();
+    log_index_close();
     g_hash_table_destroy(logs);
     g_hash_table_destroy(groupchat_logs);
     g_date_time_unref(session_started);
 }
 
+// lines are prepended, gzread handles both compressed and plain files
+static GSList *
+_read_log_lines(const char * const filename, GSList *lines)
+{
+    if (!g_file_test(filename, G_FILE_TEST_EXISTS)) {
+        return lines;
+    }
+
+    gzFile logp = gzopen(filename, "rb");
+    if (logp == NULL) {
+        return lines;
+    }
+
+    char *line;
+    while ((line = prof_gzgetline(logp)) != NULL) {
+        lines = g_slist_prepend(lines, line);
+    }
+    gzclose(logp);
+
+    return lines;
+}
+
+static void
+_archive_start(void)
+{
+    g_atomic_int_set(&archive_stopping, 0);
+    p_threads_init();
+    archive_queue = g_async_queue_new();
+    archive_errors = g_async_queue_new();
+    archive_thread = g_thread_new("log-archive", _archive_worker, NULL);
+}
+
+static void
+_archive_stop(void)
+{
+    if (archive_thread == NULL) {
+        return;
+    }
+
+    // pending compression is abandoned, the next sweep picks it up
+    g_atomic_int_set(&archive_stopping, 1);
+    g_async_queue_push(archive_queue, _archive_job_new(ARCHIVE_STOP, NULL, NULL));
+    g_thread_join(archive_thread);
+    archive_thread = NULL;
+    g_async_queue_unref(archive_queue);
+    archive_queue = NULL;
+
+    _archive_log_errors();
+    g_async_queue_unref(archive_errors);
+    archive_errors = NULL;
+}
+
+static struct archive_job_t *
+_archive_job_new(archive_job_type_t type, const char * const path,
+    const char * const target)
+{
+    struct archive_job_t *job = malloc(sizeof(struct archive_job_t));
+    job->type = type;
+    job->path = path ? strdup(path) : NULL;
+    job->target = target ? strdup(target) : NULL;
+    job->generations = 1;
+    job->compress = FALSE;
+
+    return job;
+}
+
+static void
+_archive_job_free(struct archive_job_t *job)
+{
+    if (job != NULL) {
+        free(job->path);
+        free(job->target);
+        free(job);
+    }
+}
+
+static void
+_archive_submit(struct archive_job_t *job)
+{
+    // before chat logs are initialised or after they are closed, work inline
+    if (archive_thread == NULL) {
+        _archive_run(job);
+        _archive_job_free(job);
+    } else {
+        g_async_queue_push(archive_queue, job);
+    }
+}
+
+static void
+_archive_closed_log(const char * const filename)
+{
+    if (prefs_get_boolean(PREF_LOG_COMPRESS)) {
+        _archive_submit(_archive_job_new(ARCHIVE_COMPRESS, filename, NULL));
+    }
+}
+
+static gpointer
+_archive_worker(gpointer data)
+{
+    while (TRUE) {
+        struct archive_job_t *job = g_async_queue_pop(archive_queue);
+        if (job->type == ARCHIVE_STOP) {
+            _archive_job_free(job);
+            break;
+        }
+        _archive_run(job);
+        _archive_job_free(job);
+    }
+
+    return NULL;
+}
+
+// runs on the archive thread, must not call log_* or touch preferences
+static void
+_archive_run(struct archive_job_t *job)
+{
+    gboolean stopping = g_atomic_int_get(&archive_stopping);
+
+    switch (job->type)
+    {
+        case ARCHIVE_ROTATE:
+            // a staged log must always land in place, even when shutting down
+            _archive_rotate(job->path, job->target, job->generations,
+                job->compress && !stopping);
+            break;
+        case ARCHIVE_COMPRESS:
+            if (!stopping) {
+                _archive_compress_file(job->path);
+            }
+            break;
+        case ARCHIVE_SWEEP:
+            _archive_sweep(job->path, job->target);
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+_archive_rotate(const char * const staged, const char * const log_file,
+    int generations, gboolean compress)
+{
+    GString *from = g_string_new("");
+    GString *to = g_string_new("");
+
+    // drop the oldest generation and shift the rest up by one
+    int i;
+    for (i = generations; i >= 1; i--) {
+        g_string_printf(from, "%s.%d", log_file, i);
+        if (i == generations) {
+            remove(from->str);
+            g_string_append(from, LOG_ARCHIVE_EXT);
+            remove(from->str);
+        } else {
+            g_string_printf(to, "%s.%d", log_file, i + 1);
+            rename(from->str, to->str);
+            g_string_append(from, LOG_ARCHIVE_EXT);
+            g_string_append(to, LOG_ARCHIVE_EXT);
+            rename(from->str, to->str);
+        }
+    }
+
+    g_string_printf(to, "%s.1", log_file);
+    if (rename(staged, to->str) == 0 && compress) {
+        _archive_compress_file(to->str);
+    }
+
+    g_string_free(from, TRUE);
+    g_string_free(to, TRUE);
+}
+
+static gboolean
+_archive_compress_file(const char * const filename)
+{
+    GString *archive = g_string_new(filename);
+    g_string_append(archive, LOG_ARCHIVE_EXT);
+    GError *error = NULL;
+    gboolean ok = prof_gzip_file(filename, archive->str, &error);
+    g_string_free(archive, TRUE);
+
+    if (error) {
+        if (archive_errors) {
+            g_async_queue_push(archive_errors, g_strdup(error->message));
+        } else {
+            log_error("%s", error->message);
+        }
+        g_error_free(error);
+    }
+
+    return ok;
+}
+
+static void
+_archive_log_errors(void)
+{
+    char *message;
+    while ((message = g_async_queue_try_pop(archive_errors)) != NULL) {
+        log_error("Could not archive log: %s", message);
+        g_free(message);
+    }
+}
+
+// compress every daily log under dir apart from those named skip
+static void
+_archive_sweep(const char * const dir, const char * const skip)
+{
+    GDir *logdir = g_dir_open(dir, 0, NULL);
+    if (logdir == NULL) {
+        return;
+    }
+
+    const gchar *name;
+    while ((name = g_dir_read_name(logdir)) != NULL) {
+        if (g_atomic_int_get(&archive_stopping)) {
+            break;
+        }
+
+        gchar *path = g_build_filename(dir, name, NULL);
+        if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+            _archive_sweep(path, skip);
+        } else if (g_str_has_suffix(name, ".log") && g_strcmp0(name, skip) != 0) {
+            _archive_compress_file(path);
+        }
+        g_free(path);
+    }
+
+    g_dir_close(logdir);
+}
+
 static struct dated_chat_log *
 _create_log(char *other, const char * const login)
 {
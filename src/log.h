@@ -37,6 +37,9 @@
 
 #include "glib.h"
 
+// suffix of compressed log files, see /log compress
+#define LOG_ARCHIVE_EXT ".gz"
+
 // log levels
 typedef enum {
     PROF_LEVEL_DEBUG,
@@ -66,11 +69,14 @@ log_level_t log_level_from_string(char *log_level);
 void chat_log_init(void);
 void chat_log_chat(const gchar * const login, gchar *other,
     const gchar * const msg, chat_log_direction_t direction, GTimeVal *tv_stamp);
+void chat_log_tick(void);
 void chat_log_close(void);
 GSList * chat_log_get_previous(const gchar * const login,
     const gchar * const recipient);
 
 void groupchat_log_init(void);
 void groupchat_log_chat(const gchar * const login, const gchar * const room,
-    const gchar * const nick, const gchar * const msg);
+    const gchar * const nick, const gchar * const msg, GTimeVal *tv_stamp);
+GDateTime * groupchat_log_get_last_time(const gchar * const login,
+    const gchar * const room);
 #endif
@@ -0,0 +1,889 @@
+/*
+ * log_index.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#include "prof_config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "common.h"
+#include "log.h"
+#include "log_index.h"
+
+// the index is an append only journal in each account's chat log directory
+// made of "d <id> <file>" document lines and "t <id> <token>" posting lines,
+// rewritten once loaded if it names days whose logs are gone or bad lines
+#define INDEX_FILE ".index"
+#define TOKEN_MIN_CHARS 2
+#define TOKEN_MAX_CHARS 32
+
+// log lines start with "HH:MM:SS - "
+#define TIMESTAMP_LEN 11
+
+#define MAX_INDEX_THREADS 8
+
+// a job without a docname scans path for days, its result lists every day
+// found in tokens
+struct index_job_t {
+    char *docname;
+    char *path;
+};
+
+struct index_result_t {
+    char *docname;
+    GList *tokens;
+};
+
+static char *index_login;
+static char *index_dir;
+static FILE *journal;
+static GPtrArray *docs;
+static GHashTable *doc_ids;
+static GHashTable *postings;
+
+static GThreadPool *indexer;
+static GAsyncQueue *indexed;
+static gint index_stopping;
+static int pending;
+static guint journal_waste;
+
+static GSList *last_hits;
+
+static gboolean _index_open(const char * const login);
+static void _index_close_current(void);
+static void _index_load(const char * const filename);
+static GList * _index_scan(const char * const dir, const char * const prefix,
+    GList *found);
+static void _index_scanned(GList *found);
+static void _index_compact(GHashTable *present);
+static void _index_drain(void);
+static void _index_file(gpointer data, gpointer user_data);
+static guint _doc_id(const char * const docname);
+static gboolean _posting_add(const char * const token, guint id);
+static GArray * _postings_intersect(GSList *tokens);
+static GSList * _tokenize(const char * const text, GSList *tokens);
+static gboolean _line_matches(const char * const line, GSList *tokens);
+static GSList * _read_doc(const char * const path, GSList *lines);
+static gint _cmp_docs_newest(gconstpointer a, gconstpointer b);
+static gint _cmp_ids(gconstpointer a, gconstpointer b);
+static const char * _line_text(const char * const line);
+static LogSearchHit * _hit_new(const char * const docname, int line,
+    const char * const text);
+static void _hit_free(LogSearchHit *hit);
+static void _job_free(struct index_job_t *job);
+static void _result_free(struct index_result_t *result);
+
+void
+log_index_init(void)
+{
+    index_login = NULL;
+    index_dir = NULL;
+    journal = NULL;
+    last_hits = NULL;
+    pending = 0;
+    journal_waste = 0;
+}
+
+void
+log_index_close(void)
+{
+    _index_close_current();
+    g_slist_free_full(last_hits, (GDestroyNotify)_hit_free);
+    last_hits = NULL;
+}
+
+void
+log_index_add(const char * const login, const char * const filename,
+    const char * const text)
+{
+    if (!_index_open(login)) {
+        return;
+    }
+
+    size_t dir_len = strlen(index_dir);
+    if (strncmp(filename, index_dir, dir_len) != 0) {
+        return;
+    }
+
+    _index_drain();
+
+    guint id = _doc_id(filename + dir_len);
+    GSList *tokens = _tokenize(text, NULL);
+    GSList *curr = tokens;
+    while (curr != NULL) {
+        _posting_add(curr->data, id);
+        curr = g_slist_next(curr);
+    }
+    g_slist_free_full(tokens, g_free);
+
+    if (journal != NULL) {
+        fflush(journal);
+    }
+}
+
+GSList *
+log_index_search(const char * const login, const char * const query, int max)
+{
+    g_slist_free_full(last_hits, (GDestroyNotify)_hit_free);
+    last_hits = NULL;
+
+    if (!_index_open(login)) {
+        return NULL;
+    }
+    _index_drain();
+
+    GSList *tokens = _tokenize(query, NULL);
+    if (tokens == NULL) {
+        return NULL;
+    }
+
+    GArray *found = _postings_intersect(tokens);
+    if (found == NULL) {
+        g_slist_free_full(tokens, g_free);
+        return NULL;
+    }
+
+    GSList *candidates = NULL;
+    guint i;
+    for (i = 0; i < found->len; i++) {
+        guint id = g_array_index(found, guint, i);
+        candidates = g_slist_prepend(candidates, g_ptr_array_index(docs, id));
+    }
+    g_array_free(found, TRUE);
+    candidates = g_slist_sort(candidates, _cmp_docs_newest);
+
+    // postings are per day, the day itself is scanned to find the lines
+    int count = 0;
+    GSList *curr = candidates;
+    while (curr != NULL && count < max) {
+        char *docname = curr->data;
+        GString *path = g_string_new(index_dir);
+        g_string_append(path, docname);
+        GSList *lines = g_slist_reverse(_read_doc(path->str, NULL));
+        g_string_free(path, TRUE);
+
+        int line_num = 0;
+        GSList *line = lines;
+        while (line != NULL && count < max) {
+            if (_line_matches(line->data, tokens)) {
+                last_hits = g_slist_append(last_hits, _hit_new(docname, line_num, line->data));
+                count++;
+            }
+            line_num++;
+            line = g_slist_next(line);
+        }
+        g_slist_free_full(lines, free);
+
+        curr = g_slist_next(curr);
+    }
+
+    g_slist_free(candidates);
+    g_slist_free_full(tokens, g_free);
+
+    return last_hits;
+}
+
+LogSearchHit *
+log_index_get_hit(int num)
+{
+    if (num < 1) {
+        return NULL;
+    }
+
+    return g_slist_nth_data(last_hits, num - 1);
+}
+
+int
+log_index_pending(void)
+{
+    _index_drain();
+    return pending;
+}
+
+GSList *
+log_index_read_day(LogSearchHit *hit)
+{
+    return g_slist_reverse(_read_doc(hit->filename, NULL));
+}
+
+static gboolean
+_index_open(const char * const login)
+{
+    if (login == NULL) {
+        return FALSE;
+    }
+    if (g_strcmp0(index_login, login) == 0) {
+        return TRUE;
+    }
+
+    _index_close_current();
+
+    gchar *xdg_data = xdg_get_data_home();
+    gchar *login_dir = str_replace(login, "@", "_at_");
+    GString *dir = g_string_new(xdg_data);
+    g_string_append_printf(dir, "/profanity/chatlogs/%s", login_dir);
+    g_free(xdg_data);
+    free(login_dir);
+
+    if (!mkdir_recursive(dir->str)) {
+        log_error("Could not create chat log directory %s", dir->str);
+        g_string_free(dir, TRUE);
+        return FALSE;
+    }
+    g_string_append(dir, "/");
+
+    index_login = strdup(login);
+    index_dir = strdup(dir->str);
+    docs = g_ptr_array_new_with_free_func(free);
+    doc_ids = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, NULL);
+    postings = g_hash_table_new_full(g_str_hash, g_str_equal, free,
+        (GDestroyNotify)g_array_unref);
+
+    g_string_append(dir, INDEX_FILE);
+    _index_load(dir->str);
+    journal = fopen(dir->str, "a");
+    g_chmod(dir->str, S_IRUSR | S_IWUSR);
+    g_string_free(dir, TRUE);
+
+    // the log directory is walked on an indexer thread, days logged before
+    // the index existed are queued once the walk comes back
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = CLAMP(cpus, 1, MAX_INDEX_THREADS);
+    g_atomic_int_set(&index_stopping, 0);
+    p_threads_init();
+    indexed = g_async_queue_new();
+    indexer = g_thread_pool_new(_index_file, NULL, threads, FALSE, NULL);
+
+    struct index_job_t *scan = malloc(sizeof(struct index_job_t));
+    scan->docname = NULL;
+    scan->path = strdup(index_dir);
+    g_thread_pool_push(indexer, scan, NULL);
+    pending++;
+
+    log_info("Chat log index opened for %s, %u days indexed", login, docs->len);
+
+    return TRUE;
+}
+
+static void
+_index_close_current(void)
+{
+    if (index_login == NULL) {
+        return;
+    }
+
+    // queued files are skipped, they are picked up when next opened
+    g_atomic_int_set(&index_stopping, 1);
+    g_thread_pool_free(indexer, FALSE, TRUE);
+    indexer = NULL;
+    _index_drain();
+    g_async_queue_unref(indexed);
+    indexed = NULL;
+
+    if (journal != NULL) {
+        fclose(journal);
+        journal = NULL;
+    }
+
+    g_hash_table_destroy(postings);
+    g_hash_table_destroy(doc_ids);
+    g_ptr_array_free(docs, TRUE);
+    postings = NULL;
+    doc_ids = NULL;
+    docs = NULL;
+
+    FREE_SET_NULL(index_login);
+    FREE_SET_NULL(index_dir);
+    pending = 0;
+    journal_waste = 0;
+}
+
+static void
+_index_load(const char * const filename)
+{
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return;
+    }
+
+    char *line;
+    while ((line = prof_getline(fp)) != NULL) {
+        char *id_str = strchr(line, '\t');
+        char *value = id_str ? strchr(id_str + 1, '\t') : NULL;
+        if (value == NULL) {
+            journal_waste++;
+            free(line);
+            continue;
+        }
+        guint id = strtoul(id_str + 1, NULL, 10);
+        value++;
+
+        if (line[0] == 'd' && id == docs->len) {
+            char *docname = strdup(value);
+            g_ptr_array_add(docs, docname);
+            g_hash_table_insert(doc_ids, docname, GUINT_TO_POINTER(id + 1));
+        } else if (line[0] == 't' && id < docs->len) {
+            GArray *ids = g_hash_table_lookup(postings, value);
+            if (ids == NULL) {
+                ids = g_array_new(FALSE, FALSE, sizeof(guint));
+                g_hash_table_insert(postings, strdup(value), ids);
+            }
+            g_array_append_val(ids, id);
+        } else {
+            journal_waste++;
+        }
+        free(line);
+    }
+    fclose(fp);
+
+    // postings are appended out of order when days are indexed concurrently
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, postings);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        GArray *ids = value;
+        g_array_sort(ids, _cmp_ids);
+    }
+}
+
+// runs on an indexer thread, prepends the name of every day found to found
+static GList *
+_index_scan(const char * const dir, const char * const prefix, GList *found)
+{
+    GDir *logdir = g_dir_open(dir, 0, NULL);
+    if (logdir == NULL) {
+        return found;
+    }
+
+    const gchar *name;
+    while ((name = g_dir_read_name(logdir)) != NULL) {
+        if (g_atomic_int_get(&index_stopping)) {
+            break;
+        }
+
+        gchar *path = g_build_filename(dir, name, NULL);
+        if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+            GString *sub_prefix = g_string_new(prefix);
+            g_string_append_printf(sub_prefix, "%s/", name);
+            found = _index_scan(path, sub_prefix->str, found);
+            g_string_free(sub_prefix, TRUE);
+        } else {
+            GString *docname = g_string_new(prefix);
+            g_string_append(docname, name);
+            if (g_str_has_suffix(docname->str, LOG_ARCHIVE_EXT)) {
+                g_string_truncate(docname, docname->len - strlen(LOG_ARCHIVE_EXT));
+            }
+            if (g_str_has_suffix(docname->str, ".log")) {
+                found = g_list_prepend(found, g_string_free(docname, FALSE));
+            } else {
+                g_string_free(docname, TRUE);
+            }
+        }
+        g_free(path);
+    }
+
+    g_dir_close(logdir);
+
+    return found;
+}
+
+// queue days missing from the index and drop days whose logs are gone
+static void
+_index_scanned(GList *found)
+{
+    GHashTable *present = g_hash_table_new(g_str_hash, g_str_equal);
+    GList *curr = found;
+    while (curr != NULL) {
+        char *docname = curr->data;
+        if (!g_hash_table_lookup(present, docname)) {
+            g_hash_table_insert(present, docname, GINT_TO_POINTER(1));
+            if (!g_hash_table_lookup(doc_ids, docname)) {
+                struct index_job_t *job = malloc(sizeof(struct index_job_t));
+                job->docname = strdup(docname);
+                GString *doc_path = g_string_new(index_dir);
+                g_string_append(doc_path, docname);
+                job->path = g_string_free(doc_path, FALSE);
+                g_thread_pool_push(indexer, job, NULL);
+                pending++;
+            }
+        }
+        curr = g_list_next(curr);
+    }
+
+    // days first logged after the walk passed their directory are kept
+    gboolean removed = FALSE;
+    guint id;
+    for (id = 0; id < docs->len; id++) {
+        char *docname = g_ptr_array_index(docs, id);
+        if (g_hash_table_lookup(present, docname)) {
+            continue;
+        }
+        GString *path = g_string_new(index_dir);
+        g_string_append(path, docname);
+        if (g_file_test(path->str, G_FILE_TEST_EXISTS)) {
+            g_hash_table_insert(present, docname, GINT_TO_POINTER(1));
+        } else {
+            removed = TRUE;
+        }
+        g_string_free(path, TRUE);
+    }
+
+    if (removed || journal_waste > 0) {
+        _index_compact(present);
+    }
+    g_hash_table_destroy(present);
+}
+
+// rewrite the journal from the applied entries, keeping only present days
+static void
+_index_compact(GHashTable *present)
+{
+    GString *filename = g_string_new(index_dir);
+    g_string_append(filename, INDEX_FILE);
+    GString *tmp = g_string_new(filename->str);
+    g_string_append(tmp, ".tmp");
+
+    GPtrArray *kept = g_ptr_array_new_with_free_func(free);
+    guint *remap = malloc(sizeof(guint) * MAX(docs->len, 1));
+    GString *contents = g_string_new("");
+
+    guint id;
+    for (id = 0; id < docs->len; id++) {
+        char *docname = g_ptr_array_index(docs, id);
+        if (g_hash_table_lookup(present, docname)) {
+            remap[id] = kept->len;
+            g_string_append_printf(contents, "d\t%u\t%s\n", kept->len, docname);
+            g_ptr_array_add(kept, strdup(docname));
+        } else {
+            remap[id] = G_MAXUINT;
+        }
+    }
+
+    // ids keep their order when renumbered so the postings stay sorted
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, postings);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GArray *ids = value;
+        guint i, len = 0;
+        for (i = 0; i < ids->len; i++) {
+            guint new_id = remap[g_array_index(ids, guint, i)];
+            if (new_id != G_MAXUINT) {
+                g_array_index(ids, guint, len++) = new_id;
+                g_string_append_printf(contents, "t\t%u\t%s\n", new_id, (char *)key);
+            }
+        }
+        g_array_set_size(ids, len);
+        if (len == 0) {
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+    free(remap);
+
+    g_hash_table_remove_all(doc_ids);
+    g_ptr_array_free(docs, TRUE);
+    docs = kept;
+    for (id = 0; id < docs->len; id++) {
+        g_hash_table_insert(doc_ids, g_ptr_array_index(docs, id), GUINT_TO_POINTER(id + 1));
+    }
+
+    if (journal != NULL) {
+        fclose(journal);
+    }
+
+    GError *error = NULL;
+    if (g_file_set_contents(tmp->str, contents->str, contents->len, &error) &&
+            g_rename(tmp->str, filename->str) == 0) {
+        g_chmod(filename->str, S_IRUSR | S_IWUSR);
+        log_info("Chat log index compacted to %u days", docs->len);
+    } else {
+        // the old ids no longer apply, start again from the logs next time
+        log_error("Could not compact chat log index %s: %s", filename->str,
+            error ? error->message : g_strerror(errno));
+        remove(tmp->str);
+        remove(filename->str);
+        if (error) {
+            g_error_free(error);
+        }
+    }
+    journal = fopen(filename->str, "a");
+    journal_waste = 0;
+
+    g_string_free(contents, TRUE);
+    g_string_free(tmp, TRUE);
+    g_string_free(filename, TRUE);
+}
+
+// merge results from the indexer threads, main thread only
+static void
+_index_drain(void)
+{
+    if (indexed == NULL) {
+        return;
+    }
+
+    struct index_result_t *result;
+    gboolean merged = FALSE;
+    while ((result = g_async_queue_try_pop(indexed)) != NULL) {
+        if (result->docname == NULL) {
+            if (!g_atomic_int_get(&index_stopping)) {
+                _index_scanned(result->tokens);
+            }
+        } else if (result->tokens != NULL) {
+            guint id = _doc_id(result->docname);
+            GList *curr = result->tokens;
+            while (curr != NULL) {
+                _posting_add(curr->data, id);
+                curr = g_list_next(curr);
+            }
+        }
+        _result_free(result);
+        pending--;
+        merged = TRUE;
+    }
+
+    if (merged && journal != NULL) {
+        fflush(journal);
+    }
+}
+
+// runs on an indexer thread, must not touch the index itself
+static void
+_index_file(gpointer data, gpointer user_data)
+{
+    struct index_job_t *job = data;
+    struct index_result_t *result = malloc(sizeof(struct index_result_t));
+    result->docname = job->docname;
+    result->tokens = NULL;
+    job->docname = NULL;
+
+    if (result->docname == NULL) {
+        result->tokens = _index_scan(job->path, "", NULL);
+    } else if (!g_atomic_int_get(&index_stopping)) {
+        GHashTable *unique = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        GSList *lines = _read_doc(job->path, NULL);
+        GSList *curr = lines;
+        while (curr != NULL) {
+            GSList *tokens = _tokenize(_line_text(curr->data), NULL);
+            GSList *token = tokens;
+            while (token != NULL) {
+                g_hash_table_replace(unique, token->data, token->data);
+                token = g_slist_next(token);
+            }
+            g_slist_free(tokens);
+            curr = g_slist_next(curr);
+        }
+        g_slist_free_full(lines, free);
+
+        result->tokens = g_hash_table_get_keys(unique);
+        g_hash_table_steal_all(unique);
+        g_hash_table_destroy(unique);
+    }
+
+    _job_free(job);
+    g_async_queue_push(indexed, result);
+}
+
+static guint
+_doc_id(const char * const docname)
+{
+    gpointer found = g_hash_table_lookup(doc_ids, docname);
+    if (found != NULL) {
+        return GPOINTER_TO_UINT(found) - 1;
+    }
+
+    guint id = docs->len;
+    char *name = strdup(docname);
+    g_ptr_array_add(docs, name);
+    g_hash_table_insert(doc_ids, name, GUINT_TO_POINTER(id + 1));
+    if (journal != NULL) {
+        fprintf(journal, "d\t%u\t%s\n", id, name);
+    }
+
+    return id;
+}
+
+// postings are kept sorted so that queries can intersect them linearly
+static gboolean
+_posting_add(const char * const token, guint id)
+{
+    GArray *ids = g_hash_table_lookup(postings, token);
+    if (ids == NULL) {
+        ids = g_array_new(FALSE, FALSE, sizeof(guint));
+        g_hash_table_insert(postings, strdup(token), ids);
+    }
+
+    guint low = 0;
+    guint high = ids->len;
+    while (low < high) {
+        guint mid = (low + high) / 2;
+        guint mid_id = g_array_index(ids, guint, mid);
+        if (mid_id == id) {
+            return FALSE;
+        } else if (mid_id < id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    g_array_insert_val(ids, low, id);
+
+    if (journal != NULL) {
+        fprintf(journal, "t\t%u\t%s\n", id, token);
+    }
+
+    return TRUE;
+}
+
+static GArray *
+_postings_intersect(GSList *tokens)
+{
+    GArray *result = NULL;
+
+    GSList *curr = tokens;
+    while (curr != NULL) {
+        GArray *ids = g_hash_table_lookup(postings, curr->data);
+        if (ids == NULL) {
+            if (result != NULL) {
+                g_array_free(result, TRUE);
+            }
+            return NULL;
+        }
+
+        if (result == NULL) {
+            result = g_array_sized_new(FALSE, FALSE, sizeof(guint), ids->len);
+            g_array_append_vals(result, ids->data, ids->len);
+        } else {
+            guint i = 0, j = 0, k = 0;
+            while (i < result->len && j < ids->len) {
+                guint a = g_array_index(result, guint, i);
+                guint b = g_array_index(ids, guint, j);
+                if (a == b) {
+                    g_array_index(result, guint, k++) = a;
+                    i++;
+                    j++;
+                } else if (a < b) {
+                    i++;
+                } else {
+                    j++;
+                }
+            }
+            g_array_set_size(result, k);
+        }
+
+        curr = g_slist_next(curr);
+    }
+
+    return result;
+}
+
+// lower case words of alphanumeric characters, prepended to tokens
+static GSList *
+_tokenize(const char * const text, GSList *tokens)
+{
+    if (text == NULL || !g_utf8_validate(text, -1, NULL)) {
+        return tokens;
+    }
+
+    gchar *lower = g_utf8_strdown(text, -1);
+    const gchar *curr = lower;
+    const gchar *start = NULL;
+    glong chars = 0;
+
+    while (TRUE) {
+        gunichar ch = g_utf8_get_char(curr);
+        gboolean word = (ch != 0) && g_unichar_isalnum(ch);
+
+        if (word) {
+            if (start == NULL) {
+                start = curr;
+                chars = 0;
+            }
+            chars++;
+        } else if (start != NULL) {
+            if (chars >= TOKEN_MIN_CHARS && chars <= TOKEN_MAX_CHARS) {
+                tokens = g_slist_prepend(tokens, g_strndup(start, curr - start));
+            }
+            start = NULL;
+        }
+
+        if (ch == 0) {
+            break;
+        }
+        curr = g_utf8_next_char(curr);
+    }
+    g_free(lower);
+
+    return tokens;
+}
+
+static gboolean
+_line_matches(const char * const line, GSList *tokens)
+{
+    const char *text = _line_text(line);
+    if (text == NULL) {
+        return FALSE;
+    }
+
+    GSList *line_tokens = _tokenize(text, NULL);
+    gboolean matches = TRUE;
+    GSList *curr = tokens;
+    while (curr != NULL && matches) {
+        if (g_slist_find_custom(line_tokens, curr->data, (GCompareFunc)g_strcmp0) == NULL) {
+            matches = FALSE;
+        }
+        curr = g_slist_next(curr);
+    }
+    g_slist_free_full(line_tokens, g_free);
+
+    return matches;
+}
+
+// lines of a day are prepended, the compressed part comes first
+static GSList *
+_read_doc(const char * const path, GSList *lines)
+{
+    GString *archived = g_string_new(path);
+    g_string_append(archived, LOG_ARCHIVE_EXT);
+
+    const char *files[] = { archived->str, path };
+    int i;
+    for (i = 0; i < 2; i++) {
+        if (!g_file_test(files[i], G_FILE_TEST_EXISTS)) {
+            continue;
+        }
+        gzFile fp = gzopen(files[i], "rb");
+        if (fp == NULL) {
+            continue;
+        }
+        char *line;
+        while ((line = prof_gzgetline(fp)) != NULL) {
+            lines = g_slist_prepend(lines, line);
+        }
+        gzclose(fp);
+    }
+    g_string_free(archived, TRUE);
+
+    return lines;
+}
+
+// documents are named <contact>/YYYY_MM_DD.log or rooms/<room>/YYYY_MM_DD.log
+static gint
+_cmp_docs_newest(gconstpointer a, gconstpointer b)
+{
+    const char *day_a = strrchr(a, '/');
+    const char *day_b = strrchr(b, '/');
+
+    return g_strcmp0(day_b ? day_b : b, day_a ? day_a : a);
+}
+
+static gint
+_cmp_ids(gconstpointer a, gconstpointer b)
+{
+    guint id_a = *(const guint *)a;
+    guint id_b = *(const guint *)b;
+
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+static const char *
+_line_text(const char * const line)
+{
+    if (strlen(line) <= TIMESTAMP_LEN || line[2] != ':') {
+        return NULL;
+    }
+
+    return line + TIMESTAMP_LEN;
+}
+
+static LogSearchHit *
+_hit_new(const char * const docname, int line, const char * const text)
+{
+    LogSearchHit *hit = malloc(sizeof(LogSearchHit));
+
+    gchar **parts = g_strsplit(docname, "/", -1);
+    guint len = g_strv_length(parts);
+    hit->room = (len == 3 && g_strcmp0(parts[0], "rooms") == 0);
+    char *contact_dir = len >= 2 ? parts[len - 2] : "";
+    hit->contact = str_replace(contact_dir, "_at_", "@");
+    hit->date = g_strndup(parts[len - 1], strlen("YYYY_MM_DD"));
+    g_strdelimit(hit->date, "_", '-');
+    g_strfreev(parts);
+
+    GString *filename = g_string_new(index_dir);
+    g_string_append(filename, docname);
+    hit->filename = strdup(filename->str);
+    g_string_free(filename, TRUE);
+
+    hit->line = line;
+    hit->text = strdup(text);
+
+    return hit;
+}
+
+static void
+_hit_free(LogSearchHit *hit)
+{
+    if (hit != NULL) {
+        free(hit->contact);
+        g_free(hit->date);
+        free(hit->filename);
+        free(hit->text);
+        free(hit);
+    }
+}
+
+static void
+_job_free(struct index_job_t *job)
+{
+    free(job->docname);
+    free(job->path);
+    free(job);
+}
+
+static void
+_result_free(struct index_result_t *result)
+{
+    free(result->docname);
+    g_list_free_full(result->tokens, g_free);
+    free(result);
+}
@@ -40,6 +40,8 @@
 #include "contact.h"
 #include "common.h"
 #include "jid.h"
+#include "log.h"
+#include "config/preferences.h"
 #include "tools/autocomplete.h"
 #include "ui/ui.h"
 #include "ui/windows.h"
@@ -62,11 +64,27 @@ typedef struct _muc_room_t {
     Autocomplete jid_ac;
     GHashTable *nick_changes;
     gboolean roster_received;
+    // nick_ac and jid_ac are only built once something needs them
+    gboolean indexed;
 } ChatRoom;
 
 GHashTable *rooms = NULL;
 Autocomplete invite_ac;
 
+// newest message seen in each room, kept after leaving so a rejoin only
+// asks for the history that was missed
+static GHashTable *last_messages = NULL;
+
+// the last MUC_RECENT_MAX messages in each room, history asked for with a
+// margin repeats some of them
+static GHashTable *recent_messages = NULL;
+
+struct recent_message_t {
+    char *key;
+    // history stamped later than this is a new message saying the same
+    GDateTime *until;
+};
+
 static void _free_room(ChatRoom *room);
 static gint _compare_occupants(Occupant *a, Occupant *b);
 static muc_role_t _role_from_string(const char * const role);
@@ -76,12 +94,17 @@ static char* _affiliation_to_string(muc_affiliation_t affiliation);
 static Occupant* _muc_occupant_new(const char *const nick, const char * const jid,
     muc_role_t role, muc_affiliation_t affiliation, resource_presence_t presence, const char * const status);
 static void _occupant_free(Occupant *occupant);
+static void _room_index(ChatRoom *chat_room);
+static void _recent_free(GQueue *recent);
+static void _recent_message_free(struct recent_message_t *recent_message);
 
 void
 muc_init(void)
 {
     invite_ac = autocomplete_new();
     rooms = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)_free_room);
+    last_messages = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_date_time_unref);
+    recent_messages = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)_recent_free);
 }
 
 void
@@ -90,6 +113,10 @@ muc_close(void)
     autocomplete_free(invite_ac);
     g_hash_table_destroy(rooms);
     rooms = NULL;
+    g_hash_table_destroy(last_messages);
+    last_messages = NULL;
+    g_hash_table_destroy(recent_messages);
+    recent_messages = NULL;
 }
 
 void
@@ -175,6 +202,7 @@ muc_join(const char * const room, const char * const nick,
     new_room->jid_ac = autocomplete_new();
     new_room->nick_changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     new_room->roster_received = FALSE;
+    new_room->indexed = FALSE;
     new_room->pending_nick_change = FALSE;
     new_room->autojoin = autojoin;
 
@@ -373,6 +401,107 @@ muc_password(const char * const room)
     }
 }
 
+void
+muc_set_last_message(const char * const room, GDateTime *time)
+{
+    GDateTime *last = g_hash_table_lookup(last_messages, room);
+    if (last && g_date_time_compare(last, time) >= 0) {
+        return;
+    }
+
+    g_hash_table_replace(last_messages, strdup(room), g_date_time_ref(time));
+}
+
+GDateTime *
+muc_last_message(const char * const room)
+{
+    return g_hash_table_lookup(last_messages, room);
+}
+
+// as muc_last_message, falling back to the last line of today's room log
+GDateTime *
+muc_last_activity(const char * const login, const char * const room)
+{
+    GDateTime *last = g_hash_table_lookup(last_messages, room);
+    if (last || !prefs_get_boolean(PREF_GRLOG)) {
+        return last;
+    }
+
+    GDateTime *logged = groupchat_log_get_last_time(login, room);
+    if (logged == NULL) {
+        return NULL;
+    }
+
+    // the log is written with the local clock
+    GDateTime *mark = g_date_time_add_seconds(logged, -MUC_HISTORY_MARGIN);
+    muc_set_last_message(room, mark);
+    g_date_time_unref(mark);
+    g_date_time_unref(logged);
+
+    return g_hash_table_lookup(last_messages, room);
+}
+
+void
+muc_remember_message(const char * const room, const char * const nick,
+    const char * const message, GDateTime *stamp)
+{
+    GQueue *recent = g_hash_table_lookup(recent_messages, room);
+    if (recent == NULL) {
+        recent = g_queue_new();
+        g_hash_table_insert(recent_messages, strdup(room), recent);
+    }
+
+    struct recent_message_t *recent_message = malloc(sizeof(struct recent_message_t));
+    recent_message->key = g_strdup_printf("%s\n%s", nick ? nick : "", message);
+
+    // live messages have no stamp, the server's clock may be ahead of ours
+    if (stamp) {
+        recent_message->until = g_date_time_ref(stamp);
+    } else {
+        GDateTime *now = g_date_time_new_now_utc();
+        recent_message->until = g_date_time_add_seconds(now, MUC_HISTORY_MARGIN);
+        g_date_time_unref(now);
+    }
+
+    g_queue_push_tail(recent, recent_message);
+    if (g_queue_get_length(recent) > MUC_RECENT_MAX) {
+        _recent_message_free(g_queue_pop_head(recent));
+    }
+}
+
+gboolean
+muc_message_seen(const char * const room, const char * const nick,
+    const char * const message, GDateTime *stamp)
+{
+    GQueue *recent = g_hash_table_lookup(recent_messages, room);
+    if (recent == NULL) {
+        return FALSE;
+    }
+
+    char *key = g_strdup_printf("%s\n%s", nick ? nick : "", message);
+    GList *curr = recent->head;
+    while (curr) {
+        struct recent_message_t *recent_message = curr->data;
+        if (g_strcmp0(recent_message->key, key) == 0 &&
+                g_date_time_compare(stamp, recent_message->until) <= 0) {
+            break;
+        }
+        curr = g_list_next(curr);
+    }
+    g_free(key);
+
+    if (curr == NULL) {
+        return FALSE;
+    }
+
+    // each remembered message accounts for one history item, so a repeat
+    // said again while we were away is still shown
+    _recent_message_free(curr->data);
+    g_queue_delete_link(recent, curr);
+
+    return TRUE;
+}
+
 /*
  * Returns TRUE if the specified nick exists in the room's roster
  */
@@ -404,7 +533,9 @@ muc_roster_add(const char * const room, const char * const nick, const char * co
 
         if (!old) {
             updated = TRUE;
-            autocomplete_add(chat_room->nick_ac, nick);
+            if (chat_room->indexed) {
+                autocomplete_add(chat_room->nick_ac, nick);
+            }
         } else if (old->presence != new_presence ||
                     (g_strcmp0(old->status, status) != 0)) {
             updated = TRUE;
@@ -416,7 +547,7 @@ muc_roster_add(const char * const room, const char * const nick, const char * co
         Occupant *occupant = _muc_occupant_new(nick, jid, role_t, affiliation_t, presence, status);
         g_hash_table_replace(chat_room->roster, strdup(nick), occupant);
 
-        if (jid) {
+        if (jid && chat_room->indexed) {
             Jid *jidp = jid_create(jid);
             if (jidp->barejid) {
                 autocomplete_add(chat_room->jid_ac, jidp->barejid);
@@ -437,7 +568,9 @@ muc_roster_remove(const char * const room, const char * const nick)
     ChatRoom *chat_room = g_hash_table_lookup(rooms, room);
     if (chat_room) {
         g_hash_table_remove(chat_room->roster, nick);
-        autocomplete_remove(chat_room->nick_ac, nick);
+        if (chat_room->indexed) {
+            autocomplete_remove(chat_room->nick_ac, nick);
+        }
     }
 }
 
@@ -461,18 +594,8 @@ muc_roster(const char * const room)
 {
     ChatRoom *chat_room = g_hash_table_lookup(rooms, room);
     if (chat_room) {
-        GList *result = NULL;
         GList *occupants = g_hash_table_get_values(chat_room->roster);
-
-        GList *curr = occupants;
-        while (curr) {
-            result = g_list_insert_sorted(result, curr->data, (GCompareFunc)_compare_occupants);
-            curr = g_list_next(curr);
-        }
-
-        g_list_free(occupants);
-
-        return result;
+        return g_list_sort(occupants, (GCompareFunc)_compare_occupants);
     } else {
         return NULL;
     }
@@ -486,6 +609,7 @@ muc_roster_ac(const char * const room)
 {
     ChatRoom *chat_room = g_hash_table_lookup(rooms, room);
     if (chat_room) {
+        _room_index(chat_room);
         return chat_room->nick_ac;
     } else {
         return NULL;
@@ -497,6 +621,7 @@ muc_roster_jid_ac(const char * const room)
 {
     ChatRoom *chat_room = g_hash_table_lookup(rooms, room);
     if (chat_room) {
+        _room_index(chat_room);
         return chat_room->jid_ac;
     } else {
         return NULL;
@@ -641,6 +766,8 @@ muc_autocomplete(const char * const input)
         ChatRoom *chat_room = g_hash_table_lookup(rooms, mucwin->roomjid);
 
         if (chat_room && chat_room->nick_ac) {
+            _room_index(chat_room);
+
             const char * search_str = NULL;
 
             gchar *last_space = g_strrstr(input, " ");
@@ -690,6 +817,7 @@ muc_jid_autocomplete_add_all(const char * const room, GSList *jids)
 {
     ChatRoom *chat_room = g_hash_table_lookup(rooms, room);
     if (chat_room) {
+        _room_index(chat_room);
         if (chat_room->jid_ac) {
             GSList *curr_jid = jids;
             while (curr_jid) {
@@ -939,4 +1067,53 @@ _occupant_free(Occupant *occupant)
         free(occupant);
         occupant = NULL;
     }
-}
\ No newline at end of file
+}
+
+// builds the autocompleters from the roster in one go, from then on they
+// are kept up to date with each change
+static void
+_room_index(ChatRoom *chat_room)
+{
+    if (chat_room->indexed) {
+        return;
+    }
+
+    GSList *nicks = NULL;
+    GSList *barejids = NULL;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, chat_room->roster);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Occupant *occupant = value;
+        nicks = g_slist_prepend(nicks, occupant->nick);
+        if (occupant->jid) {
+            Jid *jidp = jid_create(occupant->jid);
+            if (jidp && jidp->barejid) {
+                barejids = g_slist_prepend(barejids, strdup(jidp->barejid));
+            }
+            jid_destroy(jidp);
+        }
+    }
+
+    autocomplete_add_all(chat_room->nick_ac, nicks);
+    autocomplete_add_all(chat_room->jid_ac, barejids);
+    g_slist_free(nicks);
+    g_slist_free_full(barejids, free);
+
+    chat_room->indexed = TRUE;
+}
+
+static void
+_recent_free(GQueue *recent)
+{
+    g_queue_foreach(recent, (GFunc)_recent_message_free, NULL);
+    g_queue_free(recent);
+}
+
+static void
+_recent_message_free(struct recent_message_t *recent_message)
+{
+    g_free(recent_message->key);
+    g_date_time_unref(recent_message->until);
+    free(recent_message);
+}
@@ -41,6 +41,13 @@
 #include "jid.h"
 #include "tools/autocomplete.h"
 
+// seconds taken off times from the local clock before asking a room for the
+// history since them, the server's clock may be behind
+#define MUC_HISTORY_MARGIN 300
+
+// recent messages kept per room to drop history that was already shown
+#define MUC_RECENT_MAX 100
+
 typedef enum {
     MUC_ROLE_NONE,
     MUC_ROLE_VISITOR,
@@ -120,6 +127,14 @@ void muc_invites_clear(void);
 void muc_set_subject(const char * const room, const char * const subject);
 char* muc_subject(const char * const room);
 
+void muc_set_last_message(const char * const room, GDateTime *time);
+GDateTime * muc_last_message(const char * const room);
+GDateTime * muc_last_activity(const char * const login, const char * const room);
+void muc_remember_message(const char * const room, const char * const nick,
+    const char * const message, GDateTime *stamp);
+gboolean muc_message_seen(const char * const room, const char * const nick,
+    const char * const message, GDateTime *stamp);
+
 void muc_pending_broadcasts_add(const char * const room, const char * const message);
 GList * muc_pending_broadcasts(const char * const room);
 
@@ -32,6 +32,10 @@
  *
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <libotr/proto.h>
 #include <libotr/privkey.h>
 #include <libotr/message.h>
@@ -44,18 +48,52 @@
 #include "roster_list.h"
 #include "contact.h"
 #include "ui/ui.h"
+#include "config/persist.h"
 #include "config/preferences.h"
 #include "chat_session.h"
+#include "tools/worker.h"
 
 #define PRESENCE_ONLINE 1
 #define PRESENCE_OFFLINE 0
 #define PRESENCE_UNKNOWN -1
 
+// seconds between progress lines while a key is being generated
+#define OTR_KEYGEN_PROGRESS 15
+
+// seconds fingerprint changes are collected before they are written
+#define OTR_FINGERPRINTS_DELAY 2
+
+// a private key being calculated on a worker thread
+struct otr_keygen_t {
+    OtrlUserState user_state;
+    void *newkey;
+    gcry_error_t err;
+    char *jid;
+    gchar *basedir;
+    GTimer *timer;
+    int reported;
+};
+
 static OtrlUserState user_state;
 static OtrlMessageAppOps ops;
 static char *jid;
 static gboolean data_loaded;
 static GHashTable *smp_initiators;
+static struct otr_keygen_t *keygen;
+
+// per account paths, set by _otr_set_account
+static char *otr_dir;
+static char *keys_filename;
+static char *fps_filename;
+
+static gboolean fps_dirty;
+static GTimer *fps_timer;
+
+static void _otr_keygen_calculate(gpointer data);
+static void _otr_keygen_finish(gpointer data);
+static void _otr_keygen_load(const char * const basedir);
+static void _otr_set_account(const char * const account_jid);
+static void _otr_fingerprints_flush(void);
 
 OtrlUserState
 otr_userstate(void)
@@ -113,30 +151,14 @@ cb_inject_message(void *opdata, const char *accountname,
     message_send_chat_encrypted(recipient, message);
 }
 
+// changes are collected for OTR_FINGERPRINTS_DELAY and written by otr_poll
 static void
 cb_write_fingerprints(void *opdata)
 {
-    gcry_error_t err = 0;
-
-    gchar *data_home = xdg_get_data_home();
-    GString *basedir = g_string_new(data_home);
-    free(data_home);
-
-    gchar *account_dir = str_replace(jid, "@", "_at_");
-    g_string_append(basedir, "/profanity/otr/");
-    g_string_append(basedir, account_dir);
-    g_string_append(basedir, "/");
-    free(account_dir);
-
-    GString *fpsfilename = g_string_new(basedir->str);
-    g_string_append(fpsfilename, "fingerprints.txt");
-    err = otrl_privkey_write_fingerprints(user_state, fpsfilename->str);
-    if (!err == GPG_ERR_NO_ERROR) {
-        log_error("Failed to write fingerprints file");
-        cons_show_error("Failed to create fingerprints file");
+    if (!fps_dirty) {
+        fps_dirty = TRUE;
+        g_timer_start(fps_timer);
     }
-    g_string_free(basedir, TRUE);
-    g_string_free(fpsfilename, TRUE);
 }
 
 static void
@@ -172,6 +194,7 @@ otr_init(void)
     otrlib_init_ops(&ops);
     otrlib_init_timer();
     smp_initiators = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    fps_timer = g_timer_new();
 
     data_loaded = FALSE;
 }
@@ -179,58 +202,62 @@ otr_init(void)
 void
 otr_shutdown(void)
 {
-    if (jid != NULL) {
-        free(jid);
+    _otr_fingerprints_flush();
+    _otr_set_account(NULL);
+    if (fps_timer) {
+        g_timer_destroy(fps_timer);
+        fps_timer = NULL;
     }
 }
 
 void
 otr_poll(void)
 {
+    if (user_state == NULL) {
+        return;
+    }
+
     otrlib_poll();
+
+    if (fps_dirty && g_timer_elapsed(fps_timer, NULL) >= OTR_FINGERPRINTS_DELAY) {
+        _otr_fingerprints_flush();
+    }
+
+    if (keygen) {
+        int elapsed = (int)g_timer_elapsed(keygen->timer, NULL);
+        if (elapsed / OTR_KEYGEN_PROGRESS > keygen->reported) {
+            keygen->reported = elapsed / OTR_KEYGEN_PROGRESS;
+            cons_show("Still generating private key (%d seconds)...", elapsed);
+        }
+    }
 }
 
 void
 otr_on_connect(ProfAccount *account)
 {
-    if (jid != NULL) {
-        free(jid);
-    }
-    jid = strdup(account->jid);
+    // changes for the previous account are written to its own directory
+    _otr_fingerprints_flush();
+    _otr_set_account(account->jid);
     log_info("Loading OTR key for %s", jid);
 
-    gchar *data_home = xdg_get_data_home();
-    GString *basedir = g_string_new(data_home);
-    free(data_home);
-
-    gchar *account_dir = str_replace(jid, "@", "_at_");
-    g_string_append(basedir, "/profanity/otr/");
-    g_string_append(basedir, account_dir);
-    g_string_append(basedir, "/");
-    free(account_dir);
-
-    if (!mkdir_recursive(basedir->str)) {
-        log_error("Could not create %s for account %s.", basedir->str, jid);
-        cons_show_error("Could not create %s for account %s.", basedir->str, jid);
-        g_string_free(basedir, TRUE);
+    if (!mkdir_recursive(otr_dir)) {
+        log_error("Could not create %s for account %s.", otr_dir, jid);
+        cons_show_error("Could not create %s for account %s.", otr_dir, jid);
         return;
     }
 
     user_state = otrl_userstate_create();
+    otrlib_init_timer();
 
     gcry_error_t err = 0;
 
-    GString *keysfilename = g_string_new(basedir->str);
-    g_string_append(keysfilename, "keys.txt");
-    if (!g_file_test(keysfilename->str, G_FILE_TEST_IS_REGULAR)) {
-        log_info("No private key file found %s", keysfilename->str);
+    if (!g_file_test(keys_filename, G_FILE_TEST_IS_REGULAR)) {
+        log_info("No private key file found %s", keys_filename);
         data_loaded = FALSE;
     } else {
-        log_info("Loading OTR private key %s", keysfilename->str);
-        err = otrl_privkey_read(user_state, keysfilename->str);
+        log_info("Loading OTR private key %s", keys_filename);
+        err = otrl_privkey_read(user_state, keys_filename);
         if (!err == GPG_ERR_NO_ERROR) {
-            g_string_free(basedir, TRUE);
-            g_string_free(keysfilename, TRUE);
             log_error("Failed to load private key");
             return;
         } else {
@@ -239,18 +266,13 @@ otr_on_connect(ProfAccount *account)
         }
     }
 
-    GString *fpsfilename = g_string_new(basedir->str);
-    g_string_append(fpsfilename, "fingerprints.txt");
-    if (!g_file_test(fpsfilename->str, G_FILE_TEST_IS_REGULAR)) {
-        log_info("No fingerprints file found %s", fpsfilename->str);
+    if (!g_file_test(fps_filename, G_FILE_TEST_IS_REGULAR)) {
+        log_info("No fingerprints file found %s", fps_filename);
         data_loaded = FALSE;
     } else {
-        log_info("Loading fingerprints %s", fpsfilename->str);
-        err = otrl_privkey_read_fingerprints(user_state, fpsfilename->str, NULL, NULL);
+        log_info("Loading fingerprints %s", fps_filename);
+        err = otrl_privkey_read_fingerprints(user_state, fps_filename, NULL, NULL);
         if (!err == GPG_ERR_NO_ERROR) {
-            g_string_free(basedir, TRUE);
-            g_string_free(keysfilename, TRUE);
-            g_string_free(fpsfilename, TRUE);
             log_error("Failed to load fingerprints");
             return;
         } else {
@@ -263,9 +285,6 @@ otr_on_connect(ProfAccount *account)
         cons_show("Loaded OTR private key for %s", jid);
     }
 
-    g_string_free(basedir, TRUE);
-    g_string_free(keysfilename, TRUE);
-    g_string_free(fpsfilename, TRUE);
     return;
 }
 
@@ -277,56 +296,106 @@ otr_keygen(ProfAccount *account)
         return;
     }
 
-    if (jid != NULL) {
-        free(jid);
+    if (keygen != NULL) {
+        cons_show("OTR key generation already in progress.");
+        return;
     }
-    jid = strdup(account->jid);
-    log_info("Generating OTR key for %s", jid);
 
-    gchar *data_home = xdg_get_data_home();
-    GString *basedir = g_string_new(data_home);
-    free(data_home);
+    _otr_set_account(account->jid);
+    log_info("Generating OTR key for %s", jid);
 
-    gchar *account_dir = str_replace(jid, "@", "_at_");
-    g_string_append(basedir, "/profanity/otr/");
-    g_string_append(basedir, account_dir);
-    g_string_append(basedir, "/");
-    free(account_dir);
+    if (!mkdir_recursive(otr_dir)) {
+        log_error("Could not create %s for account %s.", otr_dir, jid);
+        cons_show_error("Could not create %s for account %s.", otr_dir, jid);
+        return;
+    }
 
-    if (!mkdir_recursive(basedir->str)) {
-        log_error("Could not create %s for account %s.", basedir->str, jid);
-        cons_show_error("Could not create %s for account %s.", basedir->str, jid);
-        g_string_free(basedir, TRUE);
+    void *newkey = NULL;
+    gcry_error_t err = otrl_privkey_generate_start(user_state, account->jid, "xmpp", &newkey);
+    if (!err == GPG_ERR_NO_ERROR) {
+        log_error("Failed to start private key generation");
+        cons_show_error("Failed to generate private key");
         return;
     }
 
-    gcry_error_t err = 0;
+    keygen = malloc(sizeof(struct otr_keygen_t));
+    keygen->user_state = user_state;
+    keygen->newkey = newkey;
+    keygen->err = GPG_ERR_NO_ERROR;
+    keygen->jid = strdup(account->jid);
+    keygen->basedir = g_strdup(otr_dir);
+    keygen->timer = g_timer_new();
+    keygen->reported = 0;
 
-    GString *keysfilename = g_string_new(basedir->str);
-    g_string_append(keysfilename, "keys.txt");
-    log_debug("Generating private key file %s for %s", keysfilename->str, jid);
-    cons_show("Generating private key, this may take some time.");
+    log_debug("Generating private key in %s for %s", keygen->basedir, jid);
+    cons_show("Generating private key in the background, this may take some time.");
     cons_show("Moving the mouse randomly around the screen may speed up the process!");
-    ui_update();
-    err = otrl_privkey_generate(user_state, keysfilename->str, account->jid, "xmpp");
+
+    // only the calculation runs on the worker, libotr's user state is
+    // touched from the main thread alone
+    worker_submit(_otr_keygen_calculate, _otr_keygen_finish, keygen);
+}
+
+static void
+_otr_keygen_calculate(gpointer data)
+{
+    struct otr_keygen_t *job = data;
+    job->err = otrl_privkey_generate_calculate(job->newkey);
+}
+
+static void
+_otr_keygen_finish(gpointer data)
+{
+    struct otr_keygen_t *job = data;
+    keygen = NULL;
+
+    GString *keysfilename = g_string_new(job->basedir);
+    g_string_append(keysfilename, "keys.txt");
+
+    gcry_error_t err = job->err;
+    if (err == GPG_ERR_NO_ERROR) {
+        err = otrl_privkey_generate_finish(job->user_state, job->newkey, keysfilename->str);
+    } else {
+        otrl_privkey_generate_cancelled(job->user_state, job->newkey);
+    }
+
     if (!err == GPG_ERR_NO_ERROR) {
-        g_string_free(basedir, TRUE);
-        g_string_free(keysfilename, TRUE);
         log_error("Failed to generate private key");
         cons_show_error("Failed to generate private key");
-        return;
+    } else {
+        log_info("Private key generated for %s after %.0f seconds", job->jid, g_timer_elapsed(job->timer, NULL));
+        cons_show("");
+        cons_show("Private key generation complete.");
+
+        // reconnected with another account while generating, the key is
+        // loaded next time this one connects
+        if (g_strcmp0(job->jid, jid) == 0) {
+            _otr_keygen_load(job->basedir);
+        }
     }
-    log_info("Private key generated");
-    cons_show("");
-    cons_show("Private key generation complete.");
 
-    GString *fpsfilename = g_string_new(basedir->str);
+    g_string_free(keysfilename, TRUE);
+    g_timer_destroy(job->timer);
+    g_free(job->basedir);
+    free(job->jid);
+    free(job);
+}
+
+static void
+_otr_keygen_load(const char * const basedir)
+{
+    gcry_error_t err = 0;
+
+    GString *keysfilename = g_string_new(basedir);
+    g_string_append(keysfilename, "keys.txt");
+    GString *fpsfilename = g_string_new(basedir);
     g_string_append(fpsfilename, "fingerprints.txt");
+
     log_debug("Generating fingerprints file %s for %s", fpsfilename->str, jid);
     err = otrl_privkey_write_fingerprints(user_state, fpsfilename->str);
     if (!err == GPG_ERR_NO_ERROR) {
-        g_string_free(basedir, TRUE);
         g_string_free(keysfilename, TRUE);
+        g_string_free(fpsfilename, TRUE);
         log_error("Failed to create fingerprints file");
         cons_show_error("Failed to create fingerprints file");
         return;
@@ -335,8 +404,8 @@ otr_keygen(ProfAccount *account)
 
     err = otrl_privkey_read(user_state, keysfilename->str);
     if (!err == GPG_ERR_NO_ERROR) {
-        g_string_free(basedir, TRUE);
         g_string_free(keysfilename, TRUE);
+        g_string_free(fpsfilename, TRUE);
         log_error("Failed to load private key");
         data_loaded = FALSE;
         return;
@@ -344,8 +413,8 @@ otr_keygen(ProfAccount *account)
 
     err = otrl_privkey_read_fingerprints(user_state, fpsfilename->str, NULL, NULL);
     if (!err == GPG_ERR_NO_ERROR) {
-        g_string_free(basedir, TRUE);
         g_string_free(keysfilename, TRUE);
+        g_string_free(fpsfilename, TRUE);
         log_error("Failed to load fingerprints");
         data_loaded = FALSE;
         return;
@@ -353,10 +422,8 @@ otr_keygen(ProfAccount *account)
 
     data_loaded = TRUE;
 
-    g_string_free(basedir, TRUE);
     g_string_free(keysfilename, TRUE);
     g_string_free(fpsfilename, TRUE);
-    return;
 }
 
 gboolean
@@ -580,7 +647,7 @@ otr_get_policy(const char * const recipient)
     account_free(account);
 
     // check global setting
-    char *pref_otr_policy = prefs_get_string(PREF_OTR_POLICY);
+    const char *pref_otr_policy = prefs_peek_string(PREF_OTR_POLICY);
 
     // pref defaults to manual
     prof_otrpolicy_t result = PROF_OTRPOLICY_MANUAL;
@@ -591,8 +658,6 @@ otr_get_policy(const char * const recipient)
         result = PROF_OTRPOLICY_ALWAYS;
     }
 
-    prefs_free_string(pref_otr_policy);
-
     return result;
 }
 
@@ -652,4 +717,76 @@ void
 otr_free_message(char *message)
 {
     otrl_message_free(message);
-}
\ No newline at end of file
+}
+
+// caches the account's otr directory and file names, NULL clears them
+static void
+_otr_set_account(const char * const account_jid)
+{
+    if (account_jid && jid && otr_dir && strcmp(account_jid, jid) == 0) {
+        return;
+    }
+
+    free(jid);
+    g_free(otr_dir);
+    g_free(keys_filename);
+    g_free(fps_filename);
+    jid = NULL;
+    otr_dir = NULL;
+    keys_filename = NULL;
+    fps_filename = NULL;
+
+    if (account_jid == NULL) {
+        return;
+    }
+
+    jid = strdup(account_jid);
+
+    gchar *data_home = xdg_get_data_home();
+    GString *basedir = g_string_new(data_home);
+    free(data_home);
+
+    gchar *account_dir = str_replace(jid, "@", "_at_");
+    g_string_append(basedir, "/profanity/otr/");
+    g_string_append(basedir, account_dir);
+    g_string_append(basedir, "/");
+    free(account_dir);
+
+    otr_dir = g_string_free(basedir, FALSE);
+    keys_filename = g_strconcat(otr_dir, "keys.txt", NULL);
+    fps_filename = g_strconcat(otr_dir, "fingerprints.txt", NULL);
+}
+
+// the fingerprints are serialized here, only the file io happens on the
+// persist writer, which keeps writes in order and the file private
+static void
+_otr_fingerprints_flush(void)
+{
+    if (!fps_dirty) {
+        return;
+    }
+    fps_dirty = FALSE;
+
+    if (user_state == NULL || fps_filename == NULL) {
+        return;
+    }
+
+    char *data = NULL;
+    size_t size = 0;
+    FILE *stream = open_memstream(&data, &size);
+    if (stream == NULL) {
+        log_error("Failed to write fingerprints file");
+        return;
+    }
+    gcry_error_t err = otrl_privkey_write_fingerprints_FILEp(user_state, stream);
+    fclose(stream);
+    if (!err == GPG_ERR_NO_ERROR) {
+        log_error("Failed to write fingerprints file");
+        cons_show_error("Failed to create fingerprints file");
+        free(data);
+        return;
+    }
+
+    persist_write(fps_filename, data, size);
+    free(data);
+}
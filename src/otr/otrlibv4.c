@@ -50,11 +50,16 @@ otrlib_policy(void)
     return OTRL_POLICY_ALLOW_V1 | OTRL_POLICY_ALLOW_V2;
 }
 
+// called at startup and again for each new user state on connect
 void
 otrlib_init_timer(void)
 {
     OtrlUserState user_state = otr_userstate();
-    timer = g_timer_new();
+    if (timer == NULL) {
+        timer = g_timer_new();
+    } else {
+        g_timer_start(timer);
+    }
     current_interval = otrl_message_poll_get_default_interval(user_state);
 }
 
@@ -102,10 +107,12 @@ cb_otr_error_message_free(void *opdata, const char *err_msg)
     free((char *)err_msg);
 }
 
+// libotr asks for polling every interval seconds, 0 stops it
 static void
 cb_timer_control(void *opdata, unsigned int interval)
 {
     current_interval = interval;
+    g_timer_start(timer);
 }
 
 static void
@@ -42,12 +42,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <curl/curl.h>
 #include <glib.h>
 
 #include "profanity.h"
 #include "chat_session.h"
 #include "chat_state.h"
 #include "config/accounts.h"
+#include "config/persist.h"
 #include "config/preferences.h"
 #include "config/theme.h"
 #include "command/command.h"
@@ -61,6 +63,7 @@
 #include "otr/otr.h"
 #endif
 #include "resource.h"
+#include "tools/worker.h"
 #include "xmpp/xmpp.h"
 #include "ui/ui.h"
 #include "ui/windows.h"
@@ -70,9 +73,18 @@ static void _init(const int disable_tls, char *log_level);
 static void _shutdown(void);
 static void _create_directories(void);
 static void _connect_default(const char * const account);
+static void _save_snapshot(void);
+
+// seconds between session snapshots while connected, see /snapshot
+#define SNAPSHOT_INTERVAL 300
+
+// seconds between idle time samples, autoaway is configured in minutes
+#define AUTOAWAY_SAMPLE_INTERVAL 1
 
 static gboolean idle = FALSE;
 static gboolean cont = TRUE;
+static GTimer *snapshot_timer = NULL;
+static GTimer *autoaway_timer = NULL;
 
 void
 prof_run(const int disable_tls, char *log_level, char *account_name)
@@ -98,12 +110,21 @@ prof_run(const int disable_tls, char *log_level, char *account_name)
             cont = TRUE;
         }
 
+        worker_process();
 #ifdef PROF_HAVE_LIBOTR
         otr_poll();
 #endif
         plugins_run_timed();
         notify_remind();
-        jabber_process_events();
+        // restored scrollback goes in ahead of any live messages
+        if (!ui_restore_session_step()) {
+            jabber_process_events();
+        }
+        persist_tick();
+        chat_log_tick();
+        if (g_timer_elapsed(snapshot_timer, NULL) > SNAPSHOT_INTERVAL) {
+            _save_snapshot();
+        }
         ui_update();
     }
 }
@@ -144,17 +165,39 @@ prof_handle_activity(void)
 static void
 _connect_default(const char * const account)
 {
+    // windows from the last session are shown while connecting
     if (account) {
+        if (prefs_get_boolean(PREF_SNAPSHOT)) {
+            ui_restore_session(account);
+        }
         cmd_execute_connect(account);
     } else {
         char *pref_connect_account = prefs_get_string(PREF_CONNECT_ACCOUNT);
         if (pref_connect_account) {
+            if (prefs_get_boolean(PREF_SNAPSHOT)) {
+                ui_restore_session(pref_connect_account);
+            }
             cmd_execute_connect(pref_connect_account);
             prefs_free_string(pref_connect_account);
         }
     }
 }
 
+static void
+_save_snapshot(void)
+{
+    g_timer_start(snapshot_timer);
+
+    if (!prefs_get_boolean(PREF_SNAPSHOT)) {
+        return;
+    }
+
+    char *account_name = jabber_get_account_name();
+    if (account_name) {
+        ui_save_session(account_name);
+    }
+}
+
 static void
 _check_autoaway(void)
 {
@@ -163,9 +206,17 @@ _check_autoaway(void)
         return;
     }
 
+    if (g_timer_elapsed(autoaway_timer, NULL) < AUTOAWAY_SAMPLE_INTERVAL) {
+        return;
+    }
+    g_timer_start(autoaway_timer);
+
     gint prefs_time = prefs_get_autoaway_time() * 60000;
     unsigned long idle_ms = ui_get_idle_time();
-    char *pref_autoaway_mode = prefs_get_string(PREF_AUTOAWAY_MODE);
+    const char *pref_autoaway_mode = prefs_peek_string(PREF_AUTOAWAY_MODE);
+
+    // the same idle signal, or an unfocused terminal, makes the client inactive
+    jabber_set_client_active((idle_ms < prefs_time) && ui_has_focus());
 
     if (!idle) {
         resource_presence_t current_presence = accounts_get_last_presence(jabber_get_account_name());
@@ -204,8 +255,6 @@ _check_autoaway(void)
             }
         }
     }
-
-    prefs_free_string(pref_autoaway_mode);
 }
 
 static void
@@ -218,6 +267,10 @@ _init(const int disable_tls, char *log_level)
     signal(SIGTSTP, SIG_IGN);
     signal(SIGWINCH, ui_sigwinch_handler);
     _create_directories();
+    persist_init();
+    // curl's global setup isn't thread safe, do it before any worker runs
+    curl_global_init(CURL_GLOBAL_ALL);
+    worker_init();
     log_level_t prof_log_level = log_level_from_string(log_level);
     prefs_load();
     log_init(prof_log_level);
@@ -245,6 +298,8 @@ _init(const int disable_tls, char *log_level)
 #ifdef PROF_HAVE_LIBOTR
     otr_init();
 #endif
+    snapshot_timer = g_timer_new();
+    autoaway_timer = g_timer_new();
     atexit(_shutdown);
     plugins_init();
     ui_input_nonblocking(TRUE);
@@ -260,6 +315,10 @@ _shutdown(void)
             ui_clear_win_title();
         }
     }
+    _save_snapshot();
+    g_timer_destroy(snapshot_timer);
+    g_timer_destroy(autoaway_timer);
+    worker_close();
     ui_close_all_wins();
     jabber_disconnect();
     jabber_shutdown();
@@ -275,6 +334,8 @@ _shutdown(void)
     prefs_close();
     theme_close();
     accounts_close();
+    persist_close();
+    curl_global_cleanup();
     cmd_uninit();
     log_close();
     plugins_shutdown();
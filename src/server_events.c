@@ -61,6 +61,7 @@ handle_room_join_error(const char * const room, const char * const err)
         muc_leave(room);
     }
     ui_handle_room_join_error(room, err);
+    bookmark_autojoin_complete(room);
 }
 
 // handle presence stanza errors
@@ -288,9 +289,21 @@ void
 handle_room_history(const char * const room_jid, const char * const nick,
     GTimeVal tv_stamp, const char * const message)
 {
-    char *new_message = plugins_pre_room_message_display(room_jid, nick, message);
-    ui_room_history(room_jid, nick, tv_stamp, new_message);
-    plugins_post_room_message_display(room_jid, nick, new_message);
+    // the delay stamp is the server's time
+    GDateTime *time = g_date_time_new_from_timeval_utc(&tv_stamp);
+
+    // history is asked for with a margin, some of it was already shown
+    gboolean seen = muc_message_seen(room_jid, nick, message, time);
+    muc_remember_message(room_jid, nick, message, time);
+    if (!seen) {
+        char *new_message = plugins_pre_room_message_display(room_jid, nick, message);
+        ui_room_history(room_jid, nick, tv_stamp, new_message);
+        plugins_post_room_message_display(room_jid, nick, new_message);
+        free(new_message);
+    }
+
+    muc_set_last_message(room_jid, time);
+    g_date_time_unref(time);
 }
 
 void
@@ -300,10 +313,18 @@ handle_room_message(const char * const room_jid, const char * const nick,
     char *new_message = plugins_pre_room_message_display(room_jid, nick, message);
     ui_room_message(room_jid, nick, new_message);
     plugins_post_room_message_display(room_jid, nick, new_message);
+    muc_remember_message(room_jid, nick, message, NULL);
+
+    // live messages carry no stamp and the local clock may be ahead
+    GDateTime *now = g_date_time_new_now_utc();
+    GDateTime *mark = g_date_time_add_seconds(now, -MUC_HISTORY_MARGIN);
+    muc_set_last_message(room_jid, mark);
+    g_date_time_unref(mark);
+    g_date_time_unref(now);
 
     if (prefs_get_boolean(PREF_GRLOG)) {
         Jid *jid = jid_create(jabber_get_fulljid());
-        groupchat_log_chat(jid->barejid, room_jid, nick, message);
+        groupchat_log_chat(jid->barejid, room_jid, nick, message, NULL);
         jid_destroy(jid);
     }
 
@@ -375,13 +396,12 @@ handle_incoming_message(char *barejid, char *resource, char *message)
         const char *jid = jabber_get_fulljid();
         Jid *jidp = jid_create(jid);
 
-        char *pref_otr_log = prefs_get_string(PREF_OTR_LOG);
+        const char *pref_otr_log = prefs_peek_string(PREF_OTR_LOG);
         if (!was_decrypted || (strcmp(pref_otr_log, "on") == 0)) {
             chat_log_chat(jidp->barejid, barejid, newmessage, PROF_IN_LOG, NULL);
         } else if (strcmp(pref_otr_log, "redact") == 0) {
             chat_log_chat(jidp->barejid, barejid, "[redacted]", PROF_IN_LOG, NULL);
         }
-        prefs_free_string(pref_otr_log);
 
         jid_destroy(jidp);
     }
@@ -521,8 +541,8 @@ handle_contact_online(char *barejid, Resource *resource,
     gboolean updated = roster_update_presence(barejid, resource, last_activity);
 
     if (updated) {
-        char *show_console = prefs_get_string(PREF_STATUSES_CONSOLE);
-        char *show_chat_win = prefs_get_string(PREF_STATUSES_CHAT);
+        const char *show_console = prefs_peek_string(PREF_STATUSES_CONSOLE);
+        const char *show_chat_win = prefs_peek_string(PREF_STATUSES_CHAT);
         PContact contact = roster_get_contact(barejid);
         if (p_contact_subscription(contact) != NULL) {
             if (strcmp(p_contact_subscription(contact), "none") != 0) {
@@ -549,8 +569,6 @@ handle_contact_online(char *barejid, Resource *resource,
                 }
             }
         }
-        prefs_free_string(show_console);
-        prefs_free_string(show_chat_win);
     }
 
     rosterwin_roster();
@@ -629,11 +647,10 @@ handle_room_occupant_offline(const char * const room, const char * const nick,
 {
     muc_roster_remove(room, nick);
 
-    char *muc_status_pref = prefs_get_string(PREF_STATUSES_MUC);
+    const char *muc_status_pref = prefs_peek_string(PREF_STATUSES_MUC);
     if (g_strcmp0(muc_status_pref, "none") != 0) {
         ui_room_member_offline(room, nick);
     }
-    prefs_free_string(muc_status_pref);
     occupantswin_occupants(room);
 }
 
@@ -747,6 +764,7 @@ handle_muc_self_online(const char * const room, const char * const nick, gboolea
         }
         muc_invites_remove(room);
         muc_roster_set_complete(room);
+        bookmark_autojoin_complete(room);
 
         // show roster if occupants list disabled by default
         if (!prefs_get_boolean(PREF_OCCUPANTS)) {
@@ -828,22 +846,20 @@ handle_muc_occupant_online(const char * const room, const char * const nick, con
 
     // joined room
     if (!occupant) {
-        char *muc_status_pref = prefs_get_string(PREF_STATUSES_MUC);
+        const char *muc_status_pref = prefs_peek_string(PREF_STATUSES_MUC);
         if (g_strcmp0(muc_status_pref, "none") != 0) {
             ui_room_member_online(room, nick, role, affiliation, show, status);
         }
-        prefs_free_string(muc_status_pref);
         occupantswin_occupants(room);
         return;
     }
 
     // presence updated
     if (updated) {
-        char *muc_status_pref = prefs_get_string(PREF_STATUSES_MUC);
+        const char *muc_status_pref = prefs_peek_string(PREF_STATUSES_MUC);
         if (g_strcmp0(muc_status_pref, "all") == 0) {
             ui_room_member_presence(room, nick, show, status);
         }
-        prefs_free_string(muc_status_pref);
         occupantswin_occupants(room);
 
     // presence unchanged, check for role/affiliation change
@@ -117,6 +117,37 @@ autocomplete_add(Autocomplete ac, const char *item)
     return;
 }
 
+// adds many items with one sort instead of a sorted insert for each
+void
+autocomplete_add_all(Autocomplete ac, GSList *items)
+{
+    if (ac == NULL || items == NULL) {
+        return;
+    }
+
+    GSList *curr = items;
+    while (curr) {
+        ac->items = g_slist_prepend(ac->items, strdup(curr->data));
+        curr = g_slist_next(curr);
+    }
+    ac->items = g_slist_sort(ac->items, (GCompareFunc)strcmp);
+
+    // duplicates are now next to each other
+    curr = ac->items;
+    while (curr && curr->next) {
+        if (strcmp(curr->data, curr->next->data) == 0) {
+            GSList *dup = curr->next;
+            curr->next = dup->next;
+            free(dup->data);
+            g_slist_free_1(dup);
+        } else {
+            curr = curr->next;
+        }
+    }
+
+    autocomplete_reset(ac);
+}
+
 void
 autocomplete_remove(Autocomplete ac, const char * const item)
 {
@@ -102,7 +102,10 @@ A million repetitions of "a"
 #include "p_sha1.h"
 
 static uint32_t host_to_be(uint32_t i);
-void P_SHA1_Transform(uint32_t state[5], const uint8_t buffer[64]);
+static void p_sha1_select(void);
+
+static P_SHA1_BlocksFunc p_sha1_blocks = NULL;
+static const char *p_sha1_engine = NULL;
 
 #define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
@@ -213,6 +216,49 @@ void P_SHA1_Transform(uint32_t state[5], const uint8_t buffer[64])
 }
 
 
+/* Hash whole blocks, copied first as the transform rewrites its input */
+void P_SHA1_Blocks_portable(uint32_t state[5], const uint8_t *data, size_t blocks)
+{
+    uint32_t workspace[16];
+
+    while (blocks--) {
+        memcpy(workspace, data, 64);
+        P_SHA1_Transform(state, (uint8_t *)workspace);
+        data += 64;
+    }
+}
+
+static void p_sha1_select(void)
+{
+    const char *name = NULL;
+    P_SHA1_BlocksFunc blocks = P_SHA1_Blocks_accelerated(&name);
+
+    if (blocks) {
+        P_SHA1_Set_Blocks(blocks, name);
+    } else {
+        P_SHA1_Set_Blocks(P_SHA1_Blocks_portable, "portable");
+    }
+}
+
+void P_SHA1_Set_Blocks(P_SHA1_BlocksFunc blocks, const char *name)
+{
+    if (blocks == NULL) {
+        p_sha1_select();
+        return;
+    }
+    p_sha1_blocks = blocks;
+    p_sha1_engine = name;
+}
+
+const char* P_SHA1_Engine(void)
+{
+    if (p_sha1_blocks == NULL) {
+        p_sha1_select();
+    }
+    return p_sha1_engine;
+}
+
+
 /* SHA1Init - Initialize new context */
 void P_SHA1_Init(P_SHA1_CTX* context)
 {
@@ -229,7 +275,11 @@ void P_SHA1_Init(P_SHA1_CTX* context)
 /* Run your data through this. */
 void P_SHA1_Update(P_SHA1_CTX* context, const uint8_t* data, const size_t len)
 {
-    size_t i, j;
+    size_t i, j, blocks;
+
+    if (p_sha1_blocks == NULL) {
+        p_sha1_select();
+    }
 
 #ifdef VERBOSE
     SHAPrintContext(context, "before");
@@ -240,9 +290,11 @@ void P_SHA1_Update(P_SHA1_CTX* context, const uint8_t* data, const size_t len)
     context->count[1] += (len >> 29);
     if ((j + len) > 63) {
         memcpy(&context->buffer[j], data, (i = 64-j));
-        P_SHA1_Transform(context->state, context->buffer);
-        for ( ; i + 63 < len; i += 64) {
-            P_SHA1_Transform(context->state, data + i);
+        p_sha1_blocks(context->state, context->buffer, 1);
+        blocks = (len - i) / 64;
+        if (blocks > 0) {
+            p_sha1_blocks(context->state, data + i, blocks);
+            i += blocks * 64;
         }
         j = 0;
     }
@@ -260,15 +312,19 @@ void P_SHA1_Final(P_SHA1_CTX* context, uint8_t digest[P_SHA1_DIGEST_SIZE])
 {
     uint32_t i;
     uint8_t  finalcount[8];
+    uint8_t  padding[64];
+    size_t   used, padlen;
 
     for (i = 0; i < 8; i++) {
         finalcount[i] = (unsigned char)((context->count[(i >= 4 ? 0 : 1)]
          >> ((3-(i & 3)) * 8) ) & 255);  /* Endian independent */
     }
-    P_SHA1_Update(context, (uint8_t *)"\200", 1);
-    while ((context->count[0] & 504) != 448) {
-        P_SHA1_Update(context, (uint8_t *)"\0", 1);
-    }
+    /* pad to 56 bytes mod 64 in a single update */
+    used = (context->count[0] >> 3) & 63;
+    padlen = (used < 56) ? (56 - used) : (120 - used);
+    memset(padding, 0, sizeof(padding));
+    padding[0] = 0x80;
+    P_SHA1_Update(context, padding, padlen);
     P_SHA1_Update(context, finalcount, 8);  /* Should cause a SHA1_Transform() */
     for (i = 0; i < P_SHA1_DIGEST_SIZE; i++) {
         digest[i] = (uint8_t)
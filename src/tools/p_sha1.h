@@ -8,6 +8,9 @@
 #ifndef __P_SHA1_H
 #define __P_SHA1_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -24,6 +27,19 @@ void P_SHA1_Init(P_SHA1_CTX* context);
 void P_SHA1_Update(P_SHA1_CTX* context, const uint8_t* data, const size_t len);
 void P_SHA1_Final(P_SHA1_CTX* context, uint8_t digest[P_SHA1_DIGEST_SIZE]);
 
+/* hash whole 64 byte blocks into state */
+typedef void (*P_SHA1_BlocksFunc)(uint32_t state[5], const uint8_t *data, size_t blocks);
+
+void P_SHA1_Transform(uint32_t state[5], const uint8_t buffer[64]);
+void P_SHA1_Blocks_portable(uint32_t state[5], const uint8_t *data, size_t blocks);
+
+/* block function using CPU extensions, NULL when the CPU has none we support */
+P_SHA1_BlocksFunc P_SHA1_Blocks_accelerated(const char **name);
+
+/* force the block function used by P_SHA1_Update, NULL selects the fastest */
+void P_SHA1_Set_Blocks(P_SHA1_BlocksFunc blocks, const char *name);
+const char* P_SHA1_Engine(void);
+
 #ifdef __cplusplus
 }
 #endif
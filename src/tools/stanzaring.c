@@ -0,0 +1,372 @@
+/*
+ * stanzaring.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "tools/stanzaring.h"
+
+#define STANZA_RING_MIN 256
+
+// records are stored back to back as a header followed by the raw bytes,
+// a record never straddles the end of the block
+struct stanza_header_t {
+    gint64 time;
+    guint32 len;
+    guint8 dir;
+    guint8 kind;
+    guint8 truncated;
+};
+
+struct stanza_match_t {
+    size_t pos;
+    guint64 seq;
+};
+
+struct stanza_ring_t {
+    guchar *buf;
+    size_t size;
+    size_t first;
+    size_t next;
+    size_t wrap_at;
+    gboolean wrapped;
+    guint count;
+    size_t bytes;
+    guint64 pushed;
+};
+
+static void _stanza_ring_evict(StanzaRing *ring);
+static gboolean _stanza_is_tag(const char * const xml, size_t len, const char * const name);
+
+StanzaRing*
+stanza_ring_new(size_t size)
+{
+    StanzaRing *ring = malloc(sizeof(StanzaRing));
+    ring->size = MAX(size, STANZA_RING_MIN);
+    ring->buf = malloc(ring->size);
+    ring->pushed = 0;
+    stanza_ring_clear(ring);
+
+    return ring;
+}
+
+void
+stanza_ring_free(StanzaRing *ring)
+{
+    if (ring) {
+        free(ring->buf);
+        free(ring);
+    }
+}
+
+void
+stanza_ring_clear(StanzaRing *ring)
+{
+    ring->first = 0;
+    ring->next = 0;
+    ring->wrap_at = 0;
+    ring->wrapped = FALSE;
+    ring->count = 0;
+    ring->bytes = 0;
+}
+
+void
+stanza_ring_push(StanzaRing *ring, stanza_dir_t dir, const char * const xml, size_t len)
+{
+    struct stanza_header_t header;
+    size_t limit = ring->size / 4 - sizeof(header);
+
+    header.truncated = FALSE;
+    if (len > limit) {
+        const gchar *end = NULL;
+        g_utf8_validate(xml, limit, &end);
+        len = end - xml;
+        header.truncated = TRUE;
+    }
+
+    header.time = (gint64)time(NULL);
+    header.len = len;
+    header.dir = dir;
+    header.kind = stanza_kind(xml, len);
+
+    size_t need = sizeof(header) + len;
+    while (TRUE) {
+        if (!ring->wrapped) {
+            if (ring->next + need <= ring->size) {
+                break;
+            }
+            ring->wrap_at = ring->next;
+            ring->next = 0;
+            ring->wrapped = TRUE;
+        }
+
+        // free space while wrapped is between next and first
+        if (ring->next + need <= ring->first) {
+            break;
+        }
+        _stanza_ring_evict(ring);
+    }
+
+    memcpy(&ring->buf[ring->next], &header, sizeof(header));
+    memcpy(&ring->buf[ring->next + sizeof(header)], xml, len);
+    ring->next += need;
+    ring->bytes += need;
+    ring->count++;
+    ring->pushed++;
+}
+
+guint
+stanza_ring_count(StanzaRing *ring)
+{
+    return ring->count;
+}
+
+size_t
+stanza_ring_bytes(StanzaRing *ring)
+{
+    return ring->bytes;
+}
+
+guint64
+stanza_ring_last_seq(StanzaRing *ring)
+{
+    return ring->pushed;
+}
+
+GSList*
+stanza_ring_tail(StanzaRing *ring, StanzaFilter *filter, guint max)
+{
+    return stanza_ring_newer(ring, filter, 0, max);
+}
+
+GSList*
+stanza_ring_newer(StanzaRing *ring, StanzaFilter *filter, guint64 seq, guint max)
+{
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(struct stanza_match_t));
+    struct stanza_header_t header;
+
+    // the oldest record held, only newer ones are matched
+    guint64 first_seq = ring->pushed - ring->count + 1;
+    guint skip = seq >= first_seq ? (guint)MIN(seq - first_seq + 1, ring->count) : 0;
+
+    size_t pos = ring->first;
+    guint i;
+    for (i = 0; i < ring->count; i++) {
+        memcpy(&header, &ring->buf[pos], sizeof(header));
+        const char *xml = (const char *)&ring->buf[pos + sizeof(header)];
+
+        gboolean match = (i >= skip);
+        if (match && filter) {
+            if (filter->dir != STANZA_DIR_BOTH && filter->dir != header.dir) {
+                match = FALSE;
+            } else if (filter->kind != STANZA_KIND_ALL && filter->kind != header.kind) {
+                match = FALSE;
+            } else if (filter->jid && !stanza_has_jid(xml, header.len, filter->jid)) {
+                match = FALSE;
+            }
+        }
+        if (match) {
+            struct stanza_match_t found = { pos, first_seq + i };
+            g_array_append_val(matches, found);
+        }
+
+        pos += sizeof(header) + header.len;
+        if (ring->wrapped && pos == ring->wrap_at) {
+            pos = 0;
+        }
+    }
+
+    GSList *result = NULL;
+    guint start = matches->len > max ? matches->len - max : 0;
+    for (i = matches->len; i > start; i--) {
+        struct stanza_match_t found = g_array_index(matches, struct stanza_match_t, i - 1);
+        pos = found.pos;
+        memcpy(&header, &ring->buf[pos], sizeof(header));
+
+        StanzaRecord *record = malloc(sizeof(StanzaRecord));
+        record->seq = found.seq;
+        record->time = header.time;
+        record->dir = header.dir;
+        record->kind = header.kind;
+        record->truncated = header.truncated;
+        record->xml = g_strndup((const char *)&ring->buf[pos + sizeof(header)], header.len);
+        result = g_slist_prepend(result, record);
+    }
+    g_array_free(matches, TRUE);
+
+    return result;
+}
+
+void
+stanza_record_free(StanzaRecord *record)
+{
+    if (record) {
+        g_free(record->xml);
+        free(record);
+    }
+}
+
+stanza_kind_t
+stanza_kind(const char * const xml, size_t len)
+{
+    size_t i = 0;
+    while (i < len && g_ascii_isspace(xml[i])) {
+        i++;
+    }
+    if (i == len || xml[i] != '<') {
+        return STANZA_KIND_OTHER;
+    }
+
+    i++;
+    if (_stanza_is_tag(&xml[i], len - i, "message")) {
+        return STANZA_KIND_MESSAGE;
+    } else if (_stanza_is_tag(&xml[i], len - i, "presence")) {
+        return STANZA_KIND_PRESENCE;
+    } else if (_stanza_is_tag(&xml[i], len - i, "iq")) {
+        return STANZA_KIND_IQ;
+    } else {
+        return STANZA_KIND_OTHER;
+    }
+}
+
+// matches the jid as a whole attribute value, a barejid also matches its
+// fulljids
+gboolean
+stanza_has_jid(const char * const xml, size_t len, const char * const jid)
+{
+    size_t jidlen = strlen(jid);
+    if (jidlen == 0) {
+        return FALSE;
+    }
+
+    const char *curr = xml;
+    const char *end = xml + len;
+    while (curr < end) {
+        const char *found = g_strstr_len(curr, end - curr, jid);
+        if (found == NULL) {
+            return FALSE;
+        }
+
+        const char *after = found + jidlen;
+        gboolean starts = (found > xml) && (found[-1] == '"' || found[-1] == '\'');
+        gboolean ends = (after < end) && (*after == '"' || *after == '\'' || *after == '/');
+        if (starts && ends) {
+            return TRUE;
+        }
+        curr = found + 1;
+    }
+
+    return FALSE;
+}
+
+// breaks the stanza onto one line per element, text stays with its element
+GString*
+stanza_pretty(const char * const xml)
+{
+    size_t len = strlen(xml);
+    GString *result = g_string_sized_new(len + len / 4);
+    int depth = 0;
+
+    size_t i = 0;
+    while (i < len) {
+        if (xml[i] != '<') {
+            g_string_append_c(result, xml[i]);
+            i++;
+            continue;
+        }
+
+        size_t end = i;
+        while (end < len && xml[end] != '>') {
+            end++;
+        }
+
+        gboolean closing = (xml[i + 1] == '/');
+        gboolean special = (xml[i + 1] == '?' || xml[i + 1] == '!');
+        gboolean empty = (end < len && xml[end - 1] == '/');
+
+        if (closing && depth > 0) {
+            depth--;
+        }
+        if (result->len > 0 && result->str[result->len - 1] == '>') {
+            g_string_append_c(result, '\n');
+            int indent;
+            for (indent = 0; indent < depth; indent++) {
+                g_string_append(result, "  ");
+            }
+        }
+
+        if (end < len) {
+            end++;
+        }
+        g_string_append_len(result, &xml[i], end - i);
+        if (!closing && !special && !empty) {
+            depth++;
+        }
+        i = end;
+    }
+
+    return result;
+}
+
+static void
+_stanza_ring_evict(StanzaRing *ring)
+{
+    struct stanza_header_t header;
+    memcpy(&header, &ring->buf[ring->first], sizeof(header));
+
+    ring->first += sizeof(header) + header.len;
+    ring->bytes -= sizeof(header) + header.len;
+    ring->count--;
+
+    if (ring->count == 0) {
+        stanza_ring_clear(ring);
+    } else if (ring->wrapped && ring->first == ring->wrap_at) {
+        ring->first = 0;
+        ring->wrapped = FALSE;
+    }
+}
+
+static gboolean
+_stanza_is_tag(const char * const xml, size_t len, const char * const name)
+{
+    size_t namelen = strlen(name);
+    if (len < namelen || strncmp(xml, name, namelen) != 0) {
+        return FALSE;
+    }
+
+    return (len == namelen || xml[namelen] == ' ' || xml[namelen] == '>' || xml[namelen] == '/');
+}
@@ -0,0 +1,94 @@
+/*
+ * stanzaring.h
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#ifndef TOOLS_STANZARING_H
+#define TOOLS_STANZARING_H
+
+#include <glib.h>
+
+typedef enum {
+    STANZA_DIR_IN,
+    STANZA_DIR_OUT,
+    STANZA_DIR_BOTH
+} stanza_dir_t;
+
+typedef enum {
+    STANZA_KIND_MESSAGE,
+    STANZA_KIND_PRESENCE,
+    STANZA_KIND_IQ,
+    STANZA_KIND_OTHER,
+    STANZA_KIND_ALL
+} stanza_kind_t;
+
+typedef struct stanza_filter_t {
+    stanza_dir_t dir;
+    stanza_kind_t kind;
+    char *jid;
+} StanzaFilter;
+
+typedef struct stanza_record_t {
+    guint64 seq;
+    gint64 time;
+    stanza_dir_t dir;
+    stanza_kind_t kind;
+    gboolean truncated;
+    char *xml;
+} StanzaRecord;
+
+typedef struct stanza_ring_t StanzaRing;
+
+// raw stanzas are kept in a fixed block of size bytes, the oldest are
+// dropped to make room and anything over a quarter of the block is cut short
+StanzaRing* stanza_ring_new(size_t size);
+void stanza_ring_free(StanzaRing *ring);
+void stanza_ring_clear(StanzaRing *ring);
+void stanza_ring_push(StanzaRing *ring, stanza_dir_t dir, const char * const xml, size_t len);
+guint stanza_ring_count(StanzaRing *ring);
+size_t stanza_ring_bytes(StanzaRing *ring);
+
+// records are numbered from 1 in push order, clearing does not reset this
+guint64 stanza_ring_last_seq(StanzaRing *ring);
+
+// copies of the newest max records matching filter, oldest first
+GSList* stanza_ring_tail(StanzaRing *ring, StanzaFilter *filter, guint max);
+// as stanza_ring_tail, only records numbered after seq
+GSList* stanza_ring_newer(StanzaRing *ring, StanzaFilter *filter, guint64 seq, guint max);
+void stanza_record_free(StanzaRecord *record);
+
+stanza_kind_t stanza_kind(const char * const xml, size_t len);
+gboolean stanza_has_jid(const char * const xml, size_t len, const char * const jid);
+GString* stanza_pretty(const char * const xml);
+
+#endif
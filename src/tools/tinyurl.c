@@ -66,6 +66,8 @@ tinyurl_get(char *url)
     output.size = 0;
 
     curl_easy_setopt(handle, CURLOPT_URL, full_url->str);
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT, 10L);
     curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, _data_callback);
     curl_easy_setopt(handle, CURLOPT_WRITEDATA, (void *)&output);
 
@@ -0,0 +1,166 @@
+/*
+ * worker.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "common.h"
+#include "log.h"
+#include "tools/worker.h"
+
+#define WORKER_THREADS 2
+
+struct worker_job_t {
+    worker_func work;
+    worker_func done;
+    gpointer data;
+};
+
+static GThreadPool *pool;
+static GAsyncQueue *done_queue;
+static int wake_pipe[2] = { -1, -1 };
+
+static void _worker_run(gpointer data, gpointer user_data);
+static void _close_pipe(void);
+
+void
+worker_init(void)
+{
+    p_threads_init();
+
+    if (pipe(wake_pipe) != 0) {
+        log_error("Could not create worker pipe, running jobs inline: %s", g_strerror(errno));
+        wake_pipe[0] = -1;
+        wake_pipe[1] = -1;
+        return;
+    }
+    fcntl(wake_pipe[0], F_SETFL, fcntl(wake_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, fcntl(wake_pipe[1], F_GETFL) | O_NONBLOCK);
+
+    GError *error = NULL;
+    done_queue = g_async_queue_new();
+    pool = g_thread_pool_new(_worker_run, NULL, WORKER_THREADS, FALSE, &error);
+    if (pool == NULL) {
+        log_error("Could not start worker threads, running jobs inline: %s", error->message);
+        g_error_free(error);
+        g_async_queue_unref(done_queue);
+        done_queue = NULL;
+        _close_pipe();
+    }
+}
+
+void
+worker_close(void)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    // queued jobs still run, their completions are delivered here
+    g_thread_pool_free(pool, FALSE, TRUE);
+    pool = NULL;
+    worker_process();
+
+    g_async_queue_unref(done_queue);
+    done_queue = NULL;
+    _close_pipe();
+}
+
+void
+worker_submit(worker_func work, worker_func done, gpointer data)
+{
+    if (pool == NULL) {
+        work(data);
+        if (done) {
+            done(data);
+        }
+        return;
+    }
+
+    struct worker_job_t *job = malloc(sizeof(struct worker_job_t));
+    job->work = work;
+    job->done = done;
+    job->data = data;
+    g_thread_pool_push(pool, job, NULL);
+}
+
+int
+worker_fd(void)
+{
+    return wake_pipe[0];
+}
+
+void
+worker_process(void)
+{
+    if (done_queue == NULL) {
+        return;
+    }
+
+    char drain[64];
+    while (read(wake_pipe[0], drain, sizeof(drain)) > 0);
+
+    struct worker_job_t *job = NULL;
+    while ((job = g_async_queue_try_pop(done_queue)) != NULL) {
+        if (job->done) {
+            job->done(job->data);
+        }
+        free(job);
+    }
+}
+
+static void
+_worker_run(gpointer data, gpointer user_data)
+{
+    struct worker_job_t *job = data;
+    job->work(job->data);
+    g_async_queue_push(done_queue, job);
+
+    // a full pipe already has a wakeup pending
+    ssize_t written = write(wake_pipe[1], "", 1);
+    (void)written;
+}
+
+static void
+_close_pipe(void)
+{
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    wake_pipe[0] = -1;
+    wake_pipe[1] = -1;
+}
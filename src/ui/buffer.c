@@ -46,6 +46,7 @@
 #include <ncurses.h>
 #endif
 
+#include "common.h"
 #include "ui/window.h"
 #include "ui/buffer.h"
 
@@ -53,33 +54,99 @@
 
 struct prof_buff_t {
     GSList *entries;
+    int size;
+    size_t bytes;
+    buffer_evict_func evict_func;
+    void *evict_data;
+    char *find_query;
+    GPtrArray *find_hits;
+    int find_pos;
 };
 
+// all buffers, least recently viewed first
+static GList *buffers = NULL;
+static size_t total_bytes = 0;
+static size_t budget = 0;
+
 static void _free_entry(ProfBuffEntry *entry);
+static size_t _entry_bytes(ProfBuffEntry *entry);
+static void _evict_oldest(ProfBuff buffer);
+static void _enforce_budget(void);
+static gboolean _entry_matches(ProfBuff buffer, ProfBuffEntry *entry,
+    const char * const folded_query);
 
 ProfBuff
 buffer_create()
 {
     ProfBuff new_buff = malloc(sizeof(struct prof_buff_t));
     new_buff->entries = NULL;
+    new_buff->size = 0;
+    new_buff->bytes = 0;
+    new_buff->evict_func = NULL;
+    new_buff->evict_data = NULL;
+    new_buff->find_query = NULL;
+    new_buff->find_hits = NULL;
+    new_buff->find_pos = -1;
+    buffers = g_list_append(buffers, new_buff);
     return new_buff;
 }
 
 int
 buffer_size(ProfBuff buffer)
 {
-    return g_slist_length(buffer->entries);
+    return buffer->size;
 }
 
 void
 buffer_free(ProfBuff buffer)
 {
+    buffers = g_list_remove(buffers, buffer);
+    total_bytes -= buffer->bytes;
+    buffer_find_clear(buffer);
     g_slist_free_full(buffer->entries, (GDestroyNotify)_free_entry);
     free(buffer);
     buffer = NULL;
 }
 
 void
+buffer_set_evict_func(ProfBuff buffer, buffer_evict_func func, void *data)
+{
+    buffer->evict_func = func;
+    buffer->evict_data = data;
+}
+
+// mark the buffer as the most recently viewed, it will be the last to lose entries
+void
+buffer_touch(ProfBuff buffer)
+{
+    GList *link = g_list_find(buffers, buffer);
+    if (link && link->next) {
+        buffers = g_list_delete_link(buffers, link);
+        buffers = g_list_append(buffers, buffer);
+    }
+}
+
+size_t
+buffer_bytes(ProfBuff buffer)
+{
+    return buffer->bytes;
+}
+
+size_t
+buffer_total_bytes(void)
+{
+    return total_bytes;
+}
+
+// limit in bytes for all buffers together, 0 for no limit
+void
+buffer_set_budget(size_t bytes)
+{
+    budget = bytes;
+    _enforce_budget();
+}
+
+ProfBuffEntry*
 buffer_push(ProfBuff buffer, const char show_char, GDateTime *time,
     int flags, theme_item_t theme_item, const char * const from, const char * const message)
 {
@@ -90,13 +157,30 @@ buffer_push(ProfBuff buffer, const char show_char, GDateTime *time,
     e->time = time;
     e->from = strdup(from);
     e->message = strdup(message);
+    e->folded = NULL;
+    e->y_start_pos = 0;
 
-    if (g_slist_length(buffer->entries) == BUFF_SIZE) {
-        _free_entry(buffer->entries->data);
-        buffer->entries = g_slist_delete_link(buffer->entries, buffer->entries);
+    if (buffer->size == BUFF_SIZE) {
+        _evict_oldest(buffer);
     }
 
     buffer->entries = g_slist_append(buffer->entries, e);
+    buffer->size++;
+    size_t bytes = _entry_bytes(e);
+    buffer->bytes += bytes;
+    total_bytes += bytes;
+
+    // keep an active search current as new lines arrive
+    if (buffer->find_query && _entry_matches(buffer, e, buffer->find_query)) {
+        g_ptr_array_add(buffer->find_hits, e);
+        if (buffer->find_pos == -1) {
+            buffer->find_pos = 0;
+        }
+    }
+
+    _enforce_budget();
+
+    return e;
 }
 
 ProfBuffEntry*
@@ -106,9 +190,183 @@ buffer_yield_entry(ProfBuff buffer, int entry)
     return node->data;
 }
 
+// searches are case insensitive, a search that extends the previous query only
+// rechecks the previous hits, otherwise the whole buffer is scanned
+int
+buffer_find(ProfBuff buffer, const char * const query)
+{
+    char *folded_query = g_utf8_casefold(query, -1);
+    GPtrArray *hits = g_ptr_array_new();
+
+    if (buffer->find_query && g_str_has_prefix(folded_query, buffer->find_query)) {
+        guint i;
+        for (i = 0; i < buffer->find_hits->len; i++) {
+            ProfBuffEntry *e = g_ptr_array_index(buffer->find_hits, i);
+            if (_entry_matches(buffer, e, folded_query)) {
+                g_ptr_array_add(hits, e);
+            }
+        }
+    } else {
+        GSList *curr = buffer->entries;
+        while (curr) {
+            if (_entry_matches(buffer, curr->data, folded_query)) {
+                g_ptr_array_add(hits, curr->data);
+            }
+            curr = g_slist_next(curr);
+        }
+    }
+
+    buffer_find_clear(buffer);
+    buffer->find_query = folded_query;
+    buffer->find_hits = hits;
+
+    // reverse search, start at the most recent hit
+    buffer->find_pos = hits->len - 1;
+
+    return hits->len;
+}
+
+ProfBuffEntry*
+buffer_find_current(ProfBuff buffer)
+{
+    if (buffer->find_hits == NULL || buffer->find_pos < 0) {
+        return NULL;
+    }
+
+    return g_ptr_array_index(buffer->find_hits, buffer->find_pos);
+}
+
+ProfBuffEntry*
+buffer_find_older(ProfBuff buffer)
+{
+    if (buffer->find_hits == NULL || buffer->find_pos <= 0) {
+        return NULL;
+    }
+
+    buffer->find_pos--;
+    return g_ptr_array_index(buffer->find_hits, buffer->find_pos);
+}
+
+ProfBuffEntry*
+buffer_find_newer(ProfBuff buffer)
+{
+    if (buffer->find_hits == NULL || buffer->find_pos + 1 >= (int)buffer->find_hits->len) {
+        return NULL;
+    }
+
+    buffer->find_pos++;
+    return g_ptr_array_index(buffer->find_hits, buffer->find_pos);
+}
+
+// position of the current hit counting back from the most recent, starting at 1
+int
+buffer_find_position(ProfBuff buffer)
+{
+    if (buffer->find_hits == NULL || buffer->find_pos < 0) {
+        return 0;
+    }
+
+    return buffer->find_hits->len - buffer->find_pos;
+}
+
+int
+buffer_find_count(ProfBuff buffer)
+{
+    if (buffer->find_hits == NULL) {
+        return 0;
+    }
+
+    return buffer->find_hits->len;
+}
+
+void
+buffer_find_clear(ProfBuff buffer)
+{
+    if (buffer->find_hits) {
+        g_ptr_array_free(buffer->find_hits, TRUE);
+        buffer->find_hits = NULL;
+    }
+    GFREE_SET_NULL(buffer->find_query);
+    buffer->find_pos = -1;
+}
+
+static size_t
+_entry_bytes(ProfBuffEntry *entry)
+{
+    size_t bytes = sizeof(ProfBuffEntry) + strlen(entry->from) + strlen(entry->message) + 2;
+    if (entry->folded) {
+        bytes += strlen(entry->folded) + 1;
+    }
+
+    return bytes;
+}
+
+static void
+_evict_oldest(ProfBuff buffer)
+{
+    ProfBuffEntry *oldest = buffer->entries->data;
+
+    // hits are kept oldest first, so an evicted hit is always the first
+    if (buffer->find_hits && buffer->find_hits->len > 0 &&
+            g_ptr_array_index(buffer->find_hits, 0) == oldest) {
+        g_ptr_array_remove_index(buffer->find_hits, 0);
+        if (buffer->find_pos > 0 || buffer->find_hits->len == 0) {
+            buffer->find_pos--;
+        }
+    }
+
+    if (buffer->evict_func) {
+        buffer->evict_func(oldest, buffer->evict_data);
+    }
+
+    size_t bytes = _entry_bytes(oldest);
+    buffer->bytes -= bytes;
+    total_bytes -= bytes;
+    buffer->size--;
+
+    _free_entry(oldest);
+    buffer->entries = g_slist_delete_link(buffer->entries, buffer->entries);
+}
+
+// evict the oldest entries of the least recently viewed buffers first, the
+// newest entry of each buffer is kept so every window can still be redrawn
+static void
+_enforce_budget(void)
+{
+    GList *curr = buffers;
+    while (budget > 0 && total_bytes > budget && curr) {
+        ProfBuff buffer = curr->data;
+        if (buffer->size > 1) {
+            _evict_oldest(buffer);
+        } else {
+            curr = g_list_next(curr);
+        }
+    }
+}
+
+static gboolean
+_entry_matches(ProfBuff buffer, ProfBuffEntry *entry, const char * const folded_query)
+{
+    // folded text is only built for windows that are searched
+    if (entry->folded == NULL) {
+        GString *text = g_string_new(entry->from);
+        g_string_append(text, " ");
+        g_string_append(text, entry->message);
+        entry->folded = g_utf8_casefold(text->str, text->len);
+        g_string_free(text, TRUE);
+
+        size_t bytes = strlen(entry->folded) + 1;
+        buffer->bytes += bytes;
+        total_bytes += bytes;
+    }
+
+    return strstr(entry->folded, folded_query) != NULL;
+}
+
 static void
 _free_entry(ProfBuffEntry *entry)
 {
+    g_free(entry->folded);
     free(entry->message);
     free(entry->from);
     g_date_time_unref(entry->time);
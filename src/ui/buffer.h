@@ -47,13 +47,31 @@ typedef struct prof_buff_entry_t {
     theme_item_t theme_item;
     char *from;
     char *message;
+    char *folded;
+    int y_start_pos;
 } ProfBuffEntry;
 
 typedef struct prof_buff_t *ProfBuff;
 
+// called with each entry as it is evicted, before it is freed
+typedef void (*buffer_evict_func)(ProfBuffEntry *entry, void *data);
+
 ProfBuff buffer_create();
 void buffer_free(ProfBuff buffer);
-void buffer_push(ProfBuff buffer, const char show_char, GDateTime *time, int flags, theme_item_t theme_item, const char * const from, const char * const message);
+ProfBuffEntry* buffer_push(ProfBuff buffer, const char show_char, GDateTime *time, int flags, theme_item_t theme_item, const char * const from, const char * const message);
 int buffer_size(ProfBuff buffer);
 ProfBuffEntry* buffer_yield_entry(ProfBuff buffer, int entry);
+void buffer_set_evict_func(ProfBuff buffer, buffer_evict_func func, void *data);
+void buffer_touch(ProfBuff buffer);
+size_t buffer_bytes(ProfBuff buffer);
+size_t buffer_total_bytes(void);
+void buffer_set_budget(size_t bytes);
+
+int buffer_find(ProfBuff buffer, const char * const query);
+ProfBuffEntry* buffer_find_current(ProfBuff buffer);
+ProfBuffEntry* buffer_find_older(ProfBuff buffer);
+ProfBuffEntry* buffer_find_newer(ProfBuff buffer);
+int buffer_find_position(ProfBuff buffer);
+int buffer_find_count(ProfBuff buffer);
+void buffer_find_clear(ProfBuff buffer);
 #endif
@@ -53,6 +53,7 @@
 #include "ui/windows.h"
 #include "ui/ui.h"
 #include "ui/statusbar.h"
+#include "tools/worker.h"
 #include "xmpp/xmpp.h"
 #include "xmpp/bookmark.h"
 
@@ -61,8 +62,15 @@
 #endif
 
 static void _cons_splash_logo(void);
+static void _cons_fetch_version(gpointer data);
+static void _cons_show_version(gpointer data);
 void _show_roster_contacts(GSList *list, gboolean show_groups);
 
+struct version_check_t {
+    gboolean not_available_msg;
+    char *latest_release;
+};
+
 void
 cons_show_time(void)
 {
@@ -194,11 +202,31 @@ cons_about(void)
     cons_alert();
 }
 
+// the release is fetched off the main thread, the result is shown when it arrives
 void
 cons_check_version(gboolean not_available_msg)
 {
+    struct version_check_t *check = malloc(sizeof(struct version_check_t));
+    check->not_available_msg = not_available_msg;
+    check->latest_release = NULL;
+    worker_submit(_cons_fetch_version, _cons_show_version, check);
+}
+
+static void
+_cons_fetch_version(gpointer data)
+{
+    struct version_check_t *check = data;
+    check->latest_release = release_get_latest();
+}
+
+static void
+_cons_show_version(gpointer data)
+{
+    struct version_check_t *check = data;
     ProfWin *console = wins_get_console();
-    char *latest_release = release_get_latest();
+    char *latest_release = check->latest_release;
+    gboolean not_available_msg = check->not_available_msg;
+    free(check);
 
     if (latest_release != NULL) {
         gboolean relase_valid = g_regex_match_simple("^\\d+\\.\\d+\\.\\d+$", latest_release, 0, 0);
@@ -253,6 +281,14 @@ cons_show_wins(void)
     }
     g_slist_free_full(window_strings, free);
 
+    unsigned long used = (buffer_total_bytes() + 1023) / 1024;
+    int budget = prefs_get_scrollback_budget();
+    if (budget > 0) {
+        cons_show("Scrollback: %lu KB of %d KB", used, budget);
+    } else {
+        cons_show("Scrollback: %lu KB", used);
+    }
+
     cons_show("");
     cons_alert();
 }
@@ -666,6 +702,9 @@ cons_show_account(ProfAccount *account)
     if (account->login_presence) {
         cons_show   ("Login presence    : %s", account->login_presence);
     }
+    if (accounts_get_compression_estimate(account->name)) {
+        cons_show   ("Compression       : estimate only");
+    }
 
     if (account->otr_policy) {
         cons_show   ("OTR policy        : %s", account->otr_policy);
@@ -871,6 +910,15 @@ cons_wrap_setting(void)
         cons_show("Word wrap (/wrap)             : OFF");
 }
 
+void
+cons_snapshot_setting(void)
+{
+    if (prefs_get_boolean(PREF_SNAPSHOT))
+        cons_show("Session snapshot (/snapshot)  : ON");
+    else
+        cons_show("Session snapshot (/snapshot)  : OFF");
+}
+
 void
 cons_presence_setting(void)
 {
@@ -1041,6 +1089,8 @@ cons_show_ui_prefs(void)
     cons_titlebar_setting();
     cons_presence_setting();
     cons_inpblock_setting();
+    cons_scrollback_setting();
+    cons_snapshot_setting();
 
     cons_alert();
 }
@@ -1196,6 +1246,24 @@ cons_carbons_setting(void)
         cons_show("Message carbons (/carbons)    : OFF");
 }
 
+void
+cons_sm_setting(void)
+{
+    if (prefs_get_boolean(PREF_SM))
+        cons_show("Stream management (/sm)         : ON");
+    else
+        cons_show("Stream management (/sm)         : OFF");
+}
+
+void
+cons_csi_setting(void)
+{
+    if (prefs_get_boolean(PREF_CSI))
+        cons_show("Client state indication (/csi)  : ON");
+    else
+        cons_show("Client state indication (/csi)  : OFF");
+}
+
 void
 cons_show_chat_prefs(void)
 {
@@ -1210,6 +1278,22 @@ cons_show_chat_prefs(void)
     cons_alert();
 }
 
+void
+cons_scrollback_setting(void)
+{
+    int budget = prefs_get_scrollback_budget();
+    if (budget > 0) {
+        cons_show("Scrollback budget (/scrollback): %d KB", budget);
+    } else {
+        cons_show("Scrollback budget (/scrollback): unlimited");
+    }
+    if (prefs_get_boolean(PREF_SCROLLBACK_SPILL)) {
+        cons_show("Spill to room logs (/scrollback): ON");
+    } else {
+        cons_show("Spill to room logs (/scrollback): OFF");
+    }
+}
+
 void
 cons_inpblock_setting(void)
 {
@@ -1226,12 +1310,18 @@ cons_log_setting(void)
 {
     cons_show("Log file location           : %s", get_log_file_location());
     cons_show("Max log size (/log maxsize) : %d bytes", prefs_get_max_log_size());
+    cons_show("Rotated logs kept           : %d (/log generations)", prefs_get_log_generations());
 
     if (prefs_get_boolean(PREF_LOG_ROTATE))
         cons_show("Log rotation (/log rotate)  : ON");
     else
         cons_show("Log rotation (/log rotate)  : OFF");
 
+    if (prefs_get_boolean(PREF_LOG_COMPRESS))
+        cons_show("Log compress (/log compress): ON");
+    else
+        cons_show("Log compress (/log compress): OFF");
+
     if (prefs_get_boolean(PREF_LOG_SHARED))
         cons_show("Shared log (/log shared)    : ON");
     else
@@ -1348,6 +1438,8 @@ cons_show_connection_prefs(void)
     cons_reconnect_setting();
     cons_autoping_setting();
     cons_autoconnect_setting();
+    cons_sm_setting();
+    cons_csi_setting();
 
     cons_alert();
 }
@@ -73,9 +73,13 @@
 #include "ui/inputwin.h"
 #include "ui/window.h"
 #include "ui/windows.h"
+#include "ui/snapshot.h"
 #include "xmpp/xmpp.h"
 #include "plugins/plugins.h"
 
+// lines shown either side of a log search hit
+#define LOG_CONTEXT_LINES 5
+
 static char *win_title;
 
 static int inp_size;
@@ -110,6 +114,7 @@ ui_init(void)
     create_status_bar();
     status_bar_active(1);
     create_input_window();
+    ui_update_scrollback_budget();
     wins_init();
     notifier_initialise();
     cons_about();
@@ -132,6 +137,9 @@ void
 ui_update(void)
 {
     ProfWin *current = wins_get_current();
+    if (current->type == WIN_XML) {
+        win_xml_update((ProfXMLWin*)current);
+    }
     if (current->layout->paged == 0) {
         win_move_to_end(current);
     }
@@ -189,9 +197,16 @@ ui_reset_idle_time(void)
     g_timer_start(ui_idle_time);
 }
 
+gboolean
+ui_has_focus(void)
+{
+    return inp_has_focus();
+}
+
 void
 ui_close(void)
 {
+    snapshot_close();
     notifier_uninit();
     wins_destroy();
     inp_close();
@@ -218,6 +233,77 @@ ui_page_down(void)
     win_page_down(current);
 }
 
+void
+ui_save_session(const char * const account)
+{
+    snapshot_save(account);
+}
+
+gboolean
+ui_restore_session(const char * const account)
+{
+    return snapshot_restore(account);
+}
+
+gboolean
+ui_restore_session_step(void)
+{
+    return snapshot_restore_step();
+}
+
+void
+ui_update_scrollback_budget(void)
+{
+    buffer_set_budget((size_t)prefs_get_scrollback_budget() * 1024);
+}
+
+int
+ui_find(const char * const text)
+{
+    ProfWin *current = wins_get_current();
+    int count = buffer_find(current->layout->buffer, text);
+    if (count > 0) {
+        win_move_to_entry(current, buffer_find_current(current->layout->buffer));
+    }
+
+    return count;
+}
+
+gboolean
+ui_find_older(void)
+{
+    ProfWin *current = wins_get_current();
+    ProfBuffEntry *entry = buffer_find_older(current->layout->buffer);
+    if (entry == NULL) {
+        return FALSE;
+    }
+
+    win_move_to_entry(current, entry);
+    return TRUE;
+}
+
+gboolean
+ui_find_newer(void)
+{
+    ProfWin *current = wins_get_current();
+    ProfBuffEntry *entry = buffer_find_newer(current->layout->buffer);
+    if (entry == NULL) {
+        return FALSE;
+    }
+
+    win_move_to_entry(current, entry);
+    return TRUE;
+}
+
+void
+ui_find_clear(void)
+{
+    ProfWin *current = wins_get_current();
+    buffer_find_clear(current->layout->buffer);
+    win_move_to_end(current);
+    win_update_virtual(current);
+}
+
 void
 ui_subwin_page_up(void)
 {
@@ -302,19 +388,18 @@ ui_xmlconsole_exists(void)
 void
 ui_handle_stanza(const char * const msg)
 {
-    if (ui_xmlconsole_exists()) {
-        ProfXMLWin *xmlconsole = wins_get_xmlconsole();
-        ProfWin *window = (ProfWin*) xmlconsole;
+    ProfXMLWin *xmlconsole = wins_get_xmlconsole();
+    if (xmlconsole == NULL) {
+        return;
+    }
 
-        if (g_str_has_prefix(msg, "SENT:")) {
-            win_save_print(window, '-', NULL, 0, 0, "", "SENT:");
-            win_save_print(window, '-', NULL, 0, THEME_ONLINE, "", &msg[6]);
-            win_save_print(window, '-', NULL, 0, THEME_ONLINE, "", "");
-        } else if (g_str_has_prefix(msg, "RECV:")) {
-            win_save_print(window, '-', NULL, 0, 0, "", "RECV:");
-            win_save_print(window, '-', NULL, 0, THEME_AWAY, "", &msg[6]);
-            win_save_print(window, '-', NULL, 0, THEME_AWAY, "", "");
-        }
+    // stored raw, formatting is left until the console is drawn
+    if (g_str_has_prefix(msg, "SENT: ")) {
+        stanza_ring_push(xmlconsole->ring, STANZA_DIR_OUT, &msg[6], strlen(&msg[6]));
+        xmlconsole->dirty = TRUE;
+    } else if (g_str_has_prefix(msg, "RECV: ")) {
+        stanza_ring_push(xmlconsole->ring, STANZA_DIR_IN, &msg[6], strlen(&msg[6]));
+        xmlconsole->dirty = TRUE;
     }
 }
 
@@ -1005,6 +1090,7 @@ ui_gone_insecure(const char * const barejid)
     ProfChatWin *chatwin = wins_get_chat(barejid);
     if (chatwin) {
         chatwin->is_otr = FALSE;
+        chatwin->was_otr = TRUE;
         chatwin->is_trusted = FALSE;
 
         ProfWin *window = (ProfWin*)chatwin;
@@ -1391,6 +1477,43 @@ ui_new_chat_win(const char * const barejid)
     ui_switch_win(num);
 }
 
+void
+ui_show_log_context(const char * const contact, gboolean room,
+    const char * const date, GSList *lines, int hit_line)
+{
+    ProfWin *window = NULL;
+    if (room) {
+        window = (ProfWin*)wins_get_muc(contact);
+    } else {
+        ui_new_chat_win(contact);
+        window = (ProfWin*)wins_get_chat(contact);
+    }
+
+    // rooms not currently joined are shown in the console
+    if (window == NULL) {
+        window = wins_get_console();
+    }
+
+    int first = MAX(0, hit_line - LOG_CONTEXT_LINES);
+    int last = hit_line + LOG_CONTEXT_LINES;
+
+    win_save_vprint(window, '-', NULL, 0, 0, "", "Log for %s on %s:", contact, date);
+    GSList *curr = g_slist_nth(lines, first);
+    int i = first;
+    while (curr != NULL && i <= last) {
+        if (i == hit_line) {
+            win_save_print(window, '*', NULL, 0, THEME_ROOMMENTION, "", curr->data);
+        } else {
+            win_save_print(window, '-', NULL, 0, 0, "", curr->data);
+        }
+        curr = g_slist_next(curr);
+        i++;
+    }
+    win_move_to_end(window);
+
+    ui_switch_win(wins_get_num(window));
+}
+
 void
 ui_create_xmlconsole_win(void)
 {
@@ -1409,6 +1532,47 @@ ui_open_xmlconsole_win(void)
     }
 }
 
+void
+ui_xmlconsole_filter_dir(stanza_dir_t dir)
+{
+    ProfXMLWin *xmlwin = wins_get_xmlconsole();
+    if (xmlwin != NULL) {
+        xmlwin->filter.dir = dir;
+        xmlwin->stale = TRUE;
+    }
+}
+
+void
+ui_xmlconsole_filter_kind(stanza_kind_t kind)
+{
+    ProfXMLWin *xmlwin = wins_get_xmlconsole();
+    if (xmlwin != NULL) {
+        xmlwin->filter.kind = kind;
+        xmlwin->stale = TRUE;
+    }
+}
+
+void
+ui_xmlconsole_filter_jid(const char * const jid)
+{
+    ProfXMLWin *xmlwin = wins_get_xmlconsole();
+    if (xmlwin != NULL) {
+        free(xmlwin->filter.jid);
+        xmlwin->filter.jid = jid ? strdup(jid) : NULL;
+        xmlwin->stale = TRUE;
+    }
+}
+
+void
+ui_xmlconsole_clear(void)
+{
+    ProfXMLWin *xmlwin = wins_get_xmlconsole();
+    if (xmlwin != NULL) {
+        stanza_ring_clear(xmlwin->ring);
+        xmlwin->stale = TRUE;
+    }
+}
+
 void
 ui_outgoing_chat_msg(const char * const from, const char * const barejid,
     const char * const message)
@@ -1898,7 +2062,7 @@ ui_room_message(const char * const roomjid, const char * const nick,
             }
 
             gboolean notify = FALSE;
-            char *room_setting = prefs_get_string(PREF_NOTIFY_ROOM);
+            const char *room_setting = prefs_peek_string(PREF_NOTIFY_ROOM);
             if (g_strcmp0(room_setting, "on") == 0) {
                 notify = TRUE;
             }
@@ -1911,7 +2075,6 @@ ui_room_message(const char * const roomjid, const char * const nick,
                 g_free(message_lower);
                 g_free(nick_lower);
             }
-            prefs_free_string(room_setting);
 
             if (notify) {
                 gboolean is_current = wins_is_current(window);
@@ -2289,8 +2452,8 @@ ui_chat_win_contact_offline(PContact contact, char *resource, char *status)
 void
 ui_contact_offline(char *barejid, char *resource, char *status)
 {
-    char *show_console = prefs_get_string(PREF_STATUSES_CONSOLE);
-    char *show_chat_win = prefs_get_string(PREF_STATUSES_CHAT);
+    const char *show_console = prefs_peek_string(PREF_STATUSES_CONSOLE);
+    const char *show_chat_win = prefs_peek_string(PREF_STATUSES_CHAT);
     Jid *jid = jid_create_from_bare_and_resource(barejid, resource);
     PContact contact = roster_get_contact(barejid);
     if (p_contact_subscription(contact) != NULL) {
@@ -2321,8 +2484,6 @@ ui_contact_offline(char *barejid, char *resource, char *status)
         FREE_SET_NULL(chatwin->resource_override);
     }
 
-    prefs_free_string(show_console);
-    prefs_free_string(show_chat_win);
     jid_destroy(jid);
 }
 
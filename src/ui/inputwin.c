@@ -63,6 +63,7 @@
 #include "ui/statusbar.h"
 #include "ui/inputwin.h"
 #include "ui/windows.h"
+#include "tools/worker.h"
 #include "xmpp/xmpp.h"
 
 static WINDOW *inp_win;
@@ -76,6 +77,8 @@ static fd_set fds;
 static int r;
 static char *inp_line = NULL;
 static gboolean get_password = FALSE;
+// terminal focus, assumed when the terminal does not report it
+static gboolean focused = TRUE;
 
 static void _inp_win_update_virtual(void);
 static int _inp_printable(const wint_t ch);
@@ -103,6 +106,8 @@ static int _inp_rl_pageup_handler(int count, int key);
 static int _inp_rl_pagedown_handler(int count, int key);
 static int _inp_rl_altpageup_handler(int count, int key);
 static int _inp_rl_altpagedown_handler(int count, int key);
+static int _inp_rl_focusin_handler(int count, int key);
+static int _inp_rl_focusout_handler(int count, int key);
 static int _inp_rl_startup_hook(void);
 
 void
@@ -131,6 +136,10 @@ create_input_window(void)
     keypad(inp_win, TRUE);
     wmove(inp_win, 0, 0);
 
+    // ask the terminal to report focus changes, ignored by those that cannot
+    fputs("\033[?1004h", stdout);
+    fflush(stdout);
+
     _inp_win_update_virtual();
 }
 
@@ -141,6 +150,10 @@ inp_readline(void)
     inp_line = NULL;
     FD_ZERO(&fds);
     FD_SET(fileno(rl_instream), &fds);
+    // finished background jobs wake the main loop early
+    if (worker_fd() >= 0) {
+        FD_SET(worker_fd(), &fds);
+    }
     errno = 0;
     r = select(FD_SETSIZE, &fds, NULL, NULL, &p_rl_timeout);
     if (r < 0) {
@@ -229,9 +242,17 @@ inp_nonblocking(gboolean reset)
 void
 inp_close(void)
 {
+    fputs("\033[?1004l", stdout);
+    fflush(stdout);
     rl_callback_handler_remove();
 }
 
+gboolean
+inp_has_focus(void)
+{
+    return focused;
+}
+
 char*
 inp_get_password(void)
 {
@@ -384,6 +405,9 @@ _inp_rl_startup_hook(void)
     rl_bind_keyseq("\\e[5~", _inp_rl_pageup_handler);
     rl_bind_keyseq("\\e[6~", _inp_rl_pagedown_handler);
 
+    rl_bind_keyseq("\\e[I", _inp_rl_focusin_handler);
+    rl_bind_keyseq("\\e[O", _inp_rl_focusout_handler);
+
     rl_bind_key('\t', _inp_rl_tab_handler);
     rl_bind_key(CTRL('L'), _inp_rl_clear_handler);
 
@@ -553,3 +577,17 @@ _inp_rl_altpagedown_handler(int count, int key)
     ui_subwin_page_down();
     return 0;
 }
+
+static int
+_inp_rl_focusin_handler(int count, int key)
+{
+    focused = TRUE;
+    return 0;
+}
+
+static int
+_inp_rl_focusout_handler(int count, int key)
+{
+    focused = FALSE;
+    return 0;
+}
@@ -59,6 +59,13 @@ occupantswin_occupants(const char * const roomjid)
 {
     ProfMucWin *mucwin = wins_get_muc(roomjid);
     if (mucwin) {
+        // rooms in the background are drawn when they next become current
+        if ((ProfWin*)mucwin != wins_get_current()) {
+            mucwin->occupants_stale = TRUE;
+            return;
+        }
+        mucwin->occupants_stale = FALSE;
+
         GList *occupants = muc_roster(roomjid);
         if (occupants) {
             ProfLayoutSplit *layout = (ProfLayoutSplit*)mucwin->window.layout;
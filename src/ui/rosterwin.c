@@ -151,7 +151,7 @@ rosterwin_roster(void)
         ProfLayoutSplit *layout = (ProfLayoutSplit*)console->layout;
         assert(layout->memcheck == LAYOUT_SPLIT_MEMCHECK);
 
-       char *by = prefs_get_string(PREF_ROSTER_BY);
+       const char *by = prefs_peek_string(PREF_ROSTER_BY);
         if (g_strcmp0(by, "presence") == 0) {
             werase(layout->subwin);
             _rosterwin_contacts_by_presence(layout, "chat", " -Available for chat");
@@ -190,6 +190,5 @@ rosterwin_roster(void)
             }
             g_slist_free(contacts);
         }
-        free(by);
     }
 }
\ No newline at end of file
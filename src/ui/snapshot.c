@@ -0,0 +1,603 @@
+/*
+ * snapshot.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#include "prof_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#ifdef PROF_HAVE_NCURSESW_NCURSES_H
+#include <ncursesw/ncurses.h>
+#elif PROF_HAVE_NCURSES_H
+#include <ncurses.h>
+#endif
+
+#include "common.h"
+#include "log.h"
+#include "config/preferences.h"
+#include "ui/ui.h"
+#include "ui/statusbar.h"
+#include "ui/window.h"
+#include "ui/windows.h"
+#include "ui/snapshot.h"
+#include "tools/worker.h"
+
+// snapshot layout, all integers in host byte order:
+//   header  : magic, version, current window number, window count
+//   window  : number, type, y_pos, paged, name, entry count, entries
+//   entry   : show char, flags, theme item, unix time, from, message
+//   strings : length followed by the bytes, no terminator
+#define SNAPSHOT_MAGIC "PSNP"
+#define SNAPSHOT_VERSION 1
+
+// entries restored on each pass of the main loop
+#define SNAPSHOT_STEP_ENTRIES 5000
+
+// a serialized snapshot waiting to be written on a worker thread
+struct snapshot_write_t {
+    char *path;
+    GString *out;
+    guint32 count;
+    GError *error;
+};
+
+struct restore_win_t {
+    win_type_t type;
+    char *name;
+    SnapshotReader reader;
+    guint32 remaining;
+    int y_pos;
+    gboolean paged;
+};
+
+static GMappedFile *restore_map = NULL;
+static GQueue *restore_queue = NULL;
+
+static char * _snapshot_path(const char * const account);
+static void _snapshot_write(gpointer data);
+static void _snapshot_written(gpointer data);
+static void _put_u32(GString *out, guint32 val);
+static void _put_i64(GString *out, gint64 val);
+static void _put_str(GString *out, const char * const str);
+static guint32 _get_u32(SnapshotReader *reader);
+static gint64 _get_i64(SnapshotReader *reader);
+static char * _get_str(SnapshotReader *reader);
+static void _skip_str(SnapshotReader *reader);
+static void _skip_entries(SnapshotReader *reader, guint32 count);
+static const char * _win_name(ProfWin *window);
+static ProfWin * _win_restore(win_type_t type, const char * const name, int num);
+static ProfWin * _win_lookup(struct restore_win_t *restore);
+static void _restore_win_free(struct restore_win_t *restore);
+static void _restore_finish(void);
+
+void
+snapshot_save(const char * const account)
+{
+    // windows still being restored would otherwise lose their scrollback
+    while (snapshot_restore_step());
+
+    GString *out = g_string_new(NULL);
+    g_string_append_len(out, SNAPSHOT_MAGIC, 4);
+    _put_u32(out, SNAPSHOT_VERSION);
+    _put_u32(out, wins_get_current_num());
+
+    GList *nums = g_list_sort(wins_get_nums(), cmp_win_num);
+    guint32 count = 0;
+    gsize count_pos = out->len;
+    _put_u32(out, 0);
+
+    GList *curr = nums;
+    while (curr) {
+        int num = GPOINTER_TO_INT(curr->data);
+        ProfWin *window = wins_get_by_num(num);
+        const char *name = _win_name(window);
+        if (name && snapshot_win_saved(window)) {
+            _put_u32(out, num);
+            _put_u32(out, window->type);
+            _put_u32(out, window->layout->y_pos);
+            _put_u32(out, window->layout->paged);
+            _put_str(out, name);
+            snapshot_put_entries(out, window->layout->buffer);
+            count++;
+        }
+        curr = g_list_next(curr);
+    }
+    g_list_free(nums);
+
+    memcpy(out->str + count_pos, &count, sizeof(count));
+
+    struct snapshot_write_t *job = malloc(sizeof(struct snapshot_write_t));
+    job->path = _snapshot_path(account);
+    job->out = out;
+    job->count = count;
+    job->error = NULL;
+    worker_submit(_snapshot_write, _snapshot_written, job);
+}
+
+static void
+_snapshot_write(gpointer data)
+{
+    struct snapshot_write_t *job = data;
+    prof_write_private_file(job->path, job->out->str, job->out->len, &job->error);
+}
+
+// appends the entry count followed by every entry in the buffer
+void
+snapshot_put_entries(GString *out, ProfBuff buffer)
+{
+    int size = buffer_size(buffer);
+    _put_u32(out, size);
+
+    int i;
+    for (i = 0; i < size; i++) {
+        ProfBuffEntry *e = buffer_yield_entry(buffer, i);
+        g_string_append_c(out, e->show_char);
+        _put_u32(out, e->flags);
+        _put_u32(out, e->theme_item);
+        _put_i64(out, g_date_time_to_unix(e->time));
+        _put_str(out, e->from);
+        _put_str(out, e->message);
+    }
+}
+
+// reads the next entry, the caller owns its time, from and message,
+// returns FALSE and leaves nothing to free when the data is truncated
+gboolean
+snapshot_get_entry(SnapshotReader *reader, ProfBuffEntry *entry)
+{
+    if (reader->error || reader->pos >= reader->end) {
+        reader->error = TRUE;
+        return FALSE;
+    }
+    entry->show_char = *reader->pos;
+    reader->pos++;
+    entry->flags = _get_u32(reader);
+    entry->theme_item = _get_u32(reader);
+    gint64 unix_time = _get_i64(reader);
+    entry->from = _get_str(reader);
+    entry->message = _get_str(reader);
+    entry->folded = NULL;
+    entry->y_start_pos = 0;
+    if (reader->error) {
+        free(entry->from);
+        free(entry->message);
+        return FALSE;
+    }
+    entry->time = g_date_time_new_from_unix_local(unix_time);
+
+    return TRUE;
+}
+
+static void
+_snapshot_written(gpointer data)
+{
+    struct snapshot_write_t *job = data;
+    if (job->error) {
+        log_error("Could not write session snapshot %s: %s", job->path, job->error->message);
+        g_error_free(job->error);
+    } else {
+        log_info("Saved %d windows to session snapshot", job->count);
+    }
+    free(job->path);
+    g_string_free(job->out, TRUE);
+    free(job);
+}
+
+// recreates the saved windows, their scrollback is filled in by snapshot_restore_step
+gboolean
+snapshot_restore(const char * const account)
+{
+    if (restore_map) {
+        return FALSE;
+    }
+
+    char *path = _snapshot_path(account);
+    if (!g_file_test(path, G_FILE_TEST_EXISTS)) {
+        free(path);
+        return FALSE;
+    }
+
+    GError *error = NULL;
+    restore_map = g_mapped_file_new(path, FALSE, &error);
+    if (restore_map == NULL) {
+        log_error("Could not open session snapshot %s: %s", path, error->message);
+        g_error_free(error);
+        free(path);
+        return FALSE;
+    }
+
+    SnapshotReader reader;
+    reader.pos = g_mapped_file_get_contents(restore_map);
+    reader.end = reader.pos + g_mapped_file_get_length(restore_map);
+    reader.error = FALSE;
+
+    if ((reader.end - reader.pos) < 4 || memcmp(reader.pos, SNAPSHOT_MAGIC, 4) != 0) {
+        log_error("Ignoring invalid session snapshot %s", path);
+        _restore_finish();
+        free(path);
+        return FALSE;
+    }
+    reader.pos += 4;
+    if (_get_u32(&reader) != SNAPSHOT_VERSION) {
+        log_info("Ignoring session snapshot %s from another version", path);
+        _restore_finish();
+        free(path);
+        return FALSE;
+    }
+
+    int current_num = _get_u32(&reader);
+    guint32 count = _get_u32(&reader);
+    restore_queue = g_queue_new();
+
+    guint32 i;
+    for (i = 0; i < count && !reader.error; i++) {
+        int num = _get_u32(&reader);
+        win_type_t type = _get_u32(&reader);
+        int y_pos = _get_u32(&reader);
+        gboolean paged = _get_u32(&reader);
+        char *name = _get_str(&reader);
+        guint32 entries = _get_u32(&reader);
+        SnapshotReader entries_reader = reader;
+        _skip_entries(&reader, entries);
+
+        if (reader.error || name == NULL || _win_restore(type, name, num) == NULL) {
+            free(name);
+            continue;
+        }
+
+        struct restore_win_t *restore = malloc(sizeof(struct restore_win_t));
+        restore->type = type;
+        restore->name = name;
+        restore->reader = entries_reader;
+        restore->remaining = entries;
+        restore->y_pos = y_pos;
+        restore->paged = paged;
+
+        // the window that was current is filled first
+        if (num == current_num) {
+            g_queue_push_head(restore_queue, restore);
+        } else {
+            g_queue_push_tail(restore_queue, restore);
+        }
+    }
+
+    if (reader.error) {
+        log_error("Session snapshot %s is truncated", path);
+    }
+    log_info("Restoring %d windows from session snapshot", g_queue_get_length(restore_queue));
+    free(path);
+
+    if (current_num > 1 && wins_get_by_num(current_num)) {
+        ui_switch_win(current_num);
+    }
+
+    return TRUE;
+}
+
+// restores the next batch of scrollback, returns TRUE while there is more to do
+gboolean
+snapshot_restore_step(void)
+{
+    if (restore_queue == NULL) {
+        return FALSE;
+    }
+
+    int restored = 0;
+    while (restored < SNAPSHOT_STEP_ENTRIES && !g_queue_is_empty(restore_queue)) {
+        struct restore_win_t *restore = g_queue_peek_head(restore_queue);
+
+        // window may have been closed since the restore started
+        ProfWin *window = _win_lookup(restore);
+
+        while (window && restore->remaining > 0 && restored < SNAPSHOT_STEP_ENTRIES) {
+            ProfBuffEntry e;
+            if (!snapshot_get_entry(&restore->reader, &e)) {
+                break;
+            }
+            win_save_print_at(window, e.show_char, e.time, e.flags, e.theme_item, e.from, e.message);
+            free(e.from);
+            free(e.message);
+
+            restore->remaining--;
+            restored++;
+        }
+
+        if (window && restore->remaining > 0 && !restore->reader.error) {
+            break;
+        }
+
+        if (window) {
+            if (restore->paged && window->layout->win == NULL) {
+                window->layout->y_pos = restore->y_pos;
+                window->layout->paged = 1;
+            } else if (restore->paged) {
+                int y = getcury(window->layout->win);
+                window->layout->y_pos = restore->y_pos < y ? restore->y_pos : y;
+                window->layout->paged = 1;
+            } else {
+                win_move_to_end(window);
+            }
+            if (wins_is_current(window)) {
+                win_update_virtual(window);
+            }
+        }
+
+        g_queue_pop_head(restore_queue);
+        _restore_win_free(restore);
+    }
+
+    if (g_queue_is_empty(restore_queue)) {
+        _restore_finish();
+        return FALSE;
+    }
+
+    // keep the main loop polling until everything is restored
+    ui_input_nonblocking(TRUE);
+
+    return TRUE;
+}
+
+void
+snapshot_close(void)
+{
+    _restore_finish();
+}
+
+static void
+_restore_finish(void)
+{
+    if (restore_queue) {
+        g_queue_free_full(restore_queue, (GDestroyNotify)_restore_win_free);
+        restore_queue = NULL;
+    }
+    if (restore_map) {
+        g_mapped_file_unref(restore_map);
+        restore_map = NULL;
+    }
+}
+
+static void
+_restore_win_free(struct restore_win_t *restore)
+{
+    free(restore->name);
+    free(restore);
+}
+
+static char *
+_snapshot_path(const char * const account)
+{
+    gchar *xdg_data = xdg_get_data_home();
+    GString *dir = g_string_new(xdg_data);
+    g_string_append(dir, "/profanity/sessions");
+    g_free(xdg_data);
+
+    if (!mkdir_recursive(dir->str)) {
+        log_error("Could not create session directory %s", dir->str);
+    }
+
+    char *account_file = str_replace(account, "@", "_at_");
+    g_strdelimit(account_file, "/", '_');
+    g_string_append_printf(dir, "/%s.snapshot", account_file);
+    free(account_file);
+
+    char *result = strdup(dir->str);
+    g_string_free(dir, TRUE);
+
+    return result;
+}
+
+// only conversations are saved, other windows depend on state from the server
+static const char *
+_win_name(ProfWin *window)
+{
+    switch (window->type) {
+        case WIN_CHAT:
+            return ((ProfChatWin*)window)->barejid;
+        case WIN_MUC:
+            return ((ProfMucWin*)window)->roomjid;
+        case WIN_PRIVATE:
+            return ((ProfPrivateWin*)window)->fulljid;
+        default:
+            return NULL;
+    }
+}
+
+// scrollback that is not logged, or has ever held an OTR session, never
+// reaches the disk
+gboolean
+snapshot_win_saved(ProfWin *window)
+{
+    ProfChatWin *chatwin = NULL;
+
+    switch (window->type) {
+        case WIN_CHAT:
+            chatwin = (ProfChatWin*)window;
+            return prefs_get_boolean(PREF_CHLOG) && !chatwin->is_otr && !chatwin->was_otr;
+        case WIN_MUC:
+            return prefs_get_boolean(PREF_GRLOG);
+        case WIN_PRIVATE:
+            return prefs_get_boolean(PREF_CHLOG);
+        default:
+            return FALSE;
+    }
+}
+
+static ProfWin *
+_win_restore(win_type_t type, const char * const name, int num)
+{
+    ProfWin *window = NULL;
+
+    switch (type) {
+        case WIN_CHAT:
+            if (wins_get_chat(name) == NULL) {
+                window = wins_new_chat(name);
+                ((ProfChatWin*)window)->history_shown = TRUE;
+            }
+            break;
+        case WIN_MUC:
+            if (wins_get_muc(name) == NULL) {
+                window = wins_new_muc(name);
+            }
+            break;
+        case WIN_PRIVATE:
+            if (wins_get_private(name) == NULL) {
+                window = wins_new_private(name);
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (window == NULL) {
+        return NULL;
+    }
+
+    // keep the saved numbering where the number is still free
+    int new_num = wins_get_num(window);
+    if (new_num != num && num > 1 && wins_get_by_num(num) == NULL) {
+        wins_swap(new_num, num);
+        new_num = num;
+    }
+    status_bar_active(new_num);
+
+    return window;
+}
+
+static ProfWin *
+_win_lookup(struct restore_win_t *restore)
+{
+    switch (restore->type) {
+        case WIN_CHAT:
+            return (ProfWin*)wins_get_chat(restore->name);
+        case WIN_MUC:
+            return (ProfWin*)wins_get_muc(restore->name);
+        case WIN_PRIVATE:
+            return (ProfWin*)wins_get_private(restore->name);
+        default:
+            return NULL;
+    }
+}
+
+static void
+_put_u32(GString *out, guint32 val)
+{
+    g_string_append_len(out, (const gchar *)&val, sizeof(val));
+}
+
+static void
+_put_i64(GString *out, gint64 val)
+{
+    g_string_append_len(out, (const gchar *)&val, sizeof(val));
+}
+
+static void
+_put_str(GString *out, const char * const str)
+{
+    guint32 len = strlen(str);
+    _put_u32(out, len);
+    g_string_append_len(out, str, len);
+}
+
+static guint32
+_get_u32(SnapshotReader *reader)
+{
+    guint32 val = 0;
+    if (reader->error || (reader->end - reader->pos) < (gssize)sizeof(val)) {
+        reader->error = TRUE;
+        return 0;
+    }
+    memcpy(&val, reader->pos, sizeof(val));
+    reader->pos += sizeof(val);
+
+    return val;
+}
+
+static gint64
+_get_i64(SnapshotReader *reader)
+{
+    gint64 val = 0;
+    if (reader->error || (reader->end - reader->pos) < (gssize)sizeof(val)) {
+        reader->error = TRUE;
+        return 0;
+    }
+    memcpy(&val, reader->pos, sizeof(val));
+    reader->pos += sizeof(val);
+
+    return val;
+}
+
+static char *
+_get_str(SnapshotReader *reader)
+{
+    guint32 len = _get_u32(reader);
+    if (reader->error || (guint32)(reader->end - reader->pos) < len) {
+        reader->error = TRUE;
+        return NULL;
+    }
+    char *result = g_strndup(reader->pos, len);
+    reader->pos += len;
+
+    return result;
+}
+
+static void
+_skip_str(SnapshotReader *reader)
+{
+    guint32 len = _get_u32(reader);
+    if (reader->error || (guint32)(reader->end - reader->pos) < len) {
+        reader->error = TRUE;
+        return;
+    }
+    reader->pos += len;
+}
+
+static void
+_skip_entries(SnapshotReader *reader, guint32 count)
+{
+    guint32 i;
+    for (i = 0; i < count && !reader->error; i++) {
+        if (reader->pos >= reader->end) {
+            reader->error = TRUE;
+            return;
+        }
+        reader->pos++;
+        _get_u32(reader);
+        _get_u32(reader);
+        _get_i64(reader);
+        _skip_str(reader);
+        _skip_str(reader);
+    }
+}
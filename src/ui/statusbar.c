@@ -128,7 +128,7 @@ status_bar_resize(void)
     wattroff(status_bar, bracket_attrs);
 
     if (message != NULL) {
-        char *time_pref = prefs_get_string(PREF_TIME_STATUSBAR);
+        const char *time_pref = prefs_peek_string(PREF_TIME_STATUSBAR);
         if (g_strcmp0(time_pref, "minutes") == 0) {
             mvwprintw(status_bar, 0, 10, message);
         } else if (g_strcmp0(time_pref, "seconds") == 0) {
@@ -302,7 +302,7 @@ status_bar_print_message(const char * const msg)
     }
     message = strdup(msg);
 
-    char *time_pref = prefs_get_string(PREF_TIME_STATUSBAR);
+    const char *time_pref = prefs_peek_string(PREF_TIME_STATUSBAR);
     if (g_strcmp0(time_pref, "minutes") == 0) {
         mvwprintw(status_bar, 0, 10, message);
     } else if (g_strcmp0(time_pref, "seconds") == 0) {
@@ -435,7 +435,7 @@ _status_bar_draw(void)
 
     int bracket_attrs = theme_attrs(THEME_STATUS_BRACKET);
 
-    char *time_pref = prefs_get_string(PREF_TIME_STATUSBAR);
+    const char *time_pref = prefs_peek_string(PREF_TIME_STATUSBAR);
     if (g_strcmp0(time_pref, "minutes") == 0) {
         gchar *date_fmt = g_date_time_format(last_time, "%H:%M");
         assert(date_fmt != NULL);
@@ -84,6 +84,7 @@ void ui_otr_authetication_waiting(const char * const recipient);
 
 unsigned long ui_get_idle_time(void);
 void ui_reset_idle_time(void);
+gboolean ui_has_focus(void);
 void ui_new_chat_win(const char * const barejid);
 void ui_new_private_win(const char * const fulljid);
 void ui_print_system_msg_from_recipient(const char * const barejid, const char *message);
@@ -222,6 +223,14 @@ gboolean ui_swap_wins(int source_win, int target_win);
 void ui_page_up(void);
 void ui_page_down(void);
 void ui_subwin_page_up(void);
+void ui_save_session(const char * const account);
+gboolean ui_restore_session(const char * const account);
+gboolean ui_restore_session_step(void);
+void ui_update_scrollback_budget(void);
+int ui_find(const char * const text);
+gboolean ui_find_older(void);
+gboolean ui_find_newer(void);
+void ui_find_clear(void);
 void ui_subwin_page_down(void);
 
 void ui_auto_away(void);
@@ -240,9 +249,16 @@ void ui_write(char *line, int offset);
 
 void ui_invalid_command_usage(const char * const usage, void (*setting_func)(void));
 
+void ui_show_log_context(const char * const contact, gboolean room,
+    const char * const date, GSList *lines, int hit_line);
+
 void ui_create_xmlconsole_win(void);
 gboolean ui_xmlconsole_exists(void);
 void ui_open_xmlconsole_win(void);
+void ui_xmlconsole_filter_dir(stanza_dir_t dir);
+void ui_xmlconsole_filter_kind(stanza_kind_t kind);
+void ui_xmlconsole_filter_jid(const char * const jid);
+void ui_xmlconsole_clear(void);
 
 gboolean ui_win_has_unsaved_form(int num);
 
@@ -316,6 +332,8 @@ void cons_intype_setting(void);
 void cons_gone_setting(void);
 void cons_history_setting(void);
 void cons_carbons_setting(void);
+void cons_sm_setting(void);
+void cons_csi_setting(void);
 void cons_log_setting(void);
 void cons_chlog_setting(void);
 void cons_grlog_setting(void);
@@ -325,6 +343,8 @@ void cons_autoping_setting(void);
 void cons_priority_setting(void);
 void cons_autoconnect_setting(void);
 void cons_inpblock_setting(void);
+void cons_scrollback_setting(void);
+void cons_snapshot_setting(void);
 void cons_show_contact_online(PContact contact, Resource *resource, GDateTime *last_activity);
 void cons_show_contact_offline(PContact contact, char *resource, char *status);
 void cons_theme_colours(void);
@@ -48,6 +48,8 @@
 
 #include "config/theme.h"
 #include "config/preferences.h"
+#include "jid.h"
+#include "log.h"
 #include "roster_list.h"
 #include "ui/ui.h"
 #include "ui/window.h"
@@ -55,12 +57,26 @@
 
 #define CONS_WIN_TITLE "Profanity. Type /help for help information."
 #define XML_WIN_TITLE "XML Console"
+#define XMLCONSOLE_RENDER_MAX 100
+
+// a stanza is cut short after this many lines, and a full render fills at
+// most half the pad so new stanzas can be appended below it
+#define XMLCONSOLE_STANZA_LINES 200
+#define XMLCONSOLE_RENDER_LINES (PAD_SIZE / 2)
 
 #define CEILING(X) (X-(int)(X) > 0 ? (int)(X+1) : (int)(X))
 
 static void _win_print(ProfWin *window, const char show_char, GDateTime *time,
     int flags, theme_item_t theme_item, const char * const from, const char * const message);
 static void _win_print_wrapped(WINDOW *win, const char * const message);
+static void _win_spill_room_entry(ProfBuffEntry *entry, void *data);
+static void _win_xml_render(ProfXMLWin *xmlwin);
+static void _win_xml_append(ProfXMLWin *xmlwin);
+static GString * _win_xml_text(StanzaRecord *record, int width, int *lines);
+static void _win_xml_text_free(GString *text);
+static void _win_xml_print(ProfWin *window, StanzaRecord *record, GString *text);
+static void _win_redraw_from(ProfWin *window, int first, gboolean stop_when_full);
+static int _win_entry_index(ProfWin *window, ProfBuffEntry *entry);
 
 int
 win_roster_cols(void)
@@ -90,6 +106,7 @@ _win_create_simple_layout(void)
     layout->base.buffer = buffer_create();
     layout->base.y_pos = 0;
     layout->base.paged = 0;
+    layout->base.partial = FALSE;
     scrollok(layout->base.win, TRUE);
 
     return &layout->base;
@@ -107,6 +124,7 @@ _win_create_split_layout(void)
     layout->base.buffer = buffer_create();
     layout->base.y_pos = 0;
     layout->base.paged = 0;
+    layout->base.partial = FALSE;
     scrollok(layout->base.win, TRUE);
     layout->subwin = NULL;
     layout->sub_y_pos = 0;
@@ -135,6 +153,7 @@ win_create_chat(const char * const barejid)
     new_win->barejid = strdup(barejid);
     new_win->resource_override = NULL;
     new_win->is_otr = FALSE;
+    new_win->was_otr = FALSE;
     new_win->is_trusted = FALSE;
     new_win->history_shown = FALSE;
     new_win->unread = 0;
@@ -149,34 +168,28 @@ ProfWin*
 win_create_muc(const char * const roomjid)
 {
     ProfMucWin *new_win = malloc(sizeof(ProfMucWin));
-    int cols = getmaxx(stdscr);
-
     new_win->window.type = WIN_MUC;
 
     ProfLayoutSplit *layout = malloc(sizeof(ProfLayoutSplit));
     layout->base.type = LAYOUT_SPLIT;
 
-    if (prefs_get_boolean(PREF_OCCUPANTS)) {
-        int subwin_cols = win_occpuants_cols();
-        layout->base.win = newpad(PAD_SIZE, cols - subwin_cols);
-        wbkgd(layout->base.win, theme_attrs(THEME_TEXT));
-        layout->subwin = newpad(PAD_SIZE, subwin_cols);;
-        wbkgd(layout->subwin, theme_attrs(THEME_TEXT));
-    } else {
-        layout->base.win = newpad(PAD_SIZE, (cols));
-        wbkgd(layout->base.win, theme_attrs(THEME_TEXT));
-        layout->subwin = NULL;
-    }
+    // pads are created by win_ensure_pads when the room is first shown,
+    // until then everything printed only goes to the buffer
+    layout->base.win = NULL;
+    layout->subwin = NULL;
     layout->sub_y_pos = 0;
     layout->memcheck = LAYOUT_SPLIT_MEMCHECK;
     layout->base.buffer = buffer_create();
     layout->base.y_pos = 0;
     layout->base.paged = 0;
-    scrollok(layout->base.win, TRUE);
+    layout->base.partial = FALSE;
     new_win->window.layout = (ProfLayout*)layout;
+    buffer_set_evict_func(layout->base.buffer, _win_spill_room_entry, new_win);
 
     new_win->roomjid = strdup(roomjid);
     new_win->unread = 0;
+    new_win->occupants_stale = TRUE;
+    new_win->occupants_shown = prefs_get_boolean(PREF_OCCUPANTS);
 
     new_win->memcheck = PROFMUCWIN_MEMCHECK;
 
@@ -219,9 +232,19 @@ win_create_xmlconsole(void)
     ProfXMLWin *new_win = malloc(sizeof(ProfXMLWin));
     new_win->window.type = WIN_XML;
     new_win->window.layout = _win_create_simple_layout();
+    new_win->ring = stanza_ring_new(XMLCONSOLE_RING_SIZE);
+    new_win->filter.dir = STANZA_DIR_BOTH;
+    new_win->filter.kind = STANZA_KIND_ALL;
+    new_win->filter.jid = NULL;
+    new_win->dirty = TRUE;
+    new_win->stale = TRUE;
+    new_win->rendered_seq = 0;
 
     new_win->memcheck = PROFXMLWIN_MEMCHECK;
 
+    // stanzas only reach the ui while a console is open
+    jabber_capture_stanzas(TRUE);
+
     return &new_win->window;
 }
 
@@ -291,9 +314,46 @@ win_get_title(ProfWin *window)
     return NULL;
 }
 
+void
+win_ensure_pads(ProfWin *window)
+{
+    if (window->type != WIN_MUC || window->layout->win != NULL) {
+        return;
+    }
+
+    ProfMucWin *mucwin = (ProfMucWin*)window;
+    ProfLayoutSplit *layout = (ProfLayoutSplit*)window->layout;
+    int cols = getmaxx(stdscr);
+
+    if (mucwin->occupants_shown) {
+        int subwin_cols = win_occpuants_cols();
+        layout->base.win = newpad(PAD_SIZE, cols - subwin_cols);
+        wbkgd(layout->base.win, theme_attrs(THEME_TEXT));
+        layout->subwin = newpad(PAD_SIZE, subwin_cols);
+        wbkgd(layout->subwin, theme_attrs(THEME_TEXT));
+    } else {
+        layout->base.win = newpad(PAD_SIZE, cols);
+        wbkgd(layout->base.win, theme_attrs(THEME_TEXT));
+    }
+    scrollok(layout->base.win, TRUE);
+
+    win_redraw(window);
+    if (!layout->base.paged) {
+        win_move_to_end(window);
+    }
+    if (layout->subwin) {
+        mucwin->occupants_stale = TRUE;
+    }
+}
+
 void
 win_hide_subwin(ProfWin *window)
 {
+    if (window->type == WIN_MUC && window->layout->win == NULL) {
+        ((ProfMucWin*)window)->occupants_shown = FALSE;
+        return;
+    }
+
     if (window->layout->type == LAYOUT_SPLIT) {
         ProfLayoutSplit *layout = (ProfLayoutSplit*)window->layout;
         if (layout->subwin) {
@@ -321,6 +381,11 @@ win_show_subwin(ProfWin *window)
         return;
     }
 
+    if (window->type == WIN_MUC && window->layout->win == NULL) {
+        ((ProfMucWin*)window)->occupants_shown = TRUE;
+        return;
+    }
+
     if (window->type == WIN_MUC) {
         subwin_cols = win_occpuants_cols();
     } else if (window->type == WIN_CONSOLE) {
@@ -343,7 +408,9 @@ win_free(ProfWin* window)
             delwin(layout->subwin);
         }
         buffer_free(layout->base.buffer);
-        delwin(layout->base.win);
+        if (layout->base.win) {
+            delwin(layout->base.win);
+        }
     } else {
         buffer_free(window->layout->buffer);
         delwin(window->layout->win);
@@ -373,6 +440,13 @@ win_free(ProfWin* window)
         free(privatewin->fulljid);
     }
 
+    if (window->type == WIN_XML) {
+        ProfXMLWin *xmlwin = (ProfXMLWin*)window;
+        jabber_capture_stanzas(FALSE);
+        stanza_ring_free(xmlwin->ring);
+        free(xmlwin->filter.jid);
+    }
+
     free(window);
 }
 
@@ -409,6 +483,13 @@ win_page_down(ProfWin *window)
 
     *page_start += page_space;
 
+    // paged past the slice drawn by win_move_to_entry, go back to the end
+    if (window->layout->partial && (y - (*page_start)) < page_space) {
+        win_move_to_end(window);
+        win_update_virtual(window);
+        return;
+    }
+
     // only got half a screen, show full screen
     if ((y - (*page_start)) < page_space)
         *page_start = y - page_space;
@@ -517,6 +598,42 @@ win_mouse(ProfWin *window, const wint_t ch, const int result)
     }
 }
 
+void
+win_move_to_entry(ProfWin *window, ProfBuffEntry *entry)
+{
+    int rows = getmaxy(stdscr);
+    int page_space = rows - 4;
+    int *page_start = &(window->layout->y_pos);
+
+    // once the pad has scrolled the recorded positions no longer match
+    // its contents, so redraw starting a little above the entry
+    if (window->layout->partial || getcury(window->layout->win) >= PAD_SIZE - 1) {
+        int index = _win_entry_index(window, entry);
+        if (index >= 0) {
+            _win_redraw_from(window, MAX(0, index - page_space), TRUE);
+        }
+    }
+    int y = getcury(window->layout->win);
+
+    // show the entry a few lines below the top of the page
+    *page_start = entry->y_start_pos - (page_space / 4);
+
+    // near the end, show last page
+    if (*page_start > y - page_space)
+        *page_start = y - page_space;
+
+    if (*page_start < 0)
+        *page_start = 0;
+
+    window->layout->paged = 1;
+    win_update_virtual(window);
+
+    // switch off page if last line and space line visible
+    if (!window->layout->partial && (y) - *page_start == page_space) {
+        window->layout->paged = 0;
+    }
+}
+
 void
 win_update_virtual(ProfWin *window)
 {
@@ -524,6 +641,10 @@ win_update_virtual(ProfWin *window)
     getmaxyx(stdscr, rows, cols);
     int subwin_cols = 0;
 
+    if (window->layout->win == NULL) {
+        return;
+    }
+
     if (window->layout->type == LAYOUT_SPLIT) {
         ProfLayoutSplit *layout = (ProfLayoutSplit*)window->layout;
         if (layout->subwin) {
@@ -546,6 +667,12 @@ void
 win_move_to_end(ProfWin *window)
 {
     window->layout->paged = 0;
+    if (window->layout->win == NULL) {
+        return;
+    }
+    if (window->layout->partial) {
+        win_redraw(window);
+    }
 
     int rows = getmaxy(stdscr);
     int y = getcury(window->layout->win);
@@ -902,12 +1029,30 @@ win_save_print(ProfWin *window, const char show_char, GTimeVal *tstamp,
         time = g_date_time_new_from_timeval_utc(tstamp);
     }
 
-    buffer_push(window->layout->buffer, show_char, time, flags, theme_item, from, message);
-    _win_print(window, show_char, time, flags, theme_item, from, message);
+    win_save_print_at(window, show_char, time, flags, theme_item, from, message);
     // TODO: cross-reference.. this should be replaced by a real event-based system
     ui_input_nonblocking(TRUE);
 }
 
+// the buffer takes ownership of time
+void
+win_save_print_at(ProfWin *window, const char show_char, GDateTime *time,
+    int flags, theme_item_t theme_item, const char * const from, const char * const message)
+{
+    ProfBuffEntry *e = buffer_push(window->layout->buffer, show_char, time, flags, theme_item, from, message);
+    if (window->layout->win == NULL) {
+        e->y_start_pos = 0;
+        return;
+    }
+    // the pad ends before this entry, it is drawn when leaving the slice
+    if (window->layout->partial) {
+        e->y_start_pos = 0;
+        return;
+    }
+    e->y_start_pos = getcury(window->layout->win);
+    _win_print(window, show_char, time, flags, theme_item, from, message);
+}
+
 void
 win_save_println(ProfWin *window, const char * const message)
 {
@@ -935,13 +1080,12 @@ _win_print(ProfWin *window, const char show_char, GDateTime *time,
 
     if ((flags & NO_DATE) == 0) {
         gchar *date_fmt = NULL;
-        char *time_pref = prefs_get_string(PREF_TIME);
+        const char *time_pref = prefs_peek_string(PREF_TIME);
         if (g_strcmp0(time_pref, "minutes") == 0) {
             date_fmt = g_date_time_format(time, "%H:%M");
         } else if (g_strcmp0(time_pref, "seconds") == 0) {
             date_fmt = g_date_time_format(time, "%H:%M:%S");
         }
-        free(time_pref);
 
         if (date_fmt) {
             if ((flags & NO_COLOUR_DATE) == 0) {
@@ -996,6 +1140,33 @@ _win_print(ProfWin *window, const char show_char, GDateTime *time,
     }
 }
 
+// write evicted room messages to the room log when room logging is off,
+// chat windows are never spilled so /otr log settings always apply
+static void
+_win_spill_room_entry(ProfBuffEntry *entry, void *data)
+{
+    if (!prefs_get_boolean(PREF_SCROLLBACK_SPILL) || prefs_get_boolean(PREF_GRLOG)) {
+        return;
+    }
+
+    // status lines have no sender
+    if (entry->from[0] == '\0') {
+        return;
+    }
+
+    const char *fulljid = jabber_get_fulljid();
+    if (fulljid == NULL) {
+        return;
+    }
+
+    ProfMucWin *mucwin = data;
+    Jid *jidp = jid_create(fulljid);
+    GTimeVal tv_stamp;
+    g_date_time_to_timeval(entry->time, &tv_stamp);
+    groupchat_log_chat(jidp->barejid, mucwin->roomjid, entry->from, entry->message, &tv_stamp);
+    jid_destroy(jidp);
+}
+
 static void
 _win_indent(WINDOW *win, int size)
 {
@@ -1011,14 +1182,13 @@ _win_print_wrapped(WINDOW *win, const char * const message)
     int wordi = 0;
     char *word = malloc(strlen(message) + 1);
 
-    char *time_pref = prefs_get_string(PREF_TIME);
+    const char *time_pref = prefs_peek_string(PREF_TIME);
     int indent = 0;
     if (g_strcmp0(time_pref, "minutes") == 0) {
         indent = 8;
     } else if (g_strcmp0(time_pref, "seconds") == 0) {
         indent = 11;
     }
-    free(time_pref);
 
     gchar *curr_ch = g_utf8_offset_to_pointer(message, 0);
 
@@ -1084,21 +1254,75 @@ _win_print_wrapped(WINDOW *win, const char * const message)
 
 void
 win_redraw(ProfWin *window)
+{
+    if (window->layout->win == NULL) {
+        return;
+    }
+    if (window->type == WIN_XML) {
+        _win_xml_render((ProfXMLWin*)window);
+        return;
+    }
+    _win_redraw_from(window, 0, FALSE);
+}
+
+static void
+_win_redraw_from(ProfWin *window, int first, gboolean stop_when_full)
 {
     int i, size;
     werase(window->layout->win);
+    window->layout->partial = FALSE;
     size = buffer_size(window->layout->buffer);
 
-    for (i = 0; i < size; i++) {
+    for (i = first; i < size; i++) {
+        // leave room for the last entry so the pad never scrolls
+        if (stop_when_full && getcury(window->layout->win) > PAD_SIZE - (PAD_SIZE / 4)) {
+            window->layout->partial = TRUE;
+            break;
+        }
         ProfBuffEntry *e = buffer_yield_entry(window->layout->buffer, i);
+        e->y_start_pos = getcury(window->layout->win);
         _win_print(window, e->show_char, e->time, e->flags, e->theme_item, e->from, e->message);
     }
 }
 
+static int
+_win_entry_index(ProfWin *window, ProfBuffEntry *entry)
+{
+    int i;
+    int size = buffer_size(window->layout->buffer);
+
+    for (i = size - 1; i >= 0; i--) {
+        if (buffer_yield_entry(window->layout->buffer, i) == entry) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// the console is drawn from the stanza ring rather than a buffer, and is
+// left alone while paged so scrolling back is not disturbed, new stanzas
+// are appended to what is already drawn
+void
+win_xml_update(ProfXMLWin *xmlwin)
+{
+    if (xmlwin->window.layout->paged != 0) {
+        return;
+    }
+
+    if (xmlwin->stale) {
+        _win_xml_render(xmlwin);
+    } else if (xmlwin->dirty) {
+        _win_xml_append(xmlwin);
+    }
+}
+
 gboolean
 win_has_active_subwin(ProfWin *window)
 {
-    if (window->layout->type == LAYOUT_SPLIT) {
+    if (window->type == WIN_MUC && window->layout->win == NULL) {
+        return ((ProfMucWin*)window)->occupants_shown;
+    } else if (window->layout->type == LAYOUT_SPLIT) {
         ProfLayoutSplit *layout = (ProfLayoutSplit*)window->layout;
         return (layout->subwin != NULL);
     } else {
@@ -1136,3 +1360,162 @@ win_printline_nowrap(WINDOW *win, char *msg)
 
     wmove(win, cury+1, 0);
 }
+
+static void
+_win_xml_render(ProfXMLWin *xmlwin)
+{
+    ProfWin *window = &xmlwin->window;
+    StanzaFilter *filter = &xmlwin->filter;
+    werase(window->layout->win);
+
+    if (filter->dir != STANZA_DIR_BOTH || filter->kind != STANZA_KIND_ALL || filter->jid) {
+        GString *summary = g_string_new("Filter:");
+        if (filter->dir != STANZA_DIR_BOTH) {
+            g_string_append(summary, filter->dir == STANZA_DIR_IN ? " in" : " out");
+        }
+        if (filter->kind == STANZA_KIND_MESSAGE) {
+            g_string_append(summary, " message");
+        } else if (filter->kind == STANZA_KIND_PRESENCE) {
+            g_string_append(summary, " presence");
+        } else if (filter->kind == STANZA_KIND_IQ) {
+            g_string_append(summary, " iq");
+        }
+        if (filter->jid) {
+            g_string_append_printf(summary, " %s", filter->jid);
+        }
+        _win_print(window, '-', NULL, NO_DATE, 0, "", summary->str);
+        _win_print(window, '-', NULL, NO_DATE, 0, "", "");
+        g_string_free(summary, TRUE);
+    }
+
+    // newest first until the pad budget is used, then drawn oldest first
+    GSList *records = g_slist_reverse(stanza_ring_tail(xmlwin->ring, filter, XMLCONSOLE_RENDER_MAX));
+    GSList *shown = NULL;
+    GSList *texts = NULL;
+    int width = getmaxx(window->layout->win);
+    int used = 0;
+    GSList *curr = records;
+    while (curr) {
+        int lines = 0;
+        GString *text = _win_xml_text(curr->data, width, &lines);
+        if (shown && used + lines > XMLCONSOLE_RENDER_LINES) {
+            g_string_free(text, TRUE);
+            break;
+        }
+        used += lines;
+        shown = g_slist_prepend(shown, curr->data);
+        texts = g_slist_prepend(texts, text);
+        curr = g_slist_next(curr);
+    }
+
+    GSList *curr_record = shown;
+    GSList *curr_text = texts;
+    while (curr_record) {
+        _win_xml_print(window, curr_record->data, curr_text->data);
+        curr_record = g_slist_next(curr_record);
+        curr_text = g_slist_next(curr_text);
+    }
+
+    g_slist_free(shown);
+    g_slist_free_full(texts, (GDestroyNotify)_win_xml_text_free);
+    g_slist_free_full(records, (GDestroyNotify)stanza_record_free);
+
+    xmlwin->rendered_seq = stanza_ring_last_seq(xmlwin->ring);
+    xmlwin->stale = FALSE;
+    xmlwin->dirty = FALSE;
+}
+
+// draws only the stanzas that arrived since the last render, starting
+// afresh when there are too many for the space left in the pad
+static void
+_win_xml_append(ProfXMLWin *xmlwin)
+{
+    ProfWin *window = &xmlwin->window;
+    GSList *records = stanza_ring_newer(xmlwin->ring, &xmlwin->filter, xmlwin->rendered_seq,
+        XMLCONSOLE_RENDER_MAX);
+    if (g_slist_length(records) == XMLCONSOLE_RENDER_MAX) {
+        g_slist_free_full(records, (GDestroyNotify)stanza_record_free);
+        _win_xml_render(xmlwin);
+        return;
+    }
+
+    int width = getmaxx(window->layout->win);
+    GSList *curr = records;
+    while (curr) {
+        int lines = 0;
+        GString *text = _win_xml_text(curr->data, width, &lines);
+        if (getcury(window->layout->win) + lines > PAD_SIZE - (PAD_SIZE / 4)) {
+            g_string_free(text, TRUE);
+            g_slist_free_full(records, (GDestroyNotify)stanza_record_free);
+            _win_xml_render(xmlwin);
+            return;
+        }
+        _win_xml_print(window, curr->data, text);
+        g_string_free(text, TRUE);
+        curr = g_slist_next(curr);
+    }
+    g_slist_free_full(records, (GDestroyNotify)stanza_record_free);
+
+    xmlwin->rendered_seq = stanza_ring_last_seq(xmlwin->ring);
+    xmlwin->dirty = FALSE;
+}
+
+// the pretty printed stanza cut to XMLCONSOLE_STANZA_LINES, lines is set
+// to the pad lines the record will take at width
+static GString *
+_win_xml_text(StanzaRecord *record, int width, int *lines)
+{
+    GString *pretty = stanza_pretty(record->xml);
+    if (width < 1) {
+        width = 1;
+    }
+
+    // header, trailing blank and truncation notice
+    *lines = record->truncated ? 3 : 2;
+
+    int count = 0;
+    size_t start = 0;
+    while (start <= pretty->len) {
+        const char *end = strchr(&pretty->str[start], '\n');
+        size_t len = end ? (size_t)(end - &pretty->str[start]) : pretty->len - start;
+        if (count == XMLCONSOLE_STANZA_LINES) {
+            int more = 1;
+            const char *rest = &pretty->str[start];
+            while ((rest = strchr(rest, '\n')) != NULL) {
+                more++;
+                rest++;
+            }
+            g_string_truncate(pretty, start);
+            g_string_append_printf(pretty, "[%d more lines]", more);
+            *lines += 1;
+            break;
+        }
+        *lines += len / width + 1;
+        count++;
+        start += len + 1;
+    }
+
+    return pretty;
+}
+
+static void
+_win_xml_text_free(GString *text)
+{
+    g_string_free(text, TRUE);
+}
+
+static void
+_win_xml_print(ProfWin *window, StanzaRecord *record, GString *text)
+{
+    theme_item_t theme_item = record->dir == STANZA_DIR_OUT ? THEME_ONLINE : THEME_AWAY;
+    GDateTime *time = g_date_time_new_from_unix_local(record->time);
+
+    _win_print(window, '-', time, 0, 0, "", record->dir == STANZA_DIR_OUT ? "SENT:" : "RECV:");
+    _win_print(window, '-', time, NO_DATE, theme_item, "", text->str);
+    if (record->truncated) {
+        _win_print(window, '-', time, NO_DATE, theme_item, "", "[truncated]");
+    }
+    _win_print(window, '-', time, NO_DATE, theme_item, "", "");
+
+    g_date_time_unref(time);
+}
@@ -50,6 +50,7 @@
 #include "ui/buffer.h"
 #include "xmpp/xmpp.h"
 #include "chat_state.h"
+#include "tools/stanzaring.h"
 
 #define NO_ME           1
 #define NO_DATE         2
@@ -58,6 +59,7 @@
 #define NO_COLOUR_DATE  16
 
 #define PAD_SIZE 1000
+#define XMLCONSOLE_RING_SIZE (1024 * 1024)
 
 #define LAYOUT_SPLIT_MEMCHECK       12345671
 #define PROFCHATWIN_MEMCHECK        22374522
@@ -78,6 +80,8 @@ typedef struct prof_layout_t {
     ProfBuff buffer;
     int y_pos;
     int paged;
+    // pad holds a slice of the buffer that stops short of the newest entry
+    gboolean partial;
 } ProfLayout;
 
 typedef struct prof_layout_simple_t {
@@ -116,6 +120,8 @@ typedef struct prof_chat_win_t {
     int unread;
     ChatState *state;
     gboolean is_otr;
+    // stays set after the session ends, the scrollback still holds it
+    gboolean was_otr;
     gboolean is_trusted;
     char *resource_override;
     gboolean history_shown;
@@ -126,6 +132,8 @@ typedef struct prof_muc_win_t {
     ProfWin window;
     char *roomjid;
     int unread;
+    gboolean occupants_stale;
+    gboolean occupants_shown;
     unsigned long memcheck;
 } ProfMucWin;
 
@@ -145,6 +153,12 @@ typedef struct prof_private_win_t {
 
 typedef struct prof_xml_win_t {
     ProfWin window;
+    StanzaRing *ring;
+    StanzaFilter filter;
+    // dirty when stanzas arrived, stale when the pad must be drawn afresh
+    gboolean dirty;
+    gboolean stale;
+    guint64 rendered_seq;
     unsigned long memcheck;
 } ProfXMLWin;
 
@@ -166,7 +180,9 @@ char *win_get_title(ProfWin *window);
 
 void win_free(ProfWin *window);
 void win_update_virtual(ProfWin *window);
+void win_ensure_pads(ProfWin *window);
 void win_move_to_end(ProfWin *window);
+void win_move_to_entry(ProfWin *window, ProfBuffEntry *entry);
 void win_show_contact(ProfWin *window, PContact contact);
 void win_show_occupant(ProfWin *window, Occupant *occupant);
 void win_show_status_string(ProfWin *window, const char * const from,
@@ -179,9 +195,11 @@ void win_show_info(ProfWin *window, PContact contact);
 void win_show_occupant_info(ProfWin *window, const char * const room, Occupant *occupant);
 void win_save_vprint(ProfWin *window, const char show_char, GTimeVal *tstamp, int flags, theme_item_t theme_item, const char * const from, const char * const message, ...);
 void win_save_print(ProfWin *window, const char show_char, GTimeVal *tstamp, int flags, theme_item_t theme_item, const char * const from, const char * const message);
+void win_save_print_at(ProfWin *window, const char show_char, GDateTime *time, int flags, theme_item_t theme_item, const char * const from, const char * const message);
 void win_save_println(ProfWin *window, const char * const message);
 void win_save_newline(ProfWin *window);
 void win_redraw(ProfWin *window);
+void win_xml_update(ProfXMLWin *xmlwin);
 void win_hide_subwin(ProfWin *window);
 void win_show_subwin(ProfWin *window);
 int win_roster_cols(void);
@@ -58,6 +58,8 @@ static GHashTable *windows;
 static int current;
 static int max_cols;
 
+static void _win_append_usage(GString *summary, ProfWin *window);
+
 void
 wins_init(void)
 {
@@ -276,6 +278,7 @@ wins_set_current_by_num(int i)
     ProfWin *window = g_hash_table_lookup(windows, GINT_TO_POINTER(i));
     if (window) {
         current = i;
+        buffer_touch(window->layout->buffer);
         if (window->type == WIN_CHAT) {
             ProfChatWin *chatwin = (ProfChatWin*) window;
             assert(chatwin->memcheck == PROFCHATWIN_MEMCHECK);
@@ -284,6 +287,10 @@ wins_set_current_by_num(int i)
             ProfMucWin *mucwin = (ProfMucWin*) window;
             assert(mucwin->memcheck == PROFMUCWIN_MEMCHECK);
             mucwin->unread = 0;
+            win_ensure_pads(window);
+            if (mucwin->occupants_stale) {
+                occupantswin_occupants(mucwin->roomjid);
+            }
         } else if (window->type == WIN_PRIVATE) {
             ProfPrivateWin *privatewin = (ProfPrivateWin*) window;
             privatewin->unread = 0;
@@ -519,6 +526,12 @@ wins_resize_all(void)
         ProfWin *window = curr->data;
         int subwin_cols = 0;
 
+        // rooms not shown yet get pads at the right size later
+        if (window->layout->win == NULL) {
+            curr = g_list_next(curr);
+            continue;
+        }
+
         if (window->layout->type == LAYOUT_SPLIT) {
             ProfLayoutSplit *layout = (ProfLayoutSplit*)window->layout;
             if (layout->subwin) {
@@ -788,6 +801,7 @@ wins_create_summary(void)
         ProfWin *window = g_hash_table_lookup(windows, curr->data);
         int ui_index = GPOINTER_TO_INT(curr->data);
 
+        GString *console_string;
         GString *chat_string;
         GString *priv_string;
         GString *muc_string;
@@ -798,7 +812,10 @@ wins_create_summary(void)
         switch (window->type)
         {
             case WIN_CONSOLE:
-                result = g_slist_append(result, strdup("1: Console"));
+                console_string = g_string_new("1: Console");
+                _win_append_usage(console_string, window);
+                result = g_slist_append(result, strdup(console_string->str));
+                g_string_free(console_string, TRUE);
                 break;
             case WIN_CHAT:
                 chat_string = g_string_new("");
@@ -823,6 +840,8 @@ wins_create_summary(void)
                     g_string_free(chat_unread, TRUE);
                 }
 
+                _win_append_usage(chat_string, window);
+
                 result = g_slist_append(result, strdup(chat_string->str));
                 g_string_free(chat_string, TRUE);
 
@@ -840,6 +859,8 @@ wins_create_summary(void)
                     g_string_free(priv_unread, TRUE);
                 }
 
+                _win_append_usage(priv_string, window);
+
                 result = g_slist_append(result, strdup(priv_string->str));
                 g_string_free(priv_string, TRUE);
 
@@ -857,6 +878,8 @@ wins_create_summary(void)
                     g_string_free(muc_unread, TRUE);
                 }
 
+                _win_append_usage(muc_string, window);
+
                 result = g_slist_append(result, strdup(muc_string->str));
                 g_string_free(muc_string, TRUE);
 
@@ -866,6 +889,7 @@ wins_create_summary(void)
                 muc_config_string = g_string_new("");
                 char *title = win_get_title(window);
                 g_string_printf(muc_config_string, "%d: %s", ui_index, title);
+                _win_append_usage(muc_config_string, window);
                 result = g_slist_append(result, strdup(muc_config_string->str));
                 g_string_free(muc_config_string, TRUE);
                 free(title);
@@ -876,6 +900,7 @@ wins_create_summary(void)
                 plugin_string = g_string_new("");
                 ProfPluginWin *pluginwin = (ProfPluginWin*)window;
                 g_string_printf(plugin_string, "%d: %s plugin", ui_index, pluginwin->tag);
+                _win_append_usage(plugin_string, window);
                 result = g_slist_append(result, strdup(plugin_string->str));
                 g_string_free(plugin_string, TRUE);
 
@@ -884,6 +909,7 @@ wins_create_summary(void)
             case WIN_XML:
                 xml_string = g_string_new("");
                 g_string_printf(xml_string, "%d: XML console", ui_index);
+                _win_append_usage(xml_string, window);
                 result = g_slist_append(result, strdup(xml_string->str));
                 g_string_free(xml_string, TRUE);
 
@@ -904,3 +930,10 @@ wins_destroy(void)
 {
     g_hash_table_destroy(windows);
 }
+
+static void
+_win_append_usage(GString *summary, ProfWin *window)
+{
+    size_t bytes = buffer_bytes(window->layout->buffer);
+    g_string_append_printf(summary, ", %lu KB", (unsigned long)((bytes + 1023) / 1024));
+}
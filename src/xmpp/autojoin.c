@@ -0,0 +1,152 @@
+/*
+ * autojoin.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "log.h"
+#include "xmpp/autojoin.h"
+
+// a join sent and not yet answered with our own presence
+typedef struct autojoin_pending_t {
+    char *room;
+    GTimer *started;
+} AutojoinPending;
+
+// room jids waiting to be joined, in the order they will be joined
+static GList *queue;
+// joins holding a slot, oldest first
+static GList *pending;
+
+static void _pending_free(AutojoinPending *entry);
+static gint _pending_cmp_room(AutojoinPending *entry, const char * const room);
+
+void
+autojoin_clear(void)
+{
+    g_list_free_full(queue, free);
+    queue = NULL;
+    g_list_free_full(pending, (GDestroyNotify)_pending_free);
+    pending = NULL;
+}
+
+void
+autojoin_add(const char * const room)
+{
+    queue = g_list_append(queue, strdup(room));
+}
+
+void
+autojoin_sort(GCompareFunc compare)
+{
+    queue = g_list_sort(queue, compare);
+}
+
+// takes the next room off the queue when a slot is free and starts its
+// timer, the room is owned here until completed or expired
+const char *
+autojoin_next(void)
+{
+    if (queue == NULL || g_list_length(pending) >= AUTOJOIN_CONCURRENT) {
+        return NULL;
+    }
+
+    AutojoinPending *entry = malloc(sizeof(AutojoinPending));
+    entry->room = queue->data;
+    entry->started = g_timer_new();
+    queue = g_list_delete_link(queue, queue);
+    pending = g_list_append(pending, entry);
+
+    return entry->room;
+}
+
+void
+autojoin_complete(const char * const room)
+{
+    GList *found = g_list_find_custom(pending, room, (GCompareFunc)_pending_cmp_room);
+    if (found == NULL) {
+        return;
+    }
+
+    _pending_free(found->data);
+    pending = g_list_delete_link(pending, found);
+}
+
+// frees the slots of joins older than timeout, their joins still complete
+// later, newer joins keep their slots
+void
+autojoin_expire(double timeout)
+{
+    GList *curr = pending;
+    while (curr) {
+        GList *next = g_list_next(curr);
+        AutojoinPending *entry = curr->data;
+        if (g_timer_elapsed(entry->started, NULL) > timeout) {
+            log_debug("Autojoin of %s timed out, starting next", entry->room);
+            _pending_free(entry);
+            pending = g_list_delete_link(pending, curr);
+        }
+        curr = next;
+    }
+}
+
+guint
+autojoin_queued_count(void)
+{
+    return g_list_length(queue);
+}
+
+guint
+autojoin_pending_count(void)
+{
+    return g_list_length(pending);
+}
+
+static void
+_pending_free(AutojoinPending *entry)
+{
+    if (entry) {
+        free(entry->room);
+        g_timer_destroy(entry->started);
+        free(entry);
+    }
+}
+
+static gint
+_pending_cmp_room(AutojoinPending *entry, const char * const room)
+{
+    return g_strcmp0(entry->room, room);
+}
@@ -0,0 +1,59 @@
+/*
+ * autojoin.h
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#ifndef XMPP_AUTOJOIN_H
+#define XMPP_AUTOJOIN_H
+
+#include <glib.h>
+
+// autojoin rooms are joined a few at a time, a room that doesn't answer
+// holds its slot for at most AUTOJOIN_TIMEOUT seconds
+#define AUTOJOIN_CONCURRENT 4
+#define AUTOJOIN_TIMEOUT 10
+
+// seconds between sweeps for joins that timed out
+#define AUTOJOIN_EXPIRE_INTERVAL 1
+
+void autojoin_clear(void);
+
+void autojoin_add(const char * const room);
+void autojoin_sort(GCompareFunc compare);
+const char * autojoin_next(void);
+void autojoin_complete(const char * const room);
+void autojoin_expire(double timeout);
+
+guint autojoin_queued_count(void);
+guint autojoin_pending_count(void);
+
+#endif
@@ -43,7 +43,9 @@
 #include "log.h"
 #include "muc.h"
 #include "server_events.h"
+#include "xmpp/autojoin.h"
 #include "xmpp/connection.h"
+#include "xmpp/send_queue.h"
 #include "xmpp/stanza.h"
 #include "xmpp/xmpp.h"
 #include "xmpp/bookmark.h"
@@ -61,6 +63,11 @@ static int _bookmark_handle_delete(xmpp_conn_t * const conn,
 static void _bookmark_item_destroy(gpointer item);
 static int _match_bookmark_by_jid(gconstpointer a, gconstpointer b);
 static void _send_bookmarks(void);
+static void _bookmark_autojoin_next(void);
+static void _bookmark_autojoin_reset(void);
+static int _bookmark_autojoin_timeout(xmpp_conn_t * const conn,
+    void * const userdata);
+static gint _bookmark_cmp_last_activity(gconstpointer a, gconstpointer b);
 
 void
 bookmark_request(void)
@@ -78,13 +85,14 @@ bookmark_request(void)
         g_list_free_full(bookmark_list, _bookmark_item_destroy);
         bookmark_list = NULL;
     }
+    _bookmark_autojoin_reset();
 
     xmpp_timed_handler_add(conn, _bookmark_handle_delete, BOOKMARK_TIMEOUT, id);
     xmpp_id_handler_add(conn, _bookmark_handle_result, id, id);
 
     iq = stanza_create_bookmarks_storage_request(ctx);
     xmpp_stanza_set_id(iq, id);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -233,6 +241,13 @@ bookmark_autocomplete_reset(void)
     }
 }
 
+void
+bookmark_autojoin_complete(const char * const room)
+{
+    autojoin_complete(room);
+    _bookmark_autojoin_next();
+}
+
 static int
 _bookmark_handle_result(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata)
@@ -325,25 +340,26 @@ _bookmark_handle_result(xmpp_conn_t * const conn,
         bookmark_list = g_list_append(bookmark_list, item);
 
         if (autojoin_val) {
-            Jid *room_jid;
+            autojoin_add(jid);
+        }
 
-            char *account_name = jabber_get_account_name();
-            ProfAccount *account = accounts_get_account(account_name);
-            if (name == NULL) {
-                name = account->muc_nick;
-            }
+        ptr = xmpp_stanza_get_next(ptr);
+    }
 
-            log_debug("Autojoin %s with nick=%s", jid, name);
-            room_jid = jid_create_from_bare_and_resource(jid, name);
-            if (!muc_active(room_jid->barejid)) {
-                presence_join_room(jid, name, password);
-                muc_join(jid, name, password, TRUE);
+    if (autojoin_queued_count() > 0) {
+        // load each room's last activity once before sorting
+        GList *curr = bookmark_list;
+        while (curr) {
+            Bookmark *bookmark = curr->data;
+            if (bookmark->autojoin) {
+                muc_last_activity(my_jid->barejid, bookmark->jid);
             }
-            jid_destroy(room_jid);
-            account_free(account);
+            curr = g_list_next(curr);
         }
+        autojoin_sort(_bookmark_cmp_last_activity);
 
-        ptr = xmpp_stanza_get_next(ptr);
+        xmpp_timed_handler_add(conn, _bookmark_autojoin_timeout, AUTOJOIN_EXPIRE_INTERVAL * 1000, NULL);
+        _bookmark_autojoin_next();
     }
 
     jid_destroy(my_jid);
@@ -351,6 +367,75 @@ _bookmark_handle_result(xmpp_conn_t * const conn,
     return 0;
 }
 
+static void
+_bookmark_autojoin_next(void)
+{
+    const char *room = NULL;
+    while ((room = autojoin_next()) != NULL) {
+        // bookmark removed, or room joined by hand, while queued
+        Bookmark search;
+        search.jid = (char *)room;
+        GList *found = g_list_find_custom(bookmark_list, &search, _match_bookmark_by_jid);
+        if (found == NULL || muc_active(room)) {
+            autojoin_complete(room);
+            continue;
+        }
+
+        Bookmark *bookmark = found->data;
+        char *account_name = jabber_get_account_name();
+        ProfAccount *account = accounts_get_account(account_name);
+        char *nick = bookmark->nick;
+        if (nick == NULL) {
+            nick = account->muc_nick;
+        }
+
+        log_debug("Autojoin %s with nick=%s", bookmark->jid, nick);
+        presence_join_room(bookmark->jid, nick, bookmark->password);
+        muc_join(bookmark->jid, nick, bookmark->password, TRUE);
+        account_free(account);
+    }
+}
+
+static void
+_bookmark_autojoin_reset(void)
+{
+    xmpp_conn_t *conn = connection_get_conn();
+    if (conn) {
+        xmpp_timed_handler_delete(conn, _bookmark_autojoin_timeout);
+    }
+
+    autojoin_clear();
+}
+
+static int
+_bookmark_autojoin_timeout(xmpp_conn_t * const conn,
+    void * const userdata)
+{
+    // give up waiting on slow rooms, their joins still complete later
+    autojoin_expire(AUTOJOIN_TIMEOUT);
+    _bookmark_autojoin_next();
+
+    return (autojoin_queued_count() > 0);
+}
+
+// most recently active first, rooms never seen keep bookmark order
+static gint
+_bookmark_cmp_last_activity(gconstpointer a, gconstpointer b)
+{
+    GDateTime *last_a = muc_last_message(a);
+    GDateTime *last_b = muc_last_message(b);
+
+    if (last_a == NULL && last_b == NULL) {
+        return 0;
+    } else if (last_a == NULL) {
+        return 1;
+    } else if (last_b == NULL) {
+        return -1;
+    } else {
+        return g_date_time_compare(last_b, last_a);
+    }
+}
+
 static int
 _bookmark_handle_delete(xmpp_conn_t * const conn,
     void * const userdata)
@@ -394,7 +479,6 @@ _match_bookmark_by_jid(gconstpointer a, gconstpointer b)
 static void
 _send_bookmarks(void)
 {
-    xmpp_conn_t *conn = connection_get_conn();
     xmpp_ctx_t *ctx = connection_get_ctx();
 
     xmpp_stanza_t *iq = xmpp_stanza_new(ctx);
@@ -466,6 +550,7 @@ _send_bookmarks(void)
     xmpp_stanza_release(storage);
     xmpp_stanza_release(query);
 
-    xmpp_send(conn, iq);
+    // each push carries the whole list, so a pending one is superseded
+    send_queue_stanza(iq, SEND_PRIORITY_NORMAL, "bookmarks");
     xmpp_stanza_release(iq);
 }
\ No newline at end of file
@@ -46,25 +46,51 @@
 #include <strophe.h>
 
 #include "common.h"
+#include "jid.h"
 #include "log.h"
+#include "config/persist.h"
 #include "xmpp/xmpp.h"
 #include "xmpp/stanza.h"
 #include "xmpp/form.h"
 #include "xmpp/capabilities.h"
 
 static gchar *cache_loc;
+static ProfStore *cache_store;
 static GKeyFile *cache;
 
+static GHashTable *ver_to_caps;
 static GHashTable *jid_to_ver;
 static GHashTable *jid_to_caps;
 
+// an outstanding disco#info query for a caps key (ver, or node#ver for legacy
+// caps), every jid advertising the key waits on the same query
+typedef struct caps_pending_t {
+    char *key;
+    char *node;
+    char *ver;
+    gboolean legacy;
+    char *queried;
+    char *queried_bare;
+    GTimer *sent;
+    GSList *waiting;
+} CapsPending;
+
+static GHashTable *pending;
+static GHashTable *queries_per_bare;
+static GList *queued;
+
 static char *my_sha1;
 
 static gchar* _get_cache_file(void);
 static void _save_cache(void);
+static Capabilities * _caps_load(const char * const ver);
 static Capabilities * _caps_by_ver(const char * const ver);
 static Capabilities * _caps_by_jid(const char * const jid);
-Capabilities * _caps_copy(Capabilities *caps);
+static Capabilities * _caps_ref(Capabilities *caps);
+static void _pending_free(CapsPending *entry);
+static void _pending_send(CapsPending *entry, const char * const jid);
+static void _pending_release(CapsPending *entry);
+static void _pending_send_queued(void);
 
 void
 caps_init(void)
@@ -79,18 +105,34 @@ caps_init(void)
     cache = g_key_file_new();
     g_key_file_load_from_file(cache, cache_loc, G_KEY_FILE_KEEP_COMMENTS,
         NULL);
+    cache_store = persist_store_new(cache, cache_loc, NULL);
+
+    // the key file is only read here, lookups use the parsed entries
+    ver_to_caps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)caps_destroy);
+    gsize nvers = 0;
+    gchar **vers = g_key_file_get_groups(cache, &nvers);
+    gsize i;
+    for (i = 0; i < nvers; i++) {
+        g_hash_table_insert(ver_to_caps, strdup(vers[i]), _caps_load(vers[i]));
+    }
+    g_strfreev(vers);
 
     jid_to_ver = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     jid_to_caps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)caps_destroy);
 
+    pending = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)_pending_free);
+    queries_per_bare = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    queued = NULL;
+
     my_sha1 = NULL;
 }
 
 void
 caps_add_by_ver(const char * const ver, Capabilities *caps)
 {
-    gboolean cached = g_key_file_has_group(cache, ver);
-    if (!cached) {
+    if (!caps_contains(ver)) {
+        g_hash_table_insert(ver_to_caps, strdup(ver), _caps_ref(caps));
+
         if (caps->name) {
             g_key_file_set_string(cache, ver, "name", caps->name);
         }
@@ -143,14 +185,15 @@ caps_map_jid_to_ver(const char * const jid, const char * const ver)
 gboolean
 caps_contains(const char * const ver)
 {
-    return (g_key_file_has_group(cache, ver));
+    return (g_hash_table_lookup(ver_to_caps, ver) != NULL);
 }
 
 static Capabilities *
-_caps_by_ver(const char * const ver)
+_caps_load(const char * const ver)
 {
     if (g_key_file_has_group(cache, ver)) {
         Capabilities *new_caps = malloc(sizeof(struct capabilities_t));
+        new_caps->refs = 1;
 
         char *category = g_key_file_get_string(cache, ver, "category", NULL);
         if (category) {
@@ -220,12 +263,164 @@ _caps_by_ver(const char * const ver)
     }
 }
 
+// request capabilities for jid, joining any query already made for the key
+void
+caps_request(const char * const jid, const char * const node, const char * const ver,
+    gboolean legacy)
+{
+    if (!node || !ver) {
+        log_error("Could not request capabilities for %s, no node or ver", jid);
+        return;
+    }
+
+    GString *key = g_string_new("");
+    if (legacy) {
+        g_string_printf(key, "%s#%s", node, ver);
+    } else {
+        g_string_append(key, ver);
+    }
+
+    if (caps_contains(key->str)) {
+        caps_map_jid_to_ver(jid, key->str);
+        g_string_free(key, TRUE);
+        return;
+    }
+
+    CapsPending *entry = g_hash_table_lookup(pending, key->str);
+    if (entry) {
+        log_debug("Capabilities request for %s already pending, %s waiting.", key->str, jid);
+        entry->waiting = g_slist_append(entry->waiting, strdup(jid));
+
+        // the queried entity never answered, ask the new one instead
+        if (entry->queried && g_timer_elapsed(entry->sent, NULL) > CAPS_QUERY_TIMEOUT) {
+            log_debug("Capabilities request for %s to %s timed out.", key->str, entry->queried);
+            _pending_release(entry);
+            _pending_send(entry, jid);
+        }
+        g_string_free(key, TRUE);
+        return;
+    }
+
+    entry = malloc(sizeof(CapsPending));
+    entry->key = strdup(key->str);
+    entry->node = strdup(node);
+    entry->ver = strdup(ver);
+    entry->legacy = legacy;
+    entry->queried = NULL;
+    entry->queried_bare = NULL;
+    entry->sent = g_timer_new();
+    entry->waiting = g_slist_append(NULL, strdup(jid));
+    g_hash_table_insert(pending, entry->key, entry);
+    g_string_free(key, TRUE);
+
+    _pending_send(entry, jid);
+}
+
+// a verified response arrived, every waiting jid gets the cached entry
+void
+caps_pending_resolve(const char * const key)
+{
+    CapsPending *entry = g_hash_table_lookup(pending, key);
+    if (entry == NULL) {
+        return;
+    }
+
+    GSList *curr = entry->waiting;
+    while (curr) {
+        caps_map_jid_to_ver(curr->data, key);
+        curr = g_slist_next(curr);
+    }
+    log_debug("Capabilities %s resolved for %d JIDs.", key, g_slist_length(entry->waiting));
+
+    _pending_release(entry);
+    g_hash_table_remove(pending, key);
+    _pending_send_queued();
+}
+
+// the queried jid gave an error or an unverifiable response, ask the next one
+void
+caps_pending_failed(const char * const key, const char * const jid)
+{
+    CapsPending *entry = g_hash_table_lookup(pending, key);
+    if (entry == NULL || g_strcmp0(entry->queried, jid) != 0) {
+        return;
+    }
+
+    GSList *found = g_slist_find_custom(entry->waiting, jid, (GCompareFunc)g_strcmp0);
+    if (found) {
+        free(found->data);
+        entry->waiting = g_slist_delete_link(entry->waiting, found);
+    }
+    _pending_release(entry);
+
+    if (entry->waiting) {
+        _pending_send(entry, entry->waiting->data);
+    } else {
+        g_hash_table_remove(pending, key);
+    }
+    _pending_send_queued();
+}
+
+// queries unanswered for longer than timeout seconds are treated as failed,
+// freeing their slot and moving on to the next jid that advertised the key
+void
+caps_pending_expire(double timeout)
+{
+    GSList *expired = NULL;
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, pending);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        CapsPending *entry = value;
+        if (entry->queried && g_timer_elapsed(entry->sent, NULL) > timeout) {
+            expired = g_slist_append(expired, entry);
+        }
+    }
+
+    // failing an entry only ever frees that entry, queries sent while
+    // sweeping are not in the list
+    GSList *curr = expired;
+    while (curr) {
+        CapsPending *entry = curr->data;
+        char *jid = strdup(entry->queried);
+        log_debug("Capabilities request for %s to %s timed out.", entry->key, jid);
+        caps_pending_failed(entry->key, jid);
+        free(jid);
+        curr = g_slist_next(curr);
+    }
+    g_slist_free(expired);
+}
+
+// replies to queries made before a disconnect are never matched
+void
+caps_pending_clear(void)
+{
+    g_list_free(queued);
+    queued = NULL;
+    g_hash_table_remove_all(pending);
+    g_hash_table_remove_all(queries_per_bare);
+}
+
+static Capabilities *
+_caps_by_ver(const char * const ver)
+{
+    return g_hash_table_lookup(ver_to_caps, ver);
+}
+
 static Capabilities *
 _caps_by_jid(const char * const jid)
 {
     return g_hash_table_lookup(jid_to_caps, jid);
 }
 
+static Capabilities *
+_caps_ref(Capabilities *caps)
+{
+    caps->refs++;
+    return caps;
+}
+
 Capabilities *
 caps_lookup(const char * const jid)
 {
@@ -234,13 +429,13 @@ caps_lookup(const char * const jid)
         Capabilities *caps = _caps_by_ver(ver);
         if (caps) {
             log_debug("Capabilities lookup %s, found by verification string %s.", jid, ver);
-            return caps;
+            return _caps_ref(caps);
         }
     } else {
         Capabilities *caps = _caps_by_jid(jid);
         if (caps) {
             log_debug("Capabilities lookup %s, found by JID.", jid);
-            return _caps_copy(caps);
+            return _caps_ref(caps);
         }
     }
 
@@ -248,32 +443,6 @@ caps_lookup(const char * const jid)
     return NULL;
 }
 
-Capabilities *
-_caps_copy(Capabilities *caps)
-{
-    if (!caps) {
-        return NULL;
-    } else {
-        Capabilities *result = (Capabilities *)malloc(sizeof(Capabilities));
-        result->category = caps->category ? strdup(caps->category) : NULL;
-        result->type = caps->type ? strdup(caps->type) : NULL;
-        result->name = caps->name ? strdup(caps->name) : NULL;
-        result->software = caps->software ? strdup(caps->software) : NULL;
-        result->software_version = caps->software_version ? strdup(caps->software_version) : NULL;
-        result->os = caps->os ? strdup(caps->os) : NULL;
-        result->os_version = caps->os_version ? strdup(caps->os_version) : NULL;
-
-        result->features = NULL;
-        GSList *curr = caps->features;
-        while (curr) {
-            result->features = g_slist_append(result->features, strdup(curr->data));
-            curr = g_slist_next(curr);
-        }
-
-        return result;
-    }
-}
-
 char *
 caps_create_sha1_str(xmpp_stanza_t * const query)
 {
@@ -489,6 +658,7 @@ caps_create(xmpp_stanza_t *query)
     }
 
     Capabilities *new_caps = malloc(sizeof(struct capabilities_t));
+    new_caps->refs = 1;
 
     if (category != NULL) {
         new_caps->category = strdup(category);
@@ -626,16 +796,28 @@ caps_create_query_response_stanza(xmpp_ctx_t * const ctx)
 void
 caps_close(void)
 {
+    persist_store_free(cache_store);
+    cache_store = NULL;
     g_key_file_free(cache);
     cache = NULL;
     g_hash_table_destroy(jid_to_ver);
     g_hash_table_destroy(jid_to_caps);
+    g_hash_table_destroy(ver_to_caps);
+    g_list_free(queued);
+    queued = NULL;
+    g_hash_table_destroy(pending);
+    g_hash_table_destroy(queries_per_bare);
 }
 
 void
 caps_destroy(Capabilities *caps)
 {
     if (caps != NULL) {
+        caps->refs--;
+        if (caps->refs > 0) {
+            return;
+        }
+
         free(caps->category);
         free(caps->type);
         free(caps->name);
@@ -666,9 +848,84 @@ _get_cache_file(void)
 static void
 _save_cache(void)
 {
-    gsize g_data_size;
-    gchar *g_cache_data = g_key_file_to_data(cache, &g_data_size, NULL);
-    g_file_set_contents(cache_loc, g_cache_data, g_data_size, NULL);
-    g_chmod(cache_loc, S_IRUSR | S_IWUSR);
-    g_free(g_cache_data);
+    persist_mark_dirty(cache_store);
+}
+
+static void
+_pending_free(CapsPending *entry)
+{
+    free(entry->key);
+    free(entry->node);
+    free(entry->ver);
+    free(entry->queried);
+    free(entry->queried_bare);
+    g_timer_destroy(entry->sent);
+    g_slist_free_full(entry->waiting, free);
+    free(entry);
+}
+
+// query jid, or queue the entry when its bare jid, usually a room being
+// joined, already has CAPS_MAX_QUERIES_PER_JID queries outstanding
+static void
+_pending_send(CapsPending *entry, const char * const jid)
+{
+    Jid *jidp = jid_create(jid);
+    const char *barejid = jidp ? jidp->barejid : jid;
+
+    int queries = GPOINTER_TO_INT(g_hash_table_lookup(queries_per_bare, barejid));
+    if (queries >= CAPS_MAX_QUERIES_PER_JID) {
+        log_debug("Capabilities request for %s queued, %d queries pending for %s.", entry->key, queries, barejid);
+        queued = g_list_append(queued, entry);
+        jid_destroy(jidp);
+        return;
+    }
+
+    g_hash_table_replace(queries_per_bare, strdup(barejid), GINT_TO_POINTER(queries + 1));
+    entry->queried = strdup(jid);
+    entry->queried_bare = strdup(barejid);
+    g_timer_start(entry->sent);
+    jid_destroy(jidp);
+
+    char *id = create_unique_id("caps");
+    if (entry->legacy) {
+        iq_send_caps_request_legacy(entry->queried, id, entry->node, entry->ver);
+    } else {
+        iq_send_caps_request(entry->queried, id, entry->node, entry->ver);
+    }
+    free(id);
+}
+
+// give back the query slot held by an entry
+static void
+_pending_release(CapsPending *entry)
+{
+    if (entry->queried_bare == NULL) {
+        queued = g_list_remove(queued, entry);
+        return;
+    }
+
+    int queries = GPOINTER_TO_INT(g_hash_table_lookup(queries_per_bare, entry->queried_bare));
+    if (queries > 1) {
+        g_hash_table_replace(queries_per_bare, strdup(entry->queried_bare), GINT_TO_POINTER(queries - 1));
+    } else {
+        g_hash_table_remove(queries_per_bare, entry->queried_bare);
+    }
+    FREE_SET_NULL(entry->queried);
+    FREE_SET_NULL(entry->queried_bare);
+}
+
+static void
+_pending_send_queued(void)
+{
+    GList *waiting = queued;
+    queued = NULL;
+
+    // entries that still can't be sent are queued again in order
+    GList *curr = waiting;
+    while (curr) {
+        CapsPending *entry = curr->data;
+        _pending_send(entry, entry->waiting->data);
+        curr = g_list_next(curr);
+    }
+    g_list_free(waiting);
 }
@@ -46,6 +46,20 @@ void caps_add_by_jid(const char * const jid, Capabilities *caps);
 void caps_map_jid_to_ver(const char * const jid, const char * const ver);
 gboolean caps_contains(const char * const ver);
 
+// seconds before a pending query is re-sent to the next jid that advertises it
+#define CAPS_QUERY_TIMEOUT 30
+// outstanding queries allowed per bare jid, so a room join can't flood the server
+#define CAPS_MAX_QUERIES_PER_JID 5
+// seconds between sweeps for queries that were never answered
+#define CAPS_EXPIRE_INTERVAL 5
+
+void caps_request(const char * const jid, const char * const node, const char * const ver,
+    gboolean legacy);
+void caps_pending_resolve(const char * const key);
+void caps_pending_failed(const char * const key, const char * const jid);
+void caps_pending_expire(double timeout);
+void caps_pending_clear(void);
+
 char* caps_create_sha1_str(xmpp_stanza_t * const query);
 xmpp_stanza_t* caps_create_query_response_stanza(xmpp_ctx_t * const ctx);
 Capabilities* caps_create(xmpp_stanza_t *query);
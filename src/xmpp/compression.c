@@ -0,0 +1,146 @@
+/*
+ * compression.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <zlib.h>
+
+#include "log.h"
+#include "xmpp/compression.h"
+
+// Traffic counts for /traffic. XEP-0138 is not negotiated: libstrophe owns
+// the socket and offers no hook to send <compress/> or to transform what it
+// reads and writes, so the stream is never compressed. With the account's
+// compression_estimate flag on, the same traffic is also fed through one
+// zlib stream per direction, flushed after every write as XEP-0138 would,
+// to estimate what compression would save. That costs a deflate per stanza,
+// so it is only done when asked for.
+
+static z_stream out_strm;
+static z_stream in_strm;
+static TrafficStats stats;
+
+static void _deflate_count(z_stream *strm, const char * const data, const size_t len);
+static void _end_streams(void);
+
+void
+compression_init(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void
+compression_close(void)
+{
+    _end_streams();
+}
+
+void
+compression_start(gboolean estimating)
+{
+    _end_streams();
+    memset(&stats, 0, sizeof(stats));
+
+    if (!estimating) {
+        return;
+    }
+
+    memset(&out_strm, 0, sizeof(out_strm));
+    memset(&in_strm, 0, sizeof(in_strm));
+    if (deflateInit(&out_strm, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        log_error("Compression: could not initialise zlib");
+        return;
+    }
+    if (deflateInit(&in_strm, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        log_error("Compression: could not initialise zlib");
+        deflateEnd(&out_strm);
+        return;
+    }
+
+    stats.estimating = TRUE;
+    log_info("Compression estimate on, the stream itself is not compressed");
+}
+
+void
+compression_count_sent(const char * const data, const size_t len)
+{
+    stats.logical_out += len;
+    if (stats.estimating) {
+        _deflate_count(&out_strm, data, len);
+        stats.deflated_out = out_strm.total_out;
+    }
+}
+
+void
+compression_count_recv(const char * const data, const size_t len)
+{
+    stats.logical_in += len;
+    if (stats.estimating) {
+        _deflate_count(&in_strm, data, len);
+        stats.deflated_in = in_strm.total_out;
+    }
+}
+
+void
+compression_get_stats(TrafficStats *result)
+{
+    *result = stats;
+}
+
+static void
+_deflate_count(z_stream *strm, const char * const data, const size_t len)
+{
+    unsigned char out[4096];
+
+    strm->next_in = (Bytef *)data;
+    strm->avail_in = len;
+    do {
+        strm->next_out = out;
+        strm->avail_out = sizeof(out);
+        if (deflate(strm, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+            return;
+        }
+    } while (strm->avail_out == 0);
+}
+
+static void
+_end_streams(void)
+{
+    if (stats.estimating) {
+        deflateEnd(&out_strm);
+        deflateEnd(&in_strm);
+        stats.estimating = FALSE;
+    }
+}
@@ -47,14 +47,19 @@
 #include "plugins/plugins.h"
 #include "profanity.h"
 #include "server_events.h"
+#include "xmpp/autojoin.h"
 #include "xmpp/bookmark.h"
 #include "xmpp/capabilities.h"
+#include "xmpp/compression.h"
 #include "xmpp/connection.h"
 #include "xmpp/iq.h"
 #include "xmpp/message.h"
 #include "xmpp/presence.h"
 #include "xmpp/roster.h"
+#include "xmpp/roster_cache.h"
+#include "xmpp/send_queue.h"
 #include "xmpp/stanza.h"
+#include "xmpp/stream_mgmt.h"
 #include "xmpp/xmpp.h"
 
 static struct _jabber_conn_t {
@@ -86,6 +91,16 @@ static struct {
 
 static GTimer *reconnect_timer;
 
+// extra reads per loop while inactive, see jabber_process_events
+#define CSI_DRAIN_ROUNDS 16
+
+// client state indication, whether the user is active and what the server was told
+static gboolean client_active = TRUE;
+static gboolean csi_active = TRUE;
+
+// raw stanzas are only passed to the ui while the xml console is open
+static gboolean capture_stanzas = FALSE;
+
 static log_level_t _get_log_level(xmpp_log_level_t xmpp_level);
 static xmpp_log_level_t _get_xmpp_log_level(void);
 static void _xmpp_file_logger(void * const userdata,
@@ -96,6 +111,7 @@ static xmpp_log_t * _xmpp_get_file_logger(void);
 static jabber_conn_status_t _jabber_connect(const char * const fulljid,
     const char * const passwd, const char * const altdomain, int port);
 static void _jabber_reconnect(void);
+static void _connection_send_client_state(void);
 
 static void _connection_handler(xmpp_conn_t * const conn,
     const xmpp_conn_event_t status, const int error,
@@ -117,6 +133,9 @@ jabber_init(const int disable_tls)
     jabber_conn.domain = NULL;
     presence_sub_requests_init();
     caps_init();
+    send_queue_init();
+    stream_mgmt_init();
+    compression_init();
     available_resources = g_hash_table_new_full(g_str_hash, g_str_equal, free,
         (GDestroyNotify)resource_destroy);
     xmpp_initialize();
@@ -195,6 +214,7 @@ jabber_disconnect(void)
         plugins_on_disconnect(account_name, fulljid);
         log_info("Closing connection");
         jabber_conn.conn_status = JABBER_DISCONNECTING;
+        send_queue_flush(TRUE);
         xmpp_disconnect(jabber_conn.conn);
 
         while (jabber_get_connection_status() == JABBER_DISCONNECTING) {
@@ -203,6 +223,7 @@ jabber_disconnect(void)
         _connection_free_saved_account();
         _connection_free_saved_details();
         _connection_free_session_data();
+        stream_mgmt_clear();
         if (jabber_conn.conn != NULL) {
             xmpp_conn_release(jabber_conn.conn);
             jabber_conn.conn = NULL;
@@ -224,6 +245,11 @@ jabber_shutdown(void)
     _connection_free_saved_account();
     _connection_free_saved_details();
     _connection_free_session_data();
+    send_queue_close();
+    stream_mgmt_close();
+    compression_close();
+    roster_cache_close();
+    autojoin_clear();
     xmpp_shutdown();
     free(jabber_conn.log);
 }
@@ -236,6 +262,24 @@ jabber_process_events(void)
     switch (jabber_conn.conn_status)
     {
         case JABBER_CONNECTED:
+            send_queue_flush(FALSE);
+            xmpp_run_once(jabber_conn.ctx, 10);
+
+            // an inactive client gets held back stanzas in bursts, read the
+            // whole burst now so it is handled and drawn in one pass
+            if (!csi_active) {
+                int i;
+                for (i = 0; i < CSI_DRAIN_ROUNDS && jabber_conn.conn_status == JABBER_CONNECTED; i++) {
+                    xmpp_run_once(jabber_conn.ctx, 0);
+                }
+            }
+
+            // replies queued by the handlers just run go out on the next
+            // run rather than waiting a whole loop turn
+            if (jabber_conn.conn_status == JABBER_CONNECTED) {
+                send_queue_flush(FALSE);
+            }
+            break;
         case JABBER_CONNECTING:
         case JABBER_DISCONNECTING:
             xmpp_run_once(jabber_conn.ctx, 10);
@@ -260,6 +304,33 @@ jabber_get_available_resources(void)
     return g_hash_table_get_values(available_resources);
 }
 
+void
+jabber_enable_stream_management(void)
+{
+    if (jabber_conn.conn_status == JABBER_CONNECTED) {
+        stream_mgmt_enable();
+    }
+}
+
+void
+jabber_get_traffic_stats(TrafficStats *stats)
+{
+    compression_get_stats(stats);
+}
+
+void
+jabber_set_client_active(gboolean active)
+{
+    client_active = active;
+    _connection_send_client_state();
+}
+
+void
+jabber_capture_stanzas(gboolean capture)
+{
+    capture_stanzas = capture;
+}
+
 jabber_conn_status_t
 jabber_get_connection_status(void)
 {
@@ -278,6 +349,15 @@ connection_get_ctx(void)
     return jabber_conn.ctx;
 }
 
+// unlike xmpp_send, xmpp_send_raw does not log what it writes, the debug line
+// keeps the log, xml console and traffic counters fed
+void
+connection_send_raw(const char * const data, const size_t len)
+{
+    xmpp_send_raw(jabber_conn.conn, data, len);
+    xmpp_debug(jabber_conn.ctx, "conn", "SENT: %.*s", (int)len, data);
+}
+
 const char *
 jabber_get_fulljid(void)
 {
@@ -351,6 +431,9 @@ _connection_free_session_data(void)
     g_hash_table_remove_all(available_resources);
     chat_sessions_clear();
     presence_clear_sub_requests();
+    caps_pending_clear();
+    send_queue_clear();
+    stream_mgmt_reset();
 }
 
 static jabber_conn_status_t
@@ -461,12 +544,15 @@ _connection_handler(xmpp_conn_t * const conn,
         jabber_conn.domain = strdup(my_jid->domainpart);
         jid_destroy(my_jid);
 
+        compression_start(accounts_get_compression_estimate(jabber_get_account_name()));
+
         chat_sessions_init();
 
         roster_add_handlers();
         message_add_handlers();
         presence_add_handlers();
         iq_add_handlers();
+        stream_mgmt_start();
 
         roster_request();
         bookmark_request();
@@ -477,6 +563,10 @@ _connection_handler(xmpp_conn_t * const conn,
         
         jabber_conn.conn_status = JABBER_CONNECTED;
 
+        // every session starts active
+        csi_active = TRUE;
+        _connection_send_client_state();
+
         if (prefs_get_reconnect() != 0) {
             if (reconnect_timer != NULL) {
                 g_timer_destroy(reconnect_timer);
@@ -497,12 +587,15 @@ _connection_handler(xmpp_conn_t * const conn,
             if (prefs_get_reconnect() != 0) {
                 assert(reconnect_timer == NULL);
                 reconnect_timer = g_timer_new();
-                // free resources but leave saved_user untouched
+                // keep unsent messages for the next session, then free
+                // resources but leave saved_user untouched
+                stream_mgmt_session_lost();
                 _connection_free_session_data();
             } else {
                 _connection_free_saved_account();
                 _connection_free_saved_details();
                 _connection_free_session_data();
+                stream_mgmt_clear();
             }
 
         // login attempt failed
@@ -514,6 +607,7 @@ _connection_handler(xmpp_conn_t * const conn,
                 _connection_free_saved_account();
                 _connection_free_saved_details();
                 _connection_free_session_data();
+                stream_mgmt_clear();
             } else {
                 log_debug("Connection handler: Restarting reconnect timer");
                 if (prefs_get_reconnect() != 0) {
@@ -570,7 +664,14 @@ _xmpp_file_logger(void * const userdata, const xmpp_log_level_t level,
     log_level_t prof_level = _get_log_level(level);
     log_msg(prof_level, area, msg);
     if ((g_strcmp0(area, "xmpp") == 0) || (g_strcmp0(area, "conn")) == 0) {
-        handle_xmpp_stanza(msg);
+        if (g_str_has_prefix(msg, "SENT: ")) {
+            compression_count_sent(&msg[6], strlen(&msg[6]));
+        } else if (g_str_has_prefix(msg, "RECV: ")) {
+            compression_count_recv(&msg[6], strlen(&msg[6]));
+        }
+        if (capture_stanzas) {
+            handle_xmpp_stanza(msg);
+        }
     }
 }
 
@@ -585,3 +686,23 @@ _xmpp_get_file_logger()
 
     return file_log;
 }
+
+// tells the server when the user's activity changes, switching /csi off
+// leaves the server thinking the client is active
+static void
+_connection_send_client_state(void)
+{
+    if (jabber_conn.conn_status != JABBER_CONNECTED) {
+        return;
+    }
+
+    gboolean active = client_active || !prefs_get_boolean(PREF_CSI);
+    if (active == csi_active) {
+        return;
+    }
+
+    csi_active = active;
+    log_debug("Client state: %s", active ? STANZA_NAME_ACTIVE : STANZA_NAME_INACTIVE);
+    xmpp_send_raw_string(jabber_conn.conn, "<%s xmlns='%s'/>",
+        active ? STANZA_NAME_ACTIVE : STANZA_NAME_INACTIVE, STANZA_NS_CSI);
+}
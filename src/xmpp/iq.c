@@ -51,6 +51,7 @@
 #include "server_events.h"
 #include "xmpp/capabilities.h"
 #include "xmpp/connection.h"
+#include "xmpp/send_queue.h"
 #include "xmpp/stanza.h"
 #include "xmpp/form.h"
 #include "roster_list.h"
@@ -78,6 +79,7 @@ static int _enable_carbons_handler(xmpp_conn_t * const conn, xmpp_stanza_t * con
 static int _disable_carbons_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza, void * const userdata);
 static int _manual_pong_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza, void * const userdata);
 static int _ping_timed_handler(xmpp_conn_t * const conn, void * const userdata);
+static int _caps_expire_timed_handler(xmpp_conn_t * const conn, void * const userdata);
 static int _caps_response_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza, void * const userdata);
 static int _caps_response_handler_for_jid(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza, void * const userdata);
 static int _caps_response_handler_legacy(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza, void * const userdata);
@@ -104,6 +106,8 @@ iq_add_handlers(void)
         int millis = prefs_get_autoping() * 1000;
         xmpp_timed_handler_add(conn, _ping_timed_handler, millis, ctx);
     }
+
+    xmpp_timed_handler_add(conn, _caps_expire_timed_handler, CAPS_EXPIRE_INTERVAL * 1000, NULL);
 }
 
 void
@@ -126,10 +130,9 @@ iq_set_autoping(const int seconds)
 void
 iq_room_list_request(gchar *conferencejid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *iq = stanza_create_disco_items_iq(ctx, "confreq", conferencejid);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -143,7 +146,7 @@ iq_enable_carbons()
 
     xmpp_id_handler_add(conn, _enable_carbons_handler, id, NULL);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -157,7 +160,7 @@ iq_disable_carbons()
 
     xmpp_id_handler_add(conn, _disable_carbons_handler, id, NULL);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -173,7 +176,7 @@ iq_disco_info_request(gchar *jid)
 
     free(id);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -189,7 +192,7 @@ iq_room_info_request(gchar *room)
 
     free(id);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -216,7 +219,7 @@ iq_send_caps_request_for_jid(const char * const to, const char * const id,
 
     xmpp_id_handler_add(conn, _caps_response_handler_for_jid, id, strdup(to));
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -241,9 +244,9 @@ iq_send_caps_request(const char * const to, const char * const id,
     xmpp_stanza_t *iq = stanza_create_disco_info_iq(ctx, id, to, node_str->str);
     g_string_free(node_str, TRUE);
 
-    xmpp_id_handler_add(conn, _caps_response_handler, id, NULL);
+    xmpp_id_handler_add(conn, _caps_response_handler, id, strdup(ver));
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -270,37 +273,34 @@ iq_send_caps_request_legacy(const char * const to, const char * const id,
     xmpp_id_handler_add(conn, _caps_response_handler_legacy, id, node_str->str);
     g_string_free(node_str, FALSE);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
 void
 iq_disco_items_request(gchar *jid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *iq = stanza_create_disco_items_iq(ctx, "discoitemsreq", jid);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
 void
 iq_send_software_version(const char * const fulljid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *iq = stanza_create_software_version_iq(ctx, fulljid);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
 void
 iq_confirm_instant_room(const char * const room_jid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *iq = stanza_create_instant_room_request_iq(ctx, room_jid);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -314,7 +314,7 @@ iq_destroy_room(const char * const room_jid)
     char *id = xmpp_stanza_get_id(iq);
     xmpp_id_handler_add(conn, _destroy_room_result_handler, id, NULL);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -328,7 +328,7 @@ iq_request_room_config_form(const char * const room_jid)
     char *id = xmpp_stanza_get_id(iq);
     xmpp_id_handler_add(conn, _room_config_handler, id, NULL);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -342,17 +342,16 @@ iq_submit_room_config(const char * const room, DataForm *form)
     char *id = xmpp_stanza_get_id(iq);
     xmpp_id_handler_add(conn, _room_config_submit_handler, id, NULL);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
 void
 iq_room_config_cancel(const char * const room_jid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *iq = stanza_create_room_config_cancel_iq(ctx, room_jid);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -366,7 +365,7 @@ iq_room_affiliation_list(const char * const room, char *affiliation)
     char *id = xmpp_stanza_get_id(iq);
     xmpp_id_handler_add(conn, _room_affiliation_list_result_handler, id, strdup(affiliation));
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -380,7 +379,7 @@ iq_room_kick_occupant(const char * const room, const char * const nick, const ch
     char *id = xmpp_stanza_get_id(iq);
     xmpp_id_handler_add(conn, _room_kick_result_handler, id, strdup(nick));
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -405,7 +404,7 @@ iq_room_affiliation_set(const char * const room, const char * const jid, char *a
 
     xmpp_id_handler_add(conn, _room_affiliation_set_result_handler, id, affiliation_set);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -425,7 +424,7 @@ iq_room_role_set(const char * const room, const char * const nick, char *role,
 
     xmpp_id_handler_add(conn, _room_role_set_result_handler, id, role_set);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -439,7 +438,7 @@ iq_room_role_list(const char * const room, char *role)
     char *id = xmpp_stanza_get_id(iq);
     xmpp_id_handler_add(conn, _room_role_list_result_handler, id, strdup(role));
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -454,7 +453,7 @@ iq_send_ping(const char * const target)
     GDateTime *now = g_date_time_new_now_local();
     xmpp_id_handler_add(conn, _manual_pong_handler, id, now);
 
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -521,6 +520,7 @@ static int
 _caps_response_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
     void * const userdata)
 {
+    char *expected_ver = (char *)userdata;
     const char *id = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_ID);
     xmpp_stanza_t *query = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_QUERY);
 
@@ -539,6 +539,7 @@ _caps_response_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
     const char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
     if (!from) {
         log_info("No from attribute");
+        free(expected_ver);
         return 0;
     }
 
@@ -547,17 +548,23 @@ _caps_response_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
         char *error_message = stanza_get_error_message(stanza);
         log_warning("Error received for capabilities response from %s: ", from, error_message);
         free(error_message);
+        caps_pending_failed(expected_ver, from);
+        free(expected_ver);
         return 0;
     }
 
     if (query == NULL) {
         log_warning("No query element found.");
+        caps_pending_failed(expected_ver, from);
+        free(expected_ver);
         return 0;
     }
 
     char *node = xmpp_stanza_get_attribute(query, STANZA_ATTR_NODE);
     if (node == NULL) {
         log_warning("No node attribute found");
+        caps_pending_failed(expected_ver, from);
+        free(expected_ver);
         return 0;
     }
 
@@ -570,6 +577,7 @@ _caps_response_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
         log_warning("Generated sha-1 does not match given:");
         log_warning("Generated : %s", generated_sha1);
         log_warning("Given     : %s", given_sha1);
+        caps_pending_failed(expected_ver, from);
     } else {
         log_info("Valid SHA-1 hash found: %s", given_sha1);
 
@@ -583,10 +591,12 @@ _caps_response_handler(xmpp_conn_t *const conn, xmpp_stanza_t * const stanza,
         }
 
         caps_map_jid_to_ver(from, given_sha1);
+        caps_pending_resolve(given_sha1);
     }
 
     g_free(generated_sha1);
     g_strfreev(split);
+    free(expected_ver);
 
     return 0;
 }
@@ -683,12 +693,14 @@ _caps_response_handler_legacy(xmpp_conn_t *const conn, xmpp_stanza_t * const sta
         char *error_message = stanza_get_error_message(stanza);
         log_warning("Error received for capabilities response from %s: ", from, error_message);
         free(error_message);
+        caps_pending_failed(expected_node, from);
         free(expected_node);
         return 0;
     }
 
     if (query == NULL) {
         log_warning("No query element found.");
+        caps_pending_failed(expected_node, from);
         free(expected_node);
         return 0;
     }
@@ -696,6 +708,7 @@ _caps_response_handler_legacy(xmpp_conn_t *const conn, xmpp_stanza_t * const sta
     char *node = xmpp_stanza_get_attribute(query, STANZA_ATTR_NODE);
     if (node == NULL) {
         log_warning("No node attribute found");
+        caps_pending_failed(expected_node, from);
         free(expected_node);
         return 0;
     }
@@ -713,10 +726,12 @@ _caps_response_handler_legacy(xmpp_conn_t *const conn, xmpp_stanza_t * const sta
         }
 
         caps_map_jid_to_ver(from, node);
+        caps_pending_resolve(node);
 
     // node match fail
     } else {
         log_info("Legacy Capabilities nodes do not match, expeceted %s, given %s.", expected_node, node);
+        caps_pending_failed(expected_node, from);
     }
 
     free(expected_node);
@@ -796,13 +811,23 @@ _ping_timed_handler(xmpp_conn_t * const conn, void * const userdata)
         // add pong handler
         xmpp_id_handler_add(conn, _pong_handler, id, ctx);
 
-        xmpp_send(conn, iq);
+        send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
         xmpp_stanza_release(iq);
     }
 
     return 1;
 }
 
+static int
+_caps_expire_timed_handler(xmpp_conn_t * const conn, void * const userdata)
+{
+    if (jabber_get_connection_status() == JABBER_CONNECTED) {
+        caps_pending_expire(CAPS_QUERY_TIMEOUT);
+    }
+
+    return 1;
+}
+
 static int
 _version_result_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
     void * const userdata)
@@ -891,7 +916,7 @@ _ping_get_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
         xmpp_stanza_set_attribute(pong, STANZA_ATTR_ID, id);
     }
 
-    xmpp_send(conn, pong);
+    send_queue_stanza(pong, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(pong);
 
     return 1;
@@ -951,7 +976,7 @@ _version_get_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
         xmpp_stanza_add_child(query, version);
         xmpp_stanza_add_child(response, query);
 
-        xmpp_send(conn, response);
+        send_queue_stanza(response, SEND_PRIORITY_HIGH, NULL);
 
         g_string_free(version_str, TRUE);
         xmpp_stanza_release(name_txt);
@@ -989,7 +1014,7 @@ _disco_items_get_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
         xmpp_stanza_set_name(query, STANZA_NAME_QUERY);
         xmpp_stanza_set_ns(query, XMPP_NS_DISCO_ITEMS);
         xmpp_stanza_add_child(response, query);
-        xmpp_send(conn, response);
+        send_queue_stanza(response, SEND_PRIORITY_HIGH, NULL);
 
         xmpp_stanza_release(response);
     }
@@ -1027,7 +1052,7 @@ _disco_info_get_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
             xmpp_stanza_set_attribute(query, STANZA_ATTR_NODE, node_str);
         }
         xmpp_stanza_add_child(response, query);
-        xmpp_send(conn, response);
+        send_queue_stanza(response, SEND_PRIORITY_HIGH, NULL);
 
         xmpp_stanza_release(query);
         xmpp_stanza_release(response);
@@ -38,6 +38,7 @@
 #include <strophe.h>
 
 #include "chat_session.h"
+#include "common.h"
 #include "config/preferences.h"
 #include "log.h"
 #include "muc.h"
@@ -46,8 +47,10 @@
 #include "xmpp/connection.h"
 #include "xmpp/message.h"
 #include "xmpp/roster.h"
+#include "xmpp/send_queue.h"
 #include "roster_list.h"
 #include "xmpp/stanza.h"
+#include "xmpp/stanza_writer.h"
 #include "xmpp/xmpp.h"
 
 #define HANDLE(ns, type, func) xmpp_handler_add(conn, func, ns, STANZA_NAME_MESSAGE, type, ctx)
@@ -65,6 +68,15 @@ static int _captcha_handler(xmpp_conn_t * const conn,
 static int _message_error_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
 
+static void _send_message(const char * const recipient, const char * const type,
+    const char * const msg, const char * const state, gboolean encrypted);
+static void _send_chat_state(const char * const jid, const char * const state);
+
+// reused for every templated stanza, grows to the largest message sent
+static GString *send_buf;
+
+#define CHAT_STATE_KEY "state:"
+
 void
 message_add_handlers(void)
 {
@@ -82,10 +94,6 @@ message_add_handlers(void)
 void
 message_send_chat(const char * const barejid, const char * const msg)
 {
-    xmpp_stanza_t *message;
-    xmpp_conn_t * const conn = connection_get_conn();
-    xmpp_ctx_t * const ctx = connection_get_ctx();
-
     ChatSession *session = chat_session_get(barejid);
     if (session) {
         char *state = NULL;
@@ -93,27 +101,20 @@ message_send_chat(const char * const barejid, const char * const msg)
             state = STANZA_NAME_ACTIVE;
         }
         Jid *jidp = jid_create_from_bare_and_resource(session->barejid, session->resource);
-        message = stanza_create_message(ctx, jidp->fulljid, STANZA_TYPE_CHAT, msg, state, false);
+        _send_message(jidp->fulljid, STANZA_TYPE_CHAT, msg, state, FALSE);
         jid_destroy(jidp);
     } else {
         char *state = NULL;
         if (prefs_get_boolean(PREF_STATES)) {
             state = STANZA_NAME_ACTIVE;
         }
-        message = stanza_create_message(ctx, barejid, STANZA_TYPE_CHAT, msg, state, false);
+        _send_message(barejid, STANZA_TYPE_CHAT, msg, state, FALSE);
     }
-
-    xmpp_send(conn, message);
-    xmpp_stanza_release(message);
 }
 
 void
 message_send_chat_encrypted(const char * const barejid, const char * const msg)
 {
-    xmpp_stanza_t *message;
-    xmpp_conn_t * const conn = connection_get_conn();
-    xmpp_ctx_t * const ctx = connection_get_ctx();
-
     ChatSession *session = chat_session_get(barejid);
     if (session) {
         char *state = NULL;
@@ -121,50 +122,36 @@ message_send_chat_encrypted(const char * const barejid, const char * const msg)
             state = STANZA_NAME_ACTIVE;
         }
         Jid *jidp = jid_create_from_bare_and_resource(session->barejid, session->resource);
-        message = stanza_create_message(ctx, jidp->fulljid, STANZA_TYPE_CHAT, msg, state, true);
+        _send_message(jidp->fulljid, STANZA_TYPE_CHAT, msg, state, TRUE);
         jid_destroy(jidp);
     } else {
         char *state = NULL;
         if (prefs_get_boolean(PREF_STATES)) {
             state = STANZA_NAME_ACTIVE;
         }
-        message = stanza_create_message(ctx, barejid, STANZA_TYPE_CHAT, msg, state, true);
+        _send_message(barejid, STANZA_TYPE_CHAT, msg, state, TRUE);
     }
-
-    xmpp_send(conn, message);
-    xmpp_stanza_release(message);
 }
 
 void
 message_send_private(const char * const fulljid, const char * const msg)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
-    xmpp_ctx_t * const ctx = connection_get_ctx();
-    xmpp_stanza_t *message = stanza_create_message(ctx, fulljid, STANZA_TYPE_CHAT, msg, NULL, false);
-
-    xmpp_send(conn, message);
-    xmpp_stanza_release(message);
+    _send_message(fulljid, STANZA_TYPE_CHAT, msg, NULL, FALSE);
 }
 
 void
 message_send_groupchat(const char * const roomjid, const char * const msg)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
-    xmpp_ctx_t * const ctx = connection_get_ctx();
-    xmpp_stanza_t *message = stanza_create_message(ctx, roomjid, STANZA_TYPE_GROUPCHAT, msg, NULL, false);
-
-    xmpp_send(conn, message);
-    xmpp_stanza_release(message);
+    _send_message(roomjid, STANZA_TYPE_GROUPCHAT, msg, NULL, FALSE);
 }
 
 void
 message_send_groupchat_subject(const char * const roomjid, const char * const subject)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *message = stanza_create_room_subject_message(ctx, roomjid, subject);
 
-    xmpp_send(conn, message);
+    send_queue_stanza(message, SEND_PRIORITY_NORMAL, NULL);
     xmpp_stanza_release(message);
 }
 
@@ -172,55 +159,74 @@ void
 message_send_invite(const char * const roomjid, const char * const contact,
     const char * const reason)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *stanza = stanza_create_invite(ctx, roomjid, contact, reason);
 
-    xmpp_send(conn, stanza);
+    send_queue_stanza(stanza, SEND_PRIORITY_NORMAL, NULL);
     xmpp_stanza_release(stanza);
 }
 
 void
 message_send_composing(const char * const jid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
-    xmpp_ctx_t * const ctx = connection_get_ctx();
-
-    xmpp_stanza_t *stanza = stanza_create_chat_state(ctx, jid, STANZA_NAME_COMPOSING);
-    xmpp_send(conn, stanza);
-    xmpp_stanza_release(stanza);
-
+    _send_chat_state(jid, STANZA_NAME_COMPOSING);
 }
 
 void
 message_send_paused(const char * const jid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
-    xmpp_ctx_t * const ctx = connection_get_ctx();
-    xmpp_stanza_t *stanza = stanza_create_chat_state(ctx, jid, STANZA_NAME_PAUSED);
-    xmpp_send(conn, stanza);
-    xmpp_stanza_release(stanza);
+    _send_chat_state(jid, STANZA_NAME_PAUSED);
 }
 
 void
 message_send_inactive(const char * const jid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
-    xmpp_ctx_t * const ctx = connection_get_ctx();
-    xmpp_stanza_t *stanza = stanza_create_chat_state(ctx, jid, STANZA_NAME_INACTIVE);
-
-    xmpp_send(conn, stanza);
-    xmpp_stanza_release(stanza);
+    _send_chat_state(jid, STANZA_NAME_INACTIVE);
 }
 
 void
 message_send_gone(const char * const jid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
-    xmpp_ctx_t * const ctx = connection_get_ctx();
-    xmpp_stanza_t *stanza = stanza_create_chat_state(ctx, jid, STANZA_NAME_GONE);
-    xmpp_send(conn, stanza);
-    xmpp_stanza_release(stanza);
+    _send_chat_state(jid, STANZA_NAME_GONE);
+}
+
+static void
+_send_message(const char * const recipient, const char * const type,
+    const char * const msg, const char * const state, gboolean encrypted)
+{
+    if (send_buf == NULL) {
+        send_buf = g_string_sized_new(1024);
+    }
+    g_string_truncate(send_buf, 0);
+
+    char *id = create_unique_id(NULL);
+    stanza_write_message(send_buf, id, recipient, type, msg, state, encrypted);
+    free(id);
+
+    // the message carries its own state, any pending one is stale
+    char *key = g_strconcat(CHAT_STATE_KEY, recipient, NULL);
+    send_queue_drop(key);
+    g_free(key);
+
+    send_queue_raw(send_buf->str, send_buf->len, SEND_PRIORITY_NORMAL, NULL);
+}
+
+static void
+_send_chat_state(const char * const jid, const char * const state)
+{
+    if (send_buf == NULL) {
+        send_buf = g_string_sized_new(1024);
+    }
+    g_string_truncate(send_buf, 0);
+
+    char *id = create_unique_id(NULL);
+    stanza_write_chat_state(send_buf, id, jid, state);
+    free(id);
+
+    // only the latest state for a recipient is worth sending
+    char *key = g_strconcat(CHAT_STATE_KEY, jid, NULL);
+    send_queue_raw(send_buf->str, send_buf->len, SEND_PRIORITY_LOW, key);
+    g_free(key);
 }
 
 static int
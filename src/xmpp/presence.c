@@ -47,6 +47,7 @@
 #include "server_events.h"
 #include "xmpp/capabilities.h"
 #include "xmpp/connection.h"
+#include "xmpp/send_queue.h"
 #include "xmpp/stanza.h"
 #include "xmpp/xmpp.h"
 
@@ -55,6 +56,8 @@ static Autocomplete sub_requests_ac;
 #define HANDLE(ns, type, func) xmpp_handler_add(conn, func, ns, \
                                                 STANZA_NAME_PRESENCE, type, ctx)
 
+static int _presence_handler(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata);
 static int _unavailable_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
 static int _subscribe_handler(xmpp_conn_t * const conn,
@@ -71,7 +74,8 @@ static int _presence_error_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata);
 
 void _send_caps_request(char *node, char *caps_key, char *id, char *from);
-static void _send_room_presence(xmpp_conn_t *conn, xmpp_stanza_t *presence);
+static void _send_room_presence(xmpp_stanza_t *presence);
+static char * _room_history_since(const char * const room);
 
 void
 presence_sub_requests_init(void)
@@ -85,13 +89,7 @@ presence_add_handlers(void)
     xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
 
-    HANDLE(NULL,               STANZA_TYPE_ERROR,        _presence_error_handler);
-    HANDLE(STANZA_NS_MUC_USER, NULL,                     _muc_user_handler);
-    HANDLE(NULL,               STANZA_TYPE_UNAVAILABLE,  _unavailable_handler);
-    HANDLE(NULL,               STANZA_TYPE_SUBSCRIBE,    _subscribe_handler);
-    HANDLE(NULL,               STANZA_TYPE_SUBSCRIBED,   _subscribed_handler);
-    HANDLE(NULL,               STANZA_TYPE_UNSUBSCRIBED, _unsubscribed_handler);
-    HANDLE(NULL,               NULL,                     _available_handler);
+    HANDLE(NULL, NULL, _presence_handler);
 }
 
 void
@@ -100,7 +98,6 @@ presence_subscription(const char * const jid, const jabber_subscr_t action)
     assert(jid != NULL);
 
     xmpp_ctx_t * const ctx = connection_get_ctx();
-    xmpp_conn_t * const conn = connection_get_conn();
     const char *type = NULL;
 
     Jid *jidp = jid_create(jid);
@@ -132,7 +129,7 @@ presence_subscription(const char * const jid, const jabber_subscr_t action)
     xmpp_stanza_set_name(presence, STANZA_NAME_PRESENCE);
     xmpp_stanza_set_type(presence, type);
     xmpp_stanza_set_attribute(presence, STANZA_ATTR_TO, jidp->barejid);
-    xmpp_send(conn, presence);
+    send_queue_stanza(presence, SEND_PRIORITY_NORMAL, NULL);
     xmpp_stanza_release(presence);
 
     jid_destroy(jidp);
@@ -209,7 +206,6 @@ presence_update(const resource_presence_t presence_type, const char * const msg,
     }
 
     xmpp_ctx_t * const ctx = connection_get_ctx();
-    xmpp_conn_t * const conn = connection_get_conn();
     const int pri =
         accounts_get_priority_for_presence_type(jabber_get_account_name(),
                                                 presence_type);
@@ -226,8 +222,10 @@ presence_update(const resource_presence_t presence_type, const char * const msg,
     stanza_attach_priority(ctx, presence, pri);
     stanza_attach_last_activity(ctx, presence, idle);
     stanza_attach_caps(ctx, presence);
-    xmpp_send(conn, presence);
-    _send_room_presence(conn, presence);
+
+    // a newer presence replaces one still waiting to be sent
+    send_queue_stanza(presence, SEND_PRIORITY_NORMAL, "presence");
+    _send_room_presence(presence);
     xmpp_stanza_release(presence);
 
     // set last presence for account
@@ -240,7 +238,7 @@ presence_update(const resource_presence_t presence_type, const char * const msg,
 }
 
 static void
-_send_room_presence(xmpp_conn_t *conn, xmpp_stanza_t *presence)
+_send_room_presence(xmpp_stanza_t *presence)
 {
     GList *rooms_p = muc_rooms();
     GList *rooms = rooms_p;
@@ -254,7 +252,9 @@ _send_room_presence(xmpp_conn_t *conn, xmpp_stanza_t *presence)
 
             xmpp_stanza_set_attribute(presence, STANZA_ATTR_TO, full_room_jid);
             log_debug("Sending presence to room: %s", full_room_jid);
-            xmpp_send(conn, presence);
+            char *key = g_strconcat("presence:", room, NULL);
+            send_queue_stanza(presence, SEND_PRIORITY_NORMAL, key);
+            g_free(key);
             free(full_room_jid);
         }
 
@@ -273,7 +273,6 @@ presence_join_room(char *room, char *nick, char * passwd)
 
     log_debug("Sending room join presence to: %s", jid->fulljid);
     xmpp_ctx_t *ctx = connection_get_ctx();
-    xmpp_conn_t *conn = connection_get_conn();
     resource_presence_t presence_type =
         accounts_get_last_presence(jabber_get_account_name());
     const char *show = stanza_get_presence_string_from_type(presence_type);
@@ -281,13 +280,15 @@ presence_join_room(char *room, char *nick, char * passwd)
     int pri = accounts_get_priority_for_presence_type(jabber_get_account_name(),
         presence_type);
 
-    xmpp_stanza_t *presence = stanza_create_room_join_presence(ctx, jid->fulljid, passwd);
+    char *since = _room_history_since(room);
+    xmpp_stanza_t *presence = stanza_create_room_join_presence(ctx, jid->fulljid, passwd, since);
+    g_free(since);
     stanza_attach_show(ctx, presence, show);
     stanza_attach_status(ctx, presence, status);
     stanza_attach_priority(ctx, presence, pri);
     stanza_attach_caps(ctx, presence);
 
-    xmpp_send(conn, presence);
+    send_queue_stanza(presence, SEND_PRIORITY_NORMAL, NULL);
     xmpp_stanza_release(presence);
 
     jid_destroy(jid);
@@ -301,7 +302,6 @@ presence_change_room_nick(const char * const room, const char * const nick)
 
     log_debug("Sending room nickname change to: %s, nick: %s", room, nick);
     xmpp_ctx_t *ctx = connection_get_ctx();
-    xmpp_conn_t *conn = connection_get_conn();
     resource_presence_t presence_type =
         accounts_get_last_presence(jabber_get_account_name());
     const char *show = stanza_get_presence_string_from_type(presence_type);
@@ -317,7 +317,7 @@ presence_change_room_nick(const char * const room, const char * const nick)
     stanza_attach_priority(ctx, presence, pri);
     stanza_attach_caps(ctx, presence);
 
-    xmpp_send(conn, presence);
+    send_queue_stanza(presence, SEND_PRIORITY_NORMAL, NULL);
     xmpp_stanza_release(presence);
 
     free(full_room_jid);
@@ -330,36 +330,65 @@ presence_leave_chat_room(const char * const room_jid)
 
     log_debug("Sending room leave presence to: %s", room_jid);
     xmpp_ctx_t *ctx = connection_get_ctx();
-    xmpp_conn_t *conn = connection_get_conn();
     char *nick = muc_nick(room_jid);
 
     if (nick != NULL) {
         xmpp_stanza_t *presence = stanza_create_room_leave_presence(ctx, room_jid,
             nick);
-        xmpp_send(conn, presence);
+        send_queue_stanza(presence, SEND_PRIORITY_NORMAL, NULL);
         xmpp_stanza_release(presence);
     }
 }
 
+// single entry point for presence, the stanza children are walked once and
+// the collected parts are handed to the handler for its type
+static int
+_presence_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
+    void * const userdata)
+{
+    XMPPPresenceParts parts;
+    stanza_get_presence_parts(stanza, &parts);
+
+    if (g_strcmp0(parts.type, STANZA_TYPE_ERROR) == 0) {
+        return _presence_error_handler(conn, stanza, &parts);
+    }
+
+    if (parts.muc_user) {
+        return _muc_user_handler(conn, stanza, &parts);
+    }
+
+    if (parts.type == NULL) {
+        return _available_handler(conn, stanza, &parts);
+    } else if (strcmp(parts.type, STANZA_TYPE_UNAVAILABLE) == 0) {
+        return _unavailable_handler(conn, stanza, &parts);
+    } else if (strcmp(parts.type, STANZA_TYPE_SUBSCRIBE) == 0) {
+        return _subscribe_handler(conn, stanza, &parts);
+    } else if (strcmp(parts.type, STANZA_TYPE_SUBSCRIBED) == 0) {
+        return _subscribed_handler(conn, stanza, &parts);
+    } else if (strcmp(parts.type, STANZA_TYPE_UNSUBSCRIBED) == 0) {
+        return _unsubscribed_handler(conn, stanza, &parts);
+    }
+
+    log_debug("Ignoring presence of type %s from %s", parts.type, parts.from);
+
+    return 1;
+}
+
 static int
 _presence_error_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
     void * const userdata)
 {
+    XMPPPresenceParts *parts = userdata;
     char *id = xmpp_stanza_get_id(stanza);
-    char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
-    xmpp_stanza_t *error_stanza = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_ERROR);
-    xmpp_stanza_t *x = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_X);
-    char *xmlns = NULL;
-    if (x != NULL) {
-        xmlns = xmpp_stanza_get_ns(x);
-    }
+    char *from = parts->from;
+    xmpp_stanza_t *error_stanza = parts->error;
     char *type = NULL;
     if (error_stanza != NULL) {
         type = xmpp_stanza_get_attribute(error_stanza, STANZA_ATTR_TYPE);
     }
 
     // handle MUC join errors
-    if (g_strcmp0(xmlns, STANZA_NS_MUC) == 0) {
+    if (parts->muc) {
         Jid *fulljid = jid_create(from);
 
         char *error_cond = NULL;
@@ -412,7 +441,8 @@ static int
 _unsubscribed_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata)
 {
-    char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
+    XMPPPresenceParts *parts = userdata;
+    char *from = parts->from;
     Jid *from_jid = jid_create(from);
     log_debug("Unsubscribed presence handler fired for %s", from);
 
@@ -428,7 +458,8 @@ static int
 _subscribed_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata)
 {
-    char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
+    XMPPPresenceParts *parts = userdata;
+    char *from = parts->from;
     Jid *from_jid = jid_create(from);
     log_debug("Subscribed presence handler fired for %s", from);
 
@@ -444,7 +475,8 @@ static int
 _subscribe_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata)
 {
-    char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
+    XMPPPresenceParts *parts = userdata;
+    char *from = parts->from;
     log_debug("Subscribe presence handler fired for %s", from);
 
     Jid *from_jid = jid_create(from);
@@ -464,8 +496,9 @@ static int
 _unavailable_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata)
 {
+    XMPPPresenceParts *parts = userdata;
     const char *jid = xmpp_conn_get_jid(conn);
-    char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
+    char *from = parts->from;
     log_debug("Unavailable presence handler fired for %s", from);
 
     Jid *my_jid = jid_create(jid);
@@ -476,7 +509,7 @@ _unavailable_handler(xmpp_conn_t * const conn,
         return 1;
     }
 
-    char *status_str = stanza_get_status(stanza, NULL);
+    char *status_str = stanza_get_text_or(parts->status, NULL);
 
     if (strcmp(my_jid->barejid, from_jid->barejid) !=0) {
         if (from_jid->resourcepart != NULL) {
@@ -510,10 +543,8 @@ _handle_caps(char *jid, XMPPCaps *caps)
                 log_info("Capabilities cache hit: %s, for %s.", caps->ver, jid);
                 caps_map_jid_to_ver(jid, caps->ver);
             } else {
-                log_info("Capabilities cache miss: %s, for %s, sending service discovery request", caps->ver, jid);
-                char *id = create_unique_id("caps");
-                iq_send_caps_request(jid, id, caps->node, caps->ver);
-                free(id);
+                log_info("Capabilities cache miss: %s, for %s, requesting service discovery", caps->ver, jid);
+                caps_request(jid, caps->node, caps->ver, FALSE);
             }
         }
 
@@ -527,9 +558,7 @@ _handle_caps(char *jid, XMPPCaps *caps)
    // no hash, legacy caps, cache against node#ver
    } else if (caps->node && caps->ver) {
         log_info("No hash specified: %s, legacy request made for %s#%s", jid, caps->node, caps->ver);
-        char *id = create_unique_id("caps");
-        iq_send_caps_request_legacy(jid, id, caps->node, caps->ver);
-        free(id);
+        caps_request(jid, caps->node, caps->ver, TRUE);
     } else {
         log_info("No hash specified: %s, could not create ver string, not sending service disovery request.", jid);
     }
@@ -539,26 +568,9 @@ static int
 _available_handler(xmpp_conn_t * const conn,
     xmpp_stanza_t * const stanza, void * const userdata)
 {
-    // handler still fires if error
-    if (g_strcmp0(xmpp_stanza_get_type(stanza), STANZA_TYPE_ERROR) == 0) {
-        return 1;
-    }
-
-    // handler still fires if other types
-    if ((g_strcmp0(xmpp_stanza_get_type(stanza), STANZA_TYPE_UNAVAILABLE) == 0) ||
-            (g_strcmp0(xmpp_stanza_get_type(stanza), STANZA_TYPE_SUBSCRIBE) == 0) ||
-            (g_strcmp0(xmpp_stanza_get_type(stanza), STANZA_TYPE_SUBSCRIBED) == 0) ||
-            (g_strcmp0(xmpp_stanza_get_type(stanza), STANZA_TYPE_UNSUBSCRIBED) == 0)) {
-        return 1;
-    }
-
-    // handler still fires for muc presence
-    if (stanza_is_muc_presence(stanza)) {
-        return 1;
-    }
-
+    XMPPPresenceParts *parts = userdata;
     int err = 0;
-    XMPPPresence *xmpp_presence = stanza_parse_presence(stanza, &err);
+    XMPPPresence *xmpp_presence = stanza_parse_presence_parts(parts, &err);
 
     if (!xmpp_presence) {
         char *from = NULL;
@@ -567,7 +579,7 @@ _available_handler(xmpp_conn_t * const conn,
                 log_warning("Available presence handler fired with no from attribute.");
                 break;
             case STANZA_PARSE_ERROR_INVALID_FROM:
-                from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
+                from = parts->from;
                 log_warning("Available presence handler fired with invalid from attribute: %s", from);
                 break;
             default:
@@ -583,7 +595,7 @@ _available_handler(xmpp_conn_t * const conn,
     const char *my_jid_str = xmpp_conn_get_jid(conn);
     Jid *my_jid = jid_create(my_jid_str);
 
-    XMPPCaps *caps = stanza_parse_caps(stanza);
+    XMPPCaps *caps = stanza_parse_caps_child(parts->caps);
     if ((g_strcmp0(my_jid->fulljid, xmpp_presence->jid->fulljid) != 0) && caps) {
         log_info("Presence contains capabilities.");
         char *jid = jid_fulljid_or_barejid(xmpp_presence->jid);
@@ -609,14 +621,13 @@ void
 _send_caps_request(char *node, char *caps_key, char *id, char *from)
 {
     xmpp_ctx_t *ctx = connection_get_ctx();
-    xmpp_conn_t *conn = connection_get_conn();
 
     if (node != NULL) {
         log_debug("Node string: %s.", node);
         if (!caps_contains(caps_key)) {
             log_debug("Capabilities not cached for '%s', sending discovery IQ.", from);
             xmpp_stanza_t *iq = stanza_create_disco_info_iq(ctx, id, from, node);
-            xmpp_send(conn, iq);
+            send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
             xmpp_stanza_release(iq);
         } else {
             log_debug("Capabilities already cached, for %s", caps_key);
@@ -629,13 +640,9 @@ _send_caps_request(char *node, char *caps_key, char *id, char *from)
 static int
 _muc_user_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza, void * const userdata)
 {
-    char *type = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_TYPE);
-    char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
-
-    // handler still fires if error
-    if (g_strcmp0(type, STANZA_TYPE_ERROR) == 0) {
-        return 1;
-    }
+    XMPPPresenceParts *parts = userdata;
+    char *type = parts->type;
+    char *from = parts->from;
 
     // invalid from attribute
     Jid *from_jid = jid_create(from);
@@ -646,14 +653,14 @@ _muc_user_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza, void *
     char *room = from_jid->barejid;
     char *nick = from_jid->resourcepart;
 
-    char *show_str = stanza_get_show(stanza, "online");
-    char *status_str = stanza_get_status(stanza, NULL);
+    char *show_str = stanza_get_text_or(parts->show, "online");
+    char *status_str = stanza_get_text_or(parts->status, NULL);
 
     char *jid = NULL;
     char *role = NULL;
     char *affiliation = NULL;
 
-    xmpp_stanza_t *x = xmpp_stanza_get_child_by_ns(stanza, STANZA_NS_MUC_USER);
+    xmpp_stanza_t *x = parts->muc_user;
     if (x) {
         xmpp_stanza_t *item = xmpp_stanza_get_child_by_name(x, STANZA_NAME_ITEM);
         if (item) {
@@ -756,7 +763,7 @@ _muc_user_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza, void *
         // room occupant online
         } else {
             // send disco info for capabilities, if not cached
-            XMPPCaps *caps = stanza_parse_caps(stanza);
+            XMPPCaps *caps = stanza_parse_caps_child(parts->caps);
             if (caps) {
                 log_info("Presence contains capabilities.");
                 _handle_caps(from, caps);
@@ -774,4 +781,24 @@ _muc_user_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza, void *
     jid_destroy(from_jid);
 
     return 1;
-}
\ No newline at end of file
+}
+
+// XEP-0045 history since the last message seen in this session, or the
+// last line of today's room log, NULL for the server's default history
+static char *
+_room_history_since(const char * const room)
+{
+    Jid *jidp = jid_create(jabber_get_fulljid());
+    GDateTime *last = muc_last_activity(jidp->barejid, room);
+    jid_destroy(jidp);
+
+    if (last == NULL) {
+        return NULL;
+    }
+
+    GDateTime *utc = g_date_time_to_utc(last);
+    char *since = g_date_time_format(utc, "%Y-%m-%dT%H:%M:%SZ");
+    g_date_time_unref(utc);
+
+    return since;
+}
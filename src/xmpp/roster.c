@@ -39,6 +39,7 @@
 #include <glib.h>
 #include <strophe.h>
 
+#include "common.h"
 #include "log.h"
 #include "plugins/plugins.h"
 #include "profanity.h"
@@ -46,7 +47,9 @@
 #include "tools/autocomplete.h"
 #include "xmpp/connection.h"
 #include "xmpp/roster.h"
+#include "xmpp/roster_cache.h"
 #include "roster_list.h"
+#include "xmpp/send_queue.h"
 #include "xmpp/stanza.h"
 #include "xmpp/xmpp.h"
 
@@ -89,41 +92,46 @@ roster_add_handlers(void)
 void
 roster_request(void)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
+    // show the cached roster straight away, the server only sends changes
+    char *ver = roster_cache_open(jabber_get_account_name());
+    if (ver) {
+        handle_roster_received();
+    }
+
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *iq = stanza_create_roster_iq(ctx);
-    xmpp_send(conn, iq);
+    xmpp_stanza_t *query = xmpp_stanza_get_child_by_name(iq, STANZA_NAME_QUERY);
+    xmpp_stanza_set_attribute(query, STANZA_ATTR_VER, ver ? ver : "");
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
+    g_free(ver);
 }
 
 void
 roster_send_add_new(const char * const barejid, const char * const name)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *iq = stanza_create_roster_set(ctx, NULL, barejid, name, NULL);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
 void
 roster_send_remove(const char * const barejid)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *iq = stanza_create_roster_remove_set(ctx, barejid);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
 void
 roster_send_name_change(const char * const barejid, const char * const new_name, GSList *groups)
 {
-    xmpp_conn_t * const conn = connection_get_conn();
     xmpp_ctx_t * const ctx = connection_get_ctx();
     xmpp_stanza_t *iq = stanza_create_roster_set(ctx, NULL, barejid, new_name,
         groups);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
 }
 
@@ -153,7 +161,7 @@ roster_send_add_to_group(const char * const group, PContact contact)
     xmpp_id_handler_add(conn, _group_add_handler, unique_id, data);
     xmpp_stanza_t *iq = stanza_create_roster_set(ctx, unique_id, p_contact_barejid(contact),
         p_contact_name(contact), new_groups);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
     free(unique_id);
 }
@@ -200,7 +208,7 @@ roster_send_remove_from_group(const char * const group, PContact contact)
     xmpp_id_handler_add(conn, _group_remove_handler, unique_id, data);
     xmpp_stanza_t *iq = stanza_create_roster_set(ctx, unique_id, p_contact_barejid(contact),
         p_contact_name(contact), new_groups);
-    xmpp_send(conn, iq);
+    send_queue_stanza(iq, SEND_PRIORITY_HIGH, NULL);
     xmpp_stanza_release(iq);
     free(unique_id);
 }
@@ -254,6 +262,8 @@ _roster_set_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
 
     // remove from roster
     if (g_strcmp0(sub, "remove") == 0) {
+        roster_cache_remove(barejid_lower);
+
         // remove barejid and name
         if (name == NULL) {
             name = barejid_lower;
@@ -273,6 +283,7 @@ _roster_set_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
         }
 
         GSList *groups = _get_groups_from_item(item);
+        roster_cache_put(barejid_lower, name, groups, sub, pending_out);
 
         // update the local roster
         PContact contact = roster_get_contact(barejid_lower);
@@ -288,6 +299,8 @@ _roster_set_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
 
     g_free(barejid_lower);
 
+    roster_cache_set_ver(xmpp_stanza_get_attribute(query, STANZA_ATTR_VER));
+
     return 1;
 }
 
@@ -300,7 +313,20 @@ _roster_result_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
     // handle initial roster response
     if (g_strcmp0(id, "roster") == 0) {
         xmpp_stanza_t *query = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_QUERY);
-        xmpp_stanza_t *item = xmpp_stanza_get_children(query);
+
+        // no query means the cached roster is current, changes arrive as pushes
+        if (query == NULL) {
+            log_debug("Roster cache is up to date");
+        } else {
+            log_debug("Full roster received, replacing cache");
+            roster_clear();
+            roster_cache_reset();
+        }
+
+        xmpp_stanza_t *item = NULL;
+        if (query != NULL) {
+            item = xmpp_stanza_get_children(query);
+        }
 
         while (item != NULL) {
             const char *barejid = xmpp_stanza_get_attribute(item, STANZA_ATTR_JID);
@@ -320,6 +346,7 @@ _roster_result_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
             }
 
             GSList *groups = _get_groups_from_item(item);
+            roster_cache_put(barejid_lower, name, groups, sub, pending_out);
 
             gboolean added = roster_add(barejid_lower, name, groups, sub, pending_out);
 
@@ -331,6 +358,10 @@ _roster_result_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
             item = xmpp_stanza_get_next(item);
         }
 
+        if (query != NULL) {
+            roster_cache_set_ver(xmpp_stanza_get_attribute(query, STANZA_ATTR_VER));
+        }
+
         handle_roster_received();
 
         char *account_name = jabber_get_account_name();
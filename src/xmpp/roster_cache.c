@@ -0,0 +1,247 @@
+/*
+ * roster_cache.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "common.h"
+#include "log.h"
+#include "config/persist.h"
+#include "roster_list.h"
+#include "xmpp/roster_cache.h"
+
+// group holding the roster version in the cache, never a valid bare JID
+#define ROSTER_CACHE_META "roster cache"
+
+// key holding the roster version, as the ver attribute of the query
+#define ROSTER_CACHE_VER "ver"
+
+// on disk copy of the roster for the connected account
+static GKeyFile *roster_cache;
+static ProfStore *roster_store;
+static char *roster_cache_account;
+static gboolean roster_cache_incomplete = FALSE;
+
+static gchar * _roster_cache_file(const char * const account);
+
+// loads the cached roster for the account into the roster list and
+// returns the version it was saved at, NULL when there is none
+char *
+roster_cache_open(const char * const account)
+{
+    if (account == NULL) {
+        return NULL;
+    }
+
+    if (g_strcmp0(account, roster_cache_account) != 0) {
+        roster_cache_close();
+
+        gchar *cache_loc = _roster_cache_file(account);
+        roster_cache = g_key_file_new();
+
+        // an unreadable cache is started afresh, the server sends it all
+        GError *error = NULL;
+        if (!g_key_file_load_from_file(roster_cache, cache_loc, G_KEY_FILE_KEEP_COMMENTS, &error)) {
+            if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+                log_warning("Could not read roster cache %s: %s", cache_loc, error->message);
+            }
+            g_error_free(error);
+        }
+        roster_store = persist_store_new(roster_cache, cache_loc, NULL);
+        roster_cache_account = strdup(account);
+        g_free(cache_loc);
+    }
+
+    char *ver = g_key_file_get_string(roster_cache, ROSTER_CACHE_META, ROSTER_CACHE_VER, NULL);
+    if (ver == NULL) {
+        return NULL;
+    }
+
+    int loaded = 0;
+    gsize ngroups_total = 0;
+    gchar **barejids = g_key_file_get_groups(roster_cache, &ngroups_total);
+    gsize i;
+    for (i = 0; i < ngroups_total; i++) {
+        if (strcmp(barejids[i], ROSTER_CACHE_META) == 0) {
+            continue;
+        }
+
+        gchar *name = g_key_file_get_string(roster_cache, barejids[i], "name", NULL);
+        gchar *sub = g_key_file_get_string(roster_cache, barejids[i], "subscription", NULL);
+        gboolean pending_out = g_key_file_get_boolean(roster_cache, barejids[i], "pending_out", NULL);
+
+        GSList *groups = NULL;
+        gsize ngroups = 0;
+        gchar **group_names = g_key_file_get_string_list(roster_cache, barejids[i], "groups", &ngroups, NULL);
+        gsize j;
+        for (j = 0; j < ngroups; j++) {
+            groups = g_slist_append(groups, strdup(group_names[j]));
+        }
+        g_strfreev(group_names);
+
+        if (roster_add(barejids[i], name, groups, sub, pending_out)) {
+            loaded++;
+        }
+
+        g_free(name);
+        g_free(sub);
+    }
+    g_strfreev(barejids);
+
+    log_info("Loaded %d contacts from roster cache, version %s", loaded, ver);
+
+    return ver;
+}
+
+void
+roster_cache_close(void)
+{
+    if (roster_store) {
+        persist_store_free(roster_store);
+        roster_store = NULL;
+    }
+    if (roster_cache) {
+        g_key_file_free(roster_cache);
+        roster_cache = NULL;
+    }
+    FREE_SET_NULL(roster_cache_account);
+    roster_cache_incomplete = FALSE;
+}
+
+void
+roster_cache_put(const char * const barejid, const char * const name,
+    GSList *groups, const char * const sub, gboolean pending_out)
+{
+    if (roster_cache == NULL) {
+        return;
+    }
+
+    // key file group names cannot hold these, fetch the full roster next time
+    if (strpbrk(barejid, "[]") != NULL) {
+        roster_cache_incomplete = TRUE;
+        g_key_file_remove_group(roster_cache, ROSTER_CACHE_META, NULL);
+        persist_mark_dirty(roster_store);
+        return;
+    }
+
+    g_key_file_remove_group(roster_cache, barejid, NULL);
+    if (name) {
+        g_key_file_set_string(roster_cache, barejid, "name", name);
+    }
+    g_key_file_set_string(roster_cache, barejid, "subscription", sub ? sub : "none");
+    g_key_file_set_boolean(roster_cache, barejid, "pending_out", pending_out);
+
+    guint ngroups = g_slist_length(groups);
+    if (ngroups > 0) {
+        const gchar *group_names[ngroups];
+        guint i = 0;
+        GSList *curr = groups;
+        while (curr) {
+            group_names[i++] = curr->data;
+            curr = g_slist_next(curr);
+        }
+        g_key_file_set_string_list(roster_cache, barejid, "groups", group_names, ngroups);
+    }
+
+    persist_mark_dirty(roster_store);
+}
+
+void
+roster_cache_remove(const char * const barejid)
+{
+    if (roster_cache == NULL) {
+        return;
+    }
+
+    g_key_file_remove_group(roster_cache, barejid, NULL);
+    persist_mark_dirty(roster_store);
+}
+
+void
+roster_cache_set_ver(const char * const ver)
+{
+    if (roster_cache == NULL) {
+        return;
+    }
+
+    // a server without versioning never sends ver, keep nothing to compare
+    if (ver == NULL || roster_cache_incomplete) {
+        g_key_file_remove_group(roster_cache, ROSTER_CACHE_META, NULL);
+    } else {
+        g_key_file_set_string(roster_cache, ROSTER_CACHE_META, ROSTER_CACHE_VER, ver);
+    }
+    persist_mark_dirty(roster_store);
+}
+
+void
+roster_cache_reset(void)
+{
+    if (roster_cache == NULL) {
+        return;
+    }
+
+    gchar **groups = g_key_file_get_groups(roster_cache, NULL);
+    int i;
+    for (i = 0; groups[i] != NULL; i++) {
+        g_key_file_remove_group(roster_cache, groups[i], NULL);
+    }
+    g_strfreev(groups);
+    roster_cache_incomplete = FALSE;
+    persist_mark_dirty(roster_store);
+}
+
+static gchar *
+_roster_cache_file(const char * const account)
+{
+    gchar *xdg_data = xdg_get_data_home();
+    GString *dir = g_string_new(xdg_data);
+    g_string_append(dir, "/profanity/roster");
+    g_free(xdg_data);
+
+    if (!mkdir_recursive(dir->str)) {
+        log_error("Could not create roster cache directory %s", dir->str);
+    }
+
+    char *account_file = str_replace(account, "@", "_at_");
+    g_strdelimit(account_file, "/", '_');
+    g_string_append_printf(dir, "/%s.cache", account_file);
+    free(account_file);
+
+    gchar *result = dir->str;
+    g_string_free(dir, FALSE);
+
+    return result;
+}
@@ -0,0 +1,284 @@
+/*
+ * send_queue.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <strophe.h>
+
+#include "log.h"
+#include "xmpp/connection.h"
+#include "xmpp/send_queue.h"
+#include "xmpp/stream_mgmt.h"
+
+// Outgoing stanzas wait here until the main loop flushes them. A stanza
+// queued with a key replaces any pending stanza with the same key, so only
+// the latest chat state or presence for a recipient is written. Stanzas
+// leave in the order they were queued and are paced by a token bucket, so
+// a slow link fills this queue rather than libstrophe's. A high priority
+// stanza is sent on the next flush along with everything queued before
+// it, overdrawing the bucket if need be.
+
+typedef struct send_item_t {
+    char *data;
+    size_t len;
+    char *key;
+    send_priority_t priority;
+} SendItem;
+
+static GQueue *queue;
+// links of the low priority items in queue, oldest first
+static GQueue *low_links;
+static guint high_count;
+static GHashTable *pending_keys;
+static GTimer *refill_timer;
+static gdouble tokens;
+
+static void _item_free(SendItem *item);
+static void _remove_link(GList *link);
+static void _refill(void);
+static GList * _last_high(void);
+
+void
+send_queue_init(void)
+{
+    queue = g_queue_new();
+    low_links = g_queue_new();
+    high_count = 0;
+    pending_keys = g_hash_table_new(g_str_hash, g_str_equal);
+    refill_timer = g_timer_new();
+    tokens = SEND_QUEUE_BURST;
+}
+
+void
+send_queue_close(void)
+{
+    send_queue_clear();
+
+    g_queue_free(queue);
+    queue = NULL;
+    g_queue_free(low_links);
+    low_links = NULL;
+    g_hash_table_destroy(pending_keys);
+    pending_keys = NULL;
+    g_timer_destroy(refill_timer);
+    refill_timer = NULL;
+}
+
+void
+send_queue_raw(const char * const data, const size_t len, send_priority_t priority,
+    const char * const key)
+{
+    if (key) {
+        send_queue_drop(key);
+    }
+
+    SendItem *item = malloc(sizeof(SendItem));
+    item->data = g_strndup(data, len);
+    item->len = len;
+    item->key = key ? strdup(key) : NULL;
+    item->priority = priority;
+
+    g_queue_push_tail(queue, item);
+    GList *link = g_queue_peek_tail_link(queue);
+    if (item->key) {
+        g_hash_table_insert(pending_keys, item->key, link);
+    }
+    if (priority == SEND_PRIORITY_HIGH) {
+        high_count++;
+    } else if (priority == SEND_PRIORITY_LOW) {
+        g_queue_push_tail(low_links, link);
+    }
+
+    // chat states are best effort, do not let them pile up behind a slow link
+    while (g_queue_get_length(low_links) > SEND_QUEUE_MAX_LOW) {
+        _remove_link(g_queue_peek_head(low_links));
+    }
+}
+
+void
+send_queue_stanza(xmpp_stanza_t * const stanza, send_priority_t priority,
+    const char * const key)
+{
+    char *text = NULL;
+    size_t len = 0;
+    if (xmpp_stanza_to_text(stanza, &text, &len) != XMPP_EOK) {
+        log_error("Could not serialise stanza for sending");
+        return;
+    }
+
+    send_queue_raw(text, len, priority, key);
+    xmpp_free(connection_get_ctx(), text);
+}
+
+void
+send_queue_drop(const char * const key)
+{
+    GList *link = g_hash_table_lookup(pending_keys, key);
+    if (link) {
+        _remove_link(link);
+    }
+}
+
+void
+send_queue_flush(gboolean all)
+{
+    xmpp_conn_t *conn = connection_get_conn();
+    if (conn == NULL) {
+        return;
+    }
+
+    _refill();
+
+    // everything up to the newest high priority item goes regardless of tokens
+    GList *forced_until = all ? g_queue_peek_tail_link(queue) : _last_high();
+
+    gboolean counting = stream_mgmt_counting();
+    gboolean sent = FALSE;
+    while (!g_queue_is_empty(queue)) {
+        if (forced_until == NULL && tokens <= 0) {
+            break;
+        }
+
+        GList *link = g_queue_peek_head_link(queue);
+        if (link == forced_until) {
+            forced_until = NULL;
+        }
+
+        // each stanza is written and logged on its own
+        SendItem *item = link->data;
+        connection_send_raw(item->data, item->len);
+        if (counting) {
+            stream_mgmt_sent(item->data, item->len);
+        }
+        tokens -= item->len;
+        sent = TRUE;
+        _remove_link(link);
+    }
+
+    if (sent) {
+        stream_mgmt_request_ack();
+    }
+}
+
+void
+send_queue_clear(void)
+{
+    if (queue) {
+        while (!g_queue_is_empty(queue)) {
+            _remove_link(g_queue_peek_head_link(queue));
+        }
+    }
+}
+
+// removes the queued messages, oldest first, so they can outlive the session
+GSList *
+send_queue_take_messages(void)
+{
+    GSList *result = NULL;
+    if (queue == NULL) {
+        return result;
+    }
+
+    GList *link = g_queue_peek_head_link(queue);
+    while (link) {
+        GList *next = g_list_next(link);
+        SendItem *item = link->data;
+        if (item->len > 8 && strncmp(item->data, "<message", 8) == 0) {
+            result = g_slist_append(result, g_strndup(item->data, item->len));
+            _remove_link(link);
+        }
+        link = next;
+    }
+
+    return result;
+}
+
+guint
+send_queue_length(void)
+{
+    return g_queue_get_length(queue);
+}
+
+static void
+_refill(void)
+{
+    tokens += g_timer_elapsed(refill_timer, NULL) * SEND_QUEUE_RATE;
+    if (tokens > SEND_QUEUE_BURST) {
+        tokens = SEND_QUEUE_BURST;
+    }
+    g_timer_start(refill_timer);
+}
+
+static GList *
+_last_high(void)
+{
+    if (high_count == 0) {
+        return NULL;
+    }
+
+    GList *link = g_queue_peek_tail_link(queue);
+    while (link && ((SendItem*)link->data)->priority != SEND_PRIORITY_HIGH) {
+        link = g_list_previous(link);
+    }
+
+    return link;
+}
+
+static void
+_remove_link(GList *link)
+{
+    SendItem *item = link->data;
+    if (item->key) {
+        g_hash_table_remove(pending_keys, item->key);
+    }
+    if (item->priority == SEND_PRIORITY_HIGH) {
+        high_count--;
+    } else if (item->priority == SEND_PRIORITY_LOW) {
+        g_queue_remove(low_links, link);
+    }
+    g_queue_delete_link(queue, link);
+    _item_free(item);
+}
+
+static void
+_item_free(SendItem *item)
+{
+    if (item) {
+        g_free(item->data);
+        free(item->key);
+        free(item);
+    }
+}
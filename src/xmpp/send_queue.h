@@ -0,0 +1,68 @@
+/*
+ * send_queue.h
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#ifndef XMPP_SEND_QUEUE_H
+#define XMPP_SEND_QUEUE_H
+
+#include <glib.h>
+#include <strophe.h>
+
+// sustained bytes per second written to the connection, and the burst allowed
+#define SEND_QUEUE_RATE 32768
+#define SEND_QUEUE_BURST 65536
+
+// low priority stanzas beyond this are dropped oldest first
+#define SEND_QUEUE_MAX_LOW 256
+
+typedef enum {
+    SEND_PRIORITY_HIGH,
+    SEND_PRIORITY_NORMAL,
+    SEND_PRIORITY_LOW
+} send_priority_t;
+
+void send_queue_init(void);
+void send_queue_close(void);
+
+void send_queue_raw(const char * const data, const size_t len, send_priority_t priority,
+    const char * const key);
+void send_queue_stanza(xmpp_stanza_t * const stanza, send_priority_t priority,
+    const char * const key);
+void send_queue_drop(const char * const key);
+
+void send_queue_flush(gboolean all);
+void send_queue_clear(void);
+GSList * send_queue_take_messages(void);
+guint send_queue_length(void);
+
+#endif
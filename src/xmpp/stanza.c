@@ -47,6 +47,8 @@
 
 #include "muc.h"
 
+static int _stanza_idle_seconds(xmpp_stanza_t * const query);
+
 #if 0
 xmpp_stanza_t *
 stanza_create_bookmarks_pubsub_request(xmpp_ctx_t *ctx)
@@ -236,28 +238,6 @@ stanza_disable_carbons(xmpp_ctx_t *ctx){
     return iq;
 }
 
-xmpp_stanza_t *
-stanza_create_chat_state(xmpp_ctx_t *ctx, const char * const fulljid, const char * const state)
-{
-    xmpp_stanza_t *msg, *chat_state;
-
-    msg = xmpp_stanza_new(ctx);
-    xmpp_stanza_set_name(msg, STANZA_NAME_MESSAGE);
-    xmpp_stanza_set_type(msg, STANZA_TYPE_CHAT);
-    xmpp_stanza_set_attribute(msg, STANZA_ATTR_TO, fulljid);
-    char *id = create_unique_id(NULL);
-    xmpp_stanza_set_id(msg, id);
-    free(id);
-
-    chat_state = xmpp_stanza_new(ctx);
-    xmpp_stanza_set_name(chat_state, state);
-    xmpp_stanza_set_ns(chat_state, STANZA_NS_CHATSTATES);
-    xmpp_stanza_add_child(msg, chat_state);
-    xmpp_stanza_release(chat_state);
-
-    return msg;
-}
-
 xmpp_stanza_t *
 stanza_create_room_subject_message(xmpp_ctx_t *ctx, const char * const room, const char * const subject)
 {
@@ -281,50 +261,6 @@ stanza_create_room_subject_message(xmpp_ctx_t *ctx, const char * const room, con
     return msg;
 }
 
-xmpp_stanza_t *
-stanza_create_message(xmpp_ctx_t *ctx, const char * const recipient,
-    const char * const type, const char * const message,
-    const char * const state, gboolean encrypted)
-{
-    xmpp_stanza_t *msg, *body, *text;
-
-    msg = xmpp_stanza_new(ctx);
-    xmpp_stanza_set_name(msg, STANZA_NAME_MESSAGE);
-    xmpp_stanza_set_type(msg, type);
-    xmpp_stanza_set_attribute(msg, STANZA_ATTR_TO, recipient);
-    char *id = create_unique_id(NULL);
-    xmpp_stanza_set_id(msg, id);
-    free(id);
-
-    body = xmpp_stanza_new(ctx);
-    xmpp_stanza_set_name(body, STANZA_NAME_BODY);
-
-    text = xmpp_stanza_new(ctx);
-    xmpp_stanza_set_text(text, message);
-    xmpp_stanza_add_child(body, text);
-    xmpp_stanza_release(text);
-    xmpp_stanza_add_child(msg, body);
-    xmpp_stanza_release(body);
-
-    if (state != NULL) {
-        xmpp_stanza_t *chat_state = xmpp_stanza_new(ctx);
-        xmpp_stanza_set_name(chat_state, state);
-        xmpp_stanza_set_ns(chat_state, STANZA_NS_CHATSTATES);
-        xmpp_stanza_add_child(msg, chat_state);
-        xmpp_stanza_release(chat_state);
-    }
-
-    if (encrypted) {
-        xmpp_stanza_t *private_carbon = xmpp_stanza_new(ctx);
-        xmpp_stanza_set_name(private_carbon, "private");
-        xmpp_stanza_set_ns(private_carbon, STANZA_NS_CARBONS);
-        xmpp_stanza_add_child(msg, private_carbon);
-        xmpp_stanza_release(private_carbon);
-    }
-
-    return msg;
-}
-
 xmpp_stanza_t *
 stanza_create_roster_remove_set(xmpp_ctx_t *ctx, const char * const barejid)
 {
@@ -425,7 +361,8 @@ stanza_create_invite(xmpp_ctx_t *ctx, const char * const room,
 
 xmpp_stanza_t *
 stanza_create_room_join_presence(xmpp_ctx_t * const ctx,
-    const char * const full_room_jid, const char * const passwd)
+    const char * const full_room_jid, const char * const passwd,
+    const char * const since)
 {
     xmpp_stanza_t *presence = xmpp_stanza_new(ctx);
     xmpp_stanza_set_name(presence, STANZA_NAME_PRESENCE);
@@ -450,6 +387,15 @@ stanza_create_room_join_presence(xmpp_ctx_t * const ctx,
         xmpp_stanza_release(pass);
     }
 
+    // only ask for history after the last message already seen
+    if (since != NULL) {
+        xmpp_stanza_t *history = xmpp_stanza_new(ctx);
+        xmpp_stanza_set_name(history, STANZA_NAME_HISTORY);
+        xmpp_stanza_set_attribute(history, STANZA_ATTR_SINCE, since);
+        xmpp_stanza_add_child(x, history);
+        xmpp_stanza_release(history);
+    }
+
     xmpp_stanza_add_child(presence, x);
     xmpp_stanza_release(x);
 
@@ -956,39 +902,30 @@ stanza_get_delay(xmpp_stanza_t * const stanza, GTimeVal *tv_stamp)
 char *
 stanza_get_status(xmpp_stanza_t *stanza, char *def)
 {
-    xmpp_ctx_t *ctx = connection_get_ctx();
     xmpp_stanza_t *status =
         xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_STATUS);
 
-    if (status != NULL) {
-        // xmpp_free and free may be different functions so convert all to
-        // libc malloc
-        char *s1, *s2 = NULL;
-        s1 = xmpp_stanza_get_text(status);
-        if (s1 != NULL) {
-            s2 = strdup(s1);
-            xmpp_free(ctx, s1);
-        }
-        return s2;
-    } else if (def != NULL) {
-        return strdup(def);
-    } else {
-        return NULL;
-    }
+    return stanza_get_text_or(status, def);
 }
 
 char *
 stanza_get_show(xmpp_stanza_t *stanza, char *def)
 {
-    xmpp_ctx_t *ctx = connection_get_ctx();
     xmpp_stanza_t *show =
         xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_SHOW);
 
-    if (show != NULL) {
+    return stanza_get_text_or(show, def);
+}
+
+char *
+stanza_get_text_or(xmpp_stanza_t *child, char *def)
+{
+    if (child != NULL) {
         // xmpp_free and free may be different functions so convert all to
         // libc malloc
+        xmpp_ctx_t *ctx = connection_get_ctx();
         char *s1, *s2 = NULL;
-        s1 = xmpp_stanza_get_text(show);
+        s1 = xmpp_stanza_get_text(child);
         if (s1 != NULL) {
             s2 = strdup(s1);
             xmpp_free(ctx, s1);
@@ -1345,17 +1282,7 @@ stanza_get_idle_time(xmpp_stanza_t * const stanza)
         return 0;
     }
 
-    char *seconds_str = xmpp_stanza_get_attribute(query, STANZA_ATTR_SECONDS);
-    if (seconds_str == NULL) {
-        return 0;
-    }
-
-    int result = atoi(seconds_str);
-    if (result < 1) {
-        return 0;
-    } else {
-        return result;
-    }
+    return _stanza_idle_seconds(query);
 }
 
 XMPPCaps*
@@ -1372,6 +1299,16 @@ stanza_parse_caps(xmpp_stanza_t * const stanza)
         return NULL;
     }
 
+    return stanza_parse_caps_child(caps_st);
+}
+
+XMPPCaps*
+stanza_parse_caps_child(xmpp_stanza_t * const caps_st)
+{
+    if (!caps_st) {
+        return NULL;
+    }
+
     char *hash = xmpp_stanza_get_attribute(caps_st, STANZA_ATTR_HASH);
     char *node = xmpp_stanza_get_attribute(caps_st, STANZA_ATTR_NODE);
     char *ver = xmpp_stanza_get_attribute(caps_st, STANZA_ATTR_VER);
@@ -1636,13 +1573,73 @@ stanza_free_presence(XMPPPresence *presence)
 XMPPPresence *
 stanza_parse_presence(xmpp_stanza_t *stanza, int *err)
 {
-    char *from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
-    if (!from) {
+    XMPPPresenceParts parts;
+    stanza_get_presence_parts(stanza, &parts);
+
+    return stanza_parse_presence_parts(&parts, err);
+}
+
+void
+stanza_get_presence_parts(xmpp_stanza_t * const stanza, XMPPPresenceParts *parts)
+{
+    memset(parts, 0, sizeof(XMPPPresenceParts));
+    parts->type = xmpp_stanza_get_type(stanza);
+    parts->from = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_FROM);
+
+    // first child of each kind wins, as with xmpp_stanza_get_child_by_name
+    xmpp_stanza_t *child = xmpp_stanza_get_children(stanza);
+    for (; child != NULL; child = xmpp_stanza_get_next(child)) {
+        char *name = xmpp_stanza_get_name(child);
+        if (name == NULL) {
+            continue;
+        }
+        char *ns = xmpp_stanza_get_ns(child);
+
+        if (g_strcmp0(ns, STANZA_NS_MUC_USER) == 0) {
+            if (!parts->muc_user) {
+                parts->muc_user = child;
+            }
+        } else if (strcmp(name, STANZA_NAME_SHOW) == 0) {
+            if (!parts->show) {
+                parts->show = child;
+            }
+        } else if (strcmp(name, STANZA_NAME_STATUS) == 0) {
+            if (!parts->status) {
+                parts->status = child;
+            }
+        } else if (strcmp(name, STANZA_NAME_PRIORITY) == 0) {
+            if (!parts->priority) {
+                parts->priority = child;
+            }
+        } else if (strcmp(name, STANZA_NAME_ERROR) == 0) {
+            if (!parts->error) {
+                parts->error = child;
+            }
+        } else if (strcmp(name, STANZA_NAME_X) == 0) {
+            if (!parts->muc && g_strcmp0(ns, STANZA_NS_MUC) == 0) {
+                parts->muc = child;
+            }
+        } else if (strcmp(name, STANZA_NAME_C) == 0) {
+            if (!parts->caps && g_strcmp0(ns, STANZA_NS_CAPS) == 0) {
+                parts->caps = child;
+            }
+        } else if (strcmp(name, STANZA_NAME_QUERY) == 0) {
+            if (!parts->last_activity && g_strcmp0(ns, STANZA_NS_LASTACTIVITY) == 0) {
+                parts->last_activity = child;
+            }
+        }
+    }
+}
+
+XMPPPresence *
+stanza_parse_presence_parts(XMPPPresenceParts *parts, int *err)
+{
+    if (!parts->from) {
         *err = STANZA_PARSE_ERROR_NO_FROM;
         return NULL;
     }
 
-    Jid *from_jid = jid_create(from);
+    Jid *from_jid = jid_create(parts->from);
     if (!from_jid) {
         *err = STANZA_PARSE_ERROR_INVALID_FROM;
         return NULL;
@@ -1651,10 +1648,13 @@ stanza_parse_presence(xmpp_stanza_t *stanza, int *err)
     XMPPPresence *result = (XMPPPresence *)malloc(sizeof(XMPPPresence));
     result->jid = from_jid;
 
-    result->show = stanza_get_show(stanza, "online");
-    result->status = stanza_get_status(stanza, NULL);
+    result->show = stanza_get_text_or(parts->show, "online");
+    result->status = stanza_get_text_or(parts->status, NULL);
 
-    int idle_seconds = stanza_get_idle_time(stanza);
+    int idle_seconds = 0;
+    if (parts->last_activity) {
+        idle_seconds = _stanza_idle_seconds(parts->last_activity);
+    }
     if (idle_seconds > 0) {
         GDateTime *now = g_date_time_new_now_local();
         result->last_activity = g_date_time_add_seconds(now, 0 - idle_seconds);
@@ -1664,9 +1664,8 @@ stanza_parse_presence(xmpp_stanza_t *stanza, int *err)
     }
 
     result->priority = 0;
-    xmpp_stanza_t *priority_stanza = xmpp_stanza_get_child_by_name(stanza, STANZA_NAME_PRIORITY);
-    if (priority_stanza != NULL) {
-        char *priority_str = xmpp_stanza_get_text(priority_stanza);
+    if (parts->priority != NULL) {
+        char *priority_str = xmpp_stanza_get_text(parts->priority);
         if (priority_str != NULL) {
             result->priority = atoi(priority_str);
         }
@@ -1675,3 +1674,19 @@ stanza_parse_presence(xmpp_stanza_t *stanza, int *err)
 
     return result;
 }
+
+static int
+_stanza_idle_seconds(xmpp_stanza_t * const query)
+{
+    char *seconds_str = xmpp_stanza_get_attribute(query, STANZA_ATTR_SECONDS);
+    if (seconds_str == NULL) {
+        return 0;
+    }
+
+    int result = atoi(seconds_str);
+    if (result < 1) {
+        return 0;
+    } else {
+        return result;
+    }
+}
@@ -78,6 +78,7 @@
 #define STANZA_NAME_DESTROY "destroy"
 #define STANZA_NAME_ACTOR "actor"
 #define STANZA_NAME_ENABLE "enable"
+#define STANZA_NAME_HISTORY "history"
 #define STANZA_NAME_DISABLE "disable"
 
 // error conditions
@@ -135,6 +136,8 @@
 #define STANZA_ATTR_CATEGORY "category"
 #define STANZA_ATTR_REASON "reason"
 #define STANZA_ATTR_AUTOJOIN "autojoin"
+#define STANZA_ATTR_H "h"
+#define STANZA_ATTR_SINCE "since"
 
 #define STANZA_TEXT_AWAY "away"
 #define STANZA_TEXT_DND "dnd"
@@ -158,6 +161,8 @@
 #define STANZA_NS_PUBSUB "http://jabber.org/protocol/pubsub"
 #define STANZA_NS_CARBONS "urn:xmpp:carbons:2"
 #define STANZA_NS_FORWARD "urn:xmpp:forward:0"
+#define STANZA_NS_SM "urn:xmpp:sm:3"
+#define STANZA_NS_CSI "urn:xmpp:csi:0"
 
 #define STANZA_DATAFORM_SOFTWARE "urn:xmpp:dataforms:softwareinfo"
 
@@ -175,6 +180,20 @@ typedef struct presence_stanza_t {
     GDateTime *last_activity;
 } XMPPPresence;
 
+// children of a presence stanza, collected in a single walk
+typedef struct presence_parts_t {
+    char *type;
+    char *from;
+    xmpp_stanza_t *show;
+    xmpp_stanza_t *status;
+    xmpp_stanza_t *priority;
+    xmpp_stanza_t *error;
+    xmpp_stanza_t *muc;
+    xmpp_stanza_t *muc_user;
+    xmpp_stanza_t *caps;
+    xmpp_stanza_t *last_activity;
+} XMPPPresenceParts;
+
 typedef enum {
     STANZA_PARSE_ERROR_NO_FROM,
     STANZA_PARSE_ERROR_INVALID_FROM
@@ -186,15 +205,9 @@ xmpp_stanza_t * stanza_enable_carbons(xmpp_ctx_t *ctx);
 
 xmpp_stanza_t * stanza_disable_carbons(xmpp_ctx_t *ctx);
 
-xmpp_stanza_t* stanza_create_chat_state(xmpp_ctx_t *ctx,
-    const char * const fulljid, const char * const state);
-
-xmpp_stanza_t* stanza_create_message(xmpp_ctx_t *ctx,
-    const char * const recipient, const char * const type,
-    const char * const message, const char * const state, gboolean encrypted);
-
 xmpp_stanza_t* stanza_create_room_join_presence(xmpp_ctx_t * const ctx,
-    const char * const full_room_jid, const char * const passwd);
+    const char * const full_room_jid, const char * const passwd,
+    const char * const since);
 
 xmpp_stanza_t* stanza_create_room_newnick_presence(xmpp_ctx_t *ctx,
     const char * const full_room_jid);
@@ -268,6 +281,7 @@ xmpp_stanza_t * stanza_create_disco_items_iq(xmpp_ctx_t *ctx, const char * const
 
 char * stanza_get_status(xmpp_stanza_t *stanza, char *def);
 char * stanza_get_show(xmpp_stanza_t *stanza, char *def);
+char * stanza_get_text_or(xmpp_stanza_t *child, char *def);
 
 xmpp_stanza_t * stanza_create_roster_set(xmpp_ctx_t *ctx, const char * const id,
     const char * const jid, const char * const handle, GSList *groups);
@@ -286,9 +300,12 @@ char* stanza_get_reason(xmpp_stanza_t *stanza);
 
 Resource* stanza_resource_from_presence(XMPPPresence *presence);
 XMPPPresence* stanza_parse_presence(xmpp_stanza_t *stanza, int *err);
+void stanza_get_presence_parts(xmpp_stanza_t * const stanza, XMPPPresenceParts *parts);
+XMPPPresence* stanza_parse_presence_parts(XMPPPresenceParts *parts, int *err);
 void stanza_free_presence(XMPPPresence *presence);
 
 XMPPCaps* stanza_parse_caps(xmpp_stanza_t * const stanza);
+XMPPCaps* stanza_parse_caps_child(xmpp_stanza_t * const caps_st);
 void stanza_free_caps(XMPPCaps *caps);
 
 #endif
@@ -0,0 +1,150 @@
+/*
+ * stanza_writer.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "xmpp/stanza.h"
+#include "xmpp/stanza_writer.h"
+
+// Serialises the most frequent outgoing stanzas straight into a buffer,
+// the fixed parts of each stanza are string literals so only the escaped
+// values are copied per send.
+
+#define TMPL_MESSAGE_OPEN "<" STANZA_NAME_MESSAGE " " STANZA_ATTR_TYPE "=\""
+#define TMPL_ATTR_TO "\" " STANZA_ATTR_TO "=\""
+#define TMPL_ATTR_ID "\" " STANZA_ATTR_ID "=\""
+#define TMPL_BODY_OPEN "\"><" STANZA_NAME_BODY ">"
+#define TMPL_BODY_CLOSE "</" STANZA_NAME_BODY ">"
+#define TMPL_STATE_NS " xmlns=\"" STANZA_NS_CHATSTATES "\"/>"
+#define TMPL_PRIVATE "<private xmlns=\"" STANZA_NS_CARBONS "\"/>"
+#define TMPL_MESSAGE_CLOSE "</" STANZA_NAME_MESSAGE ">"
+
+#define APPEND_LITERAL(buf, lit) g_string_append_len(buf, lit, sizeof(lit) - 1)
+
+static void _append_state(GString *buf, const char * const state);
+
+void
+stanza_writer_append_escaped(GString *buf, const char * const str, gboolean attr)
+{
+    if (str == NULL) {
+        return;
+    }
+
+    // copy runs of plain characters in one go
+    const char *run = str;
+    const char *curr = str;
+    for (; *curr != '\0'; curr++) {
+        const char *entity = NULL;
+        switch (*curr) {
+            case '&':
+                entity = "&amp;";
+                break;
+            case '<':
+                entity = "&lt;";
+                break;
+            case '>':
+                entity = "&gt;";
+                break;
+            case '"':
+                entity = attr ? "&quot;" : NULL;
+                break;
+            case '\'':
+                entity = attr ? "&apos;" : NULL;
+                break;
+            default:
+                break;
+        }
+
+        if (entity) {
+            g_string_append_len(buf, run, curr - run);
+            g_string_append(buf, entity);
+            run = curr + 1;
+        }
+    }
+    g_string_append_len(buf, run, curr - run);
+}
+
+void
+stanza_write_message(GString *buf, const char * const id,
+    const char * const recipient, const char * const type,
+    const char * const message, const char * const state, gboolean encrypted)
+{
+    APPEND_LITERAL(buf, TMPL_MESSAGE_OPEN);
+    stanza_writer_append_escaped(buf, type, TRUE);
+    APPEND_LITERAL(buf, TMPL_ATTR_TO);
+    stanza_writer_append_escaped(buf, recipient, TRUE);
+    APPEND_LITERAL(buf, TMPL_ATTR_ID);
+    stanza_writer_append_escaped(buf, id, TRUE);
+    APPEND_LITERAL(buf, TMPL_BODY_OPEN);
+    stanza_writer_append_escaped(buf, message, FALSE);
+    APPEND_LITERAL(buf, TMPL_BODY_CLOSE);
+
+    if (state != NULL) {
+        _append_state(buf, state);
+    }
+
+    if (encrypted) {
+        APPEND_LITERAL(buf, TMPL_PRIVATE);
+    }
+
+    APPEND_LITERAL(buf, TMPL_MESSAGE_CLOSE);
+}
+
+void
+stanza_write_chat_state(GString *buf, const char * const id,
+    const char * const fulljid, const char * const state)
+{
+    APPEND_LITERAL(buf, TMPL_MESSAGE_OPEN);
+    APPEND_LITERAL(buf, STANZA_TYPE_CHAT);
+    APPEND_LITERAL(buf, TMPL_ATTR_TO);
+    stanza_writer_append_escaped(buf, fulljid, TRUE);
+    APPEND_LITERAL(buf, TMPL_ATTR_ID);
+    stanza_writer_append_escaped(buf, id, TRUE);
+    g_string_append_c(buf, '"');
+    g_string_append_c(buf, '>');
+    _append_state(buf, state);
+    APPEND_LITERAL(buf, TMPL_MESSAGE_CLOSE);
+}
+
+static void
+_append_state(GString *buf, const char * const state)
+{
+    // chat state names are fixed element names, never user input
+    g_string_append_c(buf, '<');
+    g_string_append(buf, state);
+    APPEND_LITERAL(buf, TMPL_STATE_NS);
+}
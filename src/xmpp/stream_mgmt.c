@@ -0,0 +1,400 @@
+/*
+ * stream_mgmt.c
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <strophe.h>
+
+#include "log.h"
+#include "config/preferences.h"
+#include "xmpp/connection.h"
+#include "xmpp/send_queue.h"
+#include "xmpp/stanza.h"
+#include "xmpp/stream_mgmt.h"
+
+// XEP-0198 acknowledgements. libstrophe binds the resource itself during
+// login, so a <resume/> can never be sent in its place. Instead, when the
+// link drops, messages are sent again once the reconnect has completed:
+// those still in the send queue, and with /sm on those the server has not
+// acknowledged. An unacknowledged message may still have been delivered,
+// so it can arrive twice, it keeps its id so clients can spot the copy.
+// OTR messages are never sent again, they would be replays.
+
+#define HANDLE(name, func) xmpp_handler_add(conn, func, STANZA_NS_SM, name, NULL, ctx)
+
+typedef struct sm_item_t {
+    guint32 seq;
+    char *data;
+    size_t len;
+} SmItem;
+
+static gboolean requested;
+static gboolean enabled;
+static gboolean ack_pending;
+static guint32 handled_in;
+static guint32 sent_out;
+static guint32 acked_out;
+
+// messages written since <enable/> that the server has not acknowledged
+static GQueue *unacked;
+
+// messages the last session may not have delivered, sent after reconnect
+static GQueue *resend;
+
+static int _inbound_handler(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata);
+static int _enabled_handler(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata);
+static int _failed_handler(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata);
+static int _request_handler(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata);
+static int _ack_handler(xmpp_conn_t * const conn,
+    xmpp_stanza_t * const stanza, void * const userdata);
+static void _send(const char * const format, ...);
+static gboolean _resendable(const char * const data, const size_t len);
+static void _item_free(SmItem *item);
+
+void
+stream_mgmt_init(void)
+{
+    unacked = g_queue_new();
+    resend = g_queue_new();
+}
+
+void
+stream_mgmt_close(void)
+{
+    stream_mgmt_clear();
+    g_queue_free(unacked);
+    unacked = NULL;
+    g_queue_free(resend);
+    resend = NULL;
+}
+
+void
+stream_mgmt_start(void)
+{
+    xmpp_conn_t * const conn = connection_get_conn();
+    xmpp_ctx_t * const ctx = connection_get_ctx();
+
+    xmpp_handler_add(conn, _inbound_handler, NULL, NULL, NULL, ctx);
+    HANDLE("enabled", _enabled_handler);
+    HANDLE("failed",  _failed_handler);
+    HANDLE("r",       _request_handler);
+    HANDLE("a",       _ack_handler);
+
+    if (prefs_get_boolean(PREF_SM)) {
+        stream_mgmt_enable();
+    }
+
+    stream_mgmt_resend();
+}
+
+// no resumption, so hand anything the old session lost to the new one
+void
+stream_mgmt_resend(void)
+{
+    if (g_queue_is_empty(resend)) {
+        return;
+    }
+
+    log_info("Resending %d messages from the last session", g_queue_get_length(resend));
+    while (!g_queue_is_empty(resend)) {
+        SmItem *item = g_queue_pop_head(resend);
+        send_queue_raw(item->data, item->len, SEND_PRIORITY_NORMAL, NULL);
+        _item_free(item);
+    }
+}
+
+void
+stream_mgmt_enable(void)
+{
+    if (requested) {
+        return;
+    }
+
+    log_debug("Enabling stream management");
+
+    // both outbound counters start when <enable/> is sent
+    requested = TRUE;
+    sent_out = 0;
+    acked_out = 0;
+    ack_pending = FALSE;
+    _send("<enable xmlns='%s'/>", STANZA_NS_SM);
+}
+
+gboolean
+stream_mgmt_counting(void)
+{
+    return requested;
+}
+
+void
+stream_mgmt_sent(const char * const data, const size_t len)
+{
+    sent_out++;
+
+    // only messages are worth sending again, iq ids and presence go stale
+    if (_resendable(data, len)) {
+        SmItem *item = malloc(sizeof(SmItem));
+        item->seq = sent_out;
+        item->data = g_strndup(data, len);
+        item->len = len;
+        g_queue_push_tail(unacked, item);
+    }
+}
+
+void
+stream_mgmt_request_ack(void)
+{
+    if (!enabled || ack_pending || sent_out == acked_out) {
+        return;
+    }
+
+    ack_pending = TRUE;
+    _send("<r xmlns='%s'/>", STANZA_NS_SM);
+}
+
+// must be called before the send queue is cleared, messages still queued
+// were never written and follow the unacknowledged ones
+void
+stream_mgmt_session_lost(void)
+{
+    while (!g_queue_is_empty(unacked)) {
+        g_queue_push_tail(resend, g_queue_pop_head(unacked));
+    }
+
+    GSList *queued = send_queue_take_messages();
+    GSList *curr = queued;
+    while (curr) {
+        size_t len = strlen(curr->data);
+        if (_resendable(curr->data, len)) {
+            SmItem *item = malloc(sizeof(SmItem));
+            item->seq = 0;
+            item->data = curr->data;
+            item->len = len;
+            g_queue_push_tail(resend, item);
+        } else {
+            g_free(curr->data);
+        }
+        curr = g_slist_next(curr);
+    }
+    g_slist_free(queued);
+
+    stream_mgmt_reset();
+}
+
+guint
+stream_mgmt_unacked_count(void)
+{
+    return g_queue_get_length(unacked);
+}
+
+guint
+stream_mgmt_resend_count(void)
+{
+    return g_queue_get_length(resend);
+}
+
+// TRUE when an ack of h covers outbound stanza seq, both wrap at 2^32
+gboolean
+stream_mgmt_seq_acked(const guint32 seq, const guint32 h)
+{
+    return (gint32)(seq - h) <= 0;
+}
+
+void
+stream_mgmt_handle_enabled(void)
+{
+    log_info("Stream management enabled");
+
+    // the inbound counter starts when <enabled/> is received
+    enabled = TRUE;
+    handled_in = 0;
+    stream_mgmt_request_ack();
+}
+
+void
+stream_mgmt_handle_inbound(const char * const name)
+{
+    if (!enabled) {
+        return;
+    }
+
+    if ((g_strcmp0(name, STANZA_NAME_MESSAGE) == 0) ||
+            (g_strcmp0(name, STANZA_NAME_PRESENCE) == 0) ||
+            (g_strcmp0(name, STANZA_NAME_IQ) == 0)) {
+        handled_in++;
+    }
+}
+
+void
+stream_mgmt_handle_request(void)
+{
+    if (enabled) {
+        _send("<a xmlns='%s' h='%u'/>", STANZA_NS_SM, handled_in);
+    }
+}
+
+void
+stream_mgmt_handle_ack(const guint32 h)
+{
+    ack_pending = FALSE;
+    acked_out = h;
+
+    while (!g_queue_is_empty(unacked)) {
+        SmItem *item = g_queue_peek_head(unacked);
+        if (!stream_mgmt_seq_acked(item->seq, h)) {
+            break;
+        }
+        _item_free(g_queue_pop_head(unacked));
+    }
+}
+
+void
+stream_mgmt_reset(void)
+{
+    requested = FALSE;
+    enabled = FALSE;
+    ack_pending = FALSE;
+    handled_in = 0;
+    sent_out = 0;
+    acked_out = 0;
+
+    if (unacked) {
+        g_queue_foreach(unacked, (GFunc)_item_free, NULL);
+        g_queue_clear(unacked);
+    }
+}
+
+void
+stream_mgmt_clear(void)
+{
+    stream_mgmt_reset();
+
+    if (resend) {
+        g_queue_foreach(resend, (GFunc)_item_free, NULL);
+        g_queue_clear(resend);
+    }
+}
+
+static int
+_inbound_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
+    void * const userdata)
+{
+    stream_mgmt_handle_inbound(xmpp_stanza_get_name(stanza));
+
+    return 1;
+}
+
+static int
+_enabled_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
+    void * const userdata)
+{
+    stream_mgmt_handle_enabled();
+
+    return 1;
+}
+
+static int
+_failed_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
+    void * const userdata)
+{
+    log_warning("Server refused to enable stream management");
+    stream_mgmt_reset();
+
+    return 1;
+}
+
+static int
+_request_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
+    void * const userdata)
+{
+    stream_mgmt_handle_request();
+
+    return 1;
+}
+
+static int
+_ack_handler(xmpp_conn_t * const conn, xmpp_stanza_t * const stanza,
+    void * const userdata)
+{
+    char *h_str = xmpp_stanza_get_attribute(stanza, STANZA_ATTR_H);
+    if (h_str == NULL) {
+        return 1;
+    }
+
+    stream_mgmt_handle_ack(strtoul(h_str, NULL, 10));
+
+    return 1;
+}
+
+static void
+_send(const char * const format, ...)
+{
+    va_list arg;
+    va_start(arg, format);
+    char *data = g_strdup_vprintf(format, arg);
+    va_end(arg);
+
+    connection_send_raw(data, strlen(data));
+    g_free(data);
+}
+
+// chat states and OTR messages are not worth, or not safe, sending twice
+static gboolean
+_resendable(const char * const data, const size_t len)
+{
+    if (len <= 8 || strncmp(data, "<message", 8) != 0) {
+        return FALSE;
+    }
+    if (g_strstr_len(data, len, "<body>") == NULL) {
+        return FALSE;
+    }
+
+    return g_strstr_len(data, len, "<body>?OTR") == NULL;
+}
+
+static void
+_item_free(SmItem *item)
+{
+    if (item) {
+        g_free(item->data);
+        free(item);
+    }
+}
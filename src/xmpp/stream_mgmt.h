@@ -0,0 +1,62 @@
+/*
+ * stream_mgmt.h
+ *
+ * Copyright (C) 2012 - 2015 James Booth <boothj5@gmail.com>
+ *
+ * This file is part of Profanity.
+ *
+ * Profanity is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Profanity is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Profanity.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give permission to
+ * link the code of portions of this program with the OpenSSL library under
+ * certain conditions as described in each individual source file, and
+ * distribute linked combinations including the two.
+ *
+ * You must obey the GNU General Public License in all respects for all of the
+ * code used other than OpenSSL. If you modify file(s) with this exception, you
+ * may extend this exception to your version of the file(s), but you are not
+ * obligated to do so. If you do not wish to do so, delete this exception
+ * statement from your version. If you delete this exception statement from all
+ * source files in the program, then also delete it here.
+ *
+ */
+
+#ifndef XMPP_STREAM_MGMT_H
+#define XMPP_STREAM_MGMT_H
+
+#include <glib.h>
+
+void stream_mgmt_init(void);
+void stream_mgmt_close(void);
+
+void stream_mgmt_start(void);
+void stream_mgmt_enable(void);
+gboolean stream_mgmt_counting(void);
+void stream_mgmt_sent(const char * const data, const size_t len);
+void stream_mgmt_request_ack(void);
+
+void stream_mgmt_handle_enabled(void);
+void stream_mgmt_handle_inbound(const char * const name);
+void stream_mgmt_handle_request(void);
+void stream_mgmt_handle_ack(const guint32 h);
+gboolean stream_mgmt_seq_acked(const guint32 seq, const guint32 h);
+
+void stream_mgmt_session_lost(void);
+void stream_mgmt_resend(void);
+guint stream_mgmt_unacked_count(void);
+guint stream_mgmt_resend_count(void);
+void stream_mgmt_reset(void);
+void stream_mgmt_clear(void);
+
+#endif
@@ -65,7 +65,9 @@ typedef enum {
     INVITE_MEDIATED
 } jabber_invite_t;
 
+// shared between lookups, treat as read only and release with caps_destroy
 typedef struct capabilities_t {
+    int refs;
     char *category;
     char *type;
     char *name;
@@ -87,6 +89,15 @@ typedef struct disco_identity_t {
     char *category;
 } DiscoIdentity;
 
+// bytes of XML and, when estimating, bytes zlib would send for them
+typedef struct traffic_stats_t {
+    guint64 logical_out;
+    guint64 logical_in;
+    guint64 deflated_out;
+    guint64 deflated_in;
+    gboolean estimating;
+} TrafficStats;
+
 typedef enum {
     FIELD_HIDDEN,
     FIELD_TEXT_SINGLE,
@@ -143,6 +154,10 @@ jabber_conn_status_t jabber_get_connection_status(void);
 char * jabber_get_presence_message(void);
 char* jabber_get_account_name(void);
 GList * jabber_get_available_resources(void);
+void jabber_enable_stream_management(void);
+void jabber_set_client_active(gboolean active);
+void jabber_capture_stanzas(gboolean capture);
+void jabber_get_traffic_stats(TrafficStats *stats);
 
 // message functions
 void message_send_chat(const char * const barejid, const char * const msg);
@@ -213,6 +228,7 @@ gboolean bookmark_join(const char *jid);
 const GList * bookmark_get_list(void);
 char * bookmark_find(const char * const search_str);
 void bookmark_autocomplete_reset(void);
+void bookmark_autojoin_complete(const char * const room);
 
 void roster_send_name_change(const char * const barejid, const char * const new_name, GSList *groups);
 void roster_send_add_to_group(const char * const group, PContact contact);
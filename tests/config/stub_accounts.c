@@ -134,6 +134,17 @@ resource_presence_t accounts_get_login_presence(const char * const account_name)
     return RESOURCE_ONLINE;
 }
 
+void accounts_set_compression_estimate(const char * const account_name, gboolean value)
+{
+    check_expected(account_name);
+    check_expected(value);
+}
+
+gboolean accounts_get_compression_estimate(const char * const account_name)
+{
+    return FALSE;
+}
+
 resource_presence_t accounts_get_last_presence(const char * const account_name)
 {
     check_expected(account_name);
@@ -1,5 +1,10 @@
 #include "glib.h"
 
+void create_config_dir(void **state);
+void remove_config_dir(void **state);
+void create_data_dir(void **state);
+void remove_data_dir(void **state);
+
 void load_preferences(void **state);
 void close_preferences(void **state);
 
@@ -52,6 +52,7 @@ log_level_t log_level_from_string(char *log_level)
 void chat_log_init(void) {}
 void chat_log_chat(const gchar * const login, gchar *other,
     const gchar * const msg, chat_log_direction_t direction, GTimeVal *tv_stamp) {}
+void chat_log_tick(void) {}
 void chat_log_close(void) {}
 GSList * chat_log_get_previous(const gchar * const login,
     const gchar * const recipient)
@@ -60,5 +61,10 @@ GSList * chat_log_get_previous(const gchar * const login,
 }
 
 void groupchat_log_init(void) {}
+GDateTime * groupchat_log_get_last_time(const gchar * const login,
+    const gchar * const room)
+{
+    return NULL;
+}
 void groupchat_log_chat(const gchar * const login, const gchar * const room,
-    const gchar * const nick, const gchar * const msg) {}
+    const gchar * const nick, const gchar * const msg, GTimeVal *tv_stamp) {}
@@ -0,0 +1,74 @@
+/* SHA-1 micro-benchmark, build with make tests/sha1bench */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tools/p_sha1.h"
+
+#define LARGE_SIZE (1024 * 1024)
+#define LARGE_ROUNDS 64
+/* about the size of a disco#info verification string */
+#define SMALL_SIZE 400
+#define SMALL_ROUNDS 100000
+
+static double
+_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+_run(const char *name, P_SHA1_BlocksFunc blocks, const uint8_t *data)
+{
+    P_SHA1_CTX ctx;
+    uint8_t digest[P_SHA1_DIGEST_SIZE];
+    int i;
+
+    P_SHA1_Set_Blocks(blocks, name);
+
+    double start = _now();
+    for (i = 0; i < LARGE_ROUNDS; i++) {
+        P_SHA1_Init(&ctx);
+        P_SHA1_Update(&ctx, data, LARGE_SIZE);
+        P_SHA1_Final(&ctx, digest);
+    }
+    double large = _now() - start;
+
+    start = _now();
+    for (i = 0; i < SMALL_ROUNDS; i++) {
+        P_SHA1_Init(&ctx);
+        P_SHA1_Update(&ctx, data, SMALL_SIZE);
+        P_SHA1_Final(&ctx, digest);
+    }
+    double small = _now() - start;
+
+    printf("%-10s %8.1f MB/s %10.0f hashes/s (%d bytes)\n", name,
+        LARGE_ROUNDS / large, SMALL_ROUNDS / small, SMALL_SIZE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint8_t *data = malloc(LARGE_SIZE);
+    int i;
+    for (i = 0; i < LARGE_SIZE; i++) {
+        data[i] = rand();
+    }
+
+    _run("portable", P_SHA1_Blocks_portable, data);
+
+    const char *name = NULL;
+    P_SHA1_BlocksFunc accelerated = P_SHA1_Blocks_accelerated(&name);
+    if (accelerated) {
+        _run(name, accelerated, data);
+    } else {
+        printf("no accelerated SHA-1 on this CPU\n");
+    }
+
+    free(data);
+    return 0;
+}
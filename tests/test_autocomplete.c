@@ -117,3 +117,25 @@ void add_two_same_updates(void **state)
     autocomplete_clear(ac);
     g_slist_free_full(result, g_free);
 }
+
+void add_all_adds_sorted_without_duplicates(void **state)
+{
+    Autocomplete ac = autocomplete_new();
+    autocomplete_add(ac, "Bob");
+    GSList *items = NULL;
+    items = g_slist_append(items, "Dave");
+    items = g_slist_append(items, "Alice");
+    items = g_slist_append(items, "Bob");
+    items = g_slist_append(items, "Alice");
+    autocomplete_add_all(ac, items);
+    GSList *result = autocomplete_create_list(ac);
+
+    assert_int_equal(3, g_slist_length(result));
+    assert_string_equal("Alice", g_slist_nth_data(result, 0));
+    assert_string_equal("Bob", g_slist_nth_data(result, 1));
+    assert_string_equal("Dave", g_slist_nth_data(result, 2));
+
+    g_slist_free(items);
+    autocomplete_clear(ac);
+    g_slist_free_full(result, g_free);
+}
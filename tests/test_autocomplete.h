@@ -8,3 +8,4 @@ void add_two_and_complete_returns_second(void **state);
 void add_two_adds_two(void **state);
 void add_two_same_adds_one(void **state);
 void add_two_same_updates(void **state);
+void add_all_adds_sorted_without_duplicates(void **state);
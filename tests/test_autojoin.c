@@ -0,0 +1,131 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "xmpp/autojoin.h"
+
+static void
+_add_rooms(int count)
+{
+    int i;
+    for (i = 0; i < count; i++) {
+        char *room = g_strdup_printf("room%d@conference.server.org", i);
+        autojoin_add(room);
+        g_free(room);
+    }
+}
+
+// starts joins until every slot is taken
+static int
+_start_all(void)
+{
+    int started = 0;
+    while (autojoin_next() != NULL) {
+        started++;
+    }
+
+    return started;
+}
+
+void init_autojoin(void **state)
+{
+    autojoin_clear();
+}
+
+void close_autojoin(void **state)
+{
+    autojoin_clear();
+}
+
+void autojoin_next_limits_concurrent_joins(void **state)
+{
+    _add_rooms(AUTOJOIN_CONCURRENT + 2);
+
+    assert_int_equal(AUTOJOIN_CONCURRENT, _start_all());
+    assert_int_equal(AUTOJOIN_CONCURRENT, autojoin_pending_count());
+    assert_int_equal(2, autojoin_queued_count());
+}
+
+void autojoin_next_keeps_queue_order(void **state)
+{
+    autojoin_add("b@conference.server.org");
+    autojoin_add("a@conference.server.org");
+
+    assert_string_equal("b@conference.server.org", autojoin_next());
+    assert_string_equal("a@conference.server.org", autojoin_next());
+    assert_null(autojoin_next());
+}
+
+void autojoin_sort_orders_queue(void **state)
+{
+    autojoin_add("b@conference.server.org");
+    autojoin_add("a@conference.server.org");
+
+    autojoin_sort((GCompareFunc)g_strcmp0);
+
+    assert_string_equal("a@conference.server.org", autojoin_next());
+}
+
+void autojoin_complete_frees_slot(void **state)
+{
+    _add_rooms(AUTOJOIN_CONCURRENT + 1);
+    _start_all();
+
+    autojoin_complete("room1@conference.server.org");
+
+    assert_int_equal(AUTOJOIN_CONCURRENT - 1, autojoin_pending_count());
+    assert_string_equal("room4@conference.server.org", autojoin_next());
+    assert_null(autojoin_next());
+}
+
+void autojoin_complete_ignores_unknown_room(void **state)
+{
+    _add_rooms(AUTOJOIN_CONCURRENT + 1);
+    _start_all();
+
+    autojoin_complete("room4@conference.server.org");
+    autojoin_complete("other@conference.server.org");
+
+    assert_int_equal(AUTOJOIN_CONCURRENT, autojoin_pending_count());
+    assert_int_equal(1, autojoin_queued_count());
+}
+
+void autojoin_expire_frees_only_old_joins(void **state)
+{
+    _add_rooms(AUTOJOIN_CONCURRENT + 2);
+    autojoin_next();
+    g_usleep(200000);
+    _start_all();
+
+    autojoin_expire(0.1);
+
+    assert_int_equal(AUTOJOIN_CONCURRENT - 1, autojoin_pending_count());
+    assert_string_equal("room4@conference.server.org", autojoin_next());
+    assert_null(autojoin_next());
+}
+
+void autojoin_expire_keeps_new_joins(void **state)
+{
+    _add_rooms(AUTOJOIN_CONCURRENT);
+    _start_all();
+
+    autojoin_expire(AUTOJOIN_TIMEOUT);
+
+    assert_int_equal(AUTOJOIN_CONCURRENT, autojoin_pending_count());
+}
+
+void autojoin_clear_drops_queue_and_slots(void **state)
+{
+    _add_rooms(AUTOJOIN_CONCURRENT + 2);
+    _start_all();
+
+    autojoin_clear();
+
+    assert_int_equal(0, autojoin_pending_count());
+    assert_int_equal(0, autojoin_queued_count());
+    assert_null(autojoin_next());
+}
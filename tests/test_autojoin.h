@@ -0,0 +1,10 @@
+void init_autojoin(void **state);
+void close_autojoin(void **state);
+void autojoin_next_limits_concurrent_joins(void **state);
+void autojoin_next_keeps_queue_order(void **state);
+void autojoin_sort_orders_queue(void **state);
+void autojoin_complete_frees_slot(void **state);
+void autojoin_complete_ignores_unknown_room(void **state);
+void autojoin_expire_frees_only_old_joins(void **state);
+void autojoin_expire_keeps_new_joins(void **state);
+void autojoin_clear_drops_queue_and_slots(void **state);
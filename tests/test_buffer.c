@@ -0,0 +1,222 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "ui/buffer.h"
+
+static void
+_push(ProfBuff buffer, const char * const from, const char * const message)
+{
+    buffer_push(buffer, '-', g_date_time_new_now_local(), 0, 0, from, message);
+}
+
+void buffer_find_returns_zero_when_no_match(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, "bob", "hello");
+
+    assert_int_equal(0, buffer_find(buffer, "goodbye"));
+    assert_null(buffer_find_current(buffer));
+
+    buffer_free(buffer);
+}
+
+void buffer_find_ignores_case(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, "bob", "Hello World");
+
+    assert_int_equal(1, buffer_find(buffer, "hello world"));
+
+    buffer_free(buffer);
+}
+
+void buffer_find_matches_from(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, "bob", "hello");
+    _push(buffer, "alice", "hello");
+
+    assert_int_equal(1, buffer_find(buffer, "alice"));
+
+    buffer_free(buffer);
+}
+
+void buffer_find_starts_at_most_recent(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, "bob", "first match");
+    _push(buffer, "bob", "other");
+    _push(buffer, "bob", "second match");
+
+    assert_int_equal(2, buffer_find(buffer, "match"));
+    ProfBuffEntry *entry = buffer_find_current(buffer);
+    assert_string_equal("second match", entry->message);
+    assert_int_equal(1, buffer_find_position(buffer));
+
+    buffer_free(buffer);
+}
+
+void buffer_find_older_and_newer_move_between_hits(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, "bob", "first match");
+    _push(buffer, "bob", "second match");
+
+    buffer_find(buffer, "match");
+
+    ProfBuffEntry *entry = buffer_find_older(buffer);
+    assert_string_equal("first match", entry->message);
+    assert_null(buffer_find_older(buffer));
+    assert_int_equal(2, buffer_find_position(buffer));
+
+    entry = buffer_find_newer(buffer);
+    assert_string_equal("second match", entry->message);
+    assert_null(buffer_find_newer(buffer));
+
+    buffer_free(buffer);
+}
+
+void buffer_find_narrows_previous_hits(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, "bob", "release party");
+    _push(buffer, "bob", "release notes");
+    _push(buffer, "bob", "party");
+
+    assert_int_equal(2, buffer_find(buffer, "release"));
+    assert_int_equal(1, buffer_find(buffer, "release p"));
+    ProfBuffEntry *entry = buffer_find_current(buffer);
+    assert_string_equal("release party", entry->message);
+
+    buffer_free(buffer);
+}
+
+void buffer_find_includes_new_entries(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, "bob", "first match");
+
+    buffer_find(buffer, "match");
+    _push(buffer, "bob", "second match");
+
+    assert_int_equal(2, buffer_find_count(buffer));
+    ProfBuffEntry *entry = buffer_find_newer(buffer);
+    assert_string_equal("second match", entry->message);
+
+    buffer_free(buffer);
+}
+
+void buffer_find_clear_removes_hits(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, "bob", "match");
+
+    buffer_find(buffer, "match");
+    buffer_find_clear(buffer);
+
+    assert_null(buffer_find_current(buffer));
+    assert_int_equal(0, buffer_find_count(buffer));
+
+    buffer_free(buffer);
+}
+
+static void
+_count_evicted(ProfBuffEntry *entry, void *data)
+{
+    int *evicted = data;
+    (*evicted)++;
+}
+
+void buffer_budget_evicts_least_recently_viewed(void **state)
+{
+    ProfBuff older = buffer_create();
+    ProfBuff newer = buffer_create();
+    _push(older, "bob", "one");
+    _push(older, "bob", "two");
+    _push(newer, "bob", "one");
+    _push(newer, "bob", "two");
+    buffer_touch(newer);
+
+    buffer_set_budget(buffer_total_bytes() - 1);
+
+    assert_int_equal(1, buffer_size(older));
+    assert_int_equal(2, buffer_size(newer));
+    assert_string_equal("two", buffer_yield_entry(older, 0)->message);
+
+    buffer_set_budget(0);
+    buffer_free(older);
+    buffer_free(newer);
+}
+
+void buffer_budget_keeps_newest_entry(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, "bob", "one");
+    _push(buffer, "bob", "two");
+
+    buffer_set_budget(1);
+
+    assert_int_equal(1, buffer_size(buffer));
+    assert_string_equal("two", buffer_yield_entry(buffer, 0)->message);
+
+    buffer_set_budget(0);
+    buffer_free(buffer);
+}
+
+void buffer_budget_calls_evict_func(void **state)
+{
+    int evicted = 0;
+    ProfBuff buffer = buffer_create();
+    buffer_set_evict_func(buffer, _count_evicted, &evicted);
+    _push(buffer, "bob", "one");
+    _push(buffer, "bob", "two");
+    _push(buffer, "bob", "three");
+
+    buffer_set_budget(1);
+
+    assert_int_equal(2, evicted);
+
+    buffer_set_budget(0);
+    buffer_free(buffer);
+}
+
+void buffer_push_past_budget_evicts_oldest(void **state)
+{
+    int evicted = 0;
+    ProfBuff buffer = buffer_create();
+    buffer_set_evict_func(buffer, _count_evicted, &evicted);
+    _push(buffer, "bob", "one");
+    _push(buffer, "bob", "two");
+    size_t budget = buffer_total_bytes();
+    buffer_set_budget(budget);
+
+    _push(buffer, "bob", "six");
+
+    assert_int_equal(1, evicted);
+    assert_int_equal(2, buffer_size(buffer));
+    assert_string_equal("two", buffer_yield_entry(buffer, 0)->message);
+    assert_string_equal("six", buffer_yield_entry(buffer, 1)->message);
+    assert_true(buffer_total_bytes() <= budget);
+
+    buffer_set_budget(0);
+    buffer_free(buffer);
+}
+
+void buffer_bytes_counts_entries(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    size_t before = buffer_total_bytes();
+
+    _push(buffer, "bob", "hello");
+
+    assert_true(buffer_bytes(buffer) > strlen("bob") + strlen("hello"));
+    assert_int_equal(before + buffer_bytes(buffer), buffer_total_bytes());
+
+    buffer_free(buffer);
+    assert_int_equal(before, buffer_total_bytes());
+}
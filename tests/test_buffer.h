@@ -0,0 +1,13 @@
+void buffer_find_returns_zero_when_no_match(void **state);
+void buffer_find_ignores_case(void **state);
+void buffer_find_matches_from(void **state);
+void buffer_find_starts_at_most_recent(void **state);
+void buffer_find_older_and_newer_move_between_hits(void **state);
+void buffer_find_narrows_previous_hits(void **state);
+void buffer_find_includes_new_entries(void **state);
+void buffer_find_clear_removes_hits(void **state);
+void buffer_budget_evicts_least_recently_viewed(void **state);
+void buffer_budget_keeps_newest_entry(void **state);
+void buffer_budget_calls_evict_func(void **state);
+void buffer_push_past_budget_evicts_oldest(void **state);
+void buffer_bytes_counts_entries(void **state);
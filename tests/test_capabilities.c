@@ -0,0 +1,115 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include "helpers.h"
+#include "xmpp/capabilities.h"
+
+#define ROOM "room@conference.server.org"
+
+void init_caps(void **state)
+{
+    create_data_dir(state);
+    caps_init();
+}
+
+void close_caps(void **state)
+{
+    caps_pending_clear();
+    caps_close();
+    remove("./tests/files/xdg_data_home/profanity/capscache");
+    remove_data_dir(state);
+}
+
+static void
+_request(const char * const jid, const char * const ver)
+{
+    caps_request(jid, "http://client.org", ver, FALSE);
+}
+
+void caps_request_limits_queries_per_bare_jid(void **state)
+{
+    expect_string(iq_send_caps_request, to, ROOM "/one");
+    expect_string(iq_send_caps_request, to, ROOM "/two");
+    expect_string(iq_send_caps_request, to, ROOM "/three");
+    expect_string(iq_send_caps_request, to, ROOM "/four");
+    expect_string(iq_send_caps_request, to, ROOM "/five");
+
+    _request(ROOM "/one", "ver1");
+    _request(ROOM "/two", "ver2");
+    _request(ROOM "/three", "ver3");
+    _request(ROOM "/four", "ver4");
+    _request(ROOM "/five", "ver5");
+    _request(ROOM "/six", "ver6");
+
+    // a failed query frees the slot for the queued one
+    expect_string(iq_send_caps_request, to, ROOM "/six");
+
+    caps_pending_failed("ver1", ROOM "/one");
+}
+
+void caps_request_joins_pending_query(void **state)
+{
+    expect_string(iq_send_caps_request, to, "bob@server.org/laptop");
+
+    _request("bob@server.org/laptop", "ver1");
+    _request("alice@server.org/phone", "ver1");
+}
+
+void caps_pending_failed_asks_next_jid(void **state)
+{
+    expect_string(iq_send_caps_request, to, "bob@server.org/laptop");
+    _request("bob@server.org/laptop", "ver1");
+    _request("alice@server.org/phone", "ver1");
+
+    expect_string(iq_send_caps_request, to, "alice@server.org/phone");
+
+    caps_pending_failed("ver1", "bob@server.org/laptop");
+}
+
+void caps_pending_failed_ignores_other_jid(void **state)
+{
+    expect_string(iq_send_caps_request, to, "bob@server.org/laptop");
+    _request("bob@server.org/laptop", "ver1");
+    _request("alice@server.org/phone", "ver1");
+
+    caps_pending_failed("ver1", "alice@server.org/phone");
+}
+
+void caps_pending_expire_asks_next_jid(void **state)
+{
+    expect_string(iq_send_caps_request, to, "bob@server.org/laptop");
+    _request("bob@server.org/laptop", "ver1");
+    _request("alice@server.org/phone", "ver1");
+
+    caps_pending_expire(CAPS_QUERY_TIMEOUT);
+
+    expect_string(iq_send_caps_request, to, "alice@server.org/phone");
+
+    caps_pending_expire(0);
+}
+
+void caps_pending_expire_releases_slot(void **state)
+{
+    expect_string(iq_send_caps_request, to, ROOM "/one");
+    expect_string(iq_send_caps_request, to, ROOM "/two");
+    expect_string(iq_send_caps_request, to, ROOM "/three");
+    expect_string(iq_send_caps_request, to, ROOM "/four");
+    expect_string(iq_send_caps_request, to, ROOM "/five");
+    _request(ROOM "/one", "ver1");
+    _request(ROOM "/two", "ver2");
+    _request(ROOM "/three", "ver3");
+    _request(ROOM "/four", "ver4");
+    _request(ROOM "/five", "ver5");
+    _request(ROOM "/six", "ver6");
+
+    // the queued query goes out once, it was not sent when the sweep started
+    expect_string(iq_send_caps_request, to, ROOM "/six");
+
+    caps_pending_expire(0);
+}
@@ -0,0 +1,8 @@
+void init_caps(void **state);
+void close_caps(void **state);
+void caps_request_limits_queries_per_bare_jid(void **state);
+void caps_request_joins_pending_query(void **state);
+void caps_pending_failed_asks_next_jid(void **state);
+void caps_pending_failed_ignores_other_jid(void **state);
+void caps_pending_expire_asks_next_jid(void **state);
+void caps_pending_expire_releases_slot(void **state);
@@ -657,6 +657,43 @@ void cmd_account_set_otr_sets_otr(void **state)
     free(help);
 }
 
+void cmd_account_show_message_for_invalid_compression_estimate(void **state)
+{
+    CommandHelp *help = malloc(sizeof(CommandHelp));
+    gchar *args[] = { "set", "a_account", "compression_estimate", "maybe", NULL };
+
+    expect_any(accounts_account_exists, account_name);
+    will_return(accounts_account_exists, TRUE);
+
+    expect_cons_show("Compression estimate must be on or off.");
+
+    gboolean result = cmd_account(args, *help);
+    assert_true(result);
+
+    free(help);
+}
+
+void cmd_account_set_compression_estimate_sets_compression_estimate(void **state)
+{
+    CommandHelp *help = malloc(sizeof(CommandHelp));
+    gchar *args[] = { "set", "a_account", "compression_estimate", "on", NULL };
+
+    expect_any(accounts_account_exists, account_name);
+    will_return(accounts_account_exists, TRUE);
+
+    expect_string(accounts_set_compression_estimate, account_name, "a_account");
+    expect_value(accounts_set_compression_estimate, value, TRUE);
+
+    expect_cons_show("Updated compression estimate for account a_account: on");
+    expect_cons_show("Takes effect on the next connect.");
+    expect_cons_show("");
+
+    gboolean result = cmd_account(args, *help);
+    assert_true(result);
+
+    free(help);
+}
+
 void cmd_account_set_status_shows_message_when_invalid_status(void **state)
 {
     CommandHelp *help = malloc(sizeof(CommandHelp));
@@ -34,6 +34,8 @@ void cmd_account_set_nick_sets_nick(void **state);
 void cmd_account_show_message_for_missing_otr_policy(void **state);
 void cmd_account_show_message_for_invalid_otr_policy(void **state);
 void cmd_account_set_otr_sets_otr(void **state);
+void cmd_account_show_message_for_invalid_compression_estimate(void **state);
+void cmd_account_set_compression_estimate_sets_compression_estimate(void **state);
 void cmd_account_set_status_shows_message_when_invalid_status(void **state);
 void cmd_account_set_status_sets_status_when_valid(void **state);
 void cmd_account_set_status_sets_status_when_last(void **state);
@@ -4,6 +4,11 @@
 #include <setjmp.h>
 #include <cmocka.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <glib.h>
 
 void replace_one_substr(void **state)
 {
@@ -631,3 +636,121 @@ void strip_quotes_strips_both(void **state)
     free(result);
 }
 
+
+#define GZIP_DIR "./tests/files/gzip"
+#define GZIP_LOG GZIP_DIR "/day.log"
+#define GZIP_ARCHIVE GZIP_DIR "/day.log.gz"
+
+static void
+_write_log(const char * const content)
+{
+    mkdir_recursive(GZIP_DIR);
+    FILE *f = fopen(GZIP_LOG, "a");
+    fputs(content, f);
+    fclose(f);
+}
+
+static GSList *
+_read_archive(void)
+{
+    GSList *lines = NULL;
+    gzFile f = gzopen(GZIP_ARCHIVE, "rb");
+    char *line;
+    while ((line = prof_gzgetline(f)) != NULL) {
+        lines = g_slist_append(lines, line);
+    }
+    gzclose(f);
+
+    return lines;
+}
+
+static void
+_remove_gzip_dir(void)
+{
+    remove(GZIP_LOG);
+    remove(GZIP_ARCHIVE);
+    rmdir(GZIP_DIR);
+    rmdir("./tests/files");
+}
+
+void gzip_file_reads_back_and_removes_original(void **state)
+{
+    _write_log("one\ntwo\n");
+
+    gboolean result = prof_gzip_file(GZIP_LOG, GZIP_ARCHIVE, NULL);
+
+    assert_true(result);
+    assert_false(g_file_test(GZIP_LOG, G_FILE_TEST_EXISTS));
+    GSList *lines = _read_archive();
+    assert_int_equal(2, g_slist_length(lines));
+    assert_string_equal("one", lines->data);
+    assert_string_equal("two", lines->next->data);
+
+    g_slist_free_full(lines, free);
+    _remove_gzip_dir();
+}
+
+void gzip_file_appends_to_existing_archive(void **state)
+{
+    _write_log("one\n");
+    prof_gzip_file(GZIP_LOG, GZIP_ARCHIVE, NULL);
+    _write_log("two\n");
+
+    gboolean result = prof_gzip_file(GZIP_LOG, GZIP_ARCHIVE, NULL);
+
+    assert_true(result);
+    assert_false(g_file_test(GZIP_LOG, G_FILE_TEST_EXISTS));
+    GSList *lines = _read_archive();
+    assert_int_equal(2, g_slist_length(lines));
+    assert_string_equal("one", lines->data);
+    assert_string_equal("two", lines->next->data);
+
+    g_slist_free_full(lines, free);
+    _remove_gzip_dir();
+}
+
+void gzip_file_missing_original_leaves_archive(void **state)
+{
+    _write_log("one\n");
+    prof_gzip_file(GZIP_LOG, GZIP_ARCHIVE, NULL);
+
+    gboolean result = prof_gzip_file(GZIP_LOG, GZIP_ARCHIVE, NULL);
+
+    assert_false(result);
+    GSList *lines = _read_archive();
+    assert_int_equal(1, g_slist_length(lines));
+
+    g_slist_free_full(lines, free);
+    _remove_gzip_dir();
+}
+
+void write_private_file_is_user_only(void **state)
+{
+    mkdir_recursive(GZIP_DIR);
+    mode_t old_mask = umask(022);
+
+    gboolean result = prof_write_private_file(GZIP_LOG, "one\n", 4, NULL);
+    umask(old_mask);
+
+    assert_true(result);
+    struct stat st;
+    assert_int_equal(0, stat(GZIP_LOG, &st));
+    assert_int_equal(S_IRUSR | S_IWUSR, st.st_mode & 0777);
+    gchar *contents = NULL;
+    g_file_get_contents(GZIP_LOG, &contents, NULL, NULL);
+    assert_string_equal("one\n", contents);
+
+    g_free(contents);
+    _remove_gzip_dir();
+}
+
+void write_private_file_reports_error(void **state)
+{
+    GError *error = NULL;
+
+    gboolean result = prof_write_private_file("./tests/files/missing/day.log", "one\n", 4, &error);
+
+    assert_false(result);
+    assert_non_null(error);
+    g_error_free(error);
+}
@@ -56,3 +56,8 @@ void strip_quotes_does_nothing_when_no_quoted(void **state);
 void strip_quotes_strips_first(void **state);
 void strip_quotes_strips_last(void **state);
 void strip_quotes_strips_both(void **state);
+void gzip_file_reads_back_and_removes_original(void **state);
+void gzip_file_appends_to_existing_archive(void **state);
+void gzip_file_missing_original_leaves_archive(void **state);
+void write_private_file_is_user_only(void **state);
+void write_private_file_reports_error(void **state);
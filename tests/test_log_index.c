@@ -0,0 +1,140 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "common.h"
+#include "helpers.h"
+#include "log_index.h"
+
+#define LOGIN "me@server.org"
+#define CHATLOGS_DIR "./tests/files/xdg_data_home/profanity/chatlogs"
+#define ACCOUNT_DIR CHATLOGS_DIR "/me_at_server.org"
+#define CONTACT_DIR ACCOUNT_DIR "/bob_at_server.org"
+#define ROOMS_DIR ACCOUNT_DIR "/rooms"
+#define ROOM_DIR ROOMS_DIR "/room_at_conference.server.org"
+#define CONTACT_LOG CONTACT_DIR "/2015_01_01.log"
+#define ROOM_LOG ROOM_DIR "/2015_01_02.log"
+
+static void
+_write_log(const char * const filename, const char * const line, const char * const text)
+{
+    FILE *fp = fopen(filename, "a");
+    fprintf(fp, "10:00:00 - %s\n", line);
+    fclose(fp);
+
+    log_index_add(LOGIN, filename, text);
+}
+
+void init_log_index(void **state)
+{
+    create_data_dir(state);
+    mkdir_recursive(CONTACT_DIR);
+    mkdir_recursive(ROOM_DIR);
+    log_index_init();
+
+    _write_log(CONTACT_LOG, "bob: Hello there world", "bob: Hello there world");
+    _write_log(CONTACT_LOG, "me: goodbye", "me: goodbye");
+    _write_log(ROOM_LOG, "alice: hello room", "alice: hello room");
+}
+
+void close_log_index(void **state)
+{
+    log_index_close();
+    remove(CONTACT_LOG);
+    remove(ROOM_LOG);
+    remove(ACCOUNT_DIR "/.index");
+    rmdir(CONTACT_DIR);
+    rmdir(ROOM_DIR);
+    rmdir(ROOMS_DIR);
+    rmdir(ACCOUNT_DIR);
+    rmdir(CHATLOGS_DIR);
+    remove_data_dir(state);
+}
+
+void log_index_search_finds_logged_line(void **state)
+{
+    GSList *hits = log_index_search(LOGIN, "there", 10);
+
+    assert_int_equal(1, g_slist_length(hits));
+    LogSearchHit *hit = hits->data;
+    assert_string_equal("bob@server.org", hit->contact);
+    assert_false(hit->room);
+    assert_string_equal("2015-01-01", hit->date);
+    assert_int_equal(0, hit->line);
+    assert_string_equal("10:00:00 - bob: Hello there world", hit->text);
+}
+
+void log_index_search_ignores_case(void **state)
+{
+    GSList *hits = log_index_search(LOGIN, "HELLO", 10);
+
+    assert_int_equal(2, g_slist_length(hits));
+}
+
+void log_index_search_orders_newest_first(void **state)
+{
+    GSList *hits = log_index_search(LOGIN, "hello", 10);
+
+    LogSearchHit *hit = hits->data;
+    assert_string_equal("room@conference.server.org", hit->contact);
+    assert_true(hit->room);
+}
+
+void log_index_search_requires_all_words(void **state)
+{
+    GSList *hits = log_index_search(LOGIN, "hello room", 10);
+
+    assert_int_equal(1, g_slist_length(hits));
+    LogSearchHit *hit = hits->data;
+    assert_string_equal("room@conference.server.org", hit->contact);
+}
+
+void log_index_search_returns_null_when_no_match(void **state)
+{
+    GSList *hits = log_index_search(LOGIN, "missing", 10);
+
+    assert_null(hits);
+}
+
+void log_index_get_hit_returns_numbered_result(void **state)
+{
+    log_index_search(LOGIN, "goodbye", 10);
+
+    LogSearchHit *hit = log_index_get_hit(1);
+
+    assert_non_null(hit);
+    assert_int_equal(1, hit->line);
+    assert_null(log_index_get_hit(2));
+}
+
+static void
+_wait_for_index(void)
+{
+    while (log_index_pending() > 0) {
+        g_usleep(1000);
+    }
+}
+
+void log_index_compacts_removed_days(void **state)
+{
+    _wait_for_index();
+    log_index_close();
+    remove(ROOM_LOG);
+
+    log_index_search(LOGIN, "hello", 10);
+    _wait_for_index();
+    GSList *hits = log_index_search(LOGIN, "hello", 10);
+
+    assert_int_equal(1, g_slist_length(hits));
+    gchar *journal = NULL;
+    assert_true(g_file_get_contents(ACCOUNT_DIR "/.index", &journal, NULL, NULL));
+    assert_null(strstr(journal, "rooms/"));
+    assert_non_null(strstr(journal, "bob_at_server.org/2015_01_01.log"));
+    g_free(journal);
+}
@@ -0,0 +1,9 @@
+void init_log_index(void **state);
+void close_log_index(void **state);
+void log_index_search_finds_logged_line(void **state);
+void log_index_search_ignores_case(void **state);
+void log_index_search_orders_newest_first(void **state);
+void log_index_search_requires_all_words(void **state);
+void log_index_search_returns_null_when_no_match(void **state);
+void log_index_get_hit_returns_numbered_result(void **state);
+void log_index_compacts_removed_days(void **state);
@@ -76,3 +76,132 @@ void test_muc_active(void **state)
 
     assert_true(room_is_active);
 }
+
+void test_muc_last_message_keeps_newest(void **state)
+{
+    char *room = "room@server.org";
+    GDateTime *older = g_date_time_new_utc(2015, 3, 1, 10, 0, 0);
+    GDateTime *newer = g_date_time_new_utc(2015, 3, 1, 11, 0, 0);
+
+    muc_set_last_message(room, newer);
+    muc_set_last_message(room, older);
+
+    assert_true(g_date_time_equal(muc_last_message(room), newer));
+
+    g_date_time_unref(older);
+    g_date_time_unref(newer);
+}
+
+void test_muc_last_message_kept_after_leave(void **state)
+{
+    char *room = "room@server.org";
+    GDateTime *time = g_date_time_new_utc(2015, 3, 1, 10, 0, 0);
+    muc_join(room, "bob", NULL, FALSE);
+    muc_set_last_message(room, time);
+
+    muc_leave(room);
+
+    assert_true(g_date_time_equal(muc_last_message(room), time));
+
+    g_date_time_unref(time);
+}
+
+void test_muc_last_activity_uses_session_mark(void **state)
+{
+    char *room = "room@server.org";
+    GDateTime *time = g_date_time_new_utc(2015, 3, 1, 10, 0, 0);
+    muc_set_last_message(room, time);
+
+    assert_true(g_date_time_equal(muc_last_activity("me@server.org", room), time));
+
+    g_date_time_unref(time);
+}
+
+void test_muc_roster_ac_built_on_demand(void **state)
+{
+    char *room = "room@server.org";
+    muc_join(room, "bob", NULL, FALSE);
+    muc_roster_add(room, "alice", "alice@server.org/laptop", "participant", "none", NULL, NULL);
+    muc_roster_add(room, "dave", NULL, "participant", "none", NULL, NULL);
+
+    Autocomplete nick_ac = muc_roster_ac(room);
+    Autocomplete jid_ac = muc_roster_jid_ac(room);
+
+    assert_int_equal(2, autocomplete_length(nick_ac));
+    assert_true(autocomplete_contains(nick_ac, "alice"));
+    assert_int_equal(1, autocomplete_length(jid_ac));
+    assert_true(autocomplete_contains(jid_ac, "alice@server.org"));
+
+    muc_roster_remove(room, "alice");
+
+    assert_false(autocomplete_contains(nick_ac, "alice"));
+}
+
+void test_muc_message_seen_after_remember(void **state)
+{
+    char *room = "room@server.org";
+    GDateTime *now = g_date_time_new_now_utc();
+    muc_remember_message(room, "bob", "hello", NULL);
+
+    assert_false(muc_message_seen(room, "alice", "hello", now));
+    assert_false(muc_message_seen(room, "bob", "hello again", now));
+    assert_false(muc_message_seen("other@server.org", "bob", "hello", now));
+    assert_true(muc_message_seen(room, "bob", "hello", now));
+
+    g_date_time_unref(now);
+}
+
+void test_muc_message_seen_once_per_remember(void **state)
+{
+    char *room = "room@server.org";
+    GDateTime *now = g_date_time_new_now_utc();
+    muc_remember_message(room, "bob", "ok", NULL);
+
+    assert_true(muc_message_seen(room, "bob", "ok", now));
+    assert_false(muc_message_seen(room, "bob", "ok", now));
+
+    g_date_time_unref(now);
+}
+
+void test_muc_message_not_seen_when_stamped_after_margin(void **state)
+{
+    char *room = "room@server.org";
+    GDateTime *now = g_date_time_new_now_utc();
+    GDateTime *later = g_date_time_add_seconds(now, MUC_HISTORY_MARGIN + 60);
+    muc_remember_message(room, "bob", "ok", NULL);
+
+    assert_false(muc_message_seen(room, "bob", "ok", later));
+
+    g_date_time_unref(later);
+    g_date_time_unref(now);
+}
+
+void test_muc_message_seen_until_server_stamp(void **state)
+{
+    char *room = "room@server.org";
+    GDateTime *stamp = g_date_time_new_now_utc();
+    GDateTime *later = g_date_time_add_seconds(stamp, 1);
+    muc_remember_message(room, "bob", "ok", stamp);
+
+    assert_false(muc_message_seen(room, "bob", "ok", later));
+    assert_true(muc_message_seen(room, "bob", "ok", stamp));
+
+    g_date_time_unref(later);
+    g_date_time_unref(stamp);
+}
+
+void test_muc_message_seen_forgets_oldest(void **state)
+{
+    char *room = "room@server.org";
+    GDateTime *now = g_date_time_new_now_utc();
+    muc_remember_message(room, "bob", "first", NULL);
+    int i;
+    for (i = 0; i < MUC_RECENT_MAX; i++) {
+        muc_remember_message(room, "bob", "more", NULL);
+    }
+
+    assert_false(muc_message_seen(room, "bob", "first", now));
+    assert_true(muc_message_seen(room, "bob", "more", now));
+
+    g_date_time_unref(now);
+}
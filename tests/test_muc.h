@@ -7,3 +7,12 @@ void test_muc_invites_count_0(void **state);
 void test_muc_invites_count_5(void **state);
 void test_muc_room_is_not_active(void **state);
 void test_muc_active(void **state);
+void test_muc_last_message_keeps_newest(void **state);
+void test_muc_last_message_kept_after_leave(void **state);
+void test_muc_last_activity_uses_session_mark(void **state);
+void test_muc_roster_ac_built_on_demand(void **state);
+void test_muc_message_seen_after_remember(void **state);
+void test_muc_message_seen_once_per_remember(void **state);
+void test_muc_message_not_seen_when_stamped_after_margin(void **state);
+void test_muc_message_seen_until_server_stamp(void **state);
+void test_muc_message_seen_forgets_oldest(void **state);
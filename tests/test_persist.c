@@ -0,0 +1,107 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+#include "config/persist.h"
+
+#define PERSIST_FILE "./tests/files/xdg_config_home/profanity/persisttest"
+
+static gchar *
+_read_value(void)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    g_key_file_load_from_file(keyfile, PERSIST_FILE, G_KEY_FILE_NONE, NULL);
+    gchar *value = g_key_file_get_string(keyfile, "group", "key", NULL);
+    g_key_file_free(keyfile);
+
+    return value;
+}
+
+void persist_mark_dirty_defers_write(void **state)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    ProfStore *store = persist_store_new(keyfile, PERSIST_FILE, NULL);
+
+    g_key_file_set_string(keyfile, "group", "key", "value");
+    persist_mark_dirty(store);
+
+    assert_false(g_file_test(PERSIST_FILE, G_FILE_TEST_EXISTS));
+
+    persist_store_free(store);
+    g_key_file_free(keyfile);
+    remove(PERSIST_FILE);
+}
+
+void persist_flush_writes_keyfile(void **state)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    ProfStore *store = persist_store_new(keyfile, PERSIST_FILE, NULL);
+
+    g_key_file_set_string(keyfile, "group", "key", "value");
+    persist_mark_dirty(store);
+    persist_flush(store);
+
+    gchar *value = _read_value();
+    assert_string_equal("value", value);
+
+    g_free(value);
+    persist_store_free(store);
+    g_key_file_free(keyfile);
+    remove(PERSIST_FILE);
+}
+
+void persist_store_free_flushes_pending(void **state)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    ProfStore *store = persist_store_new(keyfile, PERSIST_FILE, NULL);
+
+    g_key_file_set_string(keyfile, "group", "key", "first");
+    persist_mark_dirty(store);
+    g_key_file_set_string(keyfile, "group", "key", "second");
+    persist_mark_dirty(store);
+    persist_store_free(store);
+
+    gchar *value = _read_value();
+    assert_string_equal("second", value);
+
+    g_free(value);
+    g_key_file_free(keyfile);
+    remove(PERSIST_FILE);
+}
+
+void persist_flush_to_missing_dir_leaves_no_file(void **state)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    ProfStore *store = persist_store_new(keyfile, PERSIST_FILE "/missing", NULL);
+
+    g_key_file_set_string(keyfile, "group", "key", "value");
+    persist_mark_dirty(store);
+    persist_flush(store);
+
+    assert_false(g_file_test(PERSIST_FILE, G_FILE_TEST_EXISTS));
+
+    persist_store_free(store);
+    g_key_file_free(keyfile);
+}
+
+void persist_write_replaces_file_privately(void **state)
+{
+    persist_write(PERSIST_FILE, "first", 5);
+    persist_write(PERSIST_FILE, "second", 6);
+
+    gchar *contents = NULL;
+    g_file_get_contents(PERSIST_FILE, &contents, NULL, NULL);
+    assert_string_equal("second", contents);
+    struct stat st;
+    assert_int_equal(0, stat(PERSIST_FILE, &st));
+    assert_int_equal(S_IRUSR | S_IWUSR, st.st_mode & 0777);
+
+    g_free(contents);
+    remove(PERSIST_FILE);
+}
@@ -0,0 +1,5 @@
+void persist_mark_dirty_defers_write(void **state);
+void persist_flush_writes_keyfile(void **state);
+void persist_store_free_flushes_pending(void **state);
+void persist_flush_to_missing_dir_leaves_no_file(void **state);
+void persist_write_replaces_file_privately(void **state);
@@ -31,3 +31,42 @@ void statuses_muc_defaults_to_all(void **state)
     assert_non_null(setting);
     assert_string_equal("all", setting);
 }
+
+void log_generations_defaults_to_one(void **state)
+{
+    assert_int_equal(1, prefs_get_log_generations());
+}
+
+void log_generations_out_of_range_defaults_to_one(void **state)
+{
+    prefs_set_log_generations(PREFS_MAX_LOG_GENERATIONS + 1);
+
+    assert_int_equal(1, prefs_get_log_generations());
+}
+
+void log_compress_defaults_to_off(void **state)
+{
+    assert_false(prefs_get_boolean(PREF_LOG_COMPRESS));
+}
+
+void peek_string_returns_default(void **state)
+{
+    const char *setting = prefs_peek_string(PREF_TIME);
+
+    assert_non_null(setting);
+    assert_string_equal("seconds", setting);
+}
+
+void peek_string_returns_set_value(void **state)
+{
+    prefs_set_string(PREF_TIME, "minutes");
+
+    assert_string_equal("minutes", prefs_peek_string(PREF_TIME));
+}
+
+void get_boolean_returns_set_value(void **state)
+{
+    prefs_set_boolean(PREF_LOG_COMPRESS, TRUE);
+
+    assert_true(prefs_get_boolean(PREF_LOG_COMPRESS));
+}
@@ -1,3 +1,9 @@
 void statuses_console_defaults_to_all(void **state);
 void statuses_chat_defaults_to_all(void **state);
 void statuses_muc_defaults_to_all(void **state);
+void log_generations_defaults_to_one(void **state);
+void log_generations_out_of_range_defaults_to_one(void **state);
+void log_compress_defaults_to_off(void **state);
+void peek_string_returns_default(void **state);
+void peek_string_returns_set_value(void **state);
+void get_boolean_returns_set_value(void **state);
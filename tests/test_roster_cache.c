@@ -0,0 +1,153 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "helpers.h"
+#include "contact.h"
+#include "roster_list.h"
+#include "xmpp/roster_cache.h"
+
+#define ACCOUNT "me@server.org"
+#define CACHE_DIR "./tests/files/xdg_data_home/profanity/roster"
+#define CACHE_FILE CACHE_DIR "/me_at_server.org.cache"
+
+// closes the cache, writing it, and opens it again into an empty roster
+static char *
+_reopen(void)
+{
+    roster_cache_close();
+    roster_clear();
+
+    return roster_cache_open(ACCOUNT);
+}
+
+void init_roster_cache(void **state)
+{
+    create_data_dir(state);
+    roster_init();
+}
+
+void close_roster_cache(void **state)
+{
+    roster_cache_close();
+    roster_free();
+    remove(CACHE_FILE);
+    rmdir(CACHE_DIR);
+    remove_data_dir(state);
+}
+
+void roster_cache_missing_file_needs_full_fetch(void **state)
+{
+    char *ver = roster_cache_open(ACCOUNT);
+
+    assert_null(ver);
+    assert_null(roster_get_contacts());
+}
+
+void roster_cache_ver_round_trip(void **state)
+{
+    GSList *groups = g_slist_append(NULL, "friends");
+
+    roster_cache_open(ACCOUNT);
+    roster_cache_put("bob@server.org", "Bob", groups, "both", FALSE);
+    roster_cache_set_ver("ver1");
+    g_slist_free(groups);
+
+    char *ver = _reopen();
+
+    assert_string_equal("ver1", ver);
+    PContact bob = roster_get_contact("bob@server.org");
+    assert_non_null(bob);
+    assert_string_equal("Bob", p_contact_name(bob));
+    assert_string_equal("both", p_contact_subscription(bob));
+    assert_int_equal(1, g_slist_length(p_contact_groups(bob)));
+    assert_string_equal("friends", p_contact_groups(bob)->data);
+
+    g_free(ver);
+}
+
+void roster_cache_applies_push(void **state)
+{
+    roster_cache_open(ACCOUNT);
+    roster_cache_put("bob@server.org", "Bob", NULL, "both", FALSE);
+    roster_cache_put("alice@server.org", NULL, NULL, "to", FALSE);
+    roster_cache_set_ver("ver1");
+    g_free(_reopen());
+
+    roster_cache_put("bob@server.org", "Robert", NULL, "both", FALSE);
+    roster_cache_remove("alice@server.org");
+    roster_cache_set_ver("ver2");
+
+    char *ver = _reopen();
+
+    assert_string_equal("ver2", ver);
+    assert_int_equal(1, g_slist_length(roster_get_contacts()));
+    assert_string_equal("Robert", p_contact_name(roster_get_contact("bob@server.org")));
+    assert_null(roster_get_contact("alice@server.org"));
+
+    g_free(ver);
+}
+
+void roster_cache_corrupt_file_needs_full_fetch(void **state)
+{
+    roster_cache_open(ACCOUNT);
+    roster_cache_close();
+
+    FILE *cache = fopen(CACHE_FILE, "w");
+    assert_non_null(cache);
+    fputs("[roster cache\nver=ver1\n\x01\x02 not a key file\n", cache);
+    fclose(cache);
+
+    char *ver = roster_cache_open(ACCOUNT);
+
+    assert_null(ver);
+    assert_null(roster_get_contacts());
+}
+
+void roster_cache_without_ver_needs_full_fetch(void **state)
+{
+    roster_cache_open(ACCOUNT);
+    roster_cache_put("bob@server.org", "Bob", NULL, "both", FALSE);
+    roster_cache_set_ver(NULL);
+
+    char *ver = _reopen();
+
+    assert_null(ver);
+    assert_null(roster_get_contacts());
+}
+
+void roster_cache_unstorable_jid_needs_full_fetch(void **state)
+{
+    roster_cache_open(ACCOUNT);
+    roster_cache_put("bob@server.org", "Bob", NULL, "both", FALSE);
+    roster_cache_put("[bob]@server.org", NULL, NULL, "both", FALSE);
+    roster_cache_set_ver("ver1");
+
+    char *ver = _reopen();
+
+    assert_null(ver);
+}
+
+void roster_cache_reset_drops_contacts(void **state)
+{
+    roster_cache_open(ACCOUNT);
+    roster_cache_put("bob@server.org", "Bob", NULL, "both", FALSE);
+    roster_cache_set_ver("ver1");
+    roster_cache_reset();
+    roster_cache_put("alice@server.org", NULL, NULL, "to", FALSE);
+    roster_cache_set_ver("ver2");
+
+    char *ver = _reopen();
+
+    assert_string_equal("ver2", ver);
+    assert_null(roster_get_contact("bob@server.org"));
+    assert_non_null(roster_get_contact("alice@server.org"));
+
+    g_free(ver);
+}
@@ -0,0 +1,9 @@
+void init_roster_cache(void **state);
+void close_roster_cache(void **state);
+void roster_cache_missing_file_needs_full_fetch(void **state);
+void roster_cache_ver_round_trip(void **state);
+void roster_cache_applies_push(void **state);
+void roster_cache_corrupt_file_needs_full_fetch(void **state);
+void roster_cache_without_ver_needs_full_fetch(void **state);
+void roster_cache_unstorable_jid_needs_full_fetch(void **state);
+void roster_cache_reset_drops_contacts(void **state);
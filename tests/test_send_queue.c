@@ -0,0 +1,174 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "xmpp/send_queue.h"
+
+static void
+_queue(const char * const data, send_priority_t priority, const char * const key)
+{
+    send_queue_raw(data, strlen(data), priority, key);
+}
+
+// a stanza of len bytes, to use up tokens
+static char *
+_stanza_of(size_t len)
+{
+    char *data = malloc(len + 1);
+    memset(data, ' ', len);
+    memcpy(data, "<m>", 3);
+    memcpy(data + len - 4, "</m>", 4);
+    data[len] = '\0';
+
+    return data;
+}
+
+void init_send_queue(void **state)
+{
+    send_queue_init();
+}
+
+void close_send_queue(void **state)
+{
+    send_queue_close();
+}
+
+void send_queue_replaces_item_with_same_key(void **state)
+{
+    _queue("<composing/>", SEND_PRIORITY_LOW, "state:bob");
+    _queue("<paused/>", SEND_PRIORITY_LOW, "state:bob");
+
+    assert_int_equal(1, send_queue_length());
+
+    expect_string(connection_send_raw, data, "<paused/>");
+
+    send_queue_flush(FALSE);
+}
+
+void send_queue_drop_removes_keyed_item(void **state)
+{
+    _queue("<composing/>", SEND_PRIORITY_LOW, "state:bob");
+
+    send_queue_drop("state:bob");
+
+    assert_int_equal(0, send_queue_length());
+}
+
+void send_queue_keeps_order_across_priorities(void **state)
+{
+    _queue("<message id='1'/>", SEND_PRIORITY_NORMAL, NULL);
+    _queue("<composing/>", SEND_PRIORITY_LOW, "state:bob");
+    _queue("<iq id='2'/>", SEND_PRIORITY_HIGH, NULL);
+
+    expect_string(connection_send_raw, data, "<message id='1'/>");
+    expect_string(connection_send_raw, data, "<composing/>");
+    expect_string(connection_send_raw, data, "<iq id='2'/>");
+
+    send_queue_flush(FALSE);
+
+    assert_int_equal(0, send_queue_length());
+}
+
+void send_queue_drops_oldest_low_beyond_max(void **state)
+{
+    char *states[SEND_QUEUE_MAX_LOW + 1];
+    int i;
+    for (i = 0; i <= SEND_QUEUE_MAX_LOW; i++) {
+        states[i] = g_strdup_printf("<state n='%d'/>", i);
+        _queue(states[i], SEND_PRIORITY_LOW, NULL);
+    }
+    _queue("<message/>", SEND_PRIORITY_NORMAL, NULL);
+
+    assert_int_equal(SEND_QUEUE_MAX_LOW + 1, send_queue_length());
+
+    for (i = 1; i <= SEND_QUEUE_MAX_LOW; i++) {
+        expect_string(connection_send_raw, data, states[i]);
+    }
+    expect_string(connection_send_raw, data, "<message/>");
+
+    send_queue_flush(TRUE);
+
+    for (i = 0; i <= SEND_QUEUE_MAX_LOW; i++) {
+        g_free(states[i]);
+    }
+}
+
+void send_queue_holds_items_once_burst_spent(void **state)
+{
+    char *half = _stanza_of(SEND_QUEUE_BURST / 2 + 500);
+    _queue(half, SEND_PRIORITY_NORMAL, NULL);
+    _queue(half, SEND_PRIORITY_NORMAL, NULL);
+    _queue("<message/>", SEND_PRIORITY_NORMAL, NULL);
+
+    expect_string(connection_send_raw, data, half);
+    expect_string(connection_send_raw, data, half);
+
+    send_queue_flush(FALSE);
+
+    assert_int_equal(1, send_queue_length());
+    free(half);
+}
+
+void send_queue_high_priority_overdraws_bucket(void **state)
+{
+    char *full = _stanza_of(SEND_QUEUE_BURST + 1000);
+    _queue(full, SEND_PRIORITY_NORMAL, NULL);
+    expect_string(connection_send_raw, data, full);
+    send_queue_flush(FALSE);
+    free(full);
+
+    _queue("<message/>", SEND_PRIORITY_NORMAL, NULL);
+    send_queue_flush(FALSE);
+    assert_int_equal(1, send_queue_length());
+
+    _queue("<iq/>", SEND_PRIORITY_HIGH, NULL);
+    _queue("<presence/>", SEND_PRIORITY_NORMAL, NULL);
+
+    expect_string(connection_send_raw, data, "<message/>");
+    expect_string(connection_send_raw, data, "<iq/>");
+
+    send_queue_flush(FALSE);
+
+    assert_int_equal(1, send_queue_length());
+}
+
+void send_queue_refills_over_time(void **state)
+{
+    char *full = _stanza_of(SEND_QUEUE_BURST + 1000);
+    _queue(full, SEND_PRIORITY_NORMAL, NULL);
+    expect_string(connection_send_raw, data, full);
+    send_queue_flush(FALSE);
+    free(full);
+
+    _queue("<message/>", SEND_PRIORITY_NORMAL, NULL);
+    send_queue_flush(FALSE);
+    assert_int_equal(1, send_queue_length());
+
+    // 32768 bytes a second covers the 1000 byte overdraw in 100ms
+    g_usleep(100000);
+
+    expect_string(connection_send_raw, data, "<message/>");
+
+    send_queue_flush(FALSE);
+
+    assert_int_equal(0, send_queue_length());
+}
+
+void send_queue_flush_all_ignores_bucket(void **state)
+{
+    char *full = _stanza_of(SEND_QUEUE_BURST + 1000);
+    _queue(full, SEND_PRIORITY_NORMAL, NULL);
+    _queue("<message/>", SEND_PRIORITY_NORMAL, NULL);
+
+    expect_string(connection_send_raw, data, full);
+    expect_string(connection_send_raw, data, "<message/>");
+
+    send_queue_flush(TRUE);
+
+    assert_int_equal(0, send_queue_length());
+    free(full);
+}
@@ -0,0 +1,10 @@
+void init_send_queue(void **state);
+void close_send_queue(void **state);
+void send_queue_replaces_item_with_same_key(void **state);
+void send_queue_drop_removes_keyed_item(void **state);
+void send_queue_keeps_order_across_priorities(void **state);
+void send_queue_drops_oldest_low_beyond_max(void **state);
+void send_queue_holds_items_once_burst_spent(void **state);
+void send_queue_high_priority_overdraws_bucket(void **state);
+void send_queue_refills_over_time(void **state);
+void send_queue_flush_all_ignores_bucket(void **state);
@@ -210,3 +210,89 @@ void lost_connection_clears_chat_sessions(void **state)
     assert_null(session1);
     assert_null(session2);
 }
+
+void room_history_skips_message_already_shown(void **state)
+{
+    muc_init();
+    GTimeVal tv_stamp = { 1425204000, 0 };
+    handle_room_message("room@server.org", "bob", "hello");
+
+    handle_room_history("room@server.org", "bob", tv_stamp, "hello");
+
+    muc_close();
+}
+
+void room_history_shows_message_not_seen(void **state)
+{
+    muc_init();
+    GTimeVal tv_stamp = { 1425204000, 0 };
+    GTimeVal tv_later = { 1425204060, 0 };
+    handle_room_message("room@server.org", "bob", "hello");
+
+    expect_string(ui_room_history, message, "hello again");
+    expect_string(ui_room_history, message, "hello again");
+
+    handle_room_history("room@server.org", "bob", tv_stamp, "hello again");
+    handle_room_history("room@server.org", "bob", tv_later, "hello again");
+
+    muc_close();
+}
+
+void room_history_shows_repeat_of_message_shown(void **state)
+{
+    muc_init();
+    GTimeVal tv_stamp = { 1425204000, 0 };
+    GTimeVal tv_later = { 1425204060, 0 };
+    handle_room_message("room@server.org", "bob", "ok");
+
+    expect_string(ui_room_history, message, "ok");
+
+    handle_room_history("room@server.org", "bob", tv_stamp, "ok");
+    handle_room_history("room@server.org", "bob", tv_later, "ok");
+
+    muc_close();
+}
+
+void room_history_shows_message_stamped_after_margin(void **state)
+{
+    muc_init();
+    GTimeVal tv_stamp;
+    g_get_current_time(&tv_stamp);
+    tv_stamp.tv_sec += MUC_HISTORY_MARGIN + 60;
+    handle_room_message("room@server.org", "bob", "ok");
+
+    expect_string(ui_room_history, message, "ok");
+
+    handle_room_history("room@server.org", "bob", tv_stamp, "ok");
+
+    muc_close();
+}
+
+void room_history_marks_last_message_with_server_stamp(void **state)
+{
+    muc_init();
+    GTimeVal tv_stamp = { 1425204000, 0 };
+    expect_any(ui_room_history, message);
+
+    handle_room_history("room@server.org", "bob", tv_stamp, "hello");
+
+    GDateTime *stamp = g_date_time_new_from_timeval_utc(&tv_stamp);
+    assert_true(g_date_time_equal(muc_last_message("room@server.org"), stamp));
+
+    g_date_time_unref(stamp);
+    muc_close();
+}
+
+void room_message_marks_last_message_before_now(void **state)
+{
+    muc_init();
+    GDateTime *now = g_date_time_new_now_utc();
+
+    handle_room_message("room@server.org", "bob", "hello");
+
+    GTimeSpan behind = g_date_time_difference(now, muc_last_message("room@server.org"));
+    assert_true(behind >= (MUC_HISTORY_MARGIN - 1) * G_TIME_SPAN_SECOND);
+
+    g_date_time_unref(now);
+    muc_close();
+}
@@ -12,3 +12,9 @@ void handle_presence_error_when_no_recipient(void **state);
 void handle_presence_error_when_from_recipient(void **state);
 void handle_offline_removes_chat_session(void **state);
 void lost_connection_clears_chat_sessions(void **state);
+void room_history_skips_message_already_shown(void **state);
+void room_history_shows_message_not_seen(void **state);
+void room_history_shows_repeat_of_message_shown(void **state);
+void room_history_shows_message_stamped_after_margin(void **state);
+void room_history_marks_last_message_with_server_stamp(void **state);
+void room_message_marks_last_message_before_now(void **state);
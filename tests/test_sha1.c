@@ -0,0 +1,89 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tools/p_sha1.h"
+
+static void
+_digest_hex(const uint8_t *data, size_t len, size_t chunk, char *hex)
+{
+    P_SHA1_CTX ctx;
+    uint8_t digest[P_SHA1_DIGEST_SIZE];
+    size_t done = 0;
+
+    P_SHA1_Init(&ctx);
+    while (done < len) {
+        size_t next = (len - done < chunk) ? len - done : chunk;
+        P_SHA1_Update(&ctx, data + done, next);
+        done += next;
+    }
+    P_SHA1_Final(&ctx, digest);
+
+    int i;
+    for (i = 0; i < P_SHA1_DIGEST_SIZE; i++) {
+        sprintf(hex + (i * 2), "%02x", digest[i]);
+    }
+}
+
+void sha1_fips_abc(void **state)
+{
+    char hex[41];
+    _digest_hex((uint8_t *)"abc", 3, 3, hex);
+
+    assert_string_equal("a9993e364706816aba3e25717850c26c9cd0d89d", hex);
+}
+
+void sha1_fips_two_blocks(void **state)
+{
+    char *inp = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    char hex[41];
+    _digest_hex((uint8_t *)inp, strlen(inp), strlen(inp), hex);
+
+    assert_string_equal("84983e441c3bd26ebaae4aa1f95129e5e54670f1", hex);
+}
+
+void sha1_fips_million_a(void **state)
+{
+    uint8_t *inp = malloc(1000000);
+    memset(inp, 'a', 1000000);
+    char hex[41];
+    _digest_hex(inp, 1000000, 4099, hex);
+
+    assert_string_equal("34aa973cd4c4daa4f61eeb2bdbad27316534016f", hex);
+    free(inp);
+}
+
+void sha1_accelerated_matches_portable(void **state)
+{
+    const char *name = NULL;
+    P_SHA1_BlocksFunc accelerated = P_SHA1_Blocks_accelerated(&name);
+    if (accelerated == NULL) {
+        accelerated = P_SHA1_Blocks_portable;
+        name = "portable";
+    }
+
+    uint8_t data[1100];
+    int i;
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = (i * 131 + 7) & 0xff;
+    }
+
+    size_t len;
+    for (len = 0; len < sizeof(data); len += 13) {
+        char expected[41];
+        char actual[41];
+
+        P_SHA1_Set_Blocks(P_SHA1_Blocks_portable, "portable");
+        _digest_hex(data, len, 70, expected);
+        P_SHA1_Set_Blocks(accelerated, name);
+        _digest_hex(data, len, 70, actual);
+
+        assert_string_equal(expected, actual);
+    }
+
+    P_SHA1_Set_Blocks(NULL, NULL);
+}
@@ -0,0 +1,4 @@
+void sha1_fips_abc(void **state);
+void sha1_fips_two_blocks(void **state);
+void sha1_fips_million_a(void **state);
+void sha1_accelerated_matches_portable(void **state);
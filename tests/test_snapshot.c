@@ -0,0 +1,130 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "config/preferences.h"
+#include "ui/buffer.h"
+#include "ui/window.h"
+#include "ui/snapshot.h"
+
+static void
+_push(ProfBuff buffer, const char show_char, int flags, const char * const from, const char * const message)
+{
+    buffer_push(buffer, show_char, g_date_time_new_from_unix_local(1400000000 + flags), flags, 0, from, message);
+}
+
+static void
+_reader_init(SnapshotReader *reader, GString *data, gsize len)
+{
+    reader->pos = data->str;
+    reader->end = data->str + len;
+    reader->error = FALSE;
+}
+
+static void
+_chatwin_init(ProfChatWin *chatwin)
+{
+    memset(chatwin, 0, sizeof(ProfChatWin));
+    chatwin->window.type = WIN_CHAT;
+    chatwin->barejid = "bob@server.org";
+    chatwin->memcheck = PROFCHATWIN_MEMCHECK;
+}
+
+static void
+_entry_free(ProfBuffEntry *entry)
+{
+    free(entry->from);
+    free(entry->message);
+    g_date_time_unref(entry->time);
+}
+
+void snapshot_entries_round_trip(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, '-', 1, "bob", "hello");
+    _push(buffer, '!', 2, "", "");
+    GString *out = g_string_new(NULL);
+
+    snapshot_put_entries(out, buffer);
+
+    SnapshotReader reader;
+    _reader_init(&reader, out, out->len);
+    guint32 count;
+    memcpy(&count, reader.pos, sizeof(count));
+    reader.pos += sizeof(count);
+    assert_int_equal(2, count);
+
+    ProfBuffEntry e;
+    assert_true(snapshot_get_entry(&reader, &e));
+    assert_int_equal('-', e.show_char);
+    assert_int_equal(1, e.flags);
+    assert_int_equal(1400000001, g_date_time_to_unix(e.time));
+    assert_string_equal("bob", e.from);
+    assert_string_equal("hello", e.message);
+    _entry_free(&e);
+
+    assert_true(snapshot_get_entry(&reader, &e));
+    assert_int_equal('!', e.show_char);
+    assert_string_equal("", e.from);
+    assert_string_equal("", e.message);
+    _entry_free(&e);
+
+    assert_false(snapshot_get_entry(&reader, &e));
+    assert_true(reader.pos == out->str + out->len);
+
+    g_string_free(out, TRUE);
+    buffer_free(buffer);
+}
+
+void snapshot_get_entry_fails_on_truncated_data(void **state)
+{
+    ProfBuff buffer = buffer_create();
+    _push(buffer, '-', 1, "bob", "hello");
+    GString *out = g_string_new(NULL);
+    snapshot_put_entries(out, buffer);
+
+    SnapshotReader reader;
+    _reader_init(&reader, out, out->len - 1);
+    reader.pos += sizeof(guint32);
+
+    ProfBuffEntry e;
+    assert_false(snapshot_get_entry(&reader, &e));
+    assert_true(reader.error);
+
+    g_string_free(out, TRUE);
+    buffer_free(buffer);
+}
+
+void snapshot_saves_logged_chat_window(void **state)
+{
+    prefs_set_boolean(PREF_CHLOG, TRUE);
+    ProfChatWin chatwin;
+    _chatwin_init(&chatwin);
+
+    assert_true(snapshot_win_saved((ProfWin*)&chatwin));
+}
+
+void snapshot_skips_chat_window_in_otr_session(void **state)
+{
+    prefs_set_boolean(PREF_CHLOG, TRUE);
+    ProfChatWin chatwin;
+    _chatwin_init(&chatwin);
+    chatwin.is_otr = TRUE;
+
+    assert_false(snapshot_win_saved((ProfWin*)&chatwin));
+}
+
+void snapshot_skips_chat_window_after_otr_ended(void **state)
+{
+    prefs_set_boolean(PREF_CHLOG, TRUE);
+    ProfChatWin chatwin;
+    _chatwin_init(&chatwin);
+    chatwin.is_otr = FALSE;
+    chatwin.was_otr = TRUE;
+
+    assert_false(snapshot_win_saved((ProfWin*)&chatwin));
+}
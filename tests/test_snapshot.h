@@ -0,0 +1,5 @@
+void snapshot_entries_round_trip(void **state);
+void snapshot_get_entry_fails_on_truncated_data(void **state);
+void snapshot_saves_logged_chat_window(void **state);
+void snapshot_skips_chat_window_in_otr_session(void **state);
+void snapshot_skips_chat_window_after_otr_ended(void **state);
@@ -0,0 +1,95 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "xmpp/stanza.h"
+#include "xmpp/stanza_writer.h"
+
+void
+escape_leaves_plain_text(void **state)
+{
+    GString *buf = g_string_new("");
+
+    stanza_writer_append_escaped(buf, "hello there", FALSE);
+
+    assert_string_equal("hello there", buf->str);
+
+    g_string_free(buf, TRUE);
+}
+
+void
+escape_text_keeps_quotes(void **state)
+{
+    GString *buf = g_string_new("");
+
+    stanza_writer_append_escaped(buf, "<a href=\"x\">&'</a>", FALSE);
+
+    assert_string_equal("&lt;a href=\"x\"&gt;&amp;'&lt;/a&gt;", buf->str);
+
+    g_string_free(buf, TRUE);
+}
+
+void
+escape_attr_escapes_quotes(void **state)
+{
+    GString *buf = g_string_new("");
+
+    stanza_writer_append_escaped(buf, "o'neil\"&<>", TRUE);
+
+    assert_string_equal("o&apos;neil&quot;&amp;&lt;&gt;", buf->str);
+
+    g_string_free(buf, TRUE);
+}
+
+void
+write_message_with_state_and_private(void **state)
+{
+    GString *buf = g_string_new("");
+
+    stanza_write_message(buf, "prof_1", "buddy@server.org/laptop", STANZA_TYPE_CHAT,
+        "hi", STANZA_NAME_ACTIVE, TRUE);
+
+    assert_string_equal(
+        "<message type=\"chat\" to=\"buddy@server.org/laptop\" id=\"prof_1\">"
+        "<body>hi</body>"
+        "<active xmlns=\"http://jabber.org/protocol/chatstates\"/>"
+        "<private xmlns=\"urn:xmpp:carbons:2\"/>"
+        "</message>", buf->str);
+
+    g_string_free(buf, TRUE);
+}
+
+void
+write_groupchat_message_escapes_body(void **state)
+{
+    GString *buf = g_string_new("");
+
+    stanza_write_message(buf, "prof_2", "room@conference.server.org", STANZA_TYPE_GROUPCHAT,
+        "a < b && c > d", NULL, FALSE);
+
+    assert_string_equal(
+        "<message type=\"groupchat\" to=\"room@conference.server.org\" id=\"prof_2\">"
+        "<body>a &lt; b &amp;&amp; c &gt; d</body>"
+        "</message>", buf->str);
+
+    g_string_free(buf, TRUE);
+}
+
+void
+write_chat_state(void **state)
+{
+    GString *buf = g_string_new("");
+
+    stanza_write_chat_state(buf, "prof_3", "buddy@server.org", STANZA_NAME_COMPOSING);
+
+    assert_string_equal(
+        "<message type=\"chat\" to=\"buddy@server.org\" id=\"prof_3\">"
+        "<composing xmlns=\"http://jabber.org/protocol/chatstates\"/>"
+        "</message>", buf->str);
+
+    g_string_free(buf, TRUE);
+}
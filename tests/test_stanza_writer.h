@@ -0,0 +1,6 @@
+void escape_leaves_plain_text(void **state);
+void escape_text_keeps_quotes(void **state);
+void escape_attr_escapes_quotes(void **state);
+void write_message_with_state_and_private(void **state);
+void write_groupchat_message_escapes_body(void **state);
+void write_chat_state(void **state);
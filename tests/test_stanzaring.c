@@ -0,0 +1,178 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "tools/stanzaring.h"
+
+static void
+_push(StanzaRing *ring, stanza_dir_t dir, const char * const xml)
+{
+    stanza_ring_push(ring, dir, xml, strlen(xml));
+}
+
+void
+stanza_ring_tail_returns_newest_in_order(void **state)
+{
+    StanzaRing *ring = stanza_ring_new(4096);
+    _push(ring, STANZA_DIR_OUT, "<iq id='1'/>");
+    _push(ring, STANZA_DIR_IN, "<iq id='2'/>");
+    _push(ring, STANZA_DIR_IN, "<iq id='3'/>");
+
+    GSList *tail = stanza_ring_tail(ring, NULL, 2);
+
+    assert_int_equal(2, g_slist_length(tail));
+    StanzaRecord *first = tail->data;
+    StanzaRecord *second = tail->next->data;
+    assert_string_equal("<iq id='2'/>", first->xml);
+    assert_string_equal("<iq id='3'/>", second->xml);
+    assert_int_equal(STANZA_KIND_IQ, first->kind);
+    assert_int_equal(STANZA_DIR_IN, first->dir);
+
+    g_slist_free_full(tail, (GDestroyNotify)stanza_record_free);
+    stanza_ring_free(ring);
+}
+
+void
+stanza_ring_drops_oldest_when_full(void **state)
+{
+    StanzaRing *ring = stanza_ring_new(1024);
+    char xml[64];
+    int i;
+    for (i = 0; i < 200; i++) {
+        g_snprintf(xml, sizeof(xml), "<message id='%d'/>", i);
+        _push(ring, STANZA_DIR_IN, xml);
+    }
+
+    assert_true(stanza_ring_bytes(ring) <= 1024);
+    assert_true(stanza_ring_count(ring) < 200);
+
+    GSList *tail = stanza_ring_tail(ring, NULL, 1000);
+    assert_int_equal(stanza_ring_count(ring), g_slist_length(tail));
+    StanzaRecord *last = g_slist_last(tail)->data;
+    assert_string_equal("<message id='199'/>", last->xml);
+
+    g_slist_free_full(tail, (GDestroyNotify)stanza_record_free);
+    stanza_ring_free(ring);
+}
+
+void
+stanza_ring_truncates_large_stanza(void **state)
+{
+    StanzaRing *ring = stanza_ring_new(1024);
+    char *xml = g_strnfill(2000, 'x');
+    _push(ring, STANZA_DIR_OUT, xml);
+
+    GSList *tail = stanza_ring_tail(ring, NULL, 1);
+    StanzaRecord *record = tail->data;
+    assert_true(record->truncated);
+    assert_true(strlen(record->xml) < 1024 / 4);
+    assert_int_equal(STANZA_KIND_OTHER, record->kind);
+
+    g_slist_free_full(tail, (GDestroyNotify)stanza_record_free);
+    g_free(xml);
+    stanza_ring_free(ring);
+}
+
+void
+stanza_ring_tail_applies_filter(void **state)
+{
+    StanzaRing *ring = stanza_ring_new(4096);
+    _push(ring, STANZA_DIR_IN, "<message from='buddy@server.org/laptop'/>");
+    _push(ring, STANZA_DIR_IN, "<presence from='buddy@server.org/laptop'/>");
+    _push(ring, STANZA_DIR_OUT, "<message to='buddy@server.org'/>");
+    _push(ring, STANZA_DIR_IN, "<message from='other@server.org'/>");
+
+    StanzaFilter filter;
+    filter.dir = STANZA_DIR_IN;
+    filter.kind = STANZA_KIND_MESSAGE;
+    filter.jid = "buddy@server.org";
+    GSList *tail = stanza_ring_tail(ring, &filter, 10);
+
+    assert_int_equal(1, g_slist_length(tail));
+    StanzaRecord *record = tail->data;
+    assert_string_equal("<message from='buddy@server.org/laptop'/>", record->xml);
+
+    g_slist_free_full(tail, (GDestroyNotify)stanza_record_free);
+    stanza_ring_free(ring);
+}
+
+void
+stanza_has_jid_matches_barejid(void **state)
+{
+    const char *xml = "<message to=\"buddy@server.org/phone\"><body>buddy@server.org.uk</body></message>";
+
+    assert_true(stanza_has_jid(xml, strlen(xml), "buddy@server.org"));
+    assert_true(stanza_has_jid(xml, strlen(xml), "buddy@server.org/phone"));
+    assert_false(stanza_has_jid(xml, strlen(xml), "buddy@server"));
+    assert_false(stanza_has_jid(xml, strlen(xml), "server.org"));
+}
+
+void
+stanza_pretty_indents_children(void **state)
+{
+    GString *pretty = stanza_pretty("<iq id='1'><query><item jid='a@b'/><group>Friends</group></query></iq>");
+
+    assert_string_equal(
+        "<iq id='1'>\n"
+        "  <query>\n"
+        "    <item jid='a@b'/>\n"
+        "    <group>Friends</group>\n"
+        "  </query>\n"
+        "</iq>", pretty->str);
+
+    g_string_free(pretty, TRUE);
+}
+
+void
+stanza_ring_newer_skips_seen_records(void **state)
+{
+    StanzaRing *ring = stanza_ring_new(4096);
+    _push(ring, STANZA_DIR_OUT, "<iq id='1'/>");
+    _push(ring, STANZA_DIR_IN, "<iq id='2'/>");
+    guint64 seen = stanza_ring_last_seq(ring);
+    _push(ring, STANZA_DIR_IN, "<iq id='3'/>");
+
+    GSList *newer = stanza_ring_newer(ring, NULL, seen, 10);
+
+    assert_int_equal(1, g_slist_length(newer));
+    StanzaRecord *record = newer->data;
+    assert_string_equal("<iq id='3'/>", record->xml);
+    assert_int_equal(3, record->seq);
+
+    g_slist_free_full(newer, (GDestroyNotify)stanza_record_free);
+    stanza_ring_free(ring);
+}
+
+void
+stanza_ring_seq_survives_eviction_and_clear(void **state)
+{
+    StanzaRing *ring = stanza_ring_new(1024);
+    char xml[64];
+    int i;
+    for (i = 1; i <= 200; i++) {
+        g_snprintf(xml, sizeof(xml), "<message id='%d'/>", i);
+        _push(ring, STANZA_DIR_IN, xml);
+    }
+
+    GSList *newer = stanza_ring_newer(ring, NULL, 198, 10);
+    assert_int_equal(2, g_slist_length(newer));
+    StanzaRecord *record = newer->data;
+    assert_string_equal("<message id='199'/>", record->xml);
+    assert_int_equal(199, record->seq);
+    g_slist_free_full(newer, (GDestroyNotify)stanza_record_free);
+
+    stanza_ring_clear(ring);
+    _push(ring, STANZA_DIR_IN, "<message id='201'/>");
+
+    newer = stanza_ring_newer(ring, NULL, 200, 10);
+    assert_int_equal(1, g_slist_length(newer));
+    record = newer->data;
+    assert_int_equal(201, record->seq);
+
+    g_slist_free_full(newer, (GDestroyNotify)stanza_record_free);
+    stanza_ring_free(ring);
+}
@@ -0,0 +1,8 @@
+void stanza_ring_tail_returns_newest_in_order(void **state);
+void stanza_ring_drops_oldest_when_full(void **state);
+void stanza_ring_truncates_large_stanza(void **state);
+void stanza_ring_tail_applies_filter(void **state);
+void stanza_has_jid_matches_barejid(void **state);
+void stanza_pretty_indents_children(void **state);
+void stanza_ring_newer_skips_seen_records(void **state);
+void stanza_ring_seq_survives_eviction_and_clear(void **state);
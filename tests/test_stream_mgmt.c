@@ -0,0 +1,153 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "xmpp/send_queue.h"
+#include "xmpp/stream_mgmt.h"
+
+#define MESSAGE_ONE "<message id=\"one\"><body>one</body></message>"
+#define MESSAGE_TWO "<message id=\"two\"><body>two</body></message>"
+
+static void
+_queue(const char * const data, send_priority_t priority)
+{
+    send_queue_raw(data, strlen(data), priority, NULL);
+}
+
+static void
+_sent(const char * const data)
+{
+    stream_mgmt_sent(data, strlen(data));
+}
+
+static void
+_enable(void)
+{
+    expect_string(connection_send_raw, data, "<enable xmlns='urn:xmpp:sm:3'/>");
+    stream_mgmt_enable();
+    stream_mgmt_handle_enabled();
+}
+
+void init_stream_mgmt(void **state)
+{
+    send_queue_init();
+    stream_mgmt_init();
+}
+
+void close_stream_mgmt(void **state)
+{
+    stream_mgmt_close();
+    send_queue_close();
+}
+
+void stream_mgmt_enable_starts_counting(void **state)
+{
+    assert_false(stream_mgmt_counting());
+
+    _enable();
+
+    assert_true(stream_mgmt_counting());
+}
+
+void stream_mgmt_answers_request_with_handled_count(void **state)
+{
+    _enable();
+    stream_mgmt_handle_inbound("message");
+    stream_mgmt_handle_inbound("presence");
+    stream_mgmt_handle_inbound("iq");
+    stream_mgmt_handle_inbound("r");
+
+    expect_string(connection_send_raw, data, "<a xmlns='urn:xmpp:sm:3' h='3'/>");
+
+    stream_mgmt_handle_request();
+}
+
+void stream_mgmt_ack_releases_acked_messages(void **state)
+{
+    _enable();
+    _sent(MESSAGE_ONE);
+    _sent("<presence/>");
+    _sent(MESSAGE_TWO);
+
+    assert_int_equal(2, stream_mgmt_unacked_count());
+
+    stream_mgmt_handle_ack(2);
+
+    assert_int_equal(1, stream_mgmt_unacked_count());
+
+    stream_mgmt_handle_ack(3);
+
+    assert_int_equal(0, stream_mgmt_unacked_count());
+}
+
+void stream_mgmt_request_ack_once_until_answered(void **state)
+{
+    _enable();
+    _sent(MESSAGE_ONE);
+
+    expect_string(connection_send_raw, data, "<r xmlns='urn:xmpp:sm:3'/>");
+
+    stream_mgmt_request_ack();
+    stream_mgmt_request_ack();
+}
+
+void stream_mgmt_seq_acked_wraps(void **state)
+{
+    assert_true(stream_mgmt_seq_acked(5, 5));
+    assert_false(stream_mgmt_seq_acked(6, 5));
+    assert_true(stream_mgmt_seq_acked(0xFFFFFFFF, 0));
+    assert_true(stream_mgmt_seq_acked(0xFFFFFFFF, 2));
+    assert_false(stream_mgmt_seq_acked(1, 0xFFFFFFFF));
+    assert_false(stream_mgmt_seq_acked(0, 0xFFFFFFFF));
+}
+
+void stream_mgmt_session_lost_resends_unacked_then_queued(void **state)
+{
+    _enable();
+    _sent(MESSAGE_ONE);
+    _queue(MESSAGE_TWO, SEND_PRIORITY_NORMAL);
+    _queue("<presence/>", SEND_PRIORITY_HIGH);
+
+    stream_mgmt_session_lost();
+
+    assert_int_equal(2, stream_mgmt_resend_count());
+    assert_int_equal(0, stream_mgmt_unacked_count());
+    assert_int_equal(1, send_queue_length());
+
+    send_queue_clear();
+    stream_mgmt_resend();
+
+    assert_int_equal(0, stream_mgmt_resend_count());
+
+    expect_string(connection_send_raw, data, MESSAGE_ONE);
+    expect_string(connection_send_raw, data, MESSAGE_TWO);
+
+    send_queue_flush(TRUE);
+}
+
+void stream_mgmt_session_lost_keeps_queued_without_sm(void **state)
+{
+    _queue(MESSAGE_ONE, SEND_PRIORITY_NORMAL);
+
+    stream_mgmt_session_lost();
+
+    assert_int_equal(1, stream_mgmt_resend_count());
+    assert_int_equal(0, send_queue_length());
+}
+
+void stream_mgmt_session_lost_never_resends_otr_or_states(void **state)
+{
+    _enable();
+    _sent("<message id=\"otr1\"><body>?OTR:AAMD</body></message>");
+    _queue("<message id=\"otr2\"><body>?OTR:AAMC</body></message>", SEND_PRIORITY_NORMAL);
+    _queue("<message to=\"bob@server.org\"><composing/></message>", SEND_PRIORITY_LOW);
+
+    stream_mgmt_session_lost();
+
+    assert_int_equal(0, stream_mgmt_resend_count());
+    assert_int_equal(0, send_queue_length());
+}
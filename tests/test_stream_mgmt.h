@@ -0,0 +1,10 @@
+void init_stream_mgmt(void **state);
+void close_stream_mgmt(void **state);
+void stream_mgmt_enable_starts_counting(void **state);
+void stream_mgmt_answers_request_with_handled_count(void **state);
+void stream_mgmt_ack_releases_acked_messages(void **state);
+void stream_mgmt_request_ack_once_until_answered(void **state);
+void stream_mgmt_seq_acked_wraps(void **state);
+void stream_mgmt_session_lost_resends_unacked_then_queued(void **state);
+void stream_mgmt_session_lost_keeps_queued_without_sm(void **state);
+void stream_mgmt_session_lost_never_resends_otr_or_states(void **state);
@@ -0,0 +1,76 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <sys/select.h>
+#include <glib.h>
+
+#include "tools/worker.h"
+
+struct test_job_t {
+    GThread *work_thread;
+    GThread *done_thread;
+};
+
+static void
+_work(gpointer data)
+{
+    struct test_job_t *job = data;
+    job->work_thread = g_thread_self();
+}
+
+static void
+_done(gpointer data)
+{
+    struct test_job_t *job = data;
+    job->done_thread = g_thread_self();
+}
+
+static gboolean
+_wait_for_wakeup(void)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(worker_fd(), &fds);
+    struct timeval timeout = { 5, 0 };
+
+    return (select(worker_fd() + 1, &fds, NULL, NULL, &timeout) == 1);
+}
+
+void worker_submit_runs_inline_without_pool(void **state)
+{
+    struct test_job_t job = { NULL, NULL };
+
+    worker_submit(_work, _done, &job);
+
+    assert_true(job.work_thread == g_thread_self());
+    assert_true(job.done_thread == g_thread_self());
+}
+
+void worker_process_runs_done_on_caller(void **state)
+{
+    struct test_job_t job = { NULL, NULL };
+    worker_init();
+
+    worker_submit(_work, _done, &job);
+
+    assert_true(_wait_for_wakeup());
+    worker_process();
+    assert_true(job.work_thread != g_thread_self());
+    assert_true(job.done_thread == g_thread_self());
+
+    worker_close();
+}
+
+void worker_close_delivers_pending(void **state)
+{
+    struct test_job_t job = { NULL, NULL };
+    worker_init();
+
+    worker_submit(_work, _done, &job);
+    worker_close();
+
+    assert_true(job.work_thread != NULL);
+    assert_true(job.done_thread == g_thread_self());
+}
@@ -0,0 +1,3 @@
+void worker_submit_runs_inline_without_pool(void **state);
+void worker_process_runs_done_on_caller(void **state);
+void worker_close_delivers_pending(void **state);
@@ -22,7 +22,13 @@
 #include "test_cmd_otr.h"
 #include "test_jid.h"
 #include "test_parser.h"
+#include "test_persist.h"
+#include "test_worker.h"
+#include "test_stanzaring.h"
+#include "test_snapshot.h"
 #include "test_roster_list.h"
+#include "test_sha1.h"
+#include "test_stanza_writer.h"
 #include "test_preferences.h"
 #include "test_server_events.h"
 #include "test_cmd_alias.h"
@@ -33,6 +39,13 @@
 #include "test_cmd_win.h"
 #include "test_cmd_disconnect.h"
 #include "test_form.h"
+#include "test_log_index.h"
+#include "test_capabilities.h"
+#include "test_send_queue.h"
+#include "test_stream_mgmt.h"
+#include "test_roster_cache.h"
+#include "test_autojoin.h"
+#include "test_buffer.h"
 
 int main(int argc, char* argv[]) {
     const UnitTest all_tests[] = {
@@ -48,6 +61,164 @@ int main(int argc, char* argv[]) {
         unit_test(replace_when_sub_empty),
         unit_test(replace_when_sub_null),
         unit_test(replace_when_new_empty),
+
+        unit_test(buffer_find_returns_zero_when_no_match),
+        unit_test(buffer_find_ignores_case),
+        unit_test(buffer_find_matches_from),
+        unit_test(buffer_find_starts_at_most_recent),
+        unit_test(buffer_find_older_and_newer_move_between_hits),
+        unit_test(buffer_find_narrows_previous_hits),
+        unit_test(buffer_find_includes_new_entries),
+        unit_test(buffer_find_clear_removes_hits),
+        unit_test(buffer_budget_evicts_least_recently_viewed),
+        unit_test(buffer_budget_keeps_newest_entry),
+        unit_test(buffer_budget_calls_evict_func),
+        unit_test(buffer_push_past_budget_evicts_oldest),
+        unit_test(snapshot_entries_round_trip),
+        unit_test(snapshot_get_entry_fails_on_truncated_data),
+        unit_test_setup_teardown(snapshot_saves_logged_chat_window,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(snapshot_skips_chat_window_in_otr_session,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(snapshot_skips_chat_window_after_otr_ended,
+            load_preferences,
+            close_preferences),
+        unit_test(buffer_bytes_counts_entries),
+
+        unit_test_setup_teardown(log_index_search_finds_logged_line,
+            init_log_index,
+            close_log_index),
+        unit_test_setup_teardown(log_index_search_ignores_case,
+            init_log_index,
+            close_log_index),
+        unit_test_setup_teardown(log_index_search_orders_newest_first,
+            init_log_index,
+            close_log_index),
+        unit_test_setup_teardown(log_index_search_requires_all_words,
+            init_log_index,
+            close_log_index),
+        unit_test_setup_teardown(log_index_search_returns_null_when_no_match,
+            init_log_index,
+            close_log_index),
+        unit_test_setup_teardown(log_index_get_hit_returns_numbered_result,
+            init_log_index,
+            close_log_index),
+        unit_test_setup_teardown(log_index_compacts_removed_days,
+            init_log_index,
+            close_log_index),
+        unit_test_setup_teardown(caps_request_limits_queries_per_bare_jid,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_request_joins_pending_query,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_pending_failed_asks_next_jid,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_pending_failed_ignores_other_jid,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_pending_expire_asks_next_jid,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(caps_pending_expire_releases_slot,
+            init_caps,
+            close_caps),
+        unit_test_setup_teardown(send_queue_replaces_item_with_same_key,
+            init_send_queue,
+            close_send_queue),
+        unit_test_setup_teardown(send_queue_drop_removes_keyed_item,
+            init_send_queue,
+            close_send_queue),
+        unit_test_setup_teardown(send_queue_keeps_order_across_priorities,
+            init_send_queue,
+            close_send_queue),
+        unit_test_setup_teardown(send_queue_drops_oldest_low_beyond_max,
+            init_send_queue,
+            close_send_queue),
+        unit_test_setup_teardown(send_queue_holds_items_once_burst_spent,
+            init_send_queue,
+            close_send_queue),
+        unit_test_setup_teardown(send_queue_high_priority_overdraws_bucket,
+            init_send_queue,
+            close_send_queue),
+        unit_test_setup_teardown(send_queue_refills_over_time,
+            init_send_queue,
+            close_send_queue),
+        unit_test_setup_teardown(send_queue_flush_all_ignores_bucket,
+            init_send_queue,
+            close_send_queue),
+        unit_test_setup_teardown(stream_mgmt_enable_starts_counting,
+            init_stream_mgmt,
+            close_stream_mgmt),
+        unit_test_setup_teardown(stream_mgmt_answers_request_with_handled_count,
+            init_stream_mgmt,
+            close_stream_mgmt),
+        unit_test_setup_teardown(stream_mgmt_ack_releases_acked_messages,
+            init_stream_mgmt,
+            close_stream_mgmt),
+        unit_test_setup_teardown(stream_mgmt_request_ack_once_until_answered,
+            init_stream_mgmt,
+            close_stream_mgmt),
+        unit_test_setup_teardown(stream_mgmt_seq_acked_wraps,
+            init_stream_mgmt,
+            close_stream_mgmt),
+        unit_test_setup_teardown(stream_mgmt_session_lost_resends_unacked_then_queued,
+            init_stream_mgmt,
+            close_stream_mgmt),
+        unit_test_setup_teardown(stream_mgmt_session_lost_keeps_queued_without_sm,
+            init_stream_mgmt,
+            close_stream_mgmt),
+        unit_test_setup_teardown(stream_mgmt_session_lost_never_resends_otr_or_states,
+            init_stream_mgmt,
+            close_stream_mgmt),
+        unit_test_setup_teardown(roster_cache_missing_file_needs_full_fetch,
+            init_roster_cache,
+            close_roster_cache),
+        unit_test_setup_teardown(roster_cache_ver_round_trip,
+            init_roster_cache,
+            close_roster_cache),
+        unit_test_setup_teardown(roster_cache_applies_push,
+            init_roster_cache,
+            close_roster_cache),
+        unit_test_setup_teardown(roster_cache_corrupt_file_needs_full_fetch,
+            init_roster_cache,
+            close_roster_cache),
+        unit_test_setup_teardown(roster_cache_without_ver_needs_full_fetch,
+            init_roster_cache,
+            close_roster_cache),
+        unit_test_setup_teardown(roster_cache_unstorable_jid_needs_full_fetch,
+            init_roster_cache,
+            close_roster_cache),
+        unit_test_setup_teardown(roster_cache_reset_drops_contacts,
+            init_roster_cache,
+            close_roster_cache),
+        unit_test_setup_teardown(autojoin_next_limits_concurrent_joins,
+            init_autojoin,
+            close_autojoin),
+        unit_test_setup_teardown(autojoin_next_keeps_queue_order,
+            init_autojoin,
+            close_autojoin),
+        unit_test_setup_teardown(autojoin_sort_orders_queue,
+            init_autojoin,
+            close_autojoin),
+        unit_test_setup_teardown(autojoin_complete_frees_slot,
+            init_autojoin,
+            close_autojoin),
+        unit_test_setup_teardown(autojoin_complete_ignores_unknown_room,
+            init_autojoin,
+            close_autojoin),
+        unit_test_setup_teardown(autojoin_expire_frees_only_old_joins,
+            init_autojoin,
+            close_autojoin),
+        unit_test_setup_teardown(autojoin_expire_keeps_new_joins,
+            init_autojoin,
+            close_autojoin),
+        unit_test_setup_teardown(autojoin_clear_drops_queue_and_slots,
+            init_autojoin,
+            close_autojoin),
         unit_test(replace_when_new_null),
         unit_test(compare_win_nums_less),
         unit_test(compare_win_nums_equal),
@@ -76,6 +247,10 @@ int main(int argc, char* argv[]) {
         unit_test(test_available_is_not_valid_resource_presence_string),
         unit_test(test_unavailable_is_not_valid_resource_presence_string),
         unit_test(test_blah_is_not_valid_resource_presence_string),
+        unit_test(sha1_fips_abc),
+        unit_test(sha1_fips_two_blocks),
+        unit_test(sha1_fips_million_a),
+        unit_test(sha1_accelerated_matches_portable),
         unit_test(test_p_sha1_hash1),
         unit_test(test_p_sha1_hash2),
         unit_test(test_p_sha1_hash3),
@@ -83,6 +258,14 @@ int main(int argc, char* argv[]) {
         unit_test(test_p_sha1_hash5),
         unit_test(test_p_sha1_hash6),
         unit_test(test_p_sha1_hash7),
+
+        unit_test(escape_leaves_plain_text),
+        unit_test(escape_text_keeps_quotes),
+        unit_test(escape_attr_escapes_quotes),
+        unit_test(write_message_with_state_and_private),
+        unit_test(write_groupchat_message_escapes_body),
+        unit_test(write_chat_state),
+
         unit_test(utf8_display_len_null_str),
         unit_test(utf8_display_len_1_non_wide),
         unit_test(utf8_display_len_1_wide),
@@ -93,6 +276,11 @@ int main(int argc, char* argv[]) {
         unit_test(strip_quotes_strips_first),
         unit_test(strip_quotes_strips_last),
         unit_test(strip_quotes_strips_both),
+        unit_test(gzip_file_reads_back_and_removes_original),
+        unit_test(gzip_file_appends_to_existing_archive),
+        unit_test(gzip_file_missing_original_leaves_archive),
+        unit_test(write_private_file_is_user_only),
+        unit_test(write_private_file_reports_error),
 
         unit_test(clear_empty),
         unit_test(reset_after_create),
@@ -104,6 +292,7 @@ int main(int argc, char* argv[]) {
         unit_test(add_two_adds_two),
         unit_test(add_two_same_adds_one),
         unit_test(add_two_same_updates),
+        unit_test(add_all_adds_sorted_without_duplicates),
 
         unit_test(create_jid_from_null_returns_null),
         unit_test(create_jid_from_empty_string_returns_null),
@@ -334,6 +523,8 @@ int main(int argc, char* argv[]) {
         unit_test(cmd_account_show_message_for_missing_otr_policy),
         unit_test(cmd_account_show_message_for_invalid_otr_policy),
         unit_test(cmd_account_set_otr_sets_otr),
+        unit_test(cmd_account_show_message_for_invalid_compression_estimate),
+        unit_test(cmd_account_set_compression_estimate_sets_compression_estimate),
 #endif
         unit_test(cmd_account_set_status_shows_message_when_invalid_status),
         unit_test(cmd_account_set_status_sets_status_when_valid),
@@ -424,6 +615,50 @@ int main(int argc, char* argv[]) {
         unit_test_setup_teardown(statuses_muc_defaults_to_all,
             load_preferences,
             close_preferences),
+        unit_test_setup_teardown(log_generations_defaults_to_one,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(log_generations_out_of_range_defaults_to_one,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(persist_mark_dirty_defers_write,
+            create_config_dir,
+            remove_config_dir),
+        unit_test_setup_teardown(persist_flush_writes_keyfile,
+            create_config_dir,
+            remove_config_dir),
+        unit_test_setup_teardown(persist_store_free_flushes_pending,
+            create_config_dir,
+            remove_config_dir),
+        unit_test_setup_teardown(persist_flush_to_missing_dir_leaves_no_file,
+            create_config_dir,
+            remove_config_dir),
+        unit_test_setup_teardown(persist_write_replaces_file_privately,
+            create_config_dir,
+            remove_config_dir),
+        unit_test(worker_submit_runs_inline_without_pool),
+        unit_test(worker_process_runs_done_on_caller),
+        unit_test(worker_close_delivers_pending),
+        unit_test(stanza_ring_tail_returns_newest_in_order),
+        unit_test(stanza_ring_drops_oldest_when_full),
+        unit_test(stanza_ring_truncates_large_stanza),
+        unit_test(stanza_ring_tail_applies_filter),
+        unit_test(stanza_ring_newer_skips_seen_records),
+        unit_test(stanza_ring_seq_survives_eviction_and_clear),
+        unit_test(stanza_has_jid_matches_barejid),
+        unit_test(stanza_pretty_indents_children),
+        unit_test_setup_teardown(log_compress_defaults_to_off,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(peek_string_returns_default,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(peek_string_returns_set_value,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(get_boolean_returns_set_value,
+            load_preferences,
+            close_preferences),
 
         unit_test_setup_teardown(console_doesnt_show_online_presence_when_set_none,
             load_preferences,
@@ -455,6 +690,24 @@ int main(int argc, char* argv[]) {
         unit_test(handle_presence_error_when_from_recipient),
         unit_test(handle_offline_removes_chat_session),
         unit_test(lost_connection_clears_chat_sessions),
+        unit_test_setup_teardown(room_history_skips_message_already_shown,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(room_history_shows_message_not_seen,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(room_history_shows_repeat_of_message_shown,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(room_history_shows_message_stamped_after_margin,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(room_history_marks_last_message_with_server_stamp,
+            load_preferences,
+            close_preferences),
+        unit_test_setup_teardown(room_message_marks_last_message_before_now,
+            load_preferences,
+            close_preferences),
 
         unit_test(cmd_alias_add_shows_usage_when_no_args),
         unit_test(cmd_alias_add_shows_usage_when_no_value),
@@ -482,6 +735,15 @@ int main(int argc, char* argv[]) {
         unit_test_setup_teardown(test_muc_invites_count_5, muc_before_test, muc_after_test),
         unit_test_setup_teardown(test_muc_room_is_not_active, muc_before_test, muc_after_test),
         unit_test_setup_teardown(test_muc_active, muc_before_test, muc_after_test),
+        unit_test_setup_teardown(test_muc_last_message_keeps_newest, muc_before_test, muc_after_test),
+        unit_test_setup_teardown(test_muc_last_message_kept_after_leave, muc_before_test, muc_after_test),
+        unit_test_setup_teardown(test_muc_last_activity_uses_session_mark, muc_before_test, muc_after_test),
+        unit_test_setup_teardown(test_muc_message_seen_after_remember, muc_before_test, muc_after_test),
+        unit_test_setup_teardown(test_muc_message_seen_once_per_remember, muc_before_test, muc_after_test),
+        unit_test_setup_teardown(test_muc_message_not_seen_when_stamped_after_margin, muc_before_test, muc_after_test),
+        unit_test_setup_teardown(test_muc_message_seen_until_server_stamp, muc_before_test, muc_after_test),
+        unit_test_setup_teardown(test_muc_message_seen_forgets_oldest, muc_before_test, muc_after_test),
+        unit_test_setup_teardown(test_muc_roster_ac_built_on_demand, muc_before_test, muc_after_test),
 
         unit_test(cmd_bookmark_shows_message_when_disconnected),
         unit_test(cmd_bookmark_shows_message_when_disconnecting),
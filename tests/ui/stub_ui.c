@@ -99,6 +99,10 @@ unsigned long ui_get_idle_time(void)
 }
 
 void ui_reset_idle_time(void) {}
+gboolean ui_has_focus(void)
+{
+    return TRUE;
+}
 void ui_new_chat_win(const char * const barejid) {}
 void ui_new_private_win(const char * const fulljid) {}
 void ui_print_system_msg_from_recipient(const char * const barejid, const char *message) {}
@@ -184,6 +188,31 @@ void ui_page_down(void) {}
 void ui_subwin_page_up(void) {}
 void ui_subwin_page_down(void) {}
 
+void ui_save_session(const char * const account) {}
+gboolean ui_restore_session(const char * const account)
+{
+    return FALSE;
+}
+gboolean ui_restore_session_step(void)
+{
+    return FALSE;
+}
+void ui_update_scrollback_budget(void) {}
+
+int ui_find(const char * const text)
+{
+    return 0;
+}
+gboolean ui_find_older(void)
+{
+    return FALSE;
+}
+gboolean ui_find_newer(void)
+{
+    return FALSE;
+}
+void ui_find_clear(void) {}
+
 char * ui_ask_password(void)
 {
     return mock_ptr_type(char *);
@@ -221,7 +250,10 @@ void ui_room_occupant_role_and_affiliation_change(const char * const roomjid, co
     const char * const affiliation, const char * const actor, const char * const reason) {}
 void ui_room_roster(const char * const roomjid, GList *occupants, const char * const presence) {}
 void ui_room_history(const char * const roomjid, const char * const nick,
-    GTimeVal tv_stamp, const char * const message) {}
+    GTimeVal tv_stamp, const char * const message)
+{
+    check_expected(message);
+}
 void ui_room_message(const char * const roomjid, const char * const nick,
     const char * const message) {}
 void ui_room_subject(const char * const roomjid, const char * const nick, const char * const subject) {}
@@ -341,6 +373,9 @@ void ui_input_nonblocking(gboolean reset) {}
 
 void ui_invalid_command_usage(const char * const usage, void (*setting_func)(void)) {}
 
+void ui_show_log_context(const char * const contact, gboolean room,
+    const char * const date, GSList *lines, int hit_line) {}
+
 void ui_create_xmlconsole_win(void) {}
 gboolean ui_xmlconsole_exists(void)
 {
@@ -348,6 +383,10 @@ gboolean ui_xmlconsole_exists(void)
 }
 
 void ui_open_xmlconsole_win(void) {}
+void ui_xmlconsole_filter_dir(stanza_dir_t dir) {}
+void ui_xmlconsole_filter_kind(stanza_kind_t kind) {}
+void ui_xmlconsole_filter_jid(const char * const jid) {}
+void ui_xmlconsole_clear(void) {}
 
 gboolean ui_win_has_unsaved_form(int num)
 {
@@ -469,6 +508,8 @@ void cons_intype_setting(void) {}
 void cons_gone_setting(void) {}
 void cons_history_setting(void) {}
 void cons_carbons_setting(void) {}
+void cons_sm_setting(void) {}
+void cons_csi_setting(void) {}
 void cons_log_setting(void) {}
 void cons_chlog_setting(void) {}
 void cons_grlog_setting(void) {}
@@ -478,6 +519,8 @@ void cons_autoping_setting(void) {}
 void cons_priority_setting(void) {}
 void cons_autoconnect_setting(void) {}
 void cons_inpblock_setting(void) {}
+void cons_scrollback_setting(void) {}
+void cons_snapshot_setting(void) {}
 
 void cons_show_contact_online(PContact contact, Resource *resource, GDateTime *last_activity)
 {
@@ -4,6 +4,7 @@
 #include <cmocka.h>
 
 #include "xmpp/xmpp.h"
+#include "xmpp/connection.h"
 
 // connection functions
 void jabber_init(const int disable_tls) {}
@@ -27,6 +28,10 @@ jabber_conn_status_t jabber_connect_with_account(const ProfAccount * const accou
 void jabber_disconnect(void) {}
 void jabber_shutdown(void) {}
 void jabber_process_events(void) {}
+void jabber_enable_stream_management(void) {}
+void jabber_set_client_active(gboolean active) {}
+void jabber_capture_stanzas(gboolean capture) {}
+void jabber_get_traffic_stats(TrafficStats *stats) {}
 const char * jabber_get_fulljid(void)
 {
     return (char *)mock();
@@ -57,6 +62,22 @@ GList * jabber_get_available_resources(void)
     return NULL;
 }
 
+// only ever compared against NULL by the code under test
+xmpp_conn_t * connection_get_conn(void)
+{
+    return (xmpp_conn_t*)1;
+}
+
+xmpp_ctx_t * connection_get_ctx(void)
+{
+    return NULL;
+}
+
+void connection_send_raw(const char * const data, const size_t len)
+{
+    check_expected(data);
+}
+
 // message functions
 void message_send_chat(const char * const barejid, const char * const msg)
 {
@@ -144,11 +165,17 @@ void iq_submit_room_config(const char * const room, DataForm *form) {}
 void iq_room_config_cancel(const char * const room_jid) {}
 void iq_send_ping(const char * const target) {}
 void iq_send_caps_request(const char * const to, const char * const id,
-    const char * const node, const char * const ver) {}
+    const char * const node, const char * const ver)
+{
+    check_expected(to);
+}
 void iq_send_caps_request_for_jid(const char * const to, const char * const id,
     const char * const node, const char * const ver) {}
 void iq_send_caps_request_legacy(const char * const to, const char * const id,
-    const char * const node, const char * const ver) {}
+    const char * const node, const char * const ver)
+{
+    check_expected(to);
+}
 void iq_room_info_request(gchar *room) {}
 void iq_room_affiliation_list(const char * const room, char *affiliation) {}
 void iq_room_affiliation_set(const char * const room, const char * const jid, char *affiliation,
@@ -158,15 +185,6 @@ void iq_room_role_set(const char * const room, const char * const nick, char *ro
     const char * const reason) {}
 void iq_room_role_list(const char * const room, char *role) {}
 
-// caps functions
-Capabilities* caps_lookup(const char * const jid)
-{
-    return NULL;
-}
-
-void caps_close(void) {}
-void caps_destroy(Capabilities *caps) {}
-
 gboolean bookmark_add(const char *jid, const char *nick, const char *password, const char *autojoin_str)
 {
     check_expected(jid);
@@ -203,6 +221,7 @@ char * bookmark_find(const char * const search_str)
 }
 
 void bookmark_autocomplete_reset(void) {}
+void bookmark_autojoin_complete(const char * const room) {}
 
 void roster_send_name_change(const char * const barejid, const char * const new_name, GSList *groups)
 {